@@ -0,0 +1,222 @@
+#include "./bench.h"
+
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/utils/logger.h"
+#include "../src/utils/memory.h"
+
+static int bench_compare_samples(const void* a, const void* b) {
+  double lhs = *(const double*)a;
+  double rhs = *(const double*)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// nearest rank, samples must be sorted
+static double bench_percentile(const double* samples,
+                               uint32_t count,
+                               uint32_t percent) {
+  uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+  return samples[rank > 0 ? rank - 1 : 0];
+}
+
+Result(int, ErrorMessage) bench_init(Bench* bench,
+                                     uint32_t iteration_override,
+                                     uint32_t warmup_count,
+                                     const char* filter) {
+  bench_reset(bench);
+  bench->iteration_override = iteration_override;
+  bench->warmup_count = warmup_count;
+  bench->filter = filter;
+  bench->frequency = SDL_GetPerformanceFrequency();
+  bench->is_bench_init = true;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void bench_reset(Bench* bench) {
+  bench->iteration_override = 0;
+  bench->warmup_count = BENCH_DEFAULT_WARMUP;
+  bench->filter = nullptr;
+  bench->context[0] = '\0';
+  bench->frequency = 1;
+  bench->sample_start = 0;
+  bench->samples_us = nullptr;
+  bench->sample_capacity = 0;
+  bench->sample_count = 0;
+  bench->run_count = 0;
+  bench->case_iterations = 0;
+  bench->result_count = 0;
+  bench->is_case_running = false;
+  bench->is_bench_init = false;
+}
+
+void bench_destroy(Bench* bench) {
+  if (!bench->is_bench_init) {
+    return;
+  }
+  mem_free(bench->samples_us);
+  bench_reset(bench);
+}
+
+bool bench_case_begin(Bench* bench,
+                      const char* name,
+                      uint32_t iterations,
+                      uint32_t items) {
+  if (bench->filter && !strstr(name, bench->filter)) {
+    return false;
+  }
+  if (bench->result_count == BENCH_MAX_RESULTS) {
+    log_warning("Skipping benchmark %s, too many results", name);
+    return false;
+  }
+  if (bench->iteration_override > 0) {
+    iterations = bench->iteration_override;
+  }
+  if (iterations > bench->sample_capacity) {
+    double* samples =
+        mem_realloc(bench->samples_us, sizeof(double) * iterations);
+    if (!samples) {
+      log_warning("Skipping benchmark %s, out of memory", name);
+      return false;
+    }
+    bench->samples_us = samples;
+    bench->sample_capacity = iterations;
+  }
+
+  BenchResult* result = &bench->results[bench->result_count];
+  *result = (BenchResult){.items = items};
+  SDL_strlcpy(result->name, name, sizeof(result->name));
+  bench->sample_count = 0;
+  bench->run_count = 0;
+  bench->case_iterations = iterations;
+  bench->is_case_running = true;
+  log_info("Running %s (%u iterations)", result->name, iterations);
+  return true;
+}
+
+bool bench_case_next(Bench* bench) {
+  return bench->run_count < bench->warmup_count + bench->case_iterations;
+}
+
+void bench_start(Bench* bench) {
+  bench->sample_start = SDL_GetPerformanceCounter();
+}
+
+void bench_stop(Bench* bench) {
+  uint64_t end = SDL_GetPerformanceCounter();
+  if (bench->run_count++ < bench->warmup_count) {
+    return;
+  }
+  bench->samples_us[bench->sample_count++] =
+      (double)(end - bench->sample_start) * 1000000.0 /
+      (double)bench->frequency;
+}
+
+void bench_case_end(Bench* bench) {
+  bench->is_case_running = false;
+  uint32_t count = bench->sample_count;
+  if (count == 0) {
+    return;
+  }
+
+  double* samples = bench->samples_us;
+  qsort(samples, count, sizeof(double), bench_compare_samples);
+  double sum = 0.0;
+  for (uint32_t i = 0; i < count; i++) {
+    sum += samples[i];
+  }
+
+  BenchResult* result = &bench->results[bench->result_count++];
+  result->iterations = count;
+  result->min_us = samples[0];
+  result->mean_us = sum / count;
+  result->p50_us = bench_percentile(samples, count, 50);
+  result->p95_us = bench_percentile(samples, count, 95);
+  result->p99_us = bench_percentile(samples, count, 99);
+  result->max_us = samples[count - 1];
+}
+
+void bench_case_abort(Bench* bench) {
+  bench->is_case_running = false;
+  bench->sample_count = 0;
+}
+
+const BenchResult* bench_find_result(const Bench* bench, const char* name) {
+  for (uint32_t i = 0; i < bench->result_count; i++) {
+    if (strcmp(bench->results[i].name, name) == 0) {
+      return &bench->results[i];
+    }
+  }
+  return nullptr;
+}
+
+void bench_log_results(const Bench* bench) {
+  log_info("Benchmarks on %s, microseconds per iteration", bench->context);
+  log_info("  %-28s %7s %11s %11s %11s %11s", "name", "iters", "p50", "p95",
+           "p99", "max");
+  for (uint32_t i = 0; i < bench->result_count; i++) {
+    const BenchResult* result = &bench->results[i];
+    log_info("  %-28s %7u %11.2f %11.2f %11.2f %11.2f", result->name,
+             result->iterations, result->p50_us, result->p95_us,
+             result->p99_us, result->max_us);
+  }
+}
+
+// the context holds a driver supplied device name, anything below a space is
+// dropped
+static void bench_escape(const char* text, char* escaped, size_t size) {
+  size_t length = 0;
+  for (const char* c = text; *c && length + 2 < size; c++) {
+    if ((unsigned char)*c < ' ') {
+      continue;
+    }
+    if (*c == '"' || *c == '\\') {
+      escaped[length++] = '\\';
+    }
+    escaped[length++] = *c;
+  }
+  escaped[length] = '\0';
+}
+
+Result(int, ErrorMessage)
+    bench_write_json(const Bench* bench, const char* path) {
+  SDL_RWops* file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+
+  char context[BENCH_CONTEXT_SIZE * 2];
+  bench_escape(bench->context, context, sizeof(context));
+  char line[BENCH_CONTEXT_SIZE * 2 + 128];
+  int length = SDL_snprintf(line, sizeof(line),
+                            "{\"version\":1,\"context\":\"%s\",\"unit\":\"us\","
+                            "\"results\":[",
+                            context);
+  bool success = length > 0 && (size_t)length < sizeof(line) &&
+                 SDL_RWwrite(file, line, (size_t)length, 1) == 1;
+
+  for (uint32_t i = 0; i < bench->result_count && success; i++) {
+    const BenchResult* result = &bench->results[i];
+    char name[BENCH_NAME_SIZE * 2];
+    bench_escape(result->name, name, sizeof(name));
+    length = SDL_snprintf(
+        line, sizeof(line),
+        "%s\n{\"name\":\"%s\",\"iterations\":%u,\"items\":%u,\"min\":%.3f,"
+        "\"mean\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+        i > 0 ? "," : "", name, result->iterations, result->items,
+        result->min_us, result->mean_us, result->p50_us, result->p95_us,
+        result->p99_us, result->max_us);
+    success = length > 0 && (size_t)length < sizeof(line) &&
+              SDL_RWwrite(file, line, (size_t)length, 1) == 1;
+  }
+
+  static const char footer[] = "\n]}\n";
+  success = success && SDL_RWwrite(file, footer, sizeof(footer) - 1, 1) == 1;
+  success = SDL_RWclose(file) == 0 && success;
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to write benchmark results");
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,89 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdint.h>
+
+#include "../src/result.h"
+
+#define BENCH_MAX_RESULTS 64
+#define BENCH_NAME_SIZE 64
+#define BENCH_CONTEXT_SIZE 256
+// iterations run before a case starts collecting samples
+#define BENCH_DEFAULT_WARMUP 3
+
+typedef struct BenchResult {
+  char name[BENCH_NAME_SIZE];
+  uint32_t iterations;
+  // units of work per iteration (draws, allocations), 0 when the iteration
+  // itself is the unit
+  uint32_t items;
+  double min_us;
+  double mean_us;
+  double p50_us;
+  double p95_us;
+  double p99_us;
+  double max_us;
+} BenchResult;
+
+// Runs benchmark cases one after another. A case runs its warmup iterations,
+// then times iteration_count more, each timed between bench_start and
+// bench_stop. Percentiles use the nearest rank of the sorted samples.
+//
+//   if (bench_case_begin(bench, "name", 100, 0)) {
+//     while (bench_case_next(bench)) {
+//       bench_start(bench);
+//       ...
+//       bench_stop(bench);
+//     }
+//     bench_case_end(bench);
+//   }
+typedef struct Bench {
+  // per case iteration count when not 0, instead of the case's own default
+  uint32_t iteration_override;
+  uint32_t warmup_count;
+  // only cases whose name contains it run, nullptr runs them all
+  const char* filter;
+  // adapter and build the results were taken on, written to the report
+  char context[BENCH_CONTEXT_SIZE];
+  uint64_t frequency;
+  uint64_t sample_start;
+  // samples of the running case
+  double* samples_us;
+  uint32_t sample_capacity;
+  uint32_t sample_count;
+  uint32_t run_count;
+  uint32_t case_iterations;
+  BenchResult results[BENCH_MAX_RESULTS];
+  uint32_t result_count;
+  bool is_case_running;
+  bool is_bench_init;
+} Bench;
+
+Result(int, ErrorMessage) bench_init(Bench* bench,
+                                     uint32_t iteration_override,
+                                     uint32_t warmup_count,
+                                     const char* filter);
+void bench_reset(Bench* bench);
+void bench_destroy(Bench* bench);
+
+// false when the filter skips the case, nothing else may be called for it
+bool bench_case_begin(Bench* bench,
+                      const char* name,
+                      uint32_t iterations,
+                      uint32_t items);
+// true while warmup or timed iterations are left
+bool bench_case_next(Bench* bench);
+void bench_start(Bench* bench);
+void bench_stop(Bench* bench);
+// sorts the samples into a result, a case without samples records nothing
+void bench_case_end(Bench* bench);
+// ends the running case without a result, after a failed iteration
+void bench_case_abort(Bench* bench);
+
+// nullptr when the case has not run
+const BenchResult* bench_find_result(const Bench* bench, const char* name);
+void bench_log_results(const Bench* bench);
+Result(int, ErrorMessage)
+    bench_write_json(const Bench* bench, const char* path);
+
+#endif
@@ -0,0 +1,2477 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "../src/assets/mesh_convert.h"
+#include "../src/assets/texture_format.h"
+#include "../src/math/batch.h"
+#include "../src/math/simd.h"
+#include "../src/result.h"
+#include "../src/utils/arena.h"
+#include "../src/utils/job_system.h"
+#include "../src/utils/logger.h"
+#include "../src/utils/memory.h"
+#include "../src/vulkan_backend/allocator.h"
+#include "../src/vulkan_backend/bindless.h"
+#include "../src/vulkan_backend/compute_queue.h"
+#include "../src/vulkan_backend/debug.h"
+#include "../src/vulkan_backend/descriptor_allocator.h"
+#include "../src/vulkan_backend/device.h"
+#include "../src/vulkan_backend/frame_scheduler.h"
+#include "../src/vulkan_backend/function_loader.h"
+#include "../src/vulkan_backend/functions.h"
+#include "../src/vulkan_backend/indirect_scene.h"
+#include "../src/vulkan_backend/layout_cache.h"
+#include "../src/vulkan_backend/mesh.h"
+#include "../src/vulkan_backend/parallel_recorder.h"
+#include "../src/vulkan_backend/pipeline_cache.h"
+#include "../src/vulkan_backend/pipeline_compiler.h"
+#include "../src/vulkan_backend/shader_cache.h"
+#include "../src/vulkan_backend/texture_streamer.h"
+#include "../src/vulkan_backend/uploader.h"
+#include "./bench.h"
+
+#if defined(_WIN32)
+#define VULKAN_LIBRARY_NAME "vulkan-1.dll"
+#elif defined(__APPLE__)
+#define VULKAN_LIBRARY_NAME "libvulkan.1.dylib"
+#else
+#define VULKAN_LIBRARY_NAME "libvulkan.so.1"
+#endif
+
+#ifdef DEBUG
+#define BENCH_BUILD "debug"
+#else
+#define BENCH_BUILD "prod"
+#endif
+
+#define BENCH_DEFAULT_DRAW_COUNT 16384
+#define BENCH_DEFAULT_INSTANCE_COUNT 16384
+#define BENCH_ALLOCATION_COUNT 256
+#define BENCH_BUFFER_COUNT 64
+// twice the sets of the first pool in a chain, every frame chains a second
+#define BENCH_DESCRIPTOR_SET_COUNT (VULKAN_DESCRIPTOR_POOL_MIN_SETS * 2)
+// materials the binding cases cycle through, one storage buffer range each
+#define BENCH_BIND_MATERIAL_COUNT 256
+#define BENCH_BIND_MATERIAL_SIZE 256
+// side of the RGBA8 textures the streaming case writes, a full chain of
+// one of them is about 5.3 MiB
+#define BENCH_TEXTURE_SIZE 1024
+#define BENCH_TEXTURE_COUNT 2
+// level 0 of a bench texture fits half of it, only the budget keeps it out
+#define BENCH_TEXTURE_RING_SIZE (8u * 1024 * 1024)
+// holds the level 1 chain of one texture next to the coarse levels of the
+// other, not level 0 of either
+#define BENCH_TEXTURE_BUDGET (2u * 1024 * 1024)
+// a stream in taking longer than this is stuck
+#define BENCH_TEXTURE_TIMEOUT_MS 5000
+// quads a side of the grid the mesh cases write as OBJ, 65536 vertices
+#define BENCH_MESH_GRID_SIZE 255
+#define BENCH_MESH_RING_SIZE (8u * 1024 * 1024)
+// relative to the larger magnitude, the SIMD kernels may fuse or reorder the
+// multiply adds of the scalar ones
+#define BENCH_MATH_TOLERANCE 1e-4f
+// what the graphics queue clears while the compute cases measure overlap
+#define BENCH_FILL_SIZE (32u * 1024 * 1024)
+// results this close to a plane may round either way on the GPU
+#define BENCH_CULL_TOLERANCE 1e-3f
+
+typedef struct BenchConfig {
+  // 0 keeps the default of every case
+  uint32_t iterations;
+  uint32_t warmup;
+  const char* filter;
+  // nullptr only logs the results
+  const char* json_path;
+  // draw list length of the recording cases
+  uint32_t draw_count;
+  // transforms, boxes and matrices of the math cases
+  uint32_t instance_count;
+  // largest job system the recording cases scale up to, 0 uses every core
+  uint32_t max_workers;
+  // SPIR-V of shaders/cull.comp, nullptr skips the compute cases
+  const char* cull_shader_path;
+} BenchConfig;
+
+// Runs headless: the loader is opened directly and the device is created
+// without a surface, so a software ICD such as lavapipe picked through
+// VK_DRIVER_FILES is enough. The instance has no layers or extensions, the
+// cases measure the engine and the driver, not the validation layers.
+typedef struct BenchVulkan {
+  void* vulkan_library;
+  VkInstance instance;
+  VulkanInstanceFunctions instance_fn;
+  VulkanDevice device;
+  VulkanAllocator allocator;
+  bool is_vulkan_library_init;
+  bool is_instance_init;
+} BenchVulkan;
+
+static bool bench_parse_uint(const char* value, uint32_t* out) {
+  if (value == nullptr || *value == '\0') {
+    return false;
+  }
+  char* end = nullptr;
+  unsigned long parsed = SDL_strtoul(value, &end, 10);
+  if (*end != '\0' || parsed > UINT32_MAX) {
+    return false;
+  }
+  *out = (uint32_t)parsed;
+  return true;
+}
+
+static Result(int, ErrorMessage)
+    bench_config_parse(BenchConfig* config, int argc, char* argv[argc + 1]) {
+  *config = (BenchConfig){
+      .warmup = BENCH_DEFAULT_WARMUP,
+      .draw_count = BENCH_DEFAULT_DRAW_COUNT,
+      .instance_count = BENCH_DEFAULT_INSTANCE_COUNT,
+  };
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--iterations") == 0) {
+      if (!bench_parse_uint(value, &config->iterations)) {
+        return Err(int, ErrorMessage)("--iterations expects an integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--warmup") == 0) {
+      if (!bench_parse_uint(value, &config->warmup)) {
+        return Err(int, ErrorMessage)("--warmup expects an integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--filter") == 0) {
+      if (!value) {
+        return Err(int, ErrorMessage)("--filter expects a case name");
+      }
+      config->filter = value;
+      i++;
+    } else if (strcmp(arg, "--json") == 0) {
+      if (!value) {
+        return Err(int, ErrorMessage)("--json expects a file path");
+      }
+      config->json_path = value;
+      i++;
+    } else if (strcmp(arg, "--draws") == 0) {
+      if (!bench_parse_uint(value, &config->draw_count) ||
+          config->draw_count == 0) {
+        return Err(int, ErrorMessage)("--draws expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--instances") == 0) {
+      if (!bench_parse_uint(value, &config->instance_count) ||
+          config->instance_count == 0) {
+        return Err(int, ErrorMessage)(
+            "--instances expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--workers") == 0) {
+      if (!bench_parse_uint(value, &config->max_workers)) {
+        return Err(int, ErrorMessage)("--workers expects an integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--cull-shader") == 0) {
+      if (!value) {
+        return Err(int, ErrorMessage)("--cull-shader expects a file path");
+      }
+      config->cull_shader_path = value;
+      i++;
+    } else {
+      return Err(int, ErrorMessage)("Unknown argument");
+    }
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static VkResult bench_create_instance(VkInstance* instance) {
+  VkApplicationInfo application_info = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pNext = nullptr,
+      .pApplicationName = "Hello Vulkan! bench",
+      .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+      .pEngineName = "Jammy Engine",
+      .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+      .apiVersion = VK_API_VERSION_1_3,
+  };
+  VkInstanceCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .pApplicationInfo = &application_info,
+      .enabledLayerCount = 0,
+      .ppEnabledLayerNames = nullptr,
+      .enabledExtensionCount = 0,
+      .ppEnabledExtensionNames = nullptr,
+  };
+  return vkCreateInstance(&create_info, nullptr, instance);
+}
+
+static void bench_vulkan_reset(BenchVulkan* vk) {
+  vk->vulkan_library = nullptr;
+  vk->instance = VK_NULL_HANDLE;
+  vk->instance_fn = (VulkanInstanceFunctions){0};
+  vulkan_device_reset(&vk->device);
+  vulkan_allocator_reset(&vk->allocator);
+  vk->is_vulkan_library_init = false;
+  vk->is_instance_init = false;
+}
+
+static Result(int, ErrorMessage) bench_vulkan_init(BenchVulkan* vk) {
+  vk->vulkan_library = SDL_LoadObject(VULKAN_LIBRARY_NAME);
+  if (!vk->vulkan_library) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  vk->is_vulkan_library_init = true;
+
+  PFN_vkGetInstanceProcAddr vk_get_proc =
+      (PFN_vkGetInstanceProcAddr)SDL_LoadFunction(vk->vulkan_library,
+                                                  "vkGetInstanceProcAddr");
+  if (!vk_get_proc) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  auto result = vulkan_load_external_function(vk_get_proc);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_load_global_functions();
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkResult vk_result = bench_create_instance(&vk->instance);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  vk->is_instance_init = true;
+  result = vulkan_load_instance_functions(&vk->instance_fn, vk->instance,
+                                          nullptr, 0, 0, nullptr);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  result = vulkan_device_init(&vk->device, &vk->instance_fn, vk->instance,
+                              VK_NULL_HANDLE);
+  if (!result.is_ok) {
+    return result;
+  }
+  return vulkan_allocator_init(&vk->allocator, &vk->device);
+}
+
+static void bench_vulkan_destroy(BenchVulkan* vk) {
+  if (vk->device.is_device_init) {
+    vk->device.fn.vkDeviceWaitIdle(vk->device.device);
+  }
+  vulkan_allocator_destroy(&vk->allocator);
+  vulkan_device_destroy(&vk->device);
+  if (vk->is_instance_init) {
+    vk->instance_fn.vkDestroyInstance(vk->instance, nullptr);
+  }
+  if (vk->is_vulkan_library_init) {
+    SDL_UnloadObject(vk->vulkan_library);
+  }
+  bench_vulkan_reset(vk);
+}
+
+static Result(int, ErrorMessage)
+    bench_instance(Bench* bench, BenchVulkan* vk) {
+  if (bench_case_begin(bench, "instance.create", 50, 0)) {
+    while (bench_case_next(bench)) {
+      VkInstance instance = VK_NULL_HANDLE;
+      bench_start(bench);
+      VkResult result = bench_create_instance(&instance);
+      bench_stop(bench);
+      if (result != VK_SUCCESS) {
+        bench_case_abort(bench);
+        return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+      }
+      // the table is not needed for anything else
+      PFN_vkDestroyInstance destroy_instance =
+          (PFN_vkDestroyInstance)vkGetInstanceProcAddr(instance,
+                                                       "vkDestroyInstance");
+      destroy_instance(instance, nullptr);
+    }
+    bench_case_end(bench);
+  }
+
+  if (bench_case_begin(bench, "instance.load_functions", 1000, 0)) {
+    while (bench_case_next(bench)) {
+      VulkanInstanceFunctions functions;
+      bench_start(bench);
+      auto result = vulkan_load_instance_functions(&functions, vk->instance,
+                                                   nullptr, 0, 0, nullptr);
+      bench_stop(bench);
+      if (!result.is_ok) {
+        bench_case_abort(bench);
+        return result;
+      }
+    }
+    bench_case_end(bench);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) bench_device(Bench* bench, BenchVulkan* vk) {
+  if (bench_case_begin(bench, "device.create", 50, 0)) {
+    while (bench_case_next(bench)) {
+      VulkanDevice device;
+      vulkan_device_reset(&device);
+      // adapter selection and function loading are part of it
+      bench_start(bench);
+      auto result = vulkan_device_init(&device, &vk->instance_fn, vk->instance,
+                                       VK_NULL_HANDLE);
+      bench_stop(bench);
+      vulkan_device_destroy(&device);
+      if (!result.is_ok) {
+        bench_case_abort(bench);
+        return result;
+      }
+    }
+    bench_case_end(bench);
+  }
+
+  const VulkanDevice* device = &vk->device;
+  if (bench_case_begin(bench, "device.load_functions", 1000, 0)) {
+    while (bench_case_next(bench)) {
+      VulkanDeviceFunctions functions;
+      bench_start(bench);
+      auto result = vulkan_load_device_functions(
+          &functions, &vk->instance_fn, device->device,
+          (const char**)device->enabled_extensions,
+          device->enabled_extension_count, device->required_extension_count,
+          nullptr);
+      bench_stop(bench);
+      if (!result.is_ok) {
+        bench_case_abort(bench);
+        return result;
+      }
+    }
+    bench_case_end(bench);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static uint32_t bench_random(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static Result(int, ErrorMessage)
+    bench_allocator(Bench* bench, BenchVulkan* vk) {
+  const VulkanDeviceFunctions* fn = &vk->device.fn;
+  VkDevice device = vk->device.device;
+
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = 64 * 1024,
+      .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+
+  if (bench_case_begin(bench, "allocator.allocate_free", 200,
+                       BENCH_ALLOCATION_COUNT)) {
+    // memory types a vertex buffer may live in
+    VkBuffer probe = VK_NULL_HANDLE;
+    VkResult vk_result = fn->vkCreateBuffer(device, &buffer_info, nullptr,
+                                            &probe);
+    if (vk_result != VK_SUCCESS) {
+      bench_case_abort(bench);
+      return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+    }
+    VkMemoryRequirements probe_requirements;
+    fn->vkGetBufferMemoryRequirements(device, probe, &probe_requirements);
+    fn->vkDestroyBuffer(device, probe, nullptr);
+
+    VulkanAllocation allocations[BENCH_ALLOCATION_COUNT];
+    uint32_t random_state = 0x9e3779b9u;
+    while (bench_case_next(bench)) {
+      // 1 KiB to 1 MiB, freed odd indices first so the buddies have to
+      // merge out of order
+      bench_start(bench);
+      for (uint32_t i = 0; i < BENCH_ALLOCATION_COUNT; i++) {
+        VkMemoryRequirements requirements = {
+            .size = (VkDeviceSize)1024 << (bench_random(&random_state) % 11),
+            .alignment = probe_requirements.alignment,
+            .memoryTypeBits = probe_requirements.memoryTypeBits,
+        };
+        auto result = vulkan_allocator_allocate(
+            &vk->allocator, &requirements, 0,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_ALLOCATION_KIND_LINEAR,
+            &allocations[i]);
+        if (!result.is_ok) {
+          for (uint32_t j = 0; j < i; j++) {
+            vulkan_allocator_free(&vk->allocator, &allocations[j]);
+          }
+          bench_case_abort(bench);
+          return result;
+        }
+      }
+      for (uint32_t parity = 1; parity <= 2; parity++) {
+        for (uint32_t i = parity % 2; i < BENCH_ALLOCATION_COUNT; i += 2) {
+          vulkan_allocator_free(&vk->allocator, &allocations[i]);
+        }
+      }
+      bench_stop(bench);
+    }
+    bench_case_end(bench);
+  }
+
+  if (bench_case_begin(bench, "allocator.create_buffer", 200,
+                       BENCH_BUFFER_COUNT)) {
+    VkBuffer buffers[BENCH_BUFFER_COUNT];
+    VulkanAllocation allocations[BENCH_BUFFER_COUNT];
+    while (bench_case_next(bench)) {
+      bench_start(bench);
+      for (uint32_t i = 0; i < BENCH_BUFFER_COUNT; i++) {
+        auto result = vulkan_allocator_create_buffer(
+            &vk->allocator, &buffer_info, 0,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffers[i], &allocations[i]);
+        if (!result.is_ok) {
+          for (uint32_t j = 0; j < i; j++) {
+            vulkan_allocator_destroy_buffer(&vk->allocator, buffers[j],
+                                            &allocations[j]);
+          }
+          bench_case_abort(bench);
+          return result;
+        }
+      }
+      for (uint32_t i = 0; i < BENCH_BUFFER_COUNT; i++) {
+        vulkan_allocator_destroy_buffer(&vk->allocator, buffers[i],
+                                        &allocations[i]);
+      }
+      bench_stop(bench);
+    }
+    bench_case_end(bench);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// a draw without the draw: the dynamic state a real one sets, valid without
+// a pipeline or render pass and free for the GPU to execute
+static void bench_record_items(VkCommandBuffer command_buffer,
+                               uint32_t first,
+                               uint32_t count,
+                               void* user_data) {
+  const VulkanDeviceFunctions* fn = user_data;
+  for (uint32_t i = first; i < first + count; i++) {
+    VkViewport viewport = {
+        .x = (float)(i % 64),
+        .y = 0.0f,
+        .width = 256.0f,
+        .height = 256.0f,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    VkRect2D scissor = {
+        .offset = {(int32_t)(i % 64), 0},
+        .extent = {256, 256},
+    };
+    float blend_constants[4] = {(float)(i % 256) / 255.0f, 0.0f, 0.0f, 1.0f};
+    fn->vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    fn->vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    fn->vkCmdSetDepthBias(command_buffer, 0.0f, 0.0f, (float)(i % 4));
+    fn->vkCmdSetBlendConstants(command_buffer, blend_constants);
+  }
+}
+
+typedef struct BenchCommands {
+  VkCommandPool command_pool;
+  VkCommandBuffer command_buffer;
+  VkFence fence;
+  bool is_command_pool_init;
+  bool is_fence_init;
+} BenchCommands;
+
+static Result(int, ErrorMessage)
+    bench_commands_init(BenchCommands* commands, const VulkanDevice* device) {
+  *commands = (BenchCommands){0};
+  VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = device->graphics_queue_family,
+  };
+  VkResult result = device->fn.vkCreateCommandPool(
+      device->device, &pool_info, nullptr, &commands->command_pool);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  commands->is_command_pool_init = true;
+
+  VkCommandBufferAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = commands->command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  result = device->fn.vkAllocateCommandBuffers(device->device, &allocate_info,
+                                               &commands->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkFenceCreateInfo fence_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = device->fn.vkCreateFence(device->device, &fence_info, nullptr,
+                                    &commands->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  commands->is_fence_init = true;
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void bench_commands_destroy(BenchCommands* commands,
+                                   const VulkanDevice* device) {
+  if (commands->is_fence_init) {
+    device->fn.vkDestroyFence(device->device, commands->fence, nullptr);
+  }
+  if (commands->is_command_pool_init) {
+    device->fn.vkDestroyCommandPool(device->device, commands->command_pool,
+                                    nullptr);
+  }
+  *commands = (BenchCommands){0};
+}
+
+static VkResult bench_commands_begin(BenchCommands* commands,
+                                     const VulkanDevice* device) {
+  VkResult result = device->fn.vkResetCommandPool(
+      device->device, commands->command_pool, 0);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  return device->fn.vkBeginCommandBuffer(commands->command_buffer,
+                                         &begin_info);
+}
+
+static Result(int, ErrorMessage) bench_record_parallel(Bench* bench,
+                                                       BenchVulkan* vk,
+                                                       BenchCommands* commands,
+                                                       uint32_t worker_count,
+                                                       uint32_t draw_count) {
+  char name[BENCH_NAME_SIZE];
+  SDL_snprintf(name, sizeof(name), "record.parallel.w%u", worker_count);
+  if (!bench_case_begin(bench, name, 200, draw_count)) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  const VulkanDevice* device = &vk->device;
+  JobSystem job_system;
+  VulkanParallelRecorder recorder;
+  job_system_reset(&job_system);
+  vulkan_parallel_recorder_reset(&recorder);
+  auto result = job_system_init(&job_system, worker_count);
+  if (result.is_ok) {
+    result = vulkan_parallel_recorder_init(&recorder, device, &job_system, 1);
+  }
+
+  while (result.is_ok && bench_case_next(bench)) {
+    bench_start(bench);
+    VkResult vk_result = bench_commands_begin(commands, device);
+    if (vk_result != VK_SUCCESS) {
+      result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+      break;
+    }
+    // nothing is submitted, the worker pools are always free to reset
+    result = vulkan_parallel_recorder_begin_frame(&recorder, 0);
+    if (result.is_ok) {
+      result = vulkan_parallel_recorder_record(
+          &recorder, commands->command_buffer, nullptr, draw_count,
+          bench_record_items, (void*)&device->fn);
+    }
+    vk_result = device->fn.vkEndCommandBuffer(commands->command_buffer);
+    if (result.is_ok && vk_result != VK_SUCCESS) {
+      result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+    }
+    bench_stop(bench);
+  }
+
+  if (result.is_ok) {
+    bench_case_end(bench);
+  } else {
+    bench_case_abort(bench);
+  }
+  vulkan_parallel_recorder_destroy(&recorder);
+  job_system_destroy(&job_system);
+  return result;
+}
+
+static Result(int, ErrorMessage) bench_record(Bench* bench,
+                                              BenchVulkan* vk,
+                                              const BenchConfig* config) {
+  const VulkanDevice* device = &vk->device;
+  BenchCommands commands;
+  auto result = bench_commands_init(&commands, device);
+  if (!result.is_ok) {
+    bench_commands_destroy(&commands, device);
+    return result;
+  }
+
+  // the baseline the parallel cases are compared against
+  if (bench_case_begin(bench, "record.serial", 200, config->draw_count)) {
+    while (bench_case_next(bench)) {
+      bench_start(bench);
+      VkResult vk_result = bench_commands_begin(&commands, device);
+      if (vk_result == VK_SUCCESS) {
+        bench_record_items(commands.command_buffer, 0, config->draw_count,
+                           (void*)&device->fn);
+        vk_result = device->fn.vkEndCommandBuffer(commands.command_buffer);
+      }
+      bench_stop(bench);
+      if (vk_result != VK_SUCCESS) {
+        result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+        break;
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  uint32_t max_workers = config->max_workers;
+  if (max_workers == 0) {
+    max_workers = (uint32_t)SDL_GetCPUCount();
+  }
+  if (max_workers > JOB_SYSTEM_MAX_WORKERS) {
+    max_workers = JOB_SYSTEM_MAX_WORKERS;
+  }
+  // powers of two, then every core when that is not one
+  uint32_t workers = 1;
+  while (result.is_ok) {
+    result = bench_record_parallel(bench, vk, &commands, workers,
+                                   config->draw_count);
+    if (workers == max_workers) {
+      break;
+    }
+    workers = workers * 2 < max_workers ? workers * 2 : max_workers;
+  }
+  bench_commands_destroy(&commands, device);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  const BenchResult* single = bench_find_result(bench, "record.parallel.w1");
+  for (uint32_t i = 0; single && i < bench->result_count; i++) {
+    const BenchResult* parallel = &bench->results[i];
+    if (parallel != single &&
+        strncmp(parallel->name, "record.parallel.", 16) == 0 &&
+        parallel->p50_us > 0.0) {
+      log_info("%s records %.2fx as fast as one worker", parallel->name,
+               single->p50_us / parallel->p50_us);
+    }
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) bench_submit(Bench* bench, BenchVulkan* vk) {
+  const VulkanDevice* device = &vk->device;
+  BenchCommands commands;
+  auto result = bench_commands_init(&commands, device);
+
+  // one round trip through the queue and back
+  if (result.is_ok && bench_case_begin(bench, "submit.wait", 500, 0)) {
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commands.command_buffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = nullptr,
+    };
+    while (bench_case_next(bench)) {
+      bench_start(bench);
+      VkResult vk_result = bench_commands_begin(&commands, device);
+      if (vk_result == VK_SUCCESS) {
+        vk_result = device->fn.vkEndCommandBuffer(commands.command_buffer);
+      }
+      if (vk_result == VK_SUCCESS) {
+        vk_result = device->fn.vkQueueSubmit(device->graphics_queue, 1,
+                                             &submit_info, commands.fence);
+      }
+      if (vk_result == VK_SUCCESS) {
+        vk_result = device->fn.vkWaitForFences(device->device, 1,
+                                               &commands.fence, VK_TRUE,
+                                               UINT64_MAX);
+      }
+      if (vk_result == VK_SUCCESS) {
+        vk_result =
+            device->fn.vkResetFences(device->device, 1, &commands.fence);
+      }
+      bench_stop(bench);
+      if (vk_result != VK_SUCCESS) {
+        result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+        break;
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+  bench_commands_destroy(&commands, device);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // the CPU side of a frame with frames in flight: waiting on the slot fence,
+  // beginning, ending and submitting its command buffer
+  if (bench_case_begin(bench, "frame.begin_submit", 1000, 0)) {
+    VulkanFrameScheduler scheduler;
+    vulkan_frame_scheduler_reset(&scheduler);
+    result = vulkan_frame_scheduler_init(&scheduler, device,
+                                         VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+    while (result.is_ok && bench_case_next(bench)) {
+      VulkanFrame* frame = nullptr;
+      bench_start(bench);
+      result = vulkan_frame_scheduler_begin_frame(&scheduler, &frame);
+      if (result.is_ok) {
+        result = vulkan_frame_scheduler_submit(&scheduler, 0, nullptr,
+                                               nullptr, 0, nullptr);
+      }
+      bench_stop(bench);
+    }
+    if (result.is_ok) {
+      result = vulkan_frame_scheduler_wait_idle(&scheduler);
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+    vulkan_frame_scheduler_destroy(&scheduler);
+  }
+  return result;
+}
+
+// One frame of descriptor sets from the per frame allocator, twice what the
+// first pool of a chain holds. The first frame chains a second pool, every
+// later one must reset and reuse both without creating a third.
+static Result(int, ErrorMessage) bench_descriptors(Bench* bench,
+                                                   BenchVulkan* vk) {
+  const VulkanDevice* device = &vk->device;
+  // a material set, a uniform buffer and a texture
+  VkDescriptorSetLayoutBinding bindings[] = {
+      {
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags =
+              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+          .pImmutableSamplers = nullptr,
+      },
+      {
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .pImmutableSamplers = nullptr,
+      },
+  };
+  VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .bindingCount = 2,
+      .pBindings = bindings,
+  };
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkResult vk_result = device->fn.vkCreateDescriptorSetLayout(
+      device->device, &layout_info, nullptr, &layout);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+
+  VulkanDescriptorAllocator allocator;
+  vulkan_descriptor_allocator_reset(&allocator);
+  auto result = vulkan_descriptor_allocator_init(&allocator, device, 1);
+  const VulkanDescriptorPoolChain* chain = &allocator.chains[0];
+  if (result.is_ok && bench_case_begin(bench, "descriptor.allocate", 500,
+                                       BENCH_DESCRIPTOR_SET_COUNT)) {
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      result = vulkan_descriptor_allocator_begin_frame(&allocator, 0);
+      for (uint32_t i = 0; result.is_ok && i < BENCH_DESCRIPTOR_SET_COUNT;
+           i++) {
+        VkDescriptorSet set;
+        result = vulkan_descriptor_allocator_allocate(&allocator, layout, &set);
+      }
+      bench_stop(bench);
+      if (result.is_ok && (chain->pool_count != 2 || chain->current != 1)) {
+        result = Err(int, ErrorMessage)(
+            "Descriptor pools were not chained and recycled");
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+      log_debug("descriptor.allocate spread %u sets over %u pools",
+                allocator.set_count, chain->pool_count);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  vulkan_descriptor_allocator_destroy(&allocator);
+  device->fn.vkDestroyDescriptorSetLayout(device->device, layout, nullptr);
+  return result;
+}
+
+// Descriptor state of draw_count draws that each read one material range
+// of a storage buffer. The per draw path allocates and writes a set for
+// every draw from the frame's descriptor allocator and binds each one, the
+// bindless path binds the table once and pushes the material index per
+// draw. Only the recording is measured, nothing is submitted.
+typedef struct BenchBind {
+  VulkanLayoutCache layout_cache;
+  VulkanDescriptorAllocator descriptor_allocator;
+  VulkanDescriptorWriter writer;
+  VulkanBindlessTable bindless;
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout pipeline_layout;
+  VkBuffer materials;
+  VulkanAllocation materials_allocation;
+  uint32_t material_indices[BENCH_BIND_MATERIAL_COUNT];
+  VkDescriptorSet* sets;
+  bool is_materials_init;
+} BenchBind;
+
+static void bench_bind_destroy(BenchBind* bind, BenchVulkan* vk) {
+  vulkan_bindless_table_destroy(&bind->bindless);
+  vulkan_descriptor_allocator_destroy(&bind->descriptor_allocator);
+  if (bind->is_materials_init) {
+    vulkan_allocator_destroy_buffer(&vk->allocator, bind->materials,
+                                    &bind->materials_allocation);
+  }
+  vulkan_layout_cache_destroy(&bind->layout_cache);
+  mem_free(bind->sets);
+  bind->sets = nullptr;
+  bind->is_materials_init = false;
+}
+
+static Result(int, ErrorMessage)
+    bench_bind_init(BenchBind* bind, BenchVulkan* vk, uint32_t draw_count) {
+  const VulkanDevice* device = &vk->device;
+  vulkan_layout_cache_reset(&bind->layout_cache);
+  vulkan_descriptor_allocator_reset(&bind->descriptor_allocator);
+  vulkan_descriptor_writer_reset(&bind->writer);
+  vulkan_bindless_table_reset(&bind->bindless);
+  bind->sets = nullptr;
+  bind->is_materials_init = false;
+
+  vulkan_layout_cache_init(&bind->layout_cache, device);
+  vulkan_descriptor_writer_init(&bind->writer, device);
+  bind->sets = mem_alloc(sizeof(VkDescriptorSet) * draw_count);
+  CHECK_ALLOC(bind->sets, Err(int, ErrorMessage)(
+                              "Unable to allocate memory for the sets"));
+
+  VkBufferCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = BENCH_BIND_MATERIAL_COUNT * BENCH_BIND_MATERIAL_SIZE,
+      .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  auto result = vulkan_allocator_create_buffer(
+      &vk->allocator, &create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+      &bind->materials, &bind->materials_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  bind->is_materials_init = true;
+
+  VkDescriptorSetLayoutBinding binding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_ALL,
+      .pImmutableSamplers = nullptr,
+  };
+  VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .bindingCount = 1,
+      .pBindings = &binding,
+  };
+  result = vulkan_layout_cache_get_set_layout(&bind->layout_cache,
+                                              &layout_info, &bind->set_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .setLayoutCount = 1,
+      .pSetLayouts = &bind->set_layout,
+      .pushConstantRangeCount = 0,
+      .pPushConstantRanges = nullptr,
+  };
+  result = vulkan_layout_cache_get_pipeline_layout(
+      &bind->layout_cache, &pipeline_layout_info, &bind->pipeline_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_descriptor_allocator_init(&bind->descriptor_allocator,
+                                            device, 1);
+  if (!result.is_ok || !device->has_bindless) {
+    return result;
+  }
+
+  result = vulkan_bindless_table_init(&bind->bindless, device,
+                                      &bind->layout_cache, 1);
+  for (uint32_t i = 0; result.is_ok && i < BENCH_BIND_MATERIAL_COUNT; i++) {
+    result = vulkan_bindless_table_register_buffer(
+        &bind->bindless, bind->materials, i * BENCH_BIND_MATERIAL_SIZE,
+        BENCH_BIND_MATERIAL_SIZE, &bind->material_indices[i]);
+  }
+  if (result.is_ok) {
+    vulkan_bindless_table_flush(&bind->bindless);
+  }
+  return result;
+}
+
+static Result(int, ErrorMessage) bench_bind_per_draw(BenchBind* bind,
+                                                     BenchVulkan* vk,
+                                                     BenchCommands* commands,
+                                                     uint32_t draw_count,
+                                                     uint32_t* bind_count) {
+  const VulkanDevice* device = &vk->device;
+  VkResult vk_result = bench_commands_begin(commands, device);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  auto result =
+      vulkan_descriptor_allocator_begin_frame(&bind->descriptor_allocator, 0);
+  for (uint32_t i = 0; result.is_ok && i < draw_count; i++) {
+    result = vulkan_descriptor_allocator_allocate(
+        &bind->descriptor_allocator, bind->set_layout, &bind->sets[i]);
+    if (result.is_ok) {
+      vulkan_descriptor_writer_write_buffer(
+          &bind->writer, bind->sets[i], 0, 0,
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bind->materials,
+          (VkDeviceSize)(i % BENCH_BIND_MATERIAL_COUNT) *
+              BENCH_BIND_MATERIAL_SIZE,
+          BENCH_BIND_MATERIAL_SIZE);
+    }
+  }
+  // a set may not be written once a command buffer bound it
+  vulkan_descriptor_writer_flush(&bind->writer);
+  *bind_count = 0;
+  for (uint32_t i = 0; result.is_ok && i < draw_count; i++) {
+    device->fn.vkCmdBindDescriptorSets(
+        commands->command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        bind->pipeline_layout, 0, 1, &bind->sets[i], 0, nullptr);
+    (*bind_count)++;
+  }
+  vk_result = device->fn.vkEndCommandBuffer(commands->command_buffer);
+  if (result.is_ok && vk_result != VK_SUCCESS) {
+    result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  return result;
+}
+
+static Result(int, ErrorMessage) bench_bind_bindless(BenchBind* bind,
+                                                     BenchVulkan* vk,
+                                                     BenchCommands* commands,
+                                                     uint32_t draw_count,
+                                                     uint32_t* bind_count) {
+  const VulkanDevice* device = &vk->device;
+  VkResult vk_result = bench_commands_begin(commands, device);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  vulkan_bindless_table_bind(&bind->bindless, commands->command_buffer,
+                             VK_PIPELINE_BIND_POINT_GRAPHICS);
+  *bind_count = 1;
+  for (uint32_t i = 0; i < draw_count; i++) {
+    const uint32_t* index =
+        &bind->material_indices[i % BENCH_BIND_MATERIAL_COUNT];
+    device->fn.vkCmdPushConstants(commands->command_buffer,
+                                  bind->bindless.pipeline_layout,
+                                  VK_SHADER_STAGE_ALL, 0, sizeof(*index),
+                                  index);
+  }
+  vk_result = device->fn.vkEndCommandBuffer(commands->command_buffer);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) bench_bind(Bench* bench,
+                                            BenchVulkan* vk,
+                                            const BenchConfig* config) {
+  const VulkanDevice* device = &vk->device;
+  uint32_t draw_count = config->draw_count;
+  BenchCommands commands = {0};
+  BenchBind bind;
+  auto result = bench_bind_init(&bind, vk, draw_count);
+  if (result.is_ok) {
+    result = bench_commands_init(&commands, device);
+  }
+
+  uint32_t per_draw_binds = 0;
+  if (result.is_ok &&
+      bench_case_begin(bench, "bind.per_draw", 200, draw_count)) {
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      result = bench_bind_per_draw(&bind, vk, &commands, draw_count,
+                                   &per_draw_binds);
+      bench_stop(bench);
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  uint32_t bindless_binds = 0;
+  if (result.is_ok && !device->has_bindless) {
+    log_info("Skipping the bindless case, the device has no bindless support");
+  } else if (result.is_ok &&
+             bench_case_begin(bench, "bind.bindless", 200, draw_count)) {
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      result = bench_bind_bindless(&bind, vk, &commands, draw_count,
+                                   &bindless_binds);
+      bench_stop(bench);
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  bench_commands_destroy(&commands, device);
+  bench_bind_destroy(&bind, vk);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  const BenchResult* per_draw = bench_find_result(bench, "bind.per_draw");
+  const BenchResult* bindless = bench_find_result(bench, "bind.bindless");
+  if (per_draw && bindless && bindless->p50_us > 0.0) {
+    log_info("bind.bindless binds %u descriptor sets for %u draws against "
+             "%u per draw, records %.2fx as fast",
+             bindless_binds, draw_count, per_draw_binds,
+             per_draw->p50_us / bindless->p50_us);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// an RGBA8 KTX2 file with the full level chain, every byte holds fill
+static Result(int, ErrorMessage)
+    bench_texture_write(const char* path, uint8_t fill) {
+  uint32_t level_count = 1;
+  while (BENCH_TEXTURE_SIZE >> level_count) {
+    level_count++;
+  }
+  TextureFileHeader header = {
+      .identifier = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n',
+                     0x1A, '\n'},
+      .vk_format = VK_FORMAT_R8G8B8A8_UNORM,
+      .type_size = 1,
+      .pixel_width = BENCH_TEXTURE_SIZE,
+      .pixel_height = BENCH_TEXTURE_SIZE,
+      .pixel_depth = 0,
+      .layer_count = 0,
+      .face_count = 1,
+      .level_count = level_count,
+      .supercompression_scheme = 0,
+  };
+  TextureLevelIndex levels[TEXTURE_MAX_LEVELS];
+  uint64_t size =
+      sizeof(TextureFileHeader) + sizeof(TextureLevelIndex) * level_count;
+  for (uint32_t i = 0; i < level_count; i++) {
+    uint64_t extent = BENCH_TEXTURE_SIZE >> i;
+    levels[i] = (TextureLevelIndex){
+        .byte_offset = size,
+        .byte_length = extent * extent * 4,
+        .uncompressed_byte_length = extent * extent * 4,
+    };
+    size += levels[i].byte_length;
+  }
+
+  uint8_t* data = mem_alloc(size);
+  CHECK_ALLOC(data, Err(int, ErrorMessage)(
+                        "Unable to allocate memory for a bench texture"));
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), levels,
+         sizeof(TextureLevelIndex) * level_count);
+  memset(data + levels[0].byte_offset, fill, size - levels[0].byte_offset);
+
+  SDL_RWops* file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    mem_free(data);
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  size_t written = SDL_RWwrite(file, data, size, 1);
+  int close_result = SDL_RWclose(file);
+  mem_free(data);
+  if (written != 1 || close_result != 0) {
+    return Err(int, ErrorMessage)("Unable to write a bench texture");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// a frame of a renderer sampling level 0 of the texture, the uploads of the
+// update are acquired by the frame like the application does
+static Result(int, ErrorMessage)
+    bench_texture_frame(VulkanFrameScheduler* scheduler,
+                        VulkanUploader* uploader,
+                        VulkanTextureStreamer* streamer,
+                        VulkanTextureHandle handle) {
+  VulkanFrame* frame = nullptr;
+  auto result = vulkan_frame_scheduler_begin_frame(scheduler, &frame);
+  if (!result.is_ok) {
+    return result;
+  }
+  vulkan_texture_streamer_request(streamer, handle, 0);
+  result = vulkan_texture_streamer_update(streamer, frame->frame_number);
+  if (result.is_ok) {
+    result = vulkan_uploader_flush(uploader);
+  }
+  if (!result.is_ok) {
+    return result;
+  }
+  VulkanUploadWait upload_wait;
+  vulkan_uploader_acquire(uploader, frame->command_buffer, &upload_wait);
+  arena_frame_clear_all();
+  return vulkan_frame_scheduler_submit(scheduler, upload_wait.count,
+                                       upload_wait.semaphores,
+                                       upload_wait.stages, 0, nullptr);
+}
+
+// every texture holds the levels the last plan gave it
+static bool bench_texture_is_settled(const VulkanTextureStreamer* streamer) {
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    const VulkanTexture* texture = &streamer->textures[i];
+    if (texture->is_loading ||
+        texture->target_level != texture->resident_level) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Two textures under a budget smaller than the full chain of either, frames
+// ask for level 0 of one and then of the other. Each iteration runs frames
+// until the requested texture streamed in as far as the budget allows,
+// evicting the levels of the other one, and every load landed.
+static Result(int, ErrorMessage) bench_textures(Bench* bench,
+                                                BenchVulkan* vk) {
+  if (!bench_case_begin(bench, "texture.stream", 20, 0)) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  const VulkanDevice* device = &vk->device;
+  char paths[BENCH_TEXTURE_COUNT][32];
+  VulkanTextureHandle handles[BENCH_TEXTURE_COUNT];
+  VulkanFrameScheduler scheduler;
+  VulkanUploader uploader;
+  VulkanTextureStreamer streamer;
+  vulkan_frame_scheduler_reset(&scheduler);
+  vulkan_uploader_reset(&uploader);
+  vulkan_texture_streamer_reset(&streamer);
+
+  auto result = Ok(int, ErrorMessage)(0);
+  uint32_t written_count = 0;
+  while (result.is_ok && written_count < BENCH_TEXTURE_COUNT) {
+    char* path = paths[written_count];
+    SDL_snprintf(path, sizeof(paths[0]), "bench_texture_%u.ktx2",
+                 written_count);
+    result = bench_texture_write(path, (uint8_t)written_count);
+    written_count++;
+  }
+  if (result.is_ok) {
+    result = vulkan_frame_scheduler_init(&scheduler, device,
+                                         VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+  }
+  if (result.is_ok) {
+    result = vulkan_uploader_init(&uploader, device, &vk->allocator,
+                                  BENCH_TEXTURE_RING_SIZE);
+  }
+  if (result.is_ok) {
+    result = vulkan_texture_streamer_init(
+        &streamer, device, &vk->allocator, &uploader, nullptr,
+        BENCH_TEXTURE_BUDGET, BENCH_TEXTURE_COUNT,
+        VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+  }
+  for (uint32_t i = 0; result.is_ok && i < BENCH_TEXTURE_COUNT; i++) {
+    result = vulkan_texture_streamer_add(&streamer, paths[i], &handles[i]);
+  }
+
+  uint32_t iteration = 0;
+  while (result.is_ok && bench_case_next(bench)) {
+    VulkanTextureHandle handle = handles[iteration % BENCH_TEXTURE_COUNT];
+    uint32_t stream_in_count = streamer.stream_in_count;
+    uint32_t start = SDL_GetTicks();
+    bench_start(bench);
+    do {
+      result = bench_texture_frame(&scheduler, &uploader, &streamer, handle);
+    } while (result.is_ok && !bench_texture_is_settled(&streamer) &&
+             SDL_GetTicks() - start < BENCH_TEXTURE_TIMEOUT_MS);
+    if (result.is_ok) {
+      result = vulkan_frame_scheduler_wait_idle(&scheduler);
+    }
+    bench_stop(bench);
+    iteration++;
+
+    const VulkanTexture* texture = &streamer.textures[handle];
+    if (!result.is_ok) {
+      break;
+    }
+    if (!bench_texture_is_settled(&streamer)) {
+      result = Err(int, ErrorMessage)("Texture streaming did not settle");
+    } else if (streamer.stream_in_count == stream_in_count) {
+      result = Err(int, ErrorMessage)("Requested texture was not streamed in");
+    } else if (texture->resident_level == 0 ||
+               streamer.resident_bytes > streamer.budget) {
+      result = Err(int, ErrorMessage)("Resident textures exceed the budget");
+    }
+  }
+  // from the second iteration on the requested texture takes its levels
+  // from the one requested before, level 0 never fits
+  if (result.is_ok && iteration > 1 &&
+      (streamer.evicted_level_count == 0 || streamer.denied_count == 0)) {
+    result = Err(int, ErrorMessage)("Texture levels were not evicted");
+  }
+
+  if (result.is_ok) {
+    bench_case_end(bench);
+    vulkan_texture_streamer_log_stats(&streamer);
+  } else {
+    bench_case_abort(bench);
+  }
+  if (device->is_device_init) {
+    device->fn.vkDeviceWaitIdle(device->device);
+  }
+  vulkan_texture_streamer_destroy(&streamer);
+  vulkan_uploader_destroy(&uploader);
+  vulkan_frame_scheduler_destroy(&scheduler);
+  for (uint32_t i = 0; i < written_count; i++) {
+    remove(paths[i]);
+  }
+  return result;
+}
+
+// a height field of BENCH_MESH_GRID_SIZE quads a side with a normal per
+// vertex, written the way exporters write OBJ files
+static Result(int, ErrorMessage) bench_mesh_write_obj(const char* path) {
+  SDL_RWops* file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  const uint32_t side = BENCH_MESH_GRID_SIZE + 1;
+  char line[128];
+  bool success = true;
+  for (uint32_t i = 0; i < side * side && success; i++) {
+    float u = (float)(i % side) * 0.1f;
+    float v = (float)(i / side) * 0.1f;
+    int length = SDL_snprintf(line, sizeof(line), "v %f %f %f\n",
+                              (float)(i % side), sinf(u) * cosf(v),
+                              (float)(i / side));
+    success = SDL_RWwrite(file, line, (size_t)length, 1) == 1;
+  }
+  for (uint32_t i = 0; i < side * side && success; i++) {
+    float u = (float)(i % side) * 0.1f;
+    float v = (float)(i / side) * 0.1f;
+    // slopes of the height along x and z
+    float dx = 0.1f * cosf(u) * cosf(v);
+    float dz = -0.1f * sinf(u) * sinf(v);
+    float length = sqrtf(dx * dx + 1.0f + dz * dz);
+    int line_length = SDL_snprintf(line, sizeof(line), "vn %f %f %f\n",
+                                   -dx / length, 1.0f / length, -dz / length);
+    success = SDL_RWwrite(file, line, (size_t)line_length, 1) == 1;
+  }
+  for (uint32_t i = 0; i < BENCH_MESH_GRID_SIZE * BENCH_MESH_GRID_SIZE &&
+                       success;
+       i++) {
+    // OBJ indices start at 1
+    uint32_t a = i / BENCH_MESH_GRID_SIZE * side + i % BENCH_MESH_GRID_SIZE + 1;
+    uint32_t b = a + 1;
+    uint32_t c = a + side + 1;
+    uint32_t d = a + side;
+    int length = SDL_snprintf(line, sizeof(line),
+                              "f %u//%u %u//%u %u//%u %u//%u\n", a, a, d, d,
+                              c, c, b, b);
+    success = SDL_RWwrite(file, line, (size_t)length, 1) == 1;
+  }
+  success = SDL_RWclose(file) == 0 && success;
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to write the bench OBJ file");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// acquires the upload of the mesh and binds it in a submitted command
+// buffer, the point from which a frame could draw it
+static Result(int, ErrorMessage) bench_mesh_bind(BenchCommands* commands,
+                                                 const VulkanDevice* device,
+                                                 VulkanUploader* uploader,
+                                                 const VulkanMesh* mesh) {
+  VkResult vk_result = bench_commands_begin(commands, device);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  VulkanUploadWait upload_wait;
+  vulkan_uploader_acquire(uploader, commands->command_buffer, &upload_wait);
+  arena_frame_clear_all();
+  vulkan_mesh_bind(mesh, &device->fn, commands->command_buffer);
+  vk_result = device->fn.vkEndCommandBuffer(commands->command_buffer);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+
+  VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = upload_wait.count,
+      .pWaitSemaphores = upload_wait.semaphores,
+      .pWaitDstStageMask = upload_wait.stages,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commands->command_buffer,
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = nullptr,
+  };
+  vk_result = device->fn.vkQueueSubmit(device->graphics_queue, 1,
+                                       &submit_info, commands->fence);
+  if (vk_result == VK_SUCCESS) {
+    vk_result = device->fn.vkWaitForFences(device->device, 1,
+                                           &commands->fence, VK_TRUE,
+                                           UINT64_MAX);
+  }
+  if (vk_result == VK_SUCCESS) {
+    vk_result = device->fn.vkResetFences(device->device, 1, &commands->fence);
+  }
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// The two ways to a mesh: parsing an OBJ file into unique vertices, which
+// is the least an engine loading OBJ files has to do, and loading the file
+// mesh_convert made of it up to the flushed upload. Both must come up with
+// the vertex and index counts of the grid.
+static Result(int, ErrorMessage) bench_meshes(Bench* bench, BenchVulkan* vk) {
+  const VulkanDevice* device = &vk->device;
+  const char* obj_path = "bench_mesh.obj";
+  const char* mesh_path = "bench_mesh.mesh";
+  const uint32_t vertex_count =
+      (BENCH_MESH_GRID_SIZE + 1) * (BENCH_MESH_GRID_SIZE + 1);
+  const uint32_t index_count = BENCH_MESH_GRID_SIZE * BENCH_MESH_GRID_SIZE * 6;
+
+  MeshBuilder builder;
+  mesh_builder_init(&builder);
+  auto result = bench_mesh_write_obj(obj_path);
+  if (result.is_ok) {
+    result = mesh_convert(&builder, obj_path, mesh_path);
+  }
+  if (result.is_ok && (builder.positions.count != vertex_count ||
+                       builder.indices.count != index_count)) {
+    result = Err(int, ErrorMessage)("Converted mesh lost vertices");
+  }
+  mesh_builder_destroy(&builder);
+
+  if (result.is_ok &&
+      bench_case_begin(bench, "mesh.parse_obj", 20, vertex_count)) {
+    while (result.is_ok && bench_case_next(bench)) {
+      mesh_builder_init(&builder);
+      bench_start(bench);
+      result = mesh_builder_load_obj(&builder, obj_path);
+      bench_stop(bench);
+      if (result.is_ok && (builder.positions.count != vertex_count ||
+                           builder.indices.count != index_count)) {
+        result = Err(int, ErrorMessage)("Parsed OBJ counts do not match");
+      }
+      mesh_builder_destroy(&builder);
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  BenchCommands commands = {0};
+  VulkanUploader uploader;
+  vulkan_uploader_reset(&uploader);
+  if (result.is_ok && bench_case_begin(bench, "mesh.load", 100, vertex_count)) {
+    result = bench_commands_init(&commands, device);
+    if (result.is_ok) {
+      result = vulkan_uploader_init(&uploader, device, &vk->allocator,
+                                    BENCH_MESH_RING_SIZE);
+    }
+    while (result.is_ok && bench_case_next(bench)) {
+      VulkanMesh mesh;
+      vulkan_mesh_reset(&mesh);
+      bench_start(bench);
+      result = vulkan_mesh_load(&mesh, &vk->allocator, &uploader, mesh_path);
+      if (result.is_ok) {
+        result = vulkan_uploader_flush(&uploader);
+      }
+      bench_stop(bench);
+      if (result.is_ok) {
+        result = bench_mesh_bind(&commands, device, &uploader, &mesh);
+      }
+      if (result.is_ok && (mesh.vertex_count != vertex_count ||
+                           mesh.index_count != index_count)) {
+        result = Err(int, ErrorMessage)("Loaded mesh counts do not match");
+      }
+      vulkan_mesh_destroy(&mesh, &vk->allocator);
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  if (device->is_device_init) {
+    device->fn.vkDeviceWaitIdle(device->device);
+  }
+  vulkan_uploader_destroy(&uploader);
+  bench_commands_destroy(&commands, device);
+  remove(obj_path);
+  remove(mesh_path);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  const BenchResult* parse = bench_find_result(bench, "mesh.parse_obj");
+  const BenchResult* load = bench_find_result(bench, "mesh.load");
+  if (parse && load && load->p50_us > 0.0) {
+    log_info("mesh.load is %.2fx as fast as parsing the OBJ file",
+             parse->p50_us / load->p50_us);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static float bench_random_float(uint32_t* state, float min, float max) {
+  return min + (max - min) * (float)(bench_random(state) % 65536) / 65535.0f;
+}
+
+// 1 in 64 nodes is a root spread over the scene, the others form 4 ary
+// trees below them in breadth first order, every node gets a box around
+// its world position
+static void bench_math_fill(TransformSoa* transforms,
+                            AabbSoa* boxes,
+                            uint32_t count) {
+  uint32_t root_count = count / 64 > 0 ? count / 64 : 1;
+  uint32_t random_state = 0x2545f491u;
+  for (uint32_t i = 0; i < count; i++) {
+    bool is_root = i < root_count;
+    transforms->parent[i] =
+        is_root ? TRANSFORM_NO_PARENT : (i - root_count) / 4;
+    float spread = is_root ? 100.0f : 2.0f;
+    Vec3 axis = {
+        bench_random_float(&random_state, -1.0f, 1.0f),
+        1.0f,
+        bench_random_float(&random_state, -1.0f, 1.0f),
+    };
+    float angle = bench_random_float(&random_state, 0.0f, MATH_PI);
+    Quat rotation = quat_from_axis_angle(vec3_normalize(axis), angle);
+    for (uint32_t j = 0; j < 3; j++) {
+      transforms->position[j][i] =
+          bench_random_float(&random_state, -spread, spread);
+      transforms->scale[j][i] = bench_random_float(&random_state, 0.8f, 1.2f);
+    }
+    transforms->rotation[0][i] = rotation.x;
+    transforms->rotation[1][i] = rotation.y;
+    transforms->rotation[2][i] = rotation.z;
+    transforms->rotation[3][i] = rotation.w;
+  }
+  transforms->count = count;
+  transform_soa_propagate_scalar(transforms);
+
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      boxes->center[axis][i] = transforms->world[axis * 4 + 3][i];
+      boxes->extent[axis][i] = 0.5f;
+    }
+  }
+  boxes->count = count;
+}
+
+static void bench_math_log_speedup(const Bench* bench, const char* kernel) {
+  char scalar_name[BENCH_NAME_SIZE];
+  char simd_name[BENCH_NAME_SIZE];
+  SDL_snprintf(scalar_name, sizeof(scalar_name), "math.%s.scalar", kernel);
+  SDL_snprintf(simd_name, sizeof(simd_name), "math.%s.simd", kernel);
+  const BenchResult* scalar = bench_find_result(bench, scalar_name);
+  const BenchResult* simd = bench_find_result(bench, simd_name);
+  if (scalar && simd && simd->p50_us > 0.0) {
+    log_info("%s runs %.2fx as fast as scalar", simd_name,
+             scalar->p50_us / simd->p50_us);
+  }
+}
+
+static bool bench_math_is_close(float a, float b) {
+  float scale = fmaxf(1.0f, fmaxf(fabsf(a), fabsf(b)));
+  return fabsf(a - b) <= BENCH_MATH_TOLERANCE * scale;
+}
+
+static void bench_math_log_mismatches(const char* kernel,
+                                      uint32_t mismatch_count,
+                                      uint32_t element_count) {
+  if (mismatch_count > 0) {
+    log_error("math.%s.simd differs from scalar in %u of %u elements",
+              kernel, mismatch_count, element_count);
+  }
+}
+
+// Runs every kernel once more on both paths and compares the outputs
+// element by element, the world matrices and the products within the
+// tolerance, the visible lists exactly
+static Result(int, ErrorMessage) bench_math_check(TransformSoa* transforms,
+                                                  const AabbSoa* boxes,
+                                                  const Frustum* frustum,
+                                                  const Mat4* view_projection,
+                                                  const Mat4* models) {
+  uint32_t count = transforms->count;
+  float* world = mem_alloc(sizeof(float) * 12 * count);
+  uint32_t* visible = mem_alloc(sizeof(uint32_t) * 2 * count);
+  Mat4* products = mem_alloc(sizeof(Mat4) * 2 * count);
+  if (!world || !visible || !products) {
+    mem_free(world);
+    mem_free(visible);
+    mem_free(products);
+    return Err(int, ErrorMessage)(
+        "Unable to allocate memory for the math checks");
+  }
+
+  transform_soa_propagate_scalar(transforms);
+  for (uint32_t row = 0; row < 12; row++) {
+    memcpy(&world[row * count], transforms->world[row],
+           sizeof(float) * count);
+  }
+  transform_soa_propagate(transforms);
+  uint32_t propagate_mismatches = 0;
+  for (uint32_t row = 0; row < 12; row++) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (!bench_math_is_close(world[row * count + i],
+                               transforms->world[row][i])) {
+        propagate_mismatches++;
+      }
+    }
+  }
+
+  uint32_t scalar_count = frustum_cull_aabbs_scalar(frustum, boxes, visible);
+  uint32_t simd_count = frustum_cull_aabbs(frustum, boxes, &visible[count]);
+  uint32_t common_count = SDL_min(scalar_count, simd_count);
+  uint32_t cull_mismatches = SDL_max(scalar_count, simd_count) - common_count;
+  for (uint32_t i = 0; i < common_count; i++) {
+    if (visible[i] != visible[count + i]) {
+      cull_mismatches++;
+    }
+  }
+
+  mat4_mul_batch_scalar(view_projection, models, products, count);
+  mat4_mul_batch(view_projection, models, &products[count], count);
+  uint32_t mat4_mul_mismatches = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t j = 0; j < 16; j++) {
+      if (!bench_math_is_close(products[i].m[j], products[count + i].m[j])) {
+        mat4_mul_mismatches++;
+      }
+    }
+  }
+
+  mem_free(world);
+  mem_free(visible);
+  mem_free(products);
+  bench_math_log_mismatches("propagate", propagate_mismatches, count * 12);
+  bench_math_log_mismatches("cull", cull_mismatches, count);
+  bench_math_log_mismatches("mat4_mul", mat4_mul_mismatches, count * 16);
+  if (propagate_mismatches > 0 || cull_mismatches > 0 ||
+      mat4_mul_mismatches > 0) {
+    return Err(int, ErrorMessage)("SIMD math results differ from scalar");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// Every kernel of the math library against its scalar variant, on the SIMD
+// path the build picked. The scalar kernels are plain C, the compiler may
+// still vectorize parts of them. Once any case ran, the outputs of both
+// paths have to agree.
+static Result(int, ErrorMessage)
+    bench_math(Bench* bench, const BenchConfig* config) {
+  uint32_t count = config->instance_count;
+  TransformSoa transforms;
+  AabbSoa boxes;
+  transform_soa_reset(&transforms);
+  aabb_soa_reset(&boxes);
+  Mat4* models = mem_alloc(sizeof(Mat4) * count);
+  Mat4* model_view_projections = mem_alloc(sizeof(Mat4) * count);
+  uint32_t* visible = mem_alloc(sizeof(uint32_t) * count);
+  auto result = transform_soa_init(&transforms, count);
+  if (result.is_ok) {
+    result = aabb_soa_init(&boxes, count);
+  }
+  if (result.is_ok && (!models || !model_view_projections || !visible)) {
+    result = Err(int, ErrorMessage)(
+        "Unable to allocate memory for the math benchmarks");
+  }
+  if (!result.is_ok) {
+    mem_free(models);
+    mem_free(model_view_projections);
+    mem_free(visible);
+    aabb_soa_destroy(&boxes);
+    transform_soa_destroy(&transforms);
+    return result;
+  }
+
+  bench_math_fill(&transforms, &boxes, count);
+  for (uint32_t i = 0; i < count; i++) {
+    models[i] = transform_soa_world(&transforms, i);
+  }
+  Mat4 projection =
+      mat4_perspective(MATH_PI / 3.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+  Mat4 view = mat4_look_at((Vec3){0.0f, 40.0f, 150.0f},
+                           (Vec3){0.0f, 0.0f, 0.0f},
+                           (Vec3){0.0f, 1.0f, 0.0f});
+  Mat4 view_projection = mat4_mul(&projection, &view);
+  Frustum frustum = frustum_from_mat4(&view_projection);
+
+  char name[BENCH_NAME_SIZE];
+  bool has_run = false;
+  for (uint32_t is_simd = 0; is_simd < 2; is_simd++) {
+    const char* variant = is_simd ? "simd" : "scalar";
+    SDL_snprintf(name, sizeof(name), "math.propagate.%s", variant);
+    if (bench_case_begin(bench, name, 500, count)) {
+      has_run = true;
+      while (bench_case_next(bench)) {
+        bench_start(bench);
+        if (is_simd) {
+          transform_soa_propagate(&transforms);
+        } else {
+          transform_soa_propagate_scalar(&transforms);
+        }
+        bench_stop(bench);
+      }
+      bench_case_end(bench);
+    }
+
+    SDL_snprintf(name, sizeof(name), "math.cull.%s", variant);
+    if (bench_case_begin(bench, name, 500, count)) {
+      has_run = true;
+      uint32_t visible_count = 0;
+      while (bench_case_next(bench)) {
+        bench_start(bench);
+        visible_count =
+            is_simd ? frustum_cull_aabbs(&frustum, &boxes, visible)
+                    : frustum_cull_aabbs_scalar(&frustum, &boxes, visible);
+        bench_stop(bench);
+      }
+      bench_case_end(bench);
+      log_debug("%s keeps %u of %u boxes", name, visible_count, count);
+    }
+
+    SDL_snprintf(name, sizeof(name), "math.mat4_mul.%s", variant);
+    if (bench_case_begin(bench, name, 500, count)) {
+      has_run = true;
+      while (bench_case_next(bench)) {
+        bench_start(bench);
+        if (is_simd) {
+          mat4_mul_batch(&view_projection, models, model_view_projections,
+                         count);
+        } else {
+          mat4_mul_batch_scalar(&view_projection, models,
+                                model_view_projections, count);
+        }
+        bench_stop(bench);
+      }
+      bench_case_end(bench);
+    }
+  }
+  bench_math_log_speedup(bench, "propagate");
+  bench_math_log_speedup(bench, "cull");
+  bench_math_log_speedup(bench, "mat4_mul");
+  if (has_run) {
+    result = bench_math_check(&transforms, &boxes, &frustum, &view_projection,
+                              models);
+  }
+
+  mem_free(models);
+  mem_free(model_view_projections);
+  mem_free(visible);
+  aabb_soa_destroy(&boxes);
+  transform_soa_destroy(&transforms);
+  return result;
+}
+
+// The indirect scene with the caches and the compiler the renderer gives it,
+// plus the buffers the results are read back through
+typedef struct BenchCompute {
+  JobSystem job_system;
+  VulkanLayoutCache layout_cache;
+  VulkanShaderCache shader_cache;
+  VulkanPipelineCache pipeline_cache;
+  VulkanPipelineCompiler pipeline_compiler;
+  const char* shader_path;
+  // host visible, the commands followed by the count
+  VkBuffer readback;
+  VulkanAllocation readback_allocation;
+  // cleared on the graphics queue while the compute work runs
+  VkBuffer fill;
+  VulkanAllocation fill_allocation;
+  // per object, its command was already found among the compacted ones
+  bool* is_seen;
+  Mat4 view_projection;
+  Frustum frustum;
+  uint32_t object_count;
+  uint32_t random_state;
+} BenchCompute;
+
+static Result(int, ErrorMessage)
+    bench_compute_create_buffer(BenchVulkan* vk,
+                                VkDeviceSize size,
+                                VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags required,
+                                VkBuffer* buffer,
+                                VulkanAllocation* allocation) {
+  VkBufferCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = size,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  return vulkan_allocator_create_buffer(&vk->allocator, &create_info,
+                                        required, 0, buffer, allocation);
+}
+
+static Result(int, ErrorMessage) bench_compute_init(BenchCompute* compute,
+                                                    BenchVulkan* vk,
+                                                    const BenchConfig* config) {
+  *compute = (BenchCompute){
+      .shader_path = config->cull_shader_path,
+      .object_count = config->instance_count,
+  };
+  job_system_reset(&compute->job_system);
+  vulkan_layout_cache_reset(&compute->layout_cache);
+  vulkan_shader_cache_reset(&compute->shader_cache);
+  vulkan_pipeline_cache_reset(&compute->pipeline_cache);
+  vulkan_pipeline_compiler_reset(&compute->pipeline_compiler);
+
+  const VulkanDevice* device = &vk->device;
+  auto result = job_system_init(&compute->job_system, config->max_workers);
+  if (!result.is_ok) {
+    return result;
+  }
+  vulkan_layout_cache_init(&compute->layout_cache, device);
+  vulkan_shader_cache_init(&compute->shader_cache, device,
+                           &compute->layout_cache, false);
+  result = vulkan_pipeline_cache_init(&compute->pipeline_cache, device,
+                                      nullptr);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_pipeline_compiler_init(&compute->pipeline_compiler, device,
+                                         &compute->pipeline_cache,
+                                         &compute->job_system);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  result = bench_compute_create_buffer(
+      vk,
+      sizeof(VkDrawIndexedIndirectCommand) * compute->object_count +
+          sizeof(uint32_t),
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      &compute->readback, &compute->readback_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = bench_compute_create_buffer(
+      vk, BENCH_FILL_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &compute->fill,
+      &compute->fill_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  compute->is_seen = mem_alloc(sizeof(bool) * compute->object_count);
+  CHECK_ALLOC(compute->is_seen,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for the culling check"));
+
+  // the view of the math cases, about half of the spheres are inside
+  Mat4 projection =
+      mat4_perspective(MATH_PI / 3.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+  Mat4 view = mat4_look_at((Vec3){0.0f, 40.0f, 150.0f},
+                           (Vec3){0.0f, 0.0f, 0.0f},
+                           (Vec3){0.0f, 1.0f, 0.0f});
+  compute->view_projection = mat4_mul(&projection, &view);
+  compute->frustum = frustum_from_mat4(&compute->view_projection);
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void bench_compute_destroy(BenchCompute* compute, BenchVulkan* vk) {
+  if (compute->readback != VK_NULL_HANDLE) {
+    vulkan_allocator_destroy_buffer(&vk->allocator, compute->readback,
+                                    &compute->readback_allocation);
+  }
+  if (compute->fill != VK_NULL_HANDLE) {
+    vulkan_allocator_destroy_buffer(&vk->allocator, compute->fill,
+                                    &compute->fill_allocation);
+  }
+  mem_free(compute->is_seen);
+  // the compiler waits for its jobs and owns the pipelines made from the
+  // shader modules
+  vulkan_pipeline_compiler_destroy(&compute->pipeline_compiler);
+  vulkan_pipeline_cache_destroy(&compute->pipeline_cache);
+  vulkan_shader_cache_destroy(&compute->shader_cache);
+  vulkan_layout_cache_destroy(&compute->layout_cache);
+  job_system_destroy(&compute->job_system);
+  *compute = (BenchCompute){0};
+}
+
+static void bench_compute_random_sphere(BenchCompute* compute,
+                                        float center[3],
+                                        float* radius) {
+  center[0] = bench_random_float(&compute->random_state, -250.0f, 250.0f);
+  center[1] = bench_random_float(&compute->random_state, -50.0f, 50.0f);
+  center[2] = bench_random_float(&compute->random_state, -250.0f, 250.0f);
+  *radius = bench_random_float(&compute->random_state, 0.5f, 4.0f);
+}
+
+// A scene of spheres spread around the view, the same objects for every
+// case. Waits for the culling pipeline so the first frame already culls.
+static Result(int, ErrorMessage)
+    bench_compute_scene_init(BenchCompute* compute,
+                             BenchVulkan* vk,
+                             VulkanIndirectScene* scene) {
+  vulkan_indirect_scene_reset(scene);
+  auto result = vulkan_indirect_scene_init(
+      scene, &vk->device, &vk->allocator, &compute->layout_cache,
+      &compute->shader_cache, &compute->pipeline_compiler,
+      compute->shader_path, compute->object_count,
+      VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  compute->random_state = 0x6a09e667u;
+  for (uint32_t i = 0; result.is_ok && i < compute->object_count; i++) {
+    VulkanIndirectObject object = {
+        .index_count = 36 + i % 64 * 3,
+        .first_index = i % 16 * 36,
+        .vertex_offset = (int32_t)(i % 8),
+    };
+    bench_compute_random_sphere(compute, object.center, &object.radius);
+    uint32_t index;
+    result = vulkan_indirect_scene_add(scene, &object, &index);
+  }
+  if (!result.is_ok) {
+    return result;
+  }
+  VkPipeline pipeline;
+  return vulkan_pipeline_compiler_wait(&compute->pipeline_compiler,
+                                       scene->pipeline_handle, &pipeline);
+}
+
+// moves the first and the last object, every frame uploads their chunks and
+// skips the ones in between
+static void bench_compute_move(BenchCompute* compute,
+                               VulkanIndirectScene* scene) {
+  const uint32_t indices[2] = {0, scene->object_count - 1};
+  for (uint32_t i = 0; i < 2; i++) {
+    float center[3];
+    float radius;
+    bench_compute_random_sphere(compute, center, &radius);
+    vulkan_indirect_scene_move(scene, indices[i], center, radius);
+  }
+}
+
+// copies the commands and the count the culling pass wrote into the
+// readback buffer
+static void bench_compute_record_readback(const BenchCompute* compute,
+                                          const VulkanDevice* device,
+                                          const VulkanIndirectScene* scene,
+                                          VkCommandBuffer command_buffer) {
+  VkMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+  };
+  device->fn.vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  VkDeviceSize commands_size =
+      sizeof(VkDrawIndexedIndirectCommand) * scene->object_count;
+  VkBufferCopy region = {
+      .srcOffset = 0,
+      .dstOffset = 0,
+      .size = commands_size,
+  };
+  device->fn.vkCmdCopyBuffer(command_buffer, scene->commands,
+                             compute->readback, 1, &region);
+  region = (VkBufferCopy){
+      .srcOffset = 0,
+      .dstOffset = commands_size,
+      .size = sizeof(uint32_t),
+  };
+  device->fn.vkCmdCopyBuffer(command_buffer, scene->count, compute->readback,
+                             1, &region);
+  VkMemoryBarrier host_barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+  };
+  device->fn.vkCmdPipelineBarrier(
+      command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+}
+
+// the sphere test of shaders/cull.comp, is_close when the sphere touches a
+// plane closely enough for the GPU to round the other way
+static bool bench_compute_is_visible(const Frustum* frustum,
+                                     const float sphere[4],
+                                     bool* is_close) {
+  bool is_visible = true;
+  *is_close = false;
+  for (uint32_t i = 0; i < 6; i++) {
+    const Vec4* plane = &frustum->planes[i];
+    float distance = plane->x * sphere[0] + plane->y * sphere[1] +
+                     plane->z * sphere[2] + plane->w + sphere[3];
+    is_visible = is_visible && distance >= 0.0f;
+    *is_close = *is_close || fabsf(distance) < BENCH_CULL_TOLERANCE;
+  }
+  return is_visible;
+}
+
+// Number of results the culling pass got wrong by the CPU test. Compacted,
+// the count must lie between the objects surely inside and those that may
+// be, and every command must be the unchanged draw of a distinct visible
+// object. Otherwise each object keeps its command with zero instances when
+// culled.
+static uint32_t bench_compute_mismatches(BenchCompute* compute,
+                                         const VulkanIndirectScene* scene,
+                                         uint32_t* visible_count) {
+  const uint8_t* readback = compute->readback_allocation.mapped;
+  const VkDrawIndexedIndirectCommand* commands =
+      (const VkDrawIndexedIndirectCommand*)readback;
+  uint32_t count;
+  mem_copy(&count,
+           readback +
+               sizeof(VkDrawIndexedIndirectCommand) * scene->object_count,
+           sizeof(count));
+  uint32_t mismatch_count = 0;
+  bool is_close;
+
+  if (!scene->has_draw_count) {
+    *visible_count = 0;
+    for (uint32_t i = 0; i < scene->object_count; i++) {
+      bool is_visible = bench_compute_is_visible(
+          &compute->frustum, scene->bounds[i], &is_close);
+      VkDrawIndexedIndirectCommand expected = scene->draws[i];
+      expected.instanceCount = is_visible ? expected.instanceCount : 0;
+      if (is_close) {
+        expected.instanceCount = commands[i].instanceCount;
+      }
+      if (memcmp(&commands[i], &expected, sizeof(expected)) != 0) {
+        mismatch_count++;
+      }
+      *visible_count += commands[i].instanceCount;
+    }
+    return mismatch_count;
+  }
+
+  uint32_t inside_count = 0;
+  uint32_t close_count = 0;
+  for (uint32_t i = 0; i < scene->object_count; i++) {
+    bool is_visible = bench_compute_is_visible(
+        &compute->frustum, scene->bounds[i], &is_close);
+    close_count += is_close ? 1 : 0;
+    inside_count += is_visible && !is_close ? 1 : 0;
+    compute->is_seen[i] = false;
+  }
+  if (count < inside_count || count > inside_count + close_count) {
+    mismatch_count++;
+  }
+  *visible_count = SDL_min(count, scene->object_count);
+  for (uint32_t i = 0; i < *visible_count; i++) {
+    uint32_t index = commands[i].firstInstance;
+    if (index >= scene->object_count || compute->is_seen[index]) {
+      mismatch_count++;
+      continue;
+    }
+    compute->is_seen[index] = true;
+    bool is_visible = bench_compute_is_visible(
+        &compute->frustum, scene->bounds[index], &is_close);
+    if ((!is_visible && !is_close) ||
+        memcmp(&commands[i], &scene->draws[index], sizeof(commands[i])) !=
+            0) {
+      mismatch_count++;
+    }
+  }
+  return mismatch_count;
+}
+
+// The work the graphics queue does while compute runs, submitted on its own
+// so it does not wait on the compute semaphore
+static VkResult bench_compute_submit_fill(const BenchCompute* compute,
+                                          BenchCommands* commands,
+                                          const VulkanDevice* device) {
+  VkResult result = bench_commands_begin(commands, device);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  device->fn.vkCmdFillBuffer(commands->command_buffer, compute->fill, 0,
+                             VK_WHOLE_SIZE, 0x5a5a5a5au);
+  result = device->fn.vkEndCommandBuffer(commands->command_buffer);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = nullptr,
+      .pWaitDstStageMask = nullptr,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &commands->command_buffer,
+      .signalSemaphoreCount = 0,
+      .pSignalSemaphores = nullptr,
+  };
+  return device->fn.vkQueueSubmit(device->graphics_queue, 1, &submit_info,
+                                  commands->fence);
+}
+
+static VkResult bench_compute_wait_fill(BenchCommands* commands,
+                                        const VulkanDevice* device) {
+  VkResult result = device->fn.vkWaitForFences(
+      device->device, 1, &commands->fence, VK_TRUE, UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  return device->fn.vkResetFences(device->device, 1, &commands->fence);
+}
+
+// One frame that culls in the graphics command buffer itself, ahead of where
+// the draws would go
+static Result(int, ErrorMessage)
+    bench_compute_scene_frame(BenchCompute* compute,
+                              const VulkanDevice* device,
+                              VulkanFrameScheduler* scheduler,
+                              VulkanIndirectScene* scene) {
+  VulkanFrame* frame = nullptr;
+  auto result = vulkan_frame_scheduler_begin_frame(scheduler, &frame);
+  if (!result.is_ok) {
+    return result;
+  }
+  bench_compute_move(compute, scene);
+  vulkan_indirect_scene_cull(scene, frame->command_buffer, frame->slot,
+                             &compute->view_projection);
+  if (!scene->is_culled) {
+    return Err(int, ErrorMessage)("Culling pipeline is not ready");
+  }
+  bench_compute_record_readback(compute, device, scene,
+                                frame->command_buffer);
+  result = vulkan_frame_scheduler_submit(scheduler, 0, nullptr, nullptr, 0,
+                                         nullptr);
+  if (!result.is_ok) {
+    return result;
+  }
+  return vulkan_frame_scheduler_wait_idle(scheduler);
+}
+
+// One frame the way the renderer runs it: the culling pass goes through the
+// compute queue and the graphics submission of the frame waits on it and
+// consumes the commands, here by copying them back for the check
+static Result(int, ErrorMessage)
+    bench_compute_frame(BenchCompute* compute,
+                        const VulkanDevice* device,
+                        VulkanFrameScheduler* scheduler,
+                        VulkanComputeQueue* compute_queue,
+                        VulkanIndirectScene* scene) {
+  VulkanFrame* frame = nullptr;
+  auto result = vulkan_frame_scheduler_begin_frame(scheduler, &frame);
+  if (!result.is_ok) {
+    return result;
+  }
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  result = vulkan_compute_queue_begin(compute_queue, frame, &command_buffer);
+  if (!result.is_ok) {
+    return result;
+  }
+  bench_compute_move(compute, scene);
+  result = vulkan_indirect_scene_cull_compute(
+      scene, compute_queue, frame->slot, &compute->view_projection,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+  if (result.is_ok && !scene->is_culled) {
+    result = Err(int, ErrorMessage)("Culling pipeline is not ready");
+  }
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_compute_queue_submit(compute_queue);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VulkanComputeWait wait;
+  vulkan_compute_queue_acquire(compute_queue, frame->command_buffer, &wait);
+  bench_compute_record_readback(compute, device, scene,
+                                frame->command_buffer);
+  result = vulkan_frame_scheduler_submit(
+      scheduler, wait.has_wait ? 1 : 0, &wait.semaphore, &wait.stage, 0,
+      nullptr);
+  if (!result.is_ok) {
+    return result;
+  }
+  return vulkan_frame_scheduler_wait_idle(scheduler);
+}
+
+// how much of the shorter workload ran while the other one did, from the
+// medians of the cases alone and together
+static void bench_compute_log_overlap(const Bench* bench, const char* path) {
+  char cull_name[BENCH_NAME_SIZE];
+  char overlap_name[BENCH_NAME_SIZE];
+  SDL_snprintf(cull_name, sizeof(cull_name), "compute.cull.%s", path);
+  SDL_snprintf(overlap_name, sizeof(overlap_name), "compute.overlap.%s",
+               path);
+  const BenchResult* fill = bench_find_result(bench, "compute.fill");
+  const BenchResult* cull = bench_find_result(bench, cull_name);
+  const BenchResult* overlap = bench_find_result(bench, overlap_name);
+  if (!fill || !cull || !overlap) {
+    return;
+  }
+  double shorter = SDL_min(fill->p50_us, cull->p50_us);
+  double hidden = fill->p50_us + cull->p50_us - overlap->p50_us;
+  if (shorter > 0.0) {
+    log_info("%s hides %.0f%% of the shorter workload", overlap_name,
+             SDL_max(hidden, 0.0) / shorter * 100.0);
+  }
+}
+
+// The scene culled inside the graphics command buffer, no compute queue
+static Result(int, ErrorMessage) bench_compute_scene(Bench* bench,
+                                                     BenchVulkan* vk,
+                                                     BenchCompute* compute) {
+  const VulkanDevice* device = &vk->device;
+  VulkanFrameScheduler scheduler;
+  VulkanIndirectScene scene;
+  vulkan_frame_scheduler_reset(&scheduler);
+  vulkan_indirect_scene_reset(&scene);
+  auto result = vulkan_frame_scheduler_init(&scheduler, device,
+                                            VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+  if (result.is_ok) {
+    result = bench_compute_scene_init(compute, vk, &scene);
+  }
+
+  if (result.is_ok &&
+      bench_case_begin(bench, "scene.cull", 200, compute->object_count)) {
+    uint32_t visible_count = 0;
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      result =
+          bench_compute_scene_frame(compute, device, &scheduler, &scene);
+      bench_stop(bench);
+      if (result.is_ok &&
+          bench_compute_mismatches(compute, &scene, &visible_count) > 0) {
+        result = Err(int, ErrorMessage)(
+            "Scene culling disagrees with the CPU frustum test");
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+      log_debug("scene.cull keeps %u of %u objects, %s draw count",
+                visible_count, compute->object_count,
+                scene.has_draw_count ? "compacted with a GPU" : "fixed");
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  device->fn.vkDeviceWaitIdle(device->device);
+  vulkan_indirect_scene_destroy(&scene);
+  vulkan_frame_scheduler_destroy(&scheduler);
+  return result;
+}
+
+// Times and checks one path of the compute queue: the frame alone, then
+// with a graphics workload submitted right before it. Each path gets its own
+// scene, the streams stay with the queue family that uploaded them.
+static Result(int, ErrorMessage) bench_compute_path(Bench* bench,
+                                                    BenchVulkan* vk,
+                                                    BenchCompute* compute,
+                                                    BenchCommands* commands,
+                                                    bool allow_async) {
+  const VulkanDevice* device = &vk->device;
+  VulkanFrameScheduler scheduler;
+  VulkanComputeQueue compute_queue;
+  VulkanIndirectScene scene;
+  vulkan_frame_scheduler_reset(&scheduler);
+  vulkan_compute_queue_reset(&compute_queue);
+  vulkan_indirect_scene_reset(&scene);
+  auto result = vulkan_frame_scheduler_init(&scheduler, device,
+                                            VULKAN_DEFAULT_FRAMES_IN_FLIGHT);
+  if (result.is_ok) {
+    result = vulkan_compute_queue_init(&compute_queue, device,
+                                       VULKAN_DEFAULT_FRAMES_IN_FLIGHT,
+                                       allow_async, nullptr);
+  }
+  if (result.is_ok && allow_async && !compute_queue.is_async) {
+    log_info("No async compute queue family, skipping its compute cases");
+    vulkan_compute_queue_destroy(&compute_queue);
+    vulkan_frame_scheduler_destroy(&scheduler);
+    return result;
+  }
+  if (result.is_ok) {
+    result = bench_compute_scene_init(compute, vk, &scene);
+  }
+  const char* path = allow_async ? "async" : "graphics";
+
+  char name[BENCH_NAME_SIZE];
+  SDL_snprintf(name, sizeof(name), "compute.cull.%s", path);
+  uint32_t object_count = compute->object_count;
+  if (result.is_ok && bench_case_begin(bench, name, 200, object_count)) {
+    uint32_t visible_count = 0;
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      result = bench_compute_frame(compute, device, &scheduler,
+                                   &compute_queue, &scene);
+      bench_stop(bench);
+      if (result.is_ok &&
+          bench_compute_mismatches(compute, &scene, &visible_count) > 0) {
+        result = Err(int, ErrorMessage)(
+            "Compute culling disagrees with the CPU frustum test");
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+      log_debug("%s keeps %u of %u objects", name, visible_count,
+                object_count);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  SDL_snprintf(name, sizeof(name), "compute.overlap.%s", path);
+  if (result.is_ok && bench_case_begin(bench, name, 200, object_count)) {
+    uint32_t visible_count = 0;
+    while (result.is_ok && bench_case_next(bench)) {
+      bench_start(bench);
+      VkResult vk_result =
+          bench_compute_submit_fill(compute, commands, device);
+      if (vk_result != VK_SUCCESS) {
+        result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+        bench_stop(bench);
+        break;
+      }
+      result = bench_compute_frame(compute, device, &scheduler,
+                                   &compute_queue, &scene);
+      vk_result = bench_compute_wait_fill(commands, device);
+      bench_stop(bench);
+      if (result.is_ok && vk_result != VK_SUCCESS) {
+        result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+      }
+      if (result.is_ok &&
+          bench_compute_mismatches(compute, &scene, &visible_count) > 0) {
+        result = Err(int, ErrorMessage)(
+            "Compute culling disagrees with the CPU frustum test");
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  if (result.is_ok) {
+    bench_compute_log_overlap(bench, path);
+  }
+  device->fn.vkDeviceWaitIdle(device->device);
+  vulkan_indirect_scene_destroy(&scene);
+  vulkan_compute_queue_destroy(&compute_queue);
+  vulkan_frame_scheduler_destroy(&scheduler);
+  return result;
+}
+
+// The indirect scene culled in the graphics command buffer, then through the
+// compute queue on the graphics fallback and, when the device has one, on an
+// async compute family. Every frame moves two objects and its results are
+// checked against the CPU, the overlap cases show how much of a graphics
+// workload the compute work hides behind.
+static Result(int, ErrorMessage) bench_compute(Bench* bench,
+                                               BenchVulkan* vk,
+                                               const BenchConfig* config) {
+  if (!config->cull_shader_path) {
+    log_info("No --cull-shader given, skipping the compute cases");
+    return Ok(int, ErrorMessage)(0);
+  }
+  const VulkanDevice* device = &vk->device;
+  if (!device->has_multi_draw_indirect) {
+    log_info("No multi draw indirect, skipping the compute cases");
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  BenchCompute compute;
+  BenchCommands commands = {0};
+  auto result = bench_compute_init(&compute, vk, config);
+  if (result.is_ok) {
+    result = bench_commands_init(&commands, device);
+  }
+
+  // the graphics workload alone, the overlap cases are compared against it
+  if (result.is_ok && bench_case_begin(bench, "compute.fill", 200, 0)) {
+    while (bench_case_next(bench)) {
+      bench_start(bench);
+      VkResult vk_result =
+          bench_compute_submit_fill(&compute, &commands, device);
+      if (vk_result == VK_SUCCESS) {
+        vk_result = bench_compute_wait_fill(&commands, device);
+      }
+      bench_stop(bench);
+      if (vk_result != VK_SUCCESS) {
+        result = Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+        break;
+      }
+    }
+    if (result.is_ok) {
+      bench_case_end(bench);
+    } else {
+      bench_case_abort(bench);
+    }
+  }
+
+  if (result.is_ok) {
+    result = bench_compute_scene(bench, vk, &compute);
+  }
+  for (uint32_t is_async = 0; result.is_ok && is_async < 2; is_async++) {
+    result = bench_compute_path(bench, vk, &compute, &commands, is_async);
+  }
+
+  device->fn.vkDeviceWaitIdle(device->device);
+  bench_compute_destroy(&compute, vk);
+  bench_commands_destroy(&commands, device);
+  return result;
+}
+
+static Result(int, ErrorMessage)
+    bench_run(Bench* bench, BenchVulkan* vk, const BenchConfig* config) {
+  auto result = bench_instance(bench, vk);
+  if (result.is_ok) {
+    result = bench_device(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_allocator(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_record(bench, vk, config);
+  }
+  if (result.is_ok) {
+    result = bench_submit(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_descriptors(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_bind(bench, vk, config);
+  }
+  if (result.is_ok) {
+    result = bench_textures(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_meshes(bench, vk);
+  }
+  if (result.is_ok) {
+    result = bench_compute(bench, vk, config);
+  }
+  if (result.is_ok) {
+    result = bench_math(bench, config);
+  }
+  return result;
+}
+
+int main(int argc, char* argv[argc + 1]) {
+  BenchConfig config;
+  auto config_result = bench_config_parse(&config, argc, argv);
+  if (!config_result.is_ok) {
+    log_error("Invalid arguments: %s", config_result.error);
+    return EXIT_FAILURE;
+  }
+
+  auto logger_result = logger_init(nullptr);
+  if (!logger_result.is_ok) {
+    log_error("Error while initializing the logger: %s", logger_result.error);
+    return EXIT_FAILURE;
+  }
+
+  Bench bench;
+  BenchVulkan vk;
+  bench_reset(&bench);
+  bench_vulkan_reset(&vk);
+
+  auto result =
+      bench_init(&bench, config.iterations, config.warmup, config.filter);
+  if (result.is_ok) {
+    result = bench_vulkan_init(&vk);
+  }
+  if (result.is_ok) {
+    SDL_snprintf(bench.context, sizeof(bench.context), "%s, %s build, %s math",
+                 vk.device.info.properties.deviceName, BENCH_BUILD,
+                 MATH_SIMD_NAME);
+    result = bench_run(&bench, &vk, &config);
+  }
+  if (result.is_ok) {
+    bench_log_results(&bench);
+    if (config.json_path) {
+      result = bench_write_json(&bench, config.json_path);
+    }
+  }
+  if (!result.is_ok) {
+    log_error("Error while benchmarking: %s", result.error);
+  } else if (config.json_path) {
+    log_info("Wrote benchmark results to %s", config.json_path);
+  }
+
+  bench_vulkan_destroy(&vk);
+  bench_destroy(&bench);
+  // every job system has exited, nothing allocates from the thread arenas
+  arena_thread_destroy_all();
+  logger_destroy();
+  return result.is_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
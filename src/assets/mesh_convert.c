@@ -0,0 +1,831 @@
+#include "./mesh_convert.h"
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utils/arena.h"
+#include "../utils/file_map.h"
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+
+#define OBJ_MAX_LINE_LENGTH 4096
+#define OBJ_NO_INDEX UINT32_MAX
+// simulated post transform cache of the vertex order optimization
+#define MESH_CACHE_SIZE 32
+// FIFO cache the reported miss ratios are measured with
+#define MESH_FIFO_SIZE 16
+
+static void mesh_array_init(MeshArray* array, uint32_t stride) {
+  *array = (MeshArray){.stride = stride};
+}
+
+static void mesh_array_destroy(MeshArray* array) {
+  mem_free(array->data);
+  mesh_array_init(array, array->stride);
+}
+
+// nullptr when out of memory, the element is not initialized
+static void* mesh_array_push(MeshArray* array) {
+  if (array->count == array->capacity) {
+    uint32_t capacity = array->capacity > 0 ? array->capacity * 2 : 256;
+    uint8_t* data = mem_realloc(array->data, (size_t)capacity * array->stride);
+    if (!data) {
+      return nullptr;
+    }
+    array->data = data;
+    array->capacity = capacity;
+  }
+  return array->data + (size_t)array->count++ * array->stride;
+}
+
+static void* mesh_array_at(const MeshArray* array, uint32_t index) {
+  return array->data + (size_t)index * array->stride;
+}
+
+void mesh_builder_init(MeshBuilder* builder) {
+  mesh_array_init(&builder->obj_positions, sizeof(float[3]));
+  mesh_array_init(&builder->obj_normals, sizeof(float[3]));
+  mesh_array_init(&builder->positions, sizeof(float[3]));
+  mesh_array_init(&builder->normals, sizeof(float[3]));
+  mesh_array_init(&builder->keys, sizeof(uint32_t[2]));
+  mesh_array_init(&builder->indices, sizeof(uint32_t));
+  mesh_array_init(&builder->meshlets, sizeof(MeshMeshlet));
+  builder->slots = nullptr;
+  builder->slot_capacity = 0;
+}
+
+void mesh_builder_destroy(MeshBuilder* builder) {
+  mesh_array_destroy(&builder->obj_positions);
+  mesh_array_destroy(&builder->obj_normals);
+  mesh_array_destroy(&builder->positions);
+  mesh_array_destroy(&builder->normals);
+  mesh_array_destroy(&builder->keys);
+  mesh_array_destroy(&builder->indices);
+  mesh_array_destroy(&builder->meshlets);
+  mem_free(builder->slots);
+  builder->slots = nullptr;
+  builder->slot_capacity = 0;
+}
+
+static uint32_t mesh_builder_slot(const MeshBuilder* builder,
+                                  const uint32_t key[2]) {
+  uint32_t mask = builder->slot_capacity - 1;
+  uint32_t slot =
+      (uint32_t)hash_fnv1a64(key, sizeof(uint32_t[2]), HASH_FNV1A64_SEED) &
+      mask;
+  while (builder->slots[slot] != 0) {
+    const uint32_t* other =
+        mesh_array_at(&builder->keys, builder->slots[slot] - 1);
+    if (other[0] == key[0] && other[1] == key[1]) {
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+// keeps the slot table at most half full
+static Result(int, ErrorMessage) mesh_builder_grow_slots(MeshBuilder* builder) {
+  if ((builder->keys.count + 1) * 2 <= builder->slot_capacity) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  uint32_t capacity =
+      builder->slot_capacity > 0 ? builder->slot_capacity * 2 : 1024;
+  uint32_t* slots = mem_alloc(sizeof(uint32_t) * capacity);
+  CHECK_ALLOC(slots, Err(int, ErrorMessage)(
+                         "Unable to allocate memory for the vertex table"));
+  memset(slots, 0, sizeof(uint32_t) * capacity);
+  mem_free(builder->slots);
+  builder->slots = slots;
+  builder->slot_capacity = capacity;
+  for (uint32_t i = 0; i < builder->keys.count; i++) {
+    const uint32_t* key = mesh_array_at(&builder->keys, i);
+    builder->slots[mesh_builder_slot(builder, key)] = i + 1;
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// index of the unique vertex of an OBJ face corner
+static Result(int, ErrorMessage)
+    mesh_builder_vertex(MeshBuilder* builder,
+                        uint32_t position,
+                        uint32_t normal,
+                        uint32_t* index) {
+  auto result = mesh_builder_grow_slots(builder);
+  if (!result.is_ok) {
+    return result;
+  }
+  const uint32_t key[2] = {position, normal};
+  uint32_t slot = mesh_builder_slot(builder, key);
+  if (builder->slots[slot] != 0) {
+    *index = builder->slots[slot] - 1;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  uint32_t* new_key = mesh_array_push(&builder->keys);
+  float* new_position = mesh_array_push(&builder->positions);
+  float* new_normal = mesh_array_push(&builder->normals);
+  if (!new_key || !new_position || !new_normal) {
+    return Err(int, ErrorMessage)("Unable to allocate memory for vertices");
+  }
+  new_key[0] = position;
+  new_key[1] = normal;
+  memcpy(new_position, mesh_array_at(&builder->obj_positions, position),
+         sizeof(float[3]));
+  // missing normals are generated once all faces are read
+  if (normal != OBJ_NO_INDEX) {
+    memcpy(new_normal, mesh_array_at(&builder->obj_normals, normal),
+           sizeof(float[3]));
+  } else {
+    memset(new_normal, 0, sizeof(float[3]));
+  }
+  *index = builder->keys.count - 1;
+  builder->slots[slot] = *index + 1;
+  return Ok(int, ErrorMessage)(0);
+}
+
+// OBJ indices start at 1, negative ones count back from the last element
+static bool obj_resolve_index(long index, uint32_t count, uint32_t* resolved) {
+  if (index > 0 && (unsigned long)index <= count) {
+    *resolved = (uint32_t)(index - 1);
+    return true;
+  }
+  if (index < 0 && (unsigned long)-index <= count) {
+    *resolved = (uint32_t)(count + index);
+    return true;
+  }
+  return false;
+}
+
+static Result(int, ErrorMessage) obj_parse_vector(MeshArray* array,
+                                                  const char* text) {
+  float* vector = mesh_array_push(array);
+  if (!vector) {
+    return Err(int, ErrorMessage)("Unable to allocate memory for vectors");
+  }
+  char* end = nullptr;
+  for (uint32_t i = 0; i < 3; i++) {
+    vector[i] = strtof(text, &end);
+    if (end == text) {
+      return Err(int, ErrorMessage)("Invalid vector");
+    }
+    text = end;
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// p, p/t, p//n or p/t/n per corner, polygons are triangulated as fans
+static Result(int, ErrorMessage) obj_parse_face(MeshBuilder* builder,
+                                                const char* text) {
+  uint32_t first = 0;
+  uint32_t previous = 0;
+  uint32_t corner_count = 0;
+  while (true) {
+    char* end = nullptr;
+    long position_index = strtol(text, &end, 10);
+    if (end == text) {
+      break;
+    }
+    text = end;
+    long normal_index = 0;
+    if (*text == '/') {
+      text++;
+      if (*text != '/') {
+        strtol(text, &end, 10);
+        text = end;
+      }
+      if (*text == '/') {
+        text++;
+        normal_index = strtol(text, &end, 10);
+        text = end;
+      }
+    }
+
+    uint32_t position = 0;
+    uint32_t normal = OBJ_NO_INDEX;
+    if (!obj_resolve_index(position_index, builder->obj_positions.count,
+                           &position) ||
+        (normal_index != 0 &&
+         !obj_resolve_index(normal_index, builder->obj_normals.count,
+                            &normal))) {
+      return Err(int, ErrorMessage)("Face index out of range");
+    }
+    uint32_t vertex = 0;
+    auto result = mesh_builder_vertex(builder, position, normal, &vertex);
+    if (!result.is_ok) {
+      return result;
+    }
+
+    if (corner_count == 0) {
+      first = vertex;
+    } else if (corner_count >= 2 && first != previous && first != vertex &&
+               previous != vertex) {
+      const uint32_t triangle[3] = {first, previous, vertex};
+      for (uint32_t i = 0; i < 3; i++) {
+        // a push may move the array, each index is written right away
+        uint32_t* index = mesh_array_push(&builder->indices);
+        if (!index) {
+          return Err(int, ErrorMessage)(
+              "Unable to allocate memory for indices");
+        }
+        *index = triangle[i];
+      }
+    }
+    previous = vertex;
+    corner_count++;
+  }
+  if (corner_count < 3) {
+    return Err(int, ErrorMessage)("Face with less than three corners");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// Positions, normals and faces, everything else (texture coordinates,
+// groups, materials) is skipped
+static Result(int, ErrorMessage) obj_parse(MeshBuilder* builder,
+                                           const char* data,
+                                           size_t size) {
+  char line[OBJ_MAX_LINE_LENGTH];
+  uint32_t line_number = 0;
+  size_t position = 0;
+  while (position < size) {
+    size_t length = 0;
+    while (position + length < size && data[position + length] != '\n') {
+      length++;
+    }
+    line_number++;
+    if (length >= sizeof(line)) {
+      log_error("Line %u is too long", line_number);
+      return Err(int, ErrorMessage)("OBJ line too long");
+    }
+    // strto* need a terminated string, the mapping is not
+    memcpy(line, data + position, length);
+    line[length] = '\0';
+    position += length + 1;
+
+    const char* text = line;
+    while (*text == ' ' || *text == '\t') {
+      text++;
+    }
+    Result(int, ErrorMessage) result = Ok(int, ErrorMessage)(0);
+    if (strncmp(text, "v ", 2) == 0) {
+      result = obj_parse_vector(&builder->obj_positions, text + 2);
+    } else if (strncmp(text, "vn ", 3) == 0) {
+      result = obj_parse_vector(&builder->obj_normals, text + 3);
+    } else if (strncmp(text, "f ", 2) == 0) {
+      result = obj_parse_face(builder, text + 2);
+    }
+    if (!result.is_ok) {
+      log_error("Line %u: %s", line_number, result.error);
+      return result;
+    }
+  }
+  if (builder->indices.count == 0) {
+    return Err(int, ErrorMessage)("OBJ file has no triangles");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// area weighted face normals for the vertices the file gave none
+static void mesh_builder_generate_normals(MeshBuilder* builder) {
+  const uint32_t* indices = (const uint32_t*)builder->indices.data;
+  for (uint32_t i = 0; i < builder->indices.count; i += 3) {
+    const float* a = mesh_array_at(&builder->positions, indices[i]);
+    const float* b = mesh_array_at(&builder->positions, indices[i + 1]);
+    const float* c = mesh_array_at(&builder->positions, indices[i + 2]);
+    float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float face[3] = {
+        ab[1] * ac[2] - ab[2] * ac[1],
+        ab[2] * ac[0] - ab[0] * ac[2],
+        ab[0] * ac[1] - ab[1] * ac[0],
+    };
+    for (uint32_t j = 0; j < 3; j++) {
+      const uint32_t* key = mesh_array_at(&builder->keys, indices[i + j]);
+      if (key[1] != OBJ_NO_INDEX) {
+        continue;
+      }
+      float* normal = mesh_array_at(&builder->normals, indices[i + j]);
+      normal[0] += face[0];
+      normal[1] += face[1];
+      normal[2] += face[2];
+    }
+  }
+
+  for (uint32_t i = 0; i < builder->normals.count; i++) {
+    float* normal = mesh_array_at(&builder->normals, i);
+    float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] +
+                         normal[2] * normal[2]);
+    if (length > 0.0f) {
+      normal[0] /= length;
+      normal[1] /= length;
+      normal[2] /= length;
+    } else {
+      normal[0] = 0.0f;
+      normal[1] = 0.0f;
+      normal[2] = 1.0f;
+    }
+  }
+}
+
+// average cache miss ratio, transformed vertices per triangle
+static float mesh_fifo_acmr(const uint32_t* indices,
+                            uint32_t index_count,
+                            uint32_t* stamps,
+                            uint32_t vertex_count) {
+  memset(stamps, 0, sizeof(uint32_t) * vertex_count);
+  uint32_t time = MESH_FIFO_SIZE + 1;
+  uint32_t miss_count = 0;
+  for (uint32_t i = 0; i < index_count; i++) {
+    if (time - stamps[indices[i]] > MESH_FIFO_SIZE) {
+      stamps[indices[i]] = time++;
+      miss_count++;
+    }
+  }
+  return (float)miss_count / (float)(index_count / 3);
+}
+
+static float mesh_forsyth_score(int32_t cache_position, uint32_t live_count) {
+  if (live_count == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cache_position >= 0 && cache_position < 3) {
+    // the last triangle's vertices, reusing them right away is no better
+    // than any other cache hit
+    score = 0.75f;
+  } else if (cache_position >= 0) {
+    float scale = 1.0f - (float)(cache_position - 3) / (MESH_CACHE_SIZE - 3);
+    score = powf(scale, 1.5f);
+  }
+  // vertices with few triangles left are finished first
+  return score + 2.0f / sqrtf((float)live_count);
+}
+
+// Tom Forsyth's linear speed vertex cache optimization: triangles are
+// emitted greedily by the scores of their vertices in a simulated LRU cache
+static Result(int, ErrorMessage)
+    mesh_optimize_vertex_cache(uint32_t* indices,
+                               uint32_t index_count,
+                               uint32_t vertex_count) {
+  uint32_t triangle_count = index_count / 3;
+  uint32_t* live_counts = mem_alloc(sizeof(uint32_t) * vertex_count);
+  uint32_t* adjacency_offsets = mem_alloc(sizeof(uint32_t) * vertex_count);
+  uint32_t* adjacency = mem_alloc(sizeof(uint32_t) * index_count);
+  int32_t* cache_positions = mem_alloc(sizeof(int32_t) * vertex_count);
+  float* vertex_scores = mem_alloc(sizeof(float) * vertex_count);
+  float* triangle_scores = mem_alloc(sizeof(float) * triangle_count);
+  bool* is_emitted = mem_alloc(sizeof(bool) * triangle_count);
+  uint32_t* output = mem_alloc(sizeof(uint32_t) * index_count);
+  if (!live_counts || !adjacency_offsets || !adjacency || !cache_positions ||
+      !vertex_scores || !triangle_scores || !is_emitted || !output) {
+    mem_free(live_counts);
+    mem_free(adjacency_offsets);
+    mem_free(adjacency);
+    mem_free(cache_positions);
+    mem_free(vertex_scores);
+    mem_free(triangle_scores);
+    mem_free(is_emitted);
+    mem_free(output);
+    return Err(int, ErrorMessage)(
+        "Unable to allocate memory for the vertex cache optimization");
+  }
+
+  memset(live_counts, 0, sizeof(uint32_t) * vertex_count);
+  for (uint32_t i = 0; i < index_count; i++) {
+    live_counts[indices[i]]++;
+  }
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    adjacency_offsets[i] = offset;
+    offset += live_counts[i];
+    live_counts[i] = 0;
+  }
+  for (uint32_t i = 0; i < index_count; i++) {
+    uint32_t vertex = indices[i];
+    adjacency[adjacency_offsets[vertex] + live_counts[vertex]++] = i / 3;
+  }
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    cache_positions[i] = -1;
+    vertex_scores[i] = mesh_forsyth_score(-1, live_counts[i]);
+  }
+  uint32_t best = 0;
+  for (uint32_t i = 0; i < triangle_count; i++) {
+    triangle_scores[i] = vertex_scores[indices[i * 3]] +
+                         vertex_scores[indices[i * 3 + 1]] +
+                         vertex_scores[indices[i * 3 + 2]];
+    is_emitted[i] = false;
+    if (triangle_scores[i] > triangle_scores[best]) {
+      best = i;
+    }
+  }
+
+  uint32_t cache[MESH_CACHE_SIZE + 3];
+  uint32_t cache_count = 0;
+  // triangles before it are all emitted, the fallback scan starts there
+  uint32_t cursor = 0;
+  for (uint32_t emitted = 0; emitted < triangle_count; emitted++) {
+    if (best == UINT32_MAX) {
+      while (is_emitted[cursor]) {
+        cursor++;
+      }
+      best = cursor;
+    }
+    const uint32_t* triangle = &indices[best * 3];
+    output[emitted * 3] = triangle[0];
+    output[emitted * 3 + 1] = triangle[1];
+    output[emitted * 3 + 2] = triangle[2];
+    is_emitted[best] = true;
+
+    for (uint32_t i = 0; i < 3; i++) {
+      uint32_t vertex = triangle[i];
+      uint32_t* triangles = &adjacency[adjacency_offsets[vertex]];
+      for (uint32_t j = 0; j < live_counts[vertex]; j++) {
+        if (triangles[j] == best) {
+          triangles[j] = triangles[--live_counts[vertex]];
+          break;
+        }
+      }
+    }
+
+    // the triangle's vertices move to the front, the others shift back and
+    // whatever passes the end falls out
+    uint32_t next_cache[MESH_CACHE_SIZE + 3];
+    uint32_t next_count = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+      next_cache[next_count++] = triangle[i];
+    }
+    for (uint32_t i = 0; i < cache_count; i++) {
+      uint32_t vertex = cache[i];
+      if (vertex != triangle[0] && vertex != triangle[1] &&
+          vertex != triangle[2]) {
+        next_cache[next_count++] = vertex;
+      }
+    }
+    for (uint32_t i = 0; i < next_count; i++) {
+      uint32_t vertex = next_cache[i];
+      cache_positions[vertex] = i < MESH_CACHE_SIZE ? (int32_t)i : -1;
+      vertex_scores[vertex] =
+          mesh_forsyth_score(cache_positions[vertex], live_counts[vertex]);
+    }
+
+    // only triangles around the touched vertices changed their score
+    best = UINT32_MAX;
+    float best_score = -1.0f;
+    for (uint32_t i = 0; i < next_count; i++) {
+      uint32_t vertex = next_cache[i];
+      const uint32_t* triangles = &adjacency[adjacency_offsets[vertex]];
+      for (uint32_t j = 0; j < live_counts[vertex]; j++) {
+        uint32_t candidate = triangles[j];
+        const uint32_t* corners = &indices[candidate * 3];
+        float score = vertex_scores[corners[0]] + vertex_scores[corners[1]] +
+                      vertex_scores[corners[2]];
+        triangle_scores[candidate] = score;
+        if (i < MESH_CACHE_SIZE && score > best_score) {
+          best = candidate;
+          best_score = score;
+        }
+      }
+    }
+    cache_count = SDL_min(next_count, (uint32_t)MESH_CACHE_SIZE);
+    memcpy(cache, next_cache, sizeof(uint32_t) * cache_count);
+  }
+
+  memcpy(indices, output, sizeof(uint32_t) * index_count);
+  mem_free(live_counts);
+  mem_free(adjacency_offsets);
+  mem_free(adjacency);
+  mem_free(cache_positions);
+  mem_free(vertex_scores);
+  mem_free(triangle_scores);
+  mem_free(is_emitted);
+  mem_free(output);
+  return Ok(int, ErrorMessage)(0);
+}
+
+// renumbers the vertices in the order the indices first use them, so vertex
+// fetches walk memory forward
+static Result(int, ErrorMessage)
+    mesh_optimize_vertex_fetch(MeshBuilder* builder) {
+  uint32_t vertex_count = builder->positions.count;
+  uint32_t* remap = mem_alloc(sizeof(uint32_t) * vertex_count);
+  float* positions = mem_alloc(sizeof(float[3]) * vertex_count);
+  float* normals = mem_alloc(sizeof(float[3]) * vertex_count);
+  if (!remap || !positions || !normals) {
+    mem_free(remap);
+    mem_free(positions);
+    mem_free(normals);
+    return Err(int, ErrorMessage)(
+        "Unable to allocate memory for the vertex fetch optimization");
+  }
+
+  memset(remap, 0xff, sizeof(uint32_t) * vertex_count);
+  uint32_t* indices = (uint32_t*)builder->indices.data;
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < builder->indices.count; i++) {
+    uint32_t vertex = indices[i];
+    if (remap[vertex] == UINT32_MAX) {
+      remap[vertex] = next;
+      memcpy(&positions[next * 3], mesh_array_at(&builder->positions, vertex),
+             sizeof(float[3]));
+      memcpy(&normals[next * 3], mesh_array_at(&builder->normals, vertex),
+             sizeof(float[3]));
+      next++;
+    }
+    indices[i] = remap[vertex];
+  }
+
+  // vertices no face uses are dropped
+  memcpy(builder->positions.data, positions, sizeof(float[3]) * next);
+  memcpy(builder->normals.data, normals, sizeof(float[3]) * next);
+  builder->positions.count = next;
+  builder->normals.count = next;
+  mem_free(remap);
+  mem_free(positions);
+  mem_free(normals);
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void mesh_bounds(const float* positions,
+                        const uint32_t* indices,
+                        uint32_t index_count,
+                        float min[3],
+                        float max[3]) {
+  for (uint32_t i = 0; i < 3; i++) {
+    min[i] = INFINITY;
+    max[i] = -INFINITY;
+  }
+  for (uint32_t i = 0; i < index_count; i++) {
+    const float* position = &positions[indices[i] * 3];
+    for (uint32_t j = 0; j < 3; j++) {
+      min[j] = fminf(min[j], position[j]);
+      max[j] = fmaxf(max[j], position[j]);
+    }
+  }
+}
+
+// sphere around the box center, margin covers the quantization error
+static void mesh_bounding_sphere(const float* positions,
+                                 const uint32_t* indices,
+                                 uint32_t index_count,
+                                 float margin,
+                                 float center[3],
+                                 float* radius) {
+  float min[3];
+  float max[3];
+  mesh_bounds(positions, indices, index_count, min, max);
+  for (uint32_t i = 0; i < 3; i++) {
+    center[i] = (min[i] + max[i]) * 0.5f;
+  }
+  float radius_squared = 0.0f;
+  for (uint32_t i = 0; i < index_count; i++) {
+    const float* position = &positions[indices[i] * 3];
+    float dx = position[0] - center[0];
+    float dy = position[1] - center[1];
+    float dz = position[2] - center[2];
+    radius_squared = fmaxf(radius_squared, dx * dx + dy * dy + dz * dz);
+  }
+  *radius = sqrtf(radius_squared) + margin;
+}
+
+// Splits the optimized triangle order into runs of at most
+// MESH_MAX_MESHLET_VERTICES unique vertices and MESH_MAX_MESHLET_TRIANGLES
+// triangles, each a range of the index buffer
+static Result(int, ErrorMessage) mesh_build_meshlets(MeshBuilder* builder,
+                                                     float margin) {
+  uint32_t* markers = mem_alloc(sizeof(uint32_t) * builder->positions.count);
+  CHECK_ALLOC(markers, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for meshlets"));
+  memset(markers, 0xff, sizeof(uint32_t) * builder->positions.count);
+
+  const uint32_t* indices = (const uint32_t*)builder->indices.data;
+  const float* positions = (const float*)builder->positions.data;
+  uint32_t meshlet_index = 0;
+  uint32_t first_index = 0;
+  uint32_t vertex_count = 0;
+  for (uint32_t i = 0; i <= builder->indices.count; i += 3) {
+    bool is_full = i == builder->indices.count;
+    if (!is_full) {
+      uint32_t new_vertices = 0;
+      for (uint32_t j = 0; j < 3; j++) {
+        new_vertices += markers[indices[i + j]] != meshlet_index;
+      }
+      is_full = vertex_count + new_vertices > MESH_MAX_MESHLET_VERTICES ||
+                (i - first_index) / 3 + 1 > MESH_MAX_MESHLET_TRIANGLES;
+    }
+
+    if (is_full && i > first_index) {
+      MeshMeshlet* meshlet = mesh_array_push(&builder->meshlets);
+      if (!meshlet) {
+        mem_free(markers);
+        return Err(int, ErrorMessage)("Unable to allocate memory for meshlets");
+      }
+      meshlet->first_index = first_index;
+      meshlet->index_count = i - first_index;
+      mesh_bounding_sphere(positions, indices + first_index,
+                           meshlet->index_count, margin, meshlet->center,
+                           &meshlet->radius);
+      meshlet_index++;
+      first_index = i;
+      vertex_count = 0;
+    }
+    if (i == builder->indices.count) {
+      break;
+    }
+    for (uint32_t j = 0; j < 3; j++) {
+      if (markers[indices[i + j]] != meshlet_index) {
+        markers[indices[i + j]] = meshlet_index;
+        vertex_count++;
+      }
+    }
+  }
+
+  mem_free(markers);
+  return Ok(int, ErrorMessage)(0);
+}
+
+static uint64_t mesh_align(uint64_t offset) {
+  return (offset + MESH_SECTION_ALIGNMENT - 1) &
+         ~(uint64_t)(MESH_SECTION_ALIGNMENT - 1);
+}
+
+static Result(int, ErrorMessage)
+    mesh_write(const char* path,
+               MeshFileHeader* header,
+               const void* sections[MESH_SECTION_COUNT]) {
+  uint64_t offset = sizeof(MeshFileHeader);
+  for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+    offset = mesh_align(offset);
+    header->sections[i].offset = offset;
+    offset += header->sections[i].size;
+  }
+
+  SDL_RWops* file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  static const uint8_t padding[MESH_SECTION_ALIGNMENT] = {0};
+  bool success = SDL_RWwrite(file, header, sizeof(*header), 1) == 1;
+  offset = sizeof(MeshFileHeader);
+  for (uint32_t i = 0; i < MESH_SECTION_COUNT && success; i++) {
+    const MeshSectionRange* range = &header->sections[i];
+    if (range->offset > offset) {
+      success = SDL_RWwrite(file, padding, range->offset - offset, 1) == 1;
+    }
+    if (success && range->size > 0) {
+      success = SDL_RWwrite(file, sections[i], range->size, 1) == 1;
+    }
+    offset = range->offset + range->size;
+  }
+  success = SDL_RWclose(file) == 0 && success;
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to write mesh file");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// quantizes the optimized builder into the file sections
+static Result(int, ErrorMessage) mesh_convert_write(MeshBuilder* builder,
+                                                    const char* path) {
+  uint32_t vertex_count = builder->positions.count;
+  uint32_t index_count = builder->indices.count;
+  const float* positions = (const float*)builder->positions.data;
+  const uint32_t* indices = (const uint32_t*)builder->indices.data;
+
+  MeshFileHeader header = {
+      .magic = MESH_FILE_MAGIC,
+      .version = MESH_FILE_VERSION,
+      .vertex_count = vertex_count,
+      .index_count = index_count,
+      .meshlet_count = builder->meshlets.count,
+      .index_size = vertex_count <= UINT16_MAX + 1 ? sizeof(uint16_t)
+                                                  : sizeof(uint32_t),
+  };
+  float max[3];
+  mesh_bounds(positions, indices, index_count, header.position_offset, max);
+  float margin = 0.0f;
+  for (uint32_t i = 0; i < 3; i++) {
+    header.position_scale[i] = max[i] - header.position_offset[i];
+    margin = fmaxf(margin, header.position_scale[i] / UINT16_MAX);
+  }
+  mesh_bounding_sphere(positions, indices, index_count, margin, header.center,
+                       &header.radius);
+
+  auto result = mesh_build_meshlets(builder, margin);
+  if (!result.is_ok) {
+    return result;
+  }
+  header.meshlet_count = builder->meshlets.count;
+
+  uint16_t* quantized = mem_alloc(sizeof(uint16_t[4]) * vertex_count);
+  int16_t* encoded = mem_alloc(sizeof(int16_t[2]) * vertex_count);
+  void* packed_indices = mem_alloc((size_t)header.index_size * index_count);
+  if (!quantized || !encoded || !packed_indices) {
+    mem_free(quantized);
+    mem_free(encoded);
+    mem_free(packed_indices);
+    return Err(int, ErrorMessage)("Unable to allocate memory for the output");
+  }
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    for (uint32_t j = 0; j < 3; j++) {
+      float scale = header.position_scale[j];
+      float value = scale > 0.0f
+                        ? (positions[i * 3 + j] - header.position_offset[j]) /
+                              scale
+                        : 0.0f;
+      quantized[i * 4 + j] = mesh_quantize_unorm16(value);
+    }
+    quantized[i * 4 + 3] = 0;
+    mesh_encode_octahedral(mesh_array_at(&builder->normals, i),
+                           &encoded[i * 2]);
+  }
+  for (uint32_t i = 0; i < index_count; i++) {
+    if (header.index_size == sizeof(uint16_t)) {
+      ((uint16_t*)packed_indices)[i] = (uint16_t)indices[i];
+    } else {
+      ((uint32_t*)packed_indices)[i] = indices[i];
+    }
+  }
+
+  header.sections[MESH_SECTION_POSITIONS].size =
+      sizeof(uint16_t[4]) * (uint64_t)vertex_count;
+  header.sections[MESH_SECTION_NORMALS].size =
+      sizeof(int16_t[2]) * (uint64_t)vertex_count;
+  header.sections[MESH_SECTION_INDICES].size =
+      (uint64_t)header.index_size * index_count;
+  header.sections[MESH_SECTION_MESHLETS].size =
+      sizeof(MeshMeshlet) * (uint64_t)header.meshlet_count;
+  const void* sections[MESH_SECTION_COUNT] = {
+      [MESH_SECTION_POSITIONS] = quantized,
+      [MESH_SECTION_NORMALS] = encoded,
+      [MESH_SECTION_INDICES] = packed_indices,
+      [MESH_SECTION_MESHLETS] = builder->meshlets.data,
+  };
+  result = mesh_write(path, &header, sections);
+  mem_free(quantized);
+  mem_free(encoded);
+  mem_free(packed_indices);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  log_info("Wrote %s: %u vertices, %u triangles, %u meshlets, %u bit indices",
+           path, vertex_count, index_count / 3, header.meshlet_count,
+           header.index_size * 8);
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    mesh_builder_load_obj(MeshBuilder* builder, const char* path) {
+  FileMap map;
+  auto result = file_map_open(&map, path);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = obj_parse(builder, (const char*)map.data, map.size);
+  file_map_close(&map);
+  if (!result.is_ok) {
+    return result;
+  }
+  mesh_builder_generate_normals(builder);
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) mesh_convert(MeshBuilder* builder,
+                                       const char* input_path,
+                                       const char* output_path) {
+  auto result = mesh_builder_load_obj(builder, input_path);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  uint32_t vertex_count = builder->positions.count;
+  uint32_t* stamps = mem_alloc(sizeof(uint32_t) * vertex_count);
+  CHECK_ALLOC(stamps, Err(int, ErrorMessage)(
+                          "Unable to allocate memory for the cache stats"));
+  uint32_t* indices = (uint32_t*)builder->indices.data;
+  float acmr_before = mesh_fifo_acmr(indices, builder->indices.count, stamps,
+                                     vertex_count);
+  // the working arrays of the optimization all die with it
+  ArenaScratch scratch = arena_scratch_begin();
+  MemArenaScope scope = mem_arena_begin(scratch.arena);
+  result = mesh_optimize_vertex_cache(indices, builder->indices.count,
+                                      vertex_count);
+  mem_arena_end(scope);
+  arena_scratch_end(scratch);
+  if (result.is_ok) {
+    result = mesh_optimize_vertex_fetch(builder);
+  }
+  if (result.is_ok) {
+    float acmr_after = mesh_fifo_acmr(indices, builder->indices.count, stamps,
+                                      builder->positions.count);
+    log_info("Vertex cache misses per triangle: %.3f before, %.3f after",
+             acmr_before, acmr_after);
+    result = mesh_convert_write(builder, output_path);
+  }
+  mem_free(stamps);
+  return result;
+}
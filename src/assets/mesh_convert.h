@@ -0,0 +1,48 @@
+#ifndef ASSETS_MESH_CONVERT_H
+#define ASSETS_MESH_CONVERT_H
+
+#include <stdint.h>
+
+#include "../result.h"
+#include "./mesh_format.h"
+
+// Growable array of fixed size elements
+typedef struct MeshArray {
+  uint8_t* data;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t stride;
+} MeshArray;
+
+// Triangle list with unique vertices, before and after optimization
+typedef struct MeshBuilder {
+  // OBJ data as read, indexed by the face corners
+  MeshArray obj_positions;
+  MeshArray obj_normals;
+  // float[3] positions and normals of the unique vertices
+  MeshArray positions;
+  MeshArray normals;
+  // uint32_t[2] OBJ position and normal index of every unique vertex
+  MeshArray keys;
+  MeshArray indices;
+  // open addressing over keys, vertex index + 1 per slot, 0 is empty
+  uint32_t* slots;
+  uint32_t slot_capacity;
+  MeshArray meshlets;
+} MeshBuilder;
+
+void mesh_builder_init(MeshBuilder* builder);
+void mesh_builder_destroy(MeshBuilder* builder);
+
+// Reads the positions, normals and faces of an OBJ file into unique
+// vertices, normals the file does not have are generated. This is all the
+// parsing a mesh file saves at load time.
+Result(int, ErrorMessage)
+    mesh_builder_load_obj(MeshBuilder* builder, const char* path);
+// loads the OBJ file, optimizes the triangle and vertex order for the
+// vertex cache and fetch and writes the result as a mesh file
+Result(int, ErrorMessage) mesh_convert(MeshBuilder* builder,
+                                       const char* input_path,
+                                       const char* output_path);
+
+#endif
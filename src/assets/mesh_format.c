@@ -0,0 +1,127 @@
+#include "./mesh_format.h"
+
+#include <math.h>
+
+static uint64_t mesh_section_expected_size(const MeshFileHeader* header,
+                                           MeshSection section) {
+  switch (section) {
+    case MESH_SECTION_POSITIONS:
+      return (uint64_t)header->vertex_count * sizeof(uint16_t[4]);
+    case MESH_SECTION_NORMALS:
+      return (uint64_t)header->vertex_count * sizeof(int16_t[2]);
+    case MESH_SECTION_INDICES:
+      return (uint64_t)header->index_count * header->index_size;
+    case MESH_SECTION_MESHLETS:
+      return (uint64_t)header->meshlet_count * sizeof(MeshMeshlet);
+    case MESH_SECTION_COUNT:
+      break;
+  }
+  return 0;
+}
+
+Result(int, ErrorMessage) mesh_file_validate(const uint8_t* data,
+                                             size_t size,
+                                             const MeshFileHeader** header) {
+  if (size < sizeof(MeshFileHeader)) {
+    return Err(int, ErrorMessage)("Mesh file is truncated");
+  }
+  const MeshFileHeader* file_header = (const MeshFileHeader*)data;
+  if (file_header->magic != MESH_FILE_MAGIC) {
+    return Err(int, ErrorMessage)("Not a mesh file");
+  }
+  if (file_header->version != MESH_FILE_VERSION) {
+    return Err(int, ErrorMessage)("Unsupported mesh file version");
+  }
+  if (file_header->index_size != sizeof(uint16_t) &&
+      file_header->index_size != sizeof(uint32_t)) {
+    return Err(int, ErrorMessage)("Invalid mesh index size");
+  }
+  if (file_header->index_count % 3 != 0) {
+    return Err(int, ErrorMessage)("Mesh index count is not a triangle list");
+  }
+
+  for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+    const MeshSectionRange* range = &file_header->sections[i];
+    if (range->offset % MESH_SECTION_ALIGNMENT != 0 ||
+        range->offset < sizeof(MeshFileHeader) || range->offset > size ||
+        range->size > size - range->offset) {
+      return Err(int, ErrorMessage)("Mesh section is out of bounds");
+    }
+    if (range->size != mesh_section_expected_size(file_header, i)) {
+      return Err(int, ErrorMessage)("Mesh section size does not match");
+    }
+  }
+
+  const MeshMeshlet* meshlets =
+      mesh_file_section(data, file_header, MESH_SECTION_MESHLETS);
+  for (uint32_t i = 0; i < file_header->meshlet_count; i++) {
+    const MeshMeshlet* meshlet = &meshlets[i];
+    uint32_t index_count = file_header->index_count;
+    if (meshlet->first_index > index_count ||
+        meshlet->index_count > index_count - meshlet->first_index) {
+      return Err(int, ErrorMessage)("Meshlet is out of bounds");
+    }
+  }
+
+  *header = file_header;
+  return Ok(int, ErrorMessage)(0);
+}
+
+const void* mesh_file_section(const uint8_t* data,
+                              const MeshFileHeader* header,
+                              MeshSection section) {
+  return data + header->sections[section].offset;
+}
+
+uint16_t mesh_quantize_unorm16(float value) {
+  if (!(value > 0.0f)) {
+    return 0;
+  }
+  if (value >= 1.0f) {
+    return UINT16_MAX;
+  }
+  return (uint16_t)(value * UINT16_MAX + 0.5f);
+}
+
+static float mesh_sign(float value) {
+  return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static int16_t mesh_quantize_snorm16(float value) {
+  value = fminf(fmaxf(value, -1.0f), 1.0f);
+  return (int16_t)lroundf(value * INT16_MAX);
+}
+
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and unfolds
+// the lower half over the diagonals, two components then cover the sphere
+// evenly enough for 16 bits each
+void mesh_encode_octahedral(const float normal[3], int16_t encoded[2]) {
+  float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+  float u = length > 0.0f ? normal[0] / length : 0.0f;
+  float v = length > 0.0f ? normal[1] / length : 0.0f;
+  if (normal[2] < 0.0f) {
+    float folded_u = (1.0f - fabsf(v)) * mesh_sign(u);
+    float folded_v = (1.0f - fabsf(u)) * mesh_sign(v);
+    u = folded_u;
+    v = folded_v;
+  }
+  encoded[0] = mesh_quantize_snorm16(u);
+  encoded[1] = mesh_quantize_snorm16(v);
+}
+
+void mesh_decode_octahedral(const int16_t encoded[2], float normal[3]) {
+  // -32768 decodes like -32767, as the snorm vertex formats do
+  float u = fmaxf((float)encoded[0] / INT16_MAX, -1.0f);
+  float v = fmaxf((float)encoded[1] / INT16_MAX, -1.0f);
+  float z = 1.0f - fabsf(u) - fabsf(v);
+  if (z < 0.0f) {
+    float unfolded_u = (1.0f - fabsf(v)) * mesh_sign(u);
+    float unfolded_v = (1.0f - fabsf(u)) * mesh_sign(v);
+    u = unfolded_u;
+    v = unfolded_v;
+  }
+  float length = sqrtf(u * u + v * v + z * z);
+  normal[0] = u / length;
+  normal[1] = v / length;
+  normal[2] = z / length;
+}
@@ -0,0 +1,86 @@
+#ifndef ASSETS_MESH_FORMAT_H
+#define ASSETS_MESH_FORMAT_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../result.h"
+
+// "MESH" read as a little endian uint32_t
+#define MESH_FILE_MAGIC 0x4853454Du
+#define MESH_FILE_VERSION 1
+// every section starts at a multiple of it, which keeps the sections valid
+// as vertex, index and copy offsets
+#define MESH_SECTION_ALIGNMENT 16
+#define MESH_MAX_MESHLET_VERTICES 64
+#define MESH_MAX_MESHLET_TRIANGLES 124
+
+// Sections in file order, the converter writes them back to back after the
+// header so the GPU data is one contiguous range
+typedef enum MeshSection {
+  // uint16_t[4] per vertex, unorm xyz inside the bounding box, w unused
+  MESH_SECTION_POSITIONS,
+  // int16_t[2] per vertex, snorm octahedral encoded unit normal
+  MESH_SECTION_NORMALS,
+  // index_size bytes per index, meshlet after meshlet
+  MESH_SECTION_INDICES,
+  // MeshMeshlet per meshlet
+  MESH_SECTION_MESHLETS,
+  MESH_SECTION_COUNT,
+} MeshSection;
+
+typedef struct MeshSectionRange {
+  // from the start of the file
+  uint64_t offset;
+  uint64_t size;
+} MeshSectionRange;
+
+// A run of triangles sharing at most MESH_MAX_MESHLET_VERTICES vertices,
+// drawn on its own it is culled against its bounding sphere
+typedef struct MeshMeshlet {
+  float center[3];
+  float radius;
+  uint32_t first_index;
+  uint32_t index_count;
+} MeshMeshlet;
+
+// Binary mesh file, little endian. The header is followed by the sections,
+// each aligned to MESH_SECTION_ALIGNMENT. Loading maps the file and copies
+// the sections as they are, nothing is parsed or converted.
+typedef struct MeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t meshlet_count;
+  // 2 or 4 bytes
+  uint32_t index_size;
+  // position = position_offset + unorm position * position_scale
+  float position_offset[3];
+  float position_scale[3];
+  // bounding sphere of the whole mesh
+  float center[3];
+  float radius;
+  MeshSectionRange sections[MESH_SECTION_COUNT];
+} MeshFileHeader;
+
+static_assert(sizeof(MeshFileHeader) == 128, "mesh header layout changed");
+static_assert(sizeof(MeshMeshlet) == 24, "meshlet layout changed");
+
+// Checks the header, the section bounds and the meshlet ranges, the indices
+// themselves are trusted. header points into data on success.
+Result(int, ErrorMessage) mesh_file_validate(const uint8_t* data,
+                                             size_t size,
+                                             const MeshFileHeader** header);
+const void* mesh_file_section(const uint8_t* data,
+                              const MeshFileHeader* header,
+                              MeshSection section);
+
+// rounds to the nearest step, value is clamped to [0, 1]
+uint16_t mesh_quantize_unorm16(float value);
+// normal must have unit length
+void mesh_encode_octahedral(const float normal[3], int16_t encoded[2]);
+void mesh_decode_octahedral(const int16_t encoded[2], float normal[3]);
+
+#endif
@@ -0,0 +1,128 @@
+#include "./texture_format.h"
+
+#include <SDL2/SDL.h>
+#include <string.h>
+
+static const uint8_t texture_file_identifier[TEXTURE_FILE_IDENTIFIER_SIZE] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n',
+};
+
+typedef struct TextureFormatBlock {
+  VkFormat format;
+  uint8_t width;
+  uint8_t height;
+  uint8_t size;
+} TextureFormatBlock;
+
+static const TextureFormatBlock texture_format_blocks[] = {
+    {VK_FORMAT_R8_UNORM, 1, 1, 1},
+    {VK_FORMAT_R8G8_UNORM, 1, 1, 2},
+    {VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4},
+    {VK_FORMAT_R8G8B8A8_SRGB, 1, 1, 4},
+    {VK_FORMAT_B8G8R8A8_UNORM, 1, 1, 4},
+    {VK_FORMAT_B8G8R8A8_SRGB, 1, 1, 4},
+    {VK_FORMAT_R16G16B16A16_SFLOAT, 1, 1, 8},
+    {VK_FORMAT_R32G32B32A32_SFLOAT, 1, 1, 16},
+    {VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, 8},
+    {VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4, 4, 8},
+    {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 8},
+    {VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4, 4, 8},
+    {VK_FORMAT_BC3_UNORM_BLOCK, 4, 4, 16},
+    {VK_FORMAT_BC3_SRGB_BLOCK, 4, 4, 16},
+    {VK_FORMAT_BC4_UNORM_BLOCK, 4, 4, 8},
+    {VK_FORMAT_BC5_UNORM_BLOCK, 4, 4, 16},
+    {VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 16},
+    {VK_FORMAT_BC7_SRGB_BLOCK, 4, 4, 16},
+};
+
+#define TEXTURE_FORMAT_BLOCK_COUNT \
+  (sizeof(texture_format_blocks) / sizeof(texture_format_blocks[0]))
+
+bool texture_format_block(VkFormat format,
+                          uint32_t* block_width,
+                          uint32_t* block_height,
+                          uint32_t* block_size) {
+  for (uint32_t i = 0; i < TEXTURE_FORMAT_BLOCK_COUNT; i++) {
+    if (texture_format_blocks[i].format == format) {
+      *block_width = texture_format_blocks[i].width;
+      *block_height = texture_format_blocks[i].height;
+      *block_size = texture_format_blocks[i].size;
+      return true;
+    }
+  }
+  return false;
+}
+
+Result(int, ErrorMessage)
+    texture_file_parse(const uint8_t* data, size_t size, TextureFile* file) {
+  if (size < sizeof(TextureFileHeader)) {
+    return Err(int, ErrorMessage)("Texture file is truncated");
+  }
+  TextureFileHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.identifier, texture_file_identifier,
+             TEXTURE_FILE_IDENTIFIER_SIZE) != 0) {
+    return Err(int, ErrorMessage)("Not a KTX2 file");
+  }
+  if (header.pixel_depth != 0 || header.layer_count > 1 ||
+      header.face_count != 1) {
+    return Err(int, ErrorMessage)("Only single 2D textures are supported");
+  }
+  if (header.supercompression_scheme != 0) {
+    return Err(int, ErrorMessage)("Supercompressed textures are unsupported");
+  }
+  uint32_t block_width = 0;
+  uint32_t block_height = 0;
+  uint32_t block_size = 0;
+  if (!texture_format_block((VkFormat)header.vk_format, &block_width,
+                            &block_height, &block_size)) {
+    return Err(int, ErrorMessage)("Unsupported texture format");
+  }
+  if (header.pixel_width == 0 || header.pixel_height == 0) {
+    return Err(int, ErrorMessage)("Texture has no texels");
+  }
+
+  // 0 asks for levels generated at load time, only the base level is stored
+  uint32_t level_count = header.level_count > 0 ? header.level_count : 1;
+  uint32_t max_extent = SDL_max(header.pixel_width, header.pixel_height);
+  uint32_t full_chain = 1;
+  while (max_extent >> full_chain) {
+    full_chain++;
+  }
+  if (level_count > TEXTURE_MAX_LEVELS || level_count > full_chain) {
+    return Err(int, ErrorMessage)("Invalid texture level count");
+  }
+  size_t index_end =
+      sizeof(TextureFileHeader) + sizeof(TextureLevelIndex) * level_count;
+  if (size < index_end) {
+    return Err(int, ErrorMessage)("Texture file is truncated");
+  }
+
+  file->format = (VkFormat)header.vk_format;
+  file->width = header.pixel_width;
+  file->height = header.pixel_height;
+  file->level_count = level_count;
+  for (uint32_t i = 0; i < level_count; i++) {
+    TextureLevelIndex index;
+    memcpy(&index,
+           data + sizeof(TextureFileHeader) + sizeof(TextureLevelIndex) * i,
+           sizeof(index));
+    TextureLevel* level = &file->levels[i];
+    level->width = SDL_max(header.pixel_width >> i, 1u);
+    level->height = SDL_max(header.pixel_height >> i, 1u);
+    uint64_t expected_size =
+        (uint64_t)((level->width + block_width - 1) / block_width) *
+        ((level->height + block_height - 1) / block_height) * block_size;
+    if (index.byte_length != expected_size) {
+      return Err(int, ErrorMessage)("Texture level size does not match");
+    }
+    if (index.byte_offset < index_end || index.byte_offset > size ||
+        index.byte_length > size - index.byte_offset) {
+      return Err(int, ErrorMessage)("Texture level is out of bounds");
+    }
+    level->offset = index.byte_offset;
+    level->size = index.byte_length;
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
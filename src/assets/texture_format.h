@@ -0,0 +1,76 @@
+#ifndef ASSETS_TEXTURE_FORMAT_H
+#define ASSETS_TEXTURE_FORMAT_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+
+#define TEXTURE_FILE_IDENTIFIER_SIZE 12
+// a 32768 texel wide texture
+#define TEXTURE_MAX_LEVELS 16
+
+// KTX2 file header, all fields little endian. The level index follows it
+// directly, one TextureLevelIndex per level with level 0 the largest.
+typedef struct TextureFileHeader {
+  uint8_t identifier[TEXTURE_FILE_IDENTIFIER_SIZE];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+} TextureFileHeader;
+
+typedef struct TextureLevelIndex {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+} TextureLevelIndex;
+
+static_assert(sizeof(TextureFileHeader) == 80, "KTX2 header layout changed");
+static_assert(sizeof(TextureLevelIndex) == 24, "KTX2 level layout changed");
+
+typedef struct TextureLevel {
+  // from the start of the file
+  uint64_t offset;
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+} TextureLevel;
+
+// What the streamer needs from a validated file, the level data is read
+// straight out of the mapping
+typedef struct TextureFile {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  TextureLevel levels[TEXTURE_MAX_LEVELS];
+} TextureFile;
+
+// Accepts the subset of KTX2 the GPU copies as is: a single 2D image
+// without supercompression in a format from the block table. Every level
+// must hold exactly the bytes its extent takes in that format.
+Result(int, ErrorMessage)
+    texture_file_parse(const uint8_t* data, size_t size, TextureFile* file);
+
+// texel block footprint of the formats texture files may use, false for
+// any other format
+bool texture_format_block(VkFormat format,
+                          uint32_t* block_width,
+                          uint32_t* block_height,
+                          uint32_t* block_size);
+
+#endif
@@ -0,0 +1,168 @@
+#include "./config.h"
+
+#include <SDL2/SDL.h>
+#include <string.h>
+
+static bool app_config_parse_uint(const char* value, uint32_t* out) {
+  if (value == nullptr || *value == '\0') {
+    return false;
+  }
+  char* end = nullptr;
+  unsigned long parsed = SDL_strtoul(value, &end, 10);
+  if (*end != '\0' || parsed > UINT32_MAX) {
+    return false;
+  }
+  *out = (uint32_t)parsed;
+  return true;
+}
+
+static bool app_config_parse_positive_uint(const char* value, uint32_t* out) {
+  uint32_t parsed = 0;
+  if (!app_config_parse_uint(value, &parsed) || parsed == 0) {
+    return false;
+  }
+  *out = parsed;
+  return true;
+}
+
+static bool app_config_parse_present_policy(const char* value,
+                                            VulkanPresentPolicy* out) {
+  if (value == nullptr) {
+    return false;
+  }
+  if (strcmp(value, "vsync") == 0) {
+    *out = VULKAN_PRESENT_POLICY_VSYNC;
+  } else if (strcmp(value, "low-latency") == 0) {
+    *out = VULKAN_PRESENT_POLICY_LOW_LATENCY;
+  } else if (strcmp(value, "immediate") == 0) {
+    *out = VULKAN_PRESENT_POLICY_IMMEDIATE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool app_config_env_flag(const char* name) {
+  const char* value = SDL_getenv(name);
+  return value != nullptr && *value != '\0' && strcmp(value, "0") != 0;
+}
+
+void app_config_reset(AppConfig* config) {
+  config->headless = false;
+  config->width = CONFIG_DEFAULT_WIDTH;
+  config->height = CONFIG_DEFAULT_HEIGHT;
+  config->frame_count = CONFIG_DEFAULT_HEADLESS_FRAME_COUNT;
+  config->output_path = nullptr;
+  config->frames_in_flight = CONFIG_DEFAULT_FRAMES_IN_FLIGHT;
+  config->max_fps = CONFIG_DEFAULT_MAX_FPS;
+  config->worker_count = CONFIG_DEFAULT_WORKER_COUNT;
+  config->pipeline_cache_path = CONFIG_DEFAULT_PIPELINE_CACHE_PATH;
+  config->staging_ring_mib = CONFIG_DEFAULT_STAGING_RING_MIB;
+  config->texture_budget_mib = CONFIG_DEFAULT_TEXTURE_BUDGET_MIB;
+  config->trace_path = nullptr;
+  config->present_policy = CONFIG_DEFAULT_PRESENT_POLICY;
+  config->async_compute = true;
+  config->watch_shaders = false;
+  config->bindless = true;
+  config->log_binary_path = nullptr;
+}
+
+Result(int, ErrorMessage)
+    app_config_parse(AppConfig* config, int argc, char* argv[argc + 1]) {
+  config->headless = app_config_env_flag(CONFIG_HEADLESS_ENV);
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (strcmp(arg, "--headless") == 0) {
+      config->headless = true;
+    } else if (strcmp(arg, "--frames") == 0) {
+      if (!app_config_parse_positive_uint(value, &config->frame_count)) {
+        return Err(int, ErrorMessage)("--frames expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--width") == 0) {
+      if (!app_config_parse_positive_uint(value, &config->width)) {
+        return Err(int, ErrorMessage)("--width expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--height") == 0) {
+      if (!app_config_parse_positive_uint(value, &config->height)) {
+        return Err(int, ErrorMessage)("--height expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--frames-in-flight") == 0) {
+      if (!app_config_parse_positive_uint(value, &config->frames_in_flight)) {
+        return Err(int, ErrorMessage)(
+            "--frames-in-flight expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--max-fps") == 0) {
+      if (!app_config_parse_uint(value, &config->max_fps)) {
+        return Err(int, ErrorMessage)("--max-fps expects an integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--workers") == 0) {
+      if (!app_config_parse_uint(value, &config->worker_count)) {
+        return Err(int, ErrorMessage)("--workers expects an integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--pipeline-cache") == 0) {
+      if (value == nullptr) {
+        return Err(int, ErrorMessage)("--pipeline-cache expects a file path");
+      }
+      config->pipeline_cache_path = value;
+      i++;
+    } else if (strcmp(arg, "--no-pipeline-cache") == 0) {
+      config->pipeline_cache_path = nullptr;
+    } else if (strcmp(arg, "--staging-mib") == 0) {
+      if (!app_config_parse_positive_uint(value, &config->staging_ring_mib)) {
+        return Err(int, ErrorMessage)(
+            "--staging-mib expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--texture-budget-mib") == 0) {
+      if (!app_config_parse_positive_uint(value,
+                                          &config->texture_budget_mib)) {
+        return Err(int, ErrorMessage)(
+            "--texture-budget-mib expects a positive integer");
+      }
+      i++;
+    } else if (strcmp(arg, "--trace") == 0) {
+      if (value == nullptr) {
+        return Err(int, ErrorMessage)("--trace expects a file path");
+      }
+      config->trace_path = value;
+      i++;
+    } else if (strcmp(arg, "--present") == 0) {
+      if (!app_config_parse_present_policy(value, &config->present_policy)) {
+        return Err(int, ErrorMessage)(
+            "--present expects vsync, low-latency or immediate");
+      }
+      i++;
+    } else if (strcmp(arg, "--no-async-compute") == 0) {
+      config->async_compute = false;
+    } else if (strcmp(arg, "--watch-shaders") == 0) {
+      config->watch_shaders = true;
+    } else if (strcmp(arg, "--no-bindless") == 0) {
+      config->bindless = false;
+    } else if (strcmp(arg, "--log-binary") == 0) {
+      if (value == nullptr) {
+        return Err(int, ErrorMessage)("--log-binary expects a file path");
+      }
+      config->log_binary_path = value;
+      i++;
+    } else if (strcmp(arg, "--output") == 0) {
+      if (value == nullptr) {
+        return Err(int, ErrorMessage)("--output expects a file path");
+      }
+      config->output_path = value;
+      i++;
+    } else {
+      return Err(int, ErrorMessage)("Unknown command line argument");
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,65 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+#include "./result.h"
+#include "./vulkan_backend/swapchain.h"
+
+#define CONFIG_HEADLESS_ENV "HELLO_HEADLESS"
+
+#define CONFIG_DEFAULT_WIDTH 1280
+#define CONFIG_DEFAULT_HEIGHT 720
+#define CONFIG_DEFAULT_HEADLESS_FRAME_COUNT 60
+#define CONFIG_DEFAULT_FRAMES_IN_FLIGHT 2
+#define CONFIG_DEFAULT_MAX_FPS 60
+// 0 picks one job system worker per CPU core
+#define CONFIG_DEFAULT_WORKER_COUNT 0
+#define CONFIG_DEFAULT_PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define CONFIG_DEFAULT_STAGING_RING_MIB 32
+#define CONFIG_DEFAULT_TEXTURE_BUDGET_MIB 256
+#define CONFIG_DEFAULT_PRESENT_POLICY VULKAN_PRESENT_POLICY_LOW_LATENCY
+
+typedef struct AppConfig {
+  bool headless;
+  uint32_t width;
+  uint32_t height;
+  // number of frames rendered before a headless run exits
+  uint32_t frame_count;
+  // optional PPM dump of the last frame, windowed runs only render the
+  // offscreen image when it is set
+  const char* output_path;
+  uint32_t frames_in_flight;
+  // CPU side frame cap of the windowed loop, 0 disables it
+  uint32_t max_fps;
+  // job system workers including the main thread, 0 uses every core
+  uint32_t worker_count;
+  // nullptr disables the on-disk pipeline cache
+  const char* pipeline_cache_path;
+  // size of the persistently mapped upload ring
+  uint32_t staging_ring_mib;
+  // device memory streamed textures may keep resident
+  uint32_t texture_budget_mib;
+  // Chrome trace of the CPU and GPU scopes written on exit, nullptr disables
+  // the capture
+  const char* trace_path;
+  // latency against power, picks the present mode of the swapchain
+  VulkanPresentPolicy present_policy;
+  // compute work uses an async compute queue when the device has one,
+  // otherwise it runs on the graphics queue
+  bool async_compute;
+  // reloads SPIR-V files that change on disk while running
+  bool watch_shaders;
+  // one update after bind descriptor set for every texture and buffer when
+  // the device supports descriptor indexing
+  bool bindless;
+  // raw log records go to this file instead of text to stderr, nullptr
+  // keeps the text
+  const char* log_binary_path;
+} AppConfig;
+
+void app_config_reset(AppConfig* config);
+Result(int, ErrorMessage)
+    app_config_parse(AppConfig* config, int argc, char* argv[argc + 1]);
+
+#endif
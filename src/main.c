@@ -4,43 +4,113 @@
 #include <stdlib.h>
 #include <vulkan/vulkan.h>
 
+#include "./config.h"
 #include "./result.h"
+#include "./utils/arena.h"
+#include "./utils/frame_limiter.h"
+#include "./utils/job_system.h"
 #include "./utils/logger.h"
 #include "./utils/memory.h"
+#include "./utils/phase_timer.h"
+#include "./vulkan_backend/allocator.h"
+#include "./vulkan_backend/bindless.h"
+#include "./vulkan_backend/compute_queue.h"
 #include "./vulkan_backend/debug.h"
+#include "./vulkan_backend/descriptor_allocator.h"
+#include "./vulkan_backend/device.h"
+#include "./vulkan_backend/diagnostics.h"
+#include "./vulkan_backend/frame_scheduler.h"
 #include "./vulkan_backend/function_loader.h"
 #include "./vulkan_backend/functions.h"
+#include "./vulkan_backend/layout_cache.h"
+#include "./vulkan_backend/offscreen.h"
+#include "./vulkan_backend/parallel_recorder.h"
+#include "./vulkan_backend/pipeline_cache.h"
+#include "./vulkan_backend/pipeline_compiler.h"
+#include "./vulkan_backend/profiler.h"
+#include "./vulkan_backend/render_graph.h"
+#include "./vulkan_backend/shader_cache.h"
+#include "./vulkan_backend/swapchain.h"
+#include "./vulkan_backend/texture_streamer.h"
+#include "./vulkan_backend/uploader.h"
 
 #define MS_PER_UPDATE 16
 
+#if defined(_WIN32)
+#define VULKAN_LIBRARY_NAME "vulkan-1.dll"
+#elif defined(__APPLE__)
+#define VULKAN_LIBRARY_NAME "libvulkan.1.dylib"
+#else
+#define VULKAN_LIBRARY_NAME "libvulkan.so.1"
+#endif
+
 typedef struct SDLResource {
   SDL_DisplayMode display_mode;
   SDL_Window* window;
+  // headless runs load the Vulkan loader directly, without the video subsystem
+  void* vulkan_library;
   int drawable_width;
   int drawable_height;
+  bool headless;
   bool is_sdl_window_init;
   bool is_sdl_vulkan_init;
+  bool is_vulkan_library_init;
   bool is_sdl_init;
 } SDLResource;
 
-Result(int, ErrorMessage) sdl_resource_init(SDLResource* sdl_resource) {
+Result(int, ErrorMessage) sdl_resource_init_headless(SDLResource* sdl_resource,
+                                                     const AppConfig* config,
+                                                     PhaseTimer* startup) {
+  if (SDL_Init(SDL_INIT_EVENTS) != 0) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  sdl_resource->is_sdl_init = true;
+  phase_timer_mark(startup, "SDL init");
+
+  sdl_resource->vulkan_library = SDL_LoadObject(VULKAN_LIBRARY_NAME);
+  if (!sdl_resource->vulkan_library) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  sdl_resource->is_vulkan_library_init = true;
+  phase_timer_mark(startup, "Vulkan library");
+
+  sdl_resource->headless = true;
+  sdl_resource->drawable_width = (int)config->width;
+  sdl_resource->drawable_height = (int)config->height;
+  log_info("Headless mode, offscreen size: %d, %d",
+           sdl_resource->drawable_width, sdl_resource->drawable_height);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) sdl_resource_init(SDLResource* sdl_resource,
+                                            const AppConfig* config,
+                                            PhaseTimer* startup) {
+  if (config->headless) {
+    return sdl_resource_init_headless(sdl_resource, config, startup);
+  }
+
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {
     return Err(int, ErrorMessage)(SDL_GetError());
   }
   sdl_resource->is_sdl_init = true;
+  phase_timer_mark(startup, "SDL init");
 
   if (SDL_Vulkan_LoadLibrary(NULL) != 0) {
     return Err(int, ErrorMessage)(SDL_GetError());
   }
   sdl_resource->is_sdl_vulkan_init = true;
+  phase_timer_mark(startup, "Vulkan library");
 
   sdl_resource->window = SDL_CreateWindow(
-      "Hello Vulkan!", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280,
-      720, SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN);
+      "Hello Vulkan!", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+      (int)config->width, (int)config->height,
+      SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
   if (!sdl_resource->window) {
     return Err(int, ErrorMessage)(SDL_GetError());
   }
   sdl_resource->is_sdl_window_init = true;
+  phase_timer_mark(startup, "window");
   SDL_GetCurrentDisplayMode(0, &sdl_resource->display_mode);
   SDL_Vulkan_GetDrawableSize(sdl_resource->window,
                              &sdl_resource->drawable_width,
@@ -55,8 +125,10 @@ Result(int, ErrorMessage) sdl_resource_init(SDLResource* sdl_resource) {
 }
 
 void sdl_resource_reset(SDLResource* sdl_resource) {
+  sdl_resource->headless = false;
   sdl_resource->is_sdl_window_init = false;
   sdl_resource->is_sdl_vulkan_init = false;
+  sdl_resource->is_vulkan_library_init = false;
   sdl_resource->is_sdl_init = false;
 }
 
@@ -64,20 +136,60 @@ void sdl_resource_destroy(SDLResource* sdl_resource) {
   if (sdl_resource->is_sdl_window_init) {
     SDL_DestroyWindow(sdl_resource->window);
   }
+  if (sdl_resource->is_vulkan_library_init) {
+    SDL_UnloadObject(sdl_resource->vulkan_library);
+  }
   if (sdl_resource->is_sdl_init) {
     SDL_Quit();
   }
 }
 
+PFN_vkGetInstanceProcAddr sdl_resource_get_vk_get_instance_proc_addr(
+    const SDLResource* sdl_resource) {
+  if (sdl_resource->headless) {
+    return (PFN_vkGetInstanceProcAddr)SDL_LoadFunction(
+        sdl_resource->vulkan_library, "vkGetInstanceProcAddr");
+  }
+  return (PFN_vkGetInstanceProcAddr)SDL_Vulkan_GetVkGetInstanceProcAddr();
+}
+
 typedef struct VulkanResource {
   VkInstance instance;
+  VulkanInstanceFunctions instance_fn;
+  VkSurfaceKHR surface;
+  VulkanDevice device;
+  VulkanAllocator allocator;
+  VulkanUploader uploader;
+  VulkanPipelineCache pipeline_cache;
+  VulkanPipelineCompiler pipeline_compiler;
+  VulkanFrameScheduler frame_scheduler;
+  VulkanLayoutCache layout_cache;
+  VulkanShaderCache shader_cache;
+  VulkanDescriptorAllocator descriptor_allocator;
+  // only initialized when enabled and the device supports it
+  VulkanBindlessTable bindless;
+  VulkanTextureStreamer texture_streamer;
+  // only initialized when there is a surface
+  VulkanSwapchain swapchain;
+  VulkanProfiler profiler;
+  VulkanComputeQueue compute_queue;
+  VulkanParallelRecorder parallel_recorder;
+  VulkanRenderGraph render_graph;
+  VulkanOffscreenTarget offscreen_target;
+  // validation message statistics, only set up in debug builds
+  VulkanDiagnostics diagnostics;
   bool is_instance_init;
+  bool is_surface_init;
 } VulkanResource;
 
 Result(int, ErrorMessage)
     vulkan_resource_init(VulkanResource* vk_resource,
-                         const SDLResource* sdl_resource) {
-  PFN_vkGetInstanceProcAddr vk_get_proc = SDL_Vulkan_GetVkGetInstanceProcAddr();
+                         const SDLResource* sdl_resource,
+                         JobSystem* job_system,
+                         const AppConfig* config,
+                         PhaseTimer* startup) {
+  PFN_vkGetInstanceProcAddr vk_get_proc =
+      sdl_resource_get_vk_get_instance_proc_addr(sdl_resource);
   if (!vk_get_proc) {
     return Err(int, ErrorMessage)(SDL_GetError());
   }
@@ -93,7 +205,9 @@ Result(int, ErrorMessage)
   const char** extensions = nullptr;
   unsigned extension_count = 0;
 
-  if (!SDL_Vulkan_GetInstanceExtensions(sdl_resource->window, &extension_count,
+  // headless instances need no surface extensions at all
+  if (!sdl_resource->headless &&
+      !SDL_Vulkan_GetInstanceExtensions(sdl_resource->window, &extension_count,
                                         nullptr)) {
     return Err(int, ErrorMessage)(SDL_GetError());
   }
@@ -103,13 +217,19 @@ Result(int, ErrorMessage)
   debug_extension_count = 1;
 #endif
 
-  extensions = mem_alloc(sizeof(const char*) *
-                         (extension_count + debug_extension_count));
+  ArenaScratch scratch = arena_scratch_begin();
+  if (scratch.arena) {
+    extensions = arena_alloc_array(scratch.arena,
+                                   extension_count + debug_extension_count,
+                                   sizeof(const char*));
+  }
   CHECK_ALLOC(extensions, Err(int, ErrorMessage)(
                               "Unable to allocate memory for extensions"));
 
-  if (!SDL_Vulkan_GetInstanceExtensions(sdl_resource->window, &extension_count,
+  if (!sdl_resource->headless &&
+      !SDL_Vulkan_GetInstanceExtensions(sdl_resource->window, &extension_count,
                                         extensions)) {
+    arena_scratch_end(scratch);
     return Err(int, ErrorMessage)(SDL_GetError());
   }
 
@@ -119,7 +239,7 @@ Result(int, ErrorMessage)
 
   const char* validation_layer_names[] = {"VK_LAYER_KHRONOS_validation"};
   uint32_t validation_layers_size = 1;
-  extensions[extension_count - 1] = VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
+  extensions[extension_count - 1] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 
   if (!vulkan_layers_all_available(validation_layer_names,
                                    validation_layers_size)) {
@@ -127,9 +247,19 @@ Result(int, ErrorMessage)
     validation_layers_size = 0;
   }
 
+  load_result = vulkan_diagnostics_init(&vk_resource->diagnostics);
+  if (!load_result.is_ok) {
+    arena_scratch_end(scratch);
+    return load_result;
+  }
+  // reports what goes wrong while the instance is created and destroyed
+  VkDebugUtilsMessengerCreateInfoEXT messenger_info =
+      vulkan_diagnostics_messenger_info(&vk_resource->diagnostics);
+  const void* instance_next = &messenger_info;
 #else
   const char* validation_layer_names[] = {};
   uint32_t validation_layers_size = 0;
+  const void* instance_next = nullptr;
 #endif
 
   VkApplicationInfo vk_application_info = {
@@ -144,7 +274,7 @@ Result(int, ErrorMessage)
 
   VkInstanceCreateInfo vk_instance_create_info = {
       .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-      .pNext = nullptr,
+      .pNext = instance_next,
       .flags = 0,
       .pApplicationInfo = &vk_application_info,
       .enabledLayerCount = validation_layers_size,
@@ -157,71 +287,684 @@ Result(int, ErrorMessage)
                                      &vk_resource->instance);
 
   if (result != VK_SUCCESS || vk_resource->instance == VK_NULL_HANDLE) {
-    mem_free(extensions);
+    arena_scratch_end(scratch);
     return Err(int, ErrorMessage)(vulkan_result_to_string(result));
   }
 
-  vulkan_load_instance_functions(vk_resource->instance);
   vk_resource->is_instance_init = true;
+  // the instance was created with every extension, none is optional
+  VulkanFunctionLoadStats instance_function_stats;
+  load_result = vulkan_load_instance_functions(
+      &vk_resource->instance_fn, vk_resource->instance, extensions,
+      extension_count, extension_count, &instance_function_stats);
+  arena_scratch_end(scratch);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+  phase_timer_carve(startup, "instance functions",
+                    instance_function_stats.elapsed_ms);
+  phase_timer_mark(startup, "instance");
   log_debug("Initialized Vulkan instance");
 
-  mem_free(extensions);
+#ifdef DEBUG
+  load_result = vulkan_diagnostics_attach(
+      &vk_resource->diagnostics, &vk_resource->instance_fn,
+      vk_resource->instance);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+#endif
 
-  return Ok(int, ErrorMessage)(0);
+  vk_resource->surface = VK_NULL_HANDLE;
+  if (!sdl_resource->headless) {
+    if (!SDL_Vulkan_CreateSurface(sdl_resource->window, vk_resource->instance,
+                                  &vk_resource->surface)) {
+      return Err(int, ErrorMessage)(SDL_GetError());
+    }
+    vk_resource->is_surface_init = true;
+    phase_timer_mark(startup, "surface");
+  }
+
+  load_result =
+      vulkan_device_init(&vk_resource->device, &vk_resource->instance_fn,
+                         vk_resource->instance, vk_resource->surface);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+  phase_timer_carve(startup, "device functions",
+                    vk_resource->device.function_stats.elapsed_ms);
+  phase_timer_mark(startup, "device");
+
+  load_result =
+      vulkan_allocator_init(&vk_resource->allocator, &vk_resource->device);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_uploader_init(
+      &vk_resource->uploader, &vk_resource->device, &vk_resource->allocator,
+      (VkDeviceSize)config->staging_ring_mib * 1024 * 1024);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_pipeline_cache_init(&vk_resource->pipeline_cache,
+                                           &vk_resource->device,
+                                           config->pipeline_cache_path);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_pipeline_compiler_init(&vk_resource->pipeline_compiler,
+                                              &vk_resource->device,
+                                              &vk_resource->pipeline_cache,
+                                              job_system);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_frame_scheduler_init(&vk_resource->frame_scheduler,
+                                            &vk_resource->device,
+                                            config->frames_in_flight);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  vulkan_layout_cache_init(&vk_resource->layout_cache, &vk_resource->device);
+  vulkan_shader_cache_init(&vk_resource->shader_cache, &vk_resource->device,
+                           &vk_resource->layout_cache, config->watch_shaders);
+  load_result = vulkan_descriptor_allocator_init(
+      &vk_resource->descriptor_allocator, &vk_resource->device,
+      config->frames_in_flight);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  if (config->bindless && vk_resource->device.has_bindless) {
+    load_result = vulkan_bindless_table_init(
+        &vk_resource->bindless, &vk_resource->device,
+        &vk_resource->layout_cache, config->frames_in_flight);
+    if (!load_result.is_ok) {
+      return load_result;
+    }
+  } else if (config->bindless) {
+    log_info("Descriptor indexing unavailable, using per draw descriptor "
+             "sets");
+  }
+
+  load_result = vulkan_texture_streamer_init(
+      &vk_resource->texture_streamer, &vk_resource->device,
+      &vk_resource->allocator, &vk_resource->uploader,
+      vk_resource->bindless.is_table_init ? &vk_resource->bindless : nullptr,
+      (VkDeviceSize)config->texture_budget_mib * 1024 * 1024,
+      VULKAN_TEXTURE_STREAMER_DEFAULT_CAPACITY, config->frames_in_flight);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  if (!sdl_resource->headless) {
+    load_result = vulkan_swapchain_init(
+        &vk_resource->swapchain, &vk_resource->device, vk_resource->surface,
+        (uint32_t)sdl_resource->drawable_width,
+        (uint32_t)sdl_resource->drawable_height, config->frames_in_flight,
+        config->present_policy);
+    if (!load_result.is_ok) {
+      return load_result;
+    }
+  }
+
+  load_result =
+      vulkan_profiler_init(&vk_resource->profiler, &vk_resource->device,
+                           config->frames_in_flight, config->trace_path);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_compute_queue_init(
+      &vk_resource->compute_queue, &vk_resource->device,
+      config->frames_in_flight, config->async_compute, &vk_resource->profiler);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_parallel_recorder_init(&vk_resource->parallel_recorder,
+                                              &vk_resource->device, job_system,
+                                              config->frames_in_flight);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  load_result = vulkan_render_graph_init(
+      &vk_resource->render_graph, &vk_resource->device,
+      &vk_resource->allocator, config->frames_in_flight);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+
+  // a window without --output only presents, nothing reads the offscreen
+  // image back
+  if (!sdl_resource->headless && !config->output_path) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  return vulkan_offscreen_target_init(
+      &vk_resource->offscreen_target, &vk_resource->allocator,
+      (uint32_t)sdl_resource->drawable_width,
+      (uint32_t)sdl_resource->drawable_height, config->frames_in_flight);
 }
 
 void vulkan_resource_reset(VulkanResource* vk_resource) {
+  vulkan_offscreen_target_reset(&vk_resource->offscreen_target);
+  vulkan_render_graph_reset(&vk_resource->render_graph);
+  vulkan_parallel_recorder_reset(&vk_resource->parallel_recorder);
+  vulkan_compute_queue_reset(&vk_resource->compute_queue);
+  vulkan_profiler_reset(&vk_resource->profiler);
+  vulkan_swapchain_reset(&vk_resource->swapchain);
+  vulkan_texture_streamer_reset(&vk_resource->texture_streamer);
+  vulkan_bindless_table_reset(&vk_resource->bindless);
+  vulkan_descriptor_allocator_reset(&vk_resource->descriptor_allocator);
+  vulkan_shader_cache_reset(&vk_resource->shader_cache);
+  vulkan_layout_cache_reset(&vk_resource->layout_cache);
+  vulkan_frame_scheduler_reset(&vk_resource->frame_scheduler);
+  vulkan_pipeline_compiler_reset(&vk_resource->pipeline_compiler);
+  vulkan_pipeline_cache_reset(&vk_resource->pipeline_cache);
+  vulkan_uploader_reset(&vk_resource->uploader);
+  vulkan_allocator_reset(&vk_resource->allocator);
+  vulkan_device_reset(&vk_resource->device);
+  vulkan_diagnostics_reset(&vk_resource->diagnostics);
+  vk_resource->is_surface_init = false;
   vk_resource->is_instance_init = false;
 }
 
 void vulkan_resource_destroy(VulkanResource* vk_resource) {
+  if (vk_resource->device.is_device_init) {
+    vk_resource->device.fn.vkDeviceWaitIdle(vk_resource->device.device);
+  }
+#ifdef DEBUG
+  if (vk_resource->allocator.is_allocator_init) {
+    vulkan_allocator_log_stats(&vk_resource->allocator);
+  }
+  if (vk_resource->descriptor_allocator.is_allocator_init) {
+    vulkan_descriptor_allocator_log_stats(&vk_resource->descriptor_allocator);
+  }
+  if (vk_resource->layout_cache.is_cache_init) {
+    vulkan_layout_cache_log_stats(&vk_resource->layout_cache);
+  }
+  if (vk_resource->bindless.is_table_init) {
+    vulkan_bindless_table_log_stats(&vk_resource->bindless);
+  }
+  if (vk_resource->texture_streamer.is_streamer_init) {
+    vulkan_texture_streamer_log_stats(&vk_resource->texture_streamer);
+  }
+#endif
+  vulkan_offscreen_target_destroy(&vk_resource->offscreen_target,
+                                  &vk_resource->allocator);
+  vulkan_render_graph_destroy(&vk_resource->render_graph);
+  vulkan_parallel_recorder_destroy(&vk_resource->parallel_recorder);
+  // the device is idle, the last frames in flight have their results
+  if (vk_resource->profiler.is_profiler_init) {
+    auto trace_result = vulkan_profiler_collect(&vk_resource->profiler);
+    // placed relative to the graphics frames, those go first
+    if (trace_result.is_ok) {
+      trace_result = vulkan_compute_queue_collect(&vk_resource->compute_queue);
+    }
+    if (trace_result.is_ok) {
+      trace_result = vulkan_profiler_write_trace(&vk_resource->profiler);
+    }
+    if (!trace_result.is_ok) {
+      log_warning("Unable to write trace: %s", trace_result.error);
+    }
+  }
+  vulkan_compute_queue_destroy(&vk_resource->compute_queue);
+  vulkan_profiler_destroy(&vk_resource->profiler);
+  vulkan_swapchain_destroy(&vk_resource->swapchain);
+  vulkan_descriptor_allocator_destroy(&vk_resource->descriptor_allocator);
+  // releases the bindless indices of the textures
+  vulkan_texture_streamer_destroy(&vk_resource->texture_streamer);
+  // the layouts of the table belong to the cache
+  vulkan_bindless_table_destroy(&vk_resource->bindless);
+  vulkan_layout_cache_destroy(&vk_resource->layout_cache);
+  vulkan_frame_scheduler_destroy(&vk_resource->frame_scheduler);
+  // merges the compile thread caches, must run before the cache is saved
+  vulkan_pipeline_compiler_destroy(&vk_resource->pipeline_compiler);
+  // background compiles may have referenced the modules until now
+  vulkan_shader_cache_destroy(&vk_resource->shader_cache);
+  if (vk_resource->pipeline_cache.is_cache_init) {
+    auto save_result = vulkan_pipeline_cache_save(&vk_resource->pipeline_cache);
+    if (!save_result.is_ok) {
+      log_warning("Unable to save pipeline cache: %s", save_result.error);
+    }
+  }
+  vulkan_pipeline_cache_destroy(&vk_resource->pipeline_cache);
+  vulkan_uploader_destroy(&vk_resource->uploader);
+  vulkan_allocator_destroy(&vk_resource->allocator);
+  vulkan_device_destroy(&vk_resource->device);
+  if (vk_resource->is_surface_init) {
+    vk_resource->instance_fn.vkDestroySurfaceKHR(vk_resource->instance,
+                                                 vk_resource->surface, nullptr);
+  }
+  vulkan_diagnostics_detach(&vk_resource->diagnostics);
   if (vk_resource->is_instance_init) {
-    vkDestroyInstance(vk_resource->instance, nullptr);
+    vk_resource->instance_fn.vkDestroyInstance(vk_resource->instance, nullptr);
   }
+  // also counts what instance destruction reported
+  vulkan_diagnostics_destroy(&vk_resource->diagnostics);
 }
 
 typedef struct ResourceManager {
   SDLResource sdl_resource;
+  JobSystem job_system;
   VulkanResource vk_resource;
+  bool is_logger_init;
 } ResourceManager;
 
 void resource_manager_reset(ResourceManager* resource_manager) {
   vulkan_resource_reset(&resource_manager->vk_resource);
+  job_system_reset(&resource_manager->job_system);
   sdl_resource_reset(&resource_manager->sdl_resource);
+  resource_manager->is_logger_init = false;
 }
 
 void resource_manager_destroy_resources(ResourceManager* resource_manager) {
   vulkan_resource_destroy(&resource_manager->vk_resource);
+  job_system_destroy(&resource_manager->job_system);
+  // every worker has exited, nothing allocates from the thread arenas anymore
+  arena_thread_log_stats();
+  arena_thread_destroy_all();
   sdl_resource_destroy(&resource_manager->sdl_resource);
+  // whatever is logged from here on is written synchronously
+  if (resource_manager->is_logger_init) {
+    logger_destroy();
+  }
   resource_manager_reset(resource_manager);
 }
 
-int main(int argc, [[maybe_unused]] char* argv[argc + 1]) {
-#ifdef DEBUG
-  SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG);
-#endif
+// what the render graph passes of a frame record, lives until execute
+typedef struct FrameGraph {
+  const VulkanOffscreenTarget* offscreen_target;
+  VkClearColorValue clear_color;
+  uint32_t slot;
+  VulkanSwapchainImage swapchain_image;
+  VulkanRenderGraphHandle color;
+} FrameGraph;
+
+void record_offscreen_clear(const VulkanRenderGraph* graph,
+                            VkCommandBuffer command_buffer,
+                            void* user_data) {
+  const FrameGraph* frame_graph = user_data;
+  vulkan_offscreen_record_clear(
+      graph->fn, command_buffer,
+      vulkan_render_graph_image(graph, frame_graph->color),
+      frame_graph->clear_color);
+}
+
+void record_offscreen_readback(const VulkanRenderGraph* graph,
+                               VkCommandBuffer command_buffer,
+                               void* user_data) {
+  const FrameGraph* frame_graph = user_data;
+  vulkan_offscreen_target_record_readback(
+      frame_graph->offscreen_target, command_buffer,
+      vulkan_render_graph_image(graph, frame_graph->color), frame_graph->slot);
+}
+
+void record_swapchain_clear(const VulkanRenderGraph* graph,
+                            VkCommandBuffer command_buffer,
+                            void* user_data) {
+  const FrameGraph* frame_graph = user_data;
+  vulkan_swapchain_record_clear(graph->fn, &frame_graph->swapchain_image,
+                                command_buffer, frame_graph->clear_color);
+}
+
+// image is nullptr when the frame presents nothing
+void declare_frame_graph(VulkanResource* vk_resource,
+                         const VulkanFrame* frame,
+                         FrameGraph* frame_graph,
+                         const VulkanSwapchainImage* image) {
+  VulkanRenderGraph* graph = &vk_resource->render_graph;
+  const VulkanOffscreenTarget* target = &vk_resource->offscreen_target;
+  vulkan_render_graph_begin(graph, frame->frame_number);
+
+  VulkanRenderGraphHandle pass;
+  if (target->is_target_init) {
+    VulkanRenderGraphImageDesc color_desc = {
+        .format = VULKAN_OFFSCREEN_FORMAT,
+        .width = target->width,
+        .height = target->height,
+    };
+    frame_graph->color = vulkan_render_graph_create_image(graph, &color_desc);
+    // the host reads the buffer of the slot once its fence signaled
+    VulkanRenderGraphState readback_initial = {0};
+    VulkanRenderGraphState readback_final = {
+        .stages = VK_PIPELINE_STAGE_HOST_BIT,
+        .access = VK_ACCESS_HOST_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VulkanRenderGraphHandle readback = vulkan_render_graph_import_buffer(
+        graph, target->readback_buffers[frame->slot],
+        vulkan_offscreen_target_readback_size(target), &readback_initial,
+        &readback_final);
+
+    pass = vulkan_render_graph_add_pass(
+        graph, "offscreen", record_offscreen_clear, frame_graph);
+    vulkan_render_graph_use(graph, pass, frame_graph->color,
+                            VULKAN_RENDER_GRAPH_USAGE_TRANSFER_DST);
+    pass = vulkan_render_graph_add_pass(graph, "readback",
+                                        record_offscreen_readback, frame_graph);
+    vulkan_render_graph_use(graph, pass, frame_graph->color,
+                            VULKAN_RENDER_GRAPH_USAGE_TRANSFER_SRC);
+    vulkan_render_graph_use(graph, pass, readback,
+                            VULKAN_RENDER_GRAPH_USAGE_TRANSFER_DST);
+  }
+
+  if (!image) {
+    return;
+  }
+  frame_graph->swapchain_image = *image;
+  const VulkanSwapchain* swapchain = &vk_resource->swapchain;
+  VulkanRenderGraphImageDesc swapchain_desc = {
+      .format = swapchain->surface_format.format,
+      .width = swapchain->extent.width,
+      .height = swapchain->extent.height,
+  };
+  // the acquire semaphore is waited on at the transfer stage and the
+  // present waits on a semaphore, that already makes the writes visible
+  VulkanRenderGraphState acquired = {
+      .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+      .access = 0,
+      .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  VulkanRenderGraphState presented = {
+      .stages = 0,
+      .access = 0,
+      .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+  };
+  VulkanRenderGraphHandle swapchain_image = vulkan_render_graph_import_image(
+      graph, &swapchain_desc, image->image, image->view, &acquired,
+      &presented);
+  pass = vulkan_render_graph_add_pass(graph, "swapchain",
+                                      record_swapchain_clear, frame_graph);
+  vulkan_render_graph_use(graph, pass, swapchain_image,
+                          VULKAN_RENDER_GRAPH_USAGE_TRANSFER_DST);
+}
+
+Result(int, ErrorMessage)
+    render_frame(VulkanResource* vk_resource, VkClearColorValue clear_color) {
+  VulkanProfiler* profiler = &vk_resource->profiler;
+
+  VulkanFrame* frame = nullptr;
+  vulkan_profiler_cpu_begin(profiler, "wait_for_frame");
+  auto result =
+      vulkan_frame_scheduler_begin_frame(&vk_resource->frame_scheduler, &frame);
+  vulkan_profiler_cpu_end(profiler);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // the slot fence signaled, its image_available semaphore is unused again
+  VulkanSwapchainImage image;
+  bool has_image = false;
+  if (vk_resource->swapchain.is_swapchain_init) {
+    vulkan_profiler_cpu_begin(profiler, "acquire");
+    result = vulkan_swapchain_acquire(&vk_resource->swapchain,
+                                      frame->image_available,
+                                      frame->frame_number, &image, &has_image);
+    vulkan_profiler_cpu_end(profiler);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  vulkan_profiler_cpu_begin(profiler, "record");
+  result = vulkan_profiler_begin_frame(profiler, frame);
+  if (!result.is_ok) {
+    return result;
+  }
+  vulkan_profiler_gpu_begin(profiler, "frame");
+
+  // the slot fence has signaled, the worker pools of the slot are free too
+  result = vulkan_parallel_recorder_begin_frame(&vk_resource->parallel_recorder,
+                                                frame->slot);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_descriptor_allocator_begin_frame(
+      &vk_resource->descriptor_allocator, frame->slot);
+  if (!result.is_ok) {
+    return result;
+  }
+  if (vk_resource->bindless.is_table_init) {
+    vulkan_bindless_table_begin_frame(&vk_resource->bindless, frame->slot);
+  }
+  // swapped in textures are uploaded with the flush below
+  result = vulkan_texture_streamer_update(&vk_resource->texture_streamer,
+                                          frame->frame_number);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // uploads queued since the last frame go out in one transfer submission,
+  // this frame is the first to use them
+  result = vulkan_uploader_flush(&vk_resource->uploader);
+  if (!result.is_ok) {
+    return result;
+  }
+  VulkanUploadWait upload_wait;
+  vulkan_uploader_acquire(&vk_resource->uploader, frame->command_buffer,
+                          &upload_wait);
+  // the upload barriers in the frame arena were consumed by the flush and
+  // the acquire above, nothing else keeps frame memory across this point
+  arena_frame_clear_all();
+  // compute work of the frame is submitted before this point
+  VulkanComputeWait compute_wait;
+  vulkan_compute_queue_acquire(&vk_resource->compute_queue,
+                               frame->command_buffer, &compute_wait);
+
+  FrameGraph frame_graph = {
+      .offscreen_target = &vk_resource->offscreen_target,
+      .clear_color = clear_color,
+      .slot = frame->slot,
+  };
+  declare_frame_graph(vk_resource, frame, &frame_graph,
+                      has_image ? &image : nullptr);
+  result = vulkan_render_graph_compile(&vk_resource->render_graph);
+  if (!result.is_ok) {
+    return result;
+  }
+  vulkan_render_graph_execute(&vk_resource->render_graph,
+                              frame->command_buffer, profiler);
+
+  vulkan_profiler_gpu_end(profiler);
+  vulkan_profiler_end_frame(profiler);
+  vulkan_profiler_cpu_end(profiler);
+
+  VkSemaphore wait_semaphores[VULKAN_UPLOADER_MAX_BATCHES + 2];
+  VkPipelineStageFlags wait_stages[VULKAN_UPLOADER_MAX_BATCHES + 2];
+  uint32_t wait_count = upload_wait.count;
+  for (uint32_t i = 0; i < upload_wait.count; i++) {
+    wait_semaphores[i] = upload_wait.semaphores[i];
+    wait_stages[i] = upload_wait.stages[i];
+  }
+  if (compute_wait.has_wait) {
+    wait_semaphores[wait_count] = compute_wait.semaphore;
+    wait_stages[wait_count] = compute_wait.stage;
+    wait_count++;
+  }
+  if (has_image) {
+    wait_semaphores[wait_count] = frame->image_available;
+    wait_stages[wait_count] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    wait_count++;
+  }
+
+  // registrations made while recording land before the GPU reads them
+  if (vk_resource->bindless.is_table_init) {
+    vulkan_bindless_table_flush(&vk_resource->bindless);
+  }
+  vulkan_profiler_cpu_begin(profiler, "submit");
+  result = vulkan_frame_scheduler_submit(
+      &vk_resource->frame_scheduler, wait_count, wait_semaphores, wait_stages,
+      has_image ? 1 : 0, has_image ? &image.present_semaphore : nullptr);
+  vulkan_profiler_cpu_end(profiler);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  if (has_image) {
+    vulkan_profiler_cpu_begin(profiler, "present");
+    result = vulkan_swapchain_present(&vk_resource->swapchain, &image);
+    vulkan_profiler_cpu_end(profiler);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  // a failed save is retried at the next interval, it never stops rendering
+  auto save_result =
+      vulkan_pipeline_cache_save_if_due(&vk_resource->pipeline_cache);
+  if (!save_result.is_ok) {
+    log_warning("Unable to save pipeline cache: %s", save_result.error);
+  }
+  // a broken shader keeps its previous module, rendering goes on
+  auto poll_result = vulkan_shader_cache_poll(&vk_resource->shader_cache);
+  if (!poll_result.is_ok) {
+    log_warning("Unable to reload shader: %s", poll_result.error);
+  }
+  vulkan_diagnostics_end_frame(&vk_resource->diagnostics);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// writes the readback of the last submitted frame, the device must be idle
+Result(int, ErrorMessage)
+    write_last_frame(VulkanResource* vk_resource, const char* path) {
+  const VulkanFrameScheduler* scheduler = &vk_resource->frame_scheduler;
+  uint32_t last_slot = (scheduler->current_slot + scheduler->frame_count - 1) %
+                       scheduler->frame_count;
+  auto result = vulkan_offscreen_target_write_ppm(
+      &vk_resource->offscreen_target, last_slot, path);
+  if (!result.is_ok) {
+    return result;
+  }
+  log_info("Wrote last frame to %s", path);
+  return Ok(int, ErrorMessage)(0);
+}
+
+// the offscreen image follows the window, the frames in flight still copy
+// into the readback buffers of the old size
+Result(int, ErrorMessage) resize_offscreen_target(VulkanResource* vk_resource,
+                                                  uint32_t width,
+                                                  uint32_t height) {
+  VulkanOffscreenTarget* target = &vk_resource->offscreen_target;
+  if (!target->is_target_init || width == 0 || height == 0 ||
+      (target->width == width && target->height == height)) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  auto result = vulkan_frame_scheduler_wait_idle(&vk_resource->frame_scheduler);
+  if (!result.is_ok) {
+    return result;
+  }
+  return vulkan_offscreen_target_resize(target, &vk_resource->allocator, width,
+                                        height);
+}
+
+Result(int, ErrorMessage)
+    run_headless(ResourceManager* resource_manager, const AppConfig* config) {
+  VulkanResource* vk_resource = &resource_manager->vk_resource;
+  VulkanFrameScheduler* scheduler = &vk_resource->frame_scheduler;
+
+  uint64_t start = SDL_GetPerformanceCounter();
+  for (uint32_t frame = 0; frame < config->frame_count; frame++) {
+    float t = (float)frame / (float)config->frame_count;
+    VkClearColorValue clear_color = {.float32 = {t, 0.2f, 1.0f - t, 1.0f}};
+    auto render_result = render_frame(vk_resource, clear_color);
+    if (!render_result.is_ok) {
+      return render_result;
+    }
+  }
+  auto wait_result = vulkan_frame_scheduler_wait_idle(scheduler);
+  if (!wait_result.is_ok) {
+    return wait_result;
+  }
+  uint64_t end = SDL_GetPerformanceCounter();
+
+  double seconds = (double)(end - start) / SDL_GetPerformanceFrequency();
+  log_info("Rendered %u headless frames with %u in flight in %.3f ms "
+           "(%.1f fps)",
+           config->frame_count, scheduler->frame_count, seconds * 1000.0,
+           seconds > 0.0 ? config->frame_count / seconds : 0.0);
+
+  if (config->output_path) {
+    return write_last_frame(vk_resource, config->output_path);
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+int main(int argc, char* argv[argc + 1]) {
+  AppConfig config;
+  app_config_reset(&config);
+  auto config_result = app_config_parse(&config, argc, argv);
+  if (!config_result.is_ok) {
+    log_error("Invalid arguments: %s", config_result.error);
+    return EXIT_FAILURE;
+  }
 
   // Init
   ResourceManager resource_manager = {0};
   resource_manager_reset(&resource_manager);
 
-  auto sdl_result = sdl_resource_init(&resource_manager.sdl_resource);
+  auto logger_result = logger_init(config.log_binary_path);
+  if (!logger_result.is_ok) {
+    log_error("Error while initializing the logger: %s", logger_result.error);
+    resource_manager_destroy_resources(&resource_manager);
+    return EXIT_FAILURE;
+  }
+  resource_manager.is_logger_init = true;
+
+  PhaseTimer startup;
+  phase_timer_init(&startup);
+
+  auto sdl_result =
+      sdl_resource_init(&resource_manager.sdl_resource, &config, &startup);
   if (!sdl_result.is_ok) {
     log_error("Error while initializing SDL: %s", sdl_result.error);
     resource_manager_destroy_resources(&resource_manager);
     return EXIT_FAILURE;
   }
 
-  auto vk_result = vulkan_resource_init(&resource_manager.vk_resource,
-                                        &resource_manager.sdl_resource);
+  auto job_result =
+      job_system_init(&resource_manager.job_system, config.worker_count);
+  if (!job_result.is_ok) {
+    log_error("Error while initializing job system: %s", job_result.error);
+    resource_manager_destroy_resources(&resource_manager);
+    return EXIT_FAILURE;
+  }
+  phase_timer_mark(&startup, "job system");
+
+  auto vk_result = vulkan_resource_init(
+      &resource_manager.vk_resource, &resource_manager.sdl_resource,
+      &resource_manager.job_system, &config, &startup);
   if (!vk_result.is_ok) {
     log_error("Error while initializing Vulkan: %s", vk_result.error);
     resource_manager_destroy_resources(&resource_manager);
     return EXIT_FAILURE;
   }
+  phase_timer_mark(&startup, "backend");
+  phase_timer_log(&startup, "Startup");
+
+  if (config.headless) {
+    auto headless_result = run_headless(&resource_manager, &config);
+    resource_manager_destroy_resources(&resource_manager);
+    if (!headless_result.is_ok) {
+      log_error("Error while rendering headless: %s", headless_result.error);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
 
   // Render loop
   bool is_running = true;
+  bool is_minimized = false;
+
+  FrameLimiter frame_limiter;
+  frame_limiter_init(&frame_limiter, config.max_fps);
 
   uint32_t previous_time = SDL_GetTicks();
   double lag = 0.0;
@@ -233,7 +976,10 @@ int main(int argc, [[maybe_unused]] char* argv[argc + 1]) {
     lag += elapsed_time;
 
     SDL_Event event;
-    while (SDL_PollEvent(&event)) {
+    // nothing is rendered while minimized, block until the next event
+    bool has_event = is_minimized ? SDL_WaitEventTimeout(&event, 100)
+                                  : SDL_PollEvent(&event);
+    while (has_event) {
       switch (event.type) {
         case SDL_QUIT:
           is_running = false;
@@ -243,7 +989,37 @@ int main(int argc, [[maybe_unused]] char* argv[argc + 1]) {
             is_running = false;
           }
           break;
+        case SDL_WINDOWEVENT:
+          if (event.window.event == SDL_WINDOWEVENT_MINIMIZED) {
+            is_minimized = true;
+          } else if (event.window.event == SDL_WINDOWEVENT_RESTORED) {
+            is_minimized = false;
+          } else if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+            // the chain is recreated at the next acquire, the old one keeps
+            // presenting the frames already in flight
+            SDLResource* sdl_resource = &resource_manager.sdl_resource;
+            SDL_Vulkan_GetDrawableSize(sdl_resource->window,
+                                       &sdl_resource->drawable_width,
+                                       &sdl_resource->drawable_height);
+            vulkan_swapchain_resize(&resource_manager.vk_resource.swapchain,
+                                    (uint32_t)sdl_resource->drawable_width,
+                                    (uint32_t)sdl_resource->drawable_height);
+            auto resize_result = resize_offscreen_target(
+                &resource_manager.vk_resource,
+                (uint32_t)sdl_resource->drawable_width,
+                (uint32_t)sdl_resource->drawable_height);
+            if (!resize_result.is_ok) {
+              log_error("Error while resizing the offscreen target: %s",
+                        resize_result.error);
+              is_running = false;
+            }
+          }
+          break;
       }
+      has_event = SDL_PollEvent(&event);
+    }
+    if (is_minimized) {
+      continue;
     }
 
     while (lag >= MS_PER_UPDATE) {
@@ -251,14 +1027,36 @@ int main(int argc, [[maybe_unused]] char* argv[argc + 1]) {
       lag -= MS_PER_UPDATE;
     }
 
-    bool success = true;
-    if (!success) {
+    // blocks on the fence of the frame slot being reused, the CPU records
+    // frame N + 1 while the GPU is still busy with frame N
+    float t = (float)(current_time % 4000) / 4000.0f;
+    VkClearColorValue clear_color = {.float32 = {t, 0.2f, 1.0f - t, 1.0f}};
+    auto frame_result =
+        render_frame(&resource_manager.vk_resource, clear_color);
+    if (!frame_result.is_ok) {
+      log_error("Error while rendering frame: %s", frame_result.error);
       is_running = false;
     }
+
+    frame_limiter_wait(&frame_limiter);
+  }
+
+  int exit_code = EXIT_SUCCESS;
+  if (config.output_path) {
+    VulkanResource* vk_resource = &resource_manager.vk_resource;
+    auto write_result =
+        vulkan_frame_scheduler_wait_idle(&vk_resource->frame_scheduler);
+    if (write_result.is_ok) {
+      write_result = write_last_frame(vk_resource, config.output_path);
+    }
+    if (!write_result.is_ok) {
+      log_error("Error while writing the last frame: %s", write_result.error);
+      exit_code = EXIT_FAILURE;
+    }
   }
 
   // Destroy
   resource_manager_destroy_resources(&resource_manager);
 
-  return EXIT_SUCCESS;
+  return exit_code;
 }
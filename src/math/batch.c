@@ -0,0 +1,424 @@
+#include "./batch.h"
+
+#include "../utils/memory.h"
+#include "./simd.h"
+
+// array lengths in a block are rounded up to it, 64 bytes of floats, so
+// every array starts at the same offset into a cache line
+#define BATCH_ARRAY_ALIGNMENT 16
+
+#define TRANSFORM_FLOAT_ARRAYS (3 + 4 + 3 + 12)
+#define AABB_FLOAT_ARRAYS (3 + 3)
+
+Result(int, ErrorMessage)
+    transform_soa_init(TransformSoa* transforms, uint32_t capacity) {
+  transforms->is_transform_init = true;
+  size_t stride = ALIGN((size_t)capacity, BATCH_ARRAY_ALIGNMENT);
+  // the parent indices follow the float arrays
+  transforms->data =
+      mem_alloc(sizeof(float) * stride * (TRANSFORM_FLOAT_ARRAYS + 1));
+  CHECK_ALLOC(transforms->data, Err(int, ErrorMessage)(
+                                    "Unable to allocate memory for "
+                                    "transforms"));
+  float* array = transforms->data;
+  for (uint32_t i = 0; i < 3; i++, array += stride) {
+    transforms->position[i] = array;
+  }
+  for (uint32_t i = 0; i < 4; i++, array += stride) {
+    transforms->rotation[i] = array;
+  }
+  for (uint32_t i = 0; i < 3; i++, array += stride) {
+    transforms->scale[i] = array;
+  }
+  for (uint32_t i = 0; i < 12; i++, array += stride) {
+    transforms->world[i] = array;
+  }
+  transforms->parent = (uint32_t*)array;
+  transforms->capacity = capacity;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void transform_soa_reset(TransformSoa* transforms) {
+  *transforms = (TransformSoa){0};
+}
+
+void transform_soa_destroy(TransformSoa* transforms) {
+  if (!transforms->is_transform_init) {
+    return;
+  }
+  mem_free(transforms->data);
+  transform_soa_reset(transforms);
+}
+
+Mat4 transform_soa_world(const TransformSoa* transforms, uint32_t index) {
+  Mat4 result = mat4_identity();
+  for (uint32_t row = 0; row < 3; row++) {
+    for (uint32_t column = 0; column < 4; column++) {
+      result.m[column * 4 + row] = transforms->world[row * 4 + column][index];
+    }
+  }
+  return result;
+}
+
+Result(int, ErrorMessage) aabb_soa_init(AabbSoa* boxes, uint32_t capacity) {
+  boxes->is_aabb_init = true;
+  size_t stride = ALIGN((size_t)capacity, BATCH_ARRAY_ALIGNMENT);
+  boxes->data = mem_alloc(sizeof(float) * stride * AABB_FLOAT_ARRAYS);
+  CHECK_ALLOC(boxes->data, Err(int, ErrorMessage)(
+                               "Unable to allocate memory for bounding "
+                               "boxes"));
+  for (uint32_t i = 0; i < 3; i++) {
+    boxes->center[i] = boxes->data + stride * i;
+    boxes->extent[i] = boxes->data + stride * (3 + i);
+  }
+  boxes->capacity = capacity;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void aabb_soa_reset(AabbSoa* boxes) {
+  *boxes = (AabbSoa){0};
+}
+
+void aabb_soa_destroy(AabbSoa* boxes) {
+  if (!boxes->is_aabb_init) {
+    return;
+  }
+  mem_free(boxes->data);
+  aabb_soa_reset(boxes);
+}
+
+// local matrix of one node, laid out like the world arrays
+static void transform_local(const TransformSoa* transforms,
+                            uint32_t index,
+                            float local[12]) {
+  float x = transforms->rotation[0][index];
+  float y = transforms->rotation[1][index];
+  float z = transforms->rotation[2][index];
+  float w = transforms->rotation[3][index];
+  float sx = transforms->scale[0][index];
+  float sy = transforms->scale[1][index];
+  float sz = transforms->scale[2][index];
+  float x2 = x + x;
+  float y2 = y + y;
+  float z2 = z + z;
+  float xx = x * x2;
+  float yy = y * y2;
+  float zz = z * z2;
+  float xy = x * y2;
+  float xz = x * z2;
+  float yz = y * z2;
+  float wx = w * x2;
+  float wy = w * y2;
+  float wz = w * z2;
+  local[0] = (1.0f - (yy + zz)) * sx;
+  local[1] = (xy - wz) * sy;
+  local[2] = (xz + wy) * sz;
+  local[3] = transforms->position[0][index];
+  local[4] = (xy + wz) * sx;
+  local[5] = (1.0f - (xx + zz)) * sy;
+  local[6] = (yz - wx) * sz;
+  local[7] = transforms->position[1][index];
+  local[8] = (xz - wy) * sx;
+  local[9] = (yz + wx) * sy;
+  local[10] = (1.0f - (xx + yy)) * sz;
+  local[11] = transforms->position[2][index];
+}
+
+static void transform_propagate_node(TransformSoa* transforms,
+                                     uint32_t index) {
+  float local[12];
+  transform_local(transforms, index, local);
+  uint32_t parent = transforms->parent[index];
+  if (parent == TRANSFORM_NO_PARENT) {
+    for (uint32_t i = 0; i < 12; i++) {
+      transforms->world[i][index] = local[i];
+    }
+    return;
+  }
+  for (uint32_t row = 0; row < 3; row++) {
+    float p0 = transforms->world[row * 4][parent];
+    float p1 = transforms->world[row * 4 + 1][parent];
+    float p2 = transforms->world[row * 4 + 2][parent];
+    float p3 = transforms->world[row * 4 + 3][parent];
+    for (uint32_t column = 0; column < 4; column++) {
+      float value = p0 * local[column] + p1 * local[4 + column] +
+                    p2 * local[8 + column];
+      transforms->world[row * 4 + column][index] =
+          column == 3 ? value + p3 : value;
+    }
+  }
+}
+
+void transform_soa_propagate_scalar(TransformSoa* transforms) {
+  for (uint32_t i = 0; i < transforms->count; i++) {
+    transform_propagate_node(transforms, i);
+  }
+}
+
+static void mat4_mul_scalar(const Mat4* a, const Mat4* b, Mat4* out) {
+  Mat4 result;
+  for (uint32_t column = 0; column < 4; column++) {
+    for (uint32_t row = 0; row < 4; row++) {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < 4; k++) {
+        sum += a->m[k * 4 + row] * b->m[column * 4 + k];
+      }
+      result.m[column * 4 + row] = sum;
+    }
+  }
+  *out = result;
+}
+
+uint32_t frustum_cull_aabbs_scalar(const Frustum* frustum,
+                                   const AabbSoa* boxes,
+                                   uint32_t* visible) {
+  uint32_t visible_count = 0;
+  for (uint32_t i = 0; i < boxes->count; i++) {
+    Vec3 center = {boxes->center[0][i], boxes->center[1][i],
+                   boxes->center[2][i]};
+    Vec3 extent = {boxes->extent[0][i], boxes->extent[1][i],
+                   boxes->extent[2][i]};
+    if (frustum_test_aabb(frustum, center, extent)) {
+      visible[visible_count++] = i;
+    }
+  }
+  return visible_count;
+}
+
+void mat4_mul_batch_scalar(const Mat4* left,
+                           const Mat4* right,
+                           Mat4* out,
+                           uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    mat4_mul_scalar(left, &right[i], &out[i]);
+  }
+}
+
+#if defined(MATH_SIMD_SCALAR)
+
+void transform_soa_propagate(TransformSoa* transforms) {
+  transform_soa_propagate_scalar(transforms);
+}
+
+uint32_t frustum_cull_aabbs(const Frustum* frustum,
+                            const AabbSoa* boxes,
+                            uint32_t* visible) {
+  return frustum_cull_aabbs_scalar(frustum, boxes, visible);
+}
+
+void mat4_mul_batch(const Mat4* left,
+                    const Mat4* right,
+                    Mat4* out,
+                    uint32_t count) {
+  mat4_mul_batch_scalar(left, right, out, count);
+}
+
+#else
+
+static const float transform_identity[12] = {
+    1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+};
+
+// transform_local for the nodes [first, first + MATH_LANES)
+static void transform_local_lanes(const TransformSoa* transforms,
+                                  uint32_t first,
+                                  FloatN local[12]) {
+  FloatN x = floatn_load(transforms->rotation[0] + first);
+  FloatN y = floatn_load(transforms->rotation[1] + first);
+  FloatN z = floatn_load(transforms->rotation[2] + first);
+  FloatN w = floatn_load(transforms->rotation[3] + first);
+  FloatN sx = floatn_load(transforms->scale[0] + first);
+  FloatN sy = floatn_load(transforms->scale[1] + first);
+  FloatN sz = floatn_load(transforms->scale[2] + first);
+  FloatN one = floatn_set1(1.0f);
+  FloatN x2 = floatn_add(x, x);
+  FloatN y2 = floatn_add(y, y);
+  FloatN z2 = floatn_add(z, z);
+  FloatN xx = floatn_mul(x, x2);
+  FloatN yy = floatn_mul(y, y2);
+  FloatN zz = floatn_mul(z, z2);
+  FloatN xy = floatn_mul(x, y2);
+  FloatN xz = floatn_mul(x, z2);
+  FloatN yz = floatn_mul(y, z2);
+  FloatN wx = floatn_mul(w, x2);
+  FloatN wy = floatn_mul(w, y2);
+  FloatN wz = floatn_mul(w, z2);
+  local[0] = floatn_mul(floatn_sub(one, floatn_add(yy, zz)), sx);
+  local[1] = floatn_mul(floatn_sub(xy, wz), sy);
+  local[2] = floatn_mul(floatn_add(xz, wy), sz);
+  local[3] = floatn_load(transforms->position[0] + first);
+  local[4] = floatn_mul(floatn_add(xy, wz), sx);
+  local[5] = floatn_mul(floatn_sub(one, floatn_add(xx, zz)), sy);
+  local[6] = floatn_mul(floatn_sub(yz, wx), sz);
+  local[7] = floatn_load(transforms->position[1] + first);
+  local[8] = floatn_mul(floatn_sub(xz, wy), sx);
+  local[9] = floatn_mul(floatn_add(yz, wx), sy);
+  local[10] = floatn_mul(floatn_sub(one, floatn_add(xx, yy)), sz);
+  local[11] = floatn_load(transforms->position[2] + first);
+}
+
+void transform_soa_propagate(TransformSoa* transforms) {
+  uint32_t simd_count = transforms->count - transforms->count % MATH_LANES;
+  uint32_t first = 0;
+  for (; first < simd_count; first += MATH_LANES) {
+    // a parent inside the register is not computed yet, those nodes go one
+    // by one in index order instead
+    bool has_parent = false;
+    bool has_parent_in_lanes = false;
+    for (uint32_t lane = 0; lane < MATH_LANES; lane++) {
+      uint32_t parent = transforms->parent[first + lane];
+      has_parent = has_parent || parent != TRANSFORM_NO_PARENT;
+      has_parent_in_lanes = has_parent_in_lanes ||
+                            (parent != TRANSFORM_NO_PARENT && parent >= first);
+    }
+    if (has_parent_in_lanes) {
+      for (uint32_t lane = 0; lane < MATH_LANES; lane++) {
+        transform_propagate_node(transforms, first + lane);
+      }
+      continue;
+    }
+
+    FloatN local[12];
+    transform_local_lanes(transforms, first, local);
+    if (!has_parent) {
+      for (uint32_t i = 0; i < 12; i++) {
+        floatn_store(transforms->world[i] + first, local[i]);
+      }
+      continue;
+    }
+
+    // the parents are scattered, their matrices are gathered lane by lane
+    // with the identity standing in for the roots
+    alignas(32) float parents[12][MATH_LANES];
+    for (uint32_t lane = 0; lane < MATH_LANES; lane++) {
+      uint32_t parent = transforms->parent[first + lane];
+      for (uint32_t i = 0; i < 12; i++) {
+        parents[i][lane] = parent != TRANSFORM_NO_PARENT
+                               ? transforms->world[i][parent]
+                               : transform_identity[i];
+      }
+    }
+    for (uint32_t row = 0; row < 3; row++) {
+      FloatN p0 = floatn_load(parents[row * 4]);
+      FloatN p1 = floatn_load(parents[row * 4 + 1]);
+      FloatN p2 = floatn_load(parents[row * 4 + 2]);
+      FloatN p3 = floatn_load(parents[row * 4 + 3]);
+      for (uint32_t column = 0; column < 4; column++) {
+        FloatN value = column == 3 ? p3 : floatn_set1(0.0f);
+        value = floatn_madd(p0, local[column], value);
+        value = floatn_madd(p1, local[4 + column], value);
+        value = floatn_madd(p2, local[8 + column], value);
+        floatn_store(transforms->world[row * 4 + column] + first, value);
+      }
+    }
+  }
+  for (; first < transforms->count; first++) {
+    transform_propagate_node(transforms, first);
+  }
+}
+
+uint32_t frustum_cull_aabbs(const Frustum* frustum,
+                            const AabbSoa* boxes,
+                            uint32_t* visible) {
+  FloatN normal[6][3];
+  FloatN distance[6];
+  FloatN abs_normal[6][3];
+  for (uint32_t i = 0; i < 6; i++) {
+    const Vec4* plane = &frustum->planes[i];
+    normal[i][0] = floatn_set1(plane->x);
+    normal[i][1] = floatn_set1(plane->y);
+    normal[i][2] = floatn_set1(plane->z);
+    distance[i] = floatn_set1(plane->w);
+    abs_normal[i][0] = floatn_set1(fabsf(plane->x));
+    abs_normal[i][1] = floatn_set1(fabsf(plane->y));
+    abs_normal[i][2] = floatn_set1(fabsf(plane->z));
+  }
+  FloatN zero = floatn_set1(0.0f);
+
+  uint32_t simd_count = boxes->count - boxes->count % MATH_LANES;
+  uint32_t visible_count = 0;
+  uint32_t first = 0;
+  for (; first < simd_count; first += MATH_LANES) {
+    FloatN cx = floatn_load(boxes->center[0] + first);
+    FloatN cy = floatn_load(boxes->center[1] + first);
+    FloatN cz = floatn_load(boxes->center[2] + first);
+    FloatN ex = floatn_load(boxes->extent[0] + first);
+    FloatN ey = floatn_load(boxes->extent[1] + first);
+    FloatN ez = floatn_load(boxes->extent[2] + first);
+    MaskN outside = floatn_less(zero, zero);
+    for (uint32_t i = 0; i < 6; i++) {
+      FloatN box_distance = floatn_madd(
+          normal[i][0], cx,
+          floatn_madd(normal[i][1], cy,
+                      floatn_madd(normal[i][2], cz, distance[i])));
+      FloatN radius = floatn_madd(
+          abs_normal[i][0], ex,
+          floatn_madd(abs_normal[i][1], ey,
+                      floatn_mul(abs_normal[i][2], ez)));
+      outside = maskn_or(
+          outside, floatn_less(floatn_add(box_distance, radius), zero));
+    }
+    // every lane is written, only the visible ones move the count on
+    uint32_t outside_bits = maskn_bits(outside);
+    for (uint32_t lane = 0; lane < MATH_LANES; lane++) {
+      visible[visible_count] = first + lane;
+      visible_count += ((outside_bits >> lane) & 1) ^ 1;
+    }
+  }
+  for (; first < boxes->count; first++) {
+    Vec3 center = {boxes->center[0][first], boxes->center[1][first],
+                   boxes->center[2][first]};
+    Vec3 extent = {boxes->extent[0][first], boxes->extent[1][first],
+                   boxes->extent[2][first]};
+    if (frustum_test_aabb(frustum, center, extent)) {
+      visible[visible_count++] = first;
+    }
+  }
+  return visible_count;
+}
+
+void mat4_mul_batch(const Mat4* left,
+                    const Mat4* right,
+                    Mat4* out,
+                    uint32_t count) {
+#if defined(MATH_SIMD_AVX2)
+  // two columns per register, the columns of left repeat in both halves and
+  // each half of a column pair broadcasts its own element
+  __m256 a0 = _mm256_broadcast_ps((const __m128*)&left->m[0]);
+  __m256 a1 = _mm256_broadcast_ps((const __m128*)&left->m[4]);
+  __m256 a2 = _mm256_broadcast_ps((const __m128*)&left->m[8]);
+  __m256 a3 = _mm256_broadcast_ps((const __m128*)&left->m[12]);
+  for (uint32_t i = 0; i < count; i++) {
+    __m256 columns[2] = {
+        _mm256_loadu_ps(&right[i].m[0]),
+        _mm256_loadu_ps(&right[i].m[8]),
+    };
+    for (uint32_t pair = 0; pair < 2; pair++) {
+      __m256 b = columns[pair];
+      __m256 sum = _mm256_mul_ps(a0, _mm256_shuffle_ps(b, b, 0x00));
+      sum = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b, b, 0x55), sum);
+      sum = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b, b, 0xAA), sum);
+      sum = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b, b, 0xFF), sum);
+      _mm256_storeu_ps(&out[i].m[pair * 8], sum);
+    }
+  }
+#else
+  Float4 a0 = float4_load(&left->m[0]);
+  Float4 a1 = float4_load(&left->m[4]);
+  Float4 a2 = float4_load(&left->m[8]);
+  Float4 a3 = float4_load(&left->m[12]);
+  for (uint32_t i = 0; i < count; i++) {
+    Mat4 b = right[i];
+    for (uint32_t column = 0; column < 4; column++) {
+      const float* b_column = &b.m[column * 4];
+      Float4 sum = float4_mul(a0, float4_set1(b_column[0]));
+      sum = float4_madd(a1, float4_set1(b_column[1]), sum);
+      sum = float4_madd(a2, float4_set1(b_column[2]), sum);
+      sum = float4_madd(a3, float4_set1(b_column[3]), sum);
+      float4_store(&out[i].m[column * 4], sum);
+    }
+  }
+#endif
+}
+
+#endif
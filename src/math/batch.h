@@ -0,0 +1,84 @@
+#ifndef MATH_BATCH_H
+#define MATH_BATCH_H
+
+#include <stdint.h>
+
+#include "../result.h"
+#include "./math3d.h"
+
+#define TRANSFORM_NO_PARENT UINT32_MAX
+
+// Kernels over thousands of instances at once, on the SIMD path of the
+// build with MATH_LANES instances per register. Each has a _scalar variant
+// that is always compiled, the results agree up to rounding.
+
+// Node transforms as structure of arrays, one array per component so a
+// register loads the same component of MATH_LANES nodes. A parent has a
+// smaller index than its children, nodes sorted breadth first keep the
+// children of a level out of the registers holding their parents and run
+// almost entirely on the SIMD path.
+typedef struct TransformSoa {
+  // relative to the parent
+  float* position[3];
+  float* rotation[4];
+  float* scale[3];
+  // TRANSFORM_NO_PARENT for the roots
+  uint32_t* parent;
+  // affine part of the world matrices, rows of three columns plus the
+  // translation: world[row * 4 + column], row 3 is always 0 0 0 1
+  float* world[12];
+  uint32_t count;
+  uint32_t capacity;
+  // every array is a slice of it
+  float* data;
+  bool is_transform_init;
+} TransformSoa;
+
+// Boxes as center and half extent per axis
+typedef struct AabbSoa {
+  float* center[3];
+  float* extent[3];
+  uint32_t count;
+  uint32_t capacity;
+  float* data;
+  bool is_aabb_init;
+} AabbSoa;
+
+// count starts at 0, the caller fills the arrays and sets it
+Result(int, ErrorMessage)
+    transform_soa_init(TransformSoa* transforms, uint32_t capacity);
+void transform_soa_reset(TransformSoa* transforms);
+void transform_soa_destroy(TransformSoa* transforms);
+// world matrix of node index in the layout the shaders read
+Mat4 transform_soa_world(const TransformSoa* transforms, uint32_t index);
+
+Result(int, ErrorMessage) aabb_soa_init(AabbSoa* boxes, uint32_t capacity);
+void aabb_soa_reset(AabbSoa* boxes);
+void aabb_soa_destroy(AabbSoa* boxes);
+
+// world = parent world * local for every node, in index order
+void transform_soa_propagate(TransformSoa* transforms);
+void transform_soa_propagate_scalar(TransformSoa* transforms);
+
+// writes the indices of the boxes that pass frustum_test_aabb in increasing
+// order and returns how many, visible must hold boxes->count indices
+uint32_t frustum_cull_aabbs(const Frustum* frustum,
+                            const AabbSoa* boxes,
+                            uint32_t* visible);
+uint32_t frustum_cull_aabbs_scalar(const Frustum* frustum,
+                                   const AabbSoa* boxes,
+                                   uint32_t* visible);
+
+// out[i] = left * right[i], for one view projection and many model
+// matrices. The matrices stay in the layout the instance buffers take,
+// the SIMD runs over the columns of each one. out may be right.
+void mat4_mul_batch(const Mat4* left,
+                    const Mat4* right,
+                    Mat4* out,
+                    uint32_t count);
+void mat4_mul_batch_scalar(const Mat4* left,
+                           const Mat4* right,
+                           Mat4* out,
+                           uint32_t count);
+
+#endif
@@ -0,0 +1,227 @@
+#include "./math3d.h"
+
+#include "./simd.h"
+
+Quat quat_from_axis_angle(Vec3 axis, float angle) {
+  float s = sinf(angle * 0.5f);
+  return (Quat){axis.x * s, axis.y * s, axis.z * s, cosf(angle * 0.5f)};
+}
+
+Quat quat_mul(Quat a, Quat b) {
+  return (Quat){
+      a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+      a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+      a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+      a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+  };
+}
+
+Quat quat_normalize(Quat q) {
+  float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  if (length == 0.0f) {
+    return quat_identity();
+  }
+  float inverse = 1.0f / length;
+  return (Quat){q.x * inverse, q.y * inverse, q.z * inverse, q.w * inverse};
+}
+
+Vec3 quat_rotate(Quat q, Vec3 v) {
+  Vec3 axis = {q.x, q.y, q.z};
+  Vec3 t = vec3_scale(vec3_cross(axis, v), 2.0f);
+  return vec3_add(vec3_add(v, vec3_scale(t, q.w)), vec3_cross(axis, t));
+}
+
+Quat quat_nlerp(Quat a, Quat b, float t) {
+  // q and -q are the same rotation, the one closer to a takes the short way
+  float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+  float sign = dot < 0.0f ? -1.0f : 1.0f;
+  float s = 1.0f - t;
+  return quat_normalize((Quat){
+      a.x * s + b.x * sign * t,
+      a.y * s + b.y * sign * t,
+      a.z * s + b.z * sign * t,
+      a.w * s + b.w * sign * t,
+  });
+}
+
+Mat4 mat4_identity(void) {
+  return (Mat4){.m = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+                      0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f}};
+}
+
+Mat4 mat4_mul(const Mat4* a, const Mat4* b) {
+  Mat4 result;
+#if defined(MATH_SIMD_SCALAR)
+  for (uint32_t column = 0; column < 4; column++) {
+    for (uint32_t row = 0; row < 4; row++) {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < 4; k++) {
+        sum += a->m[k * 4 + row] * b->m[column * 4 + k];
+      }
+      result.m[column * 4 + row] = sum;
+    }
+  }
+#else
+  // every column of the result mixes the columns of a by one column of b
+  Float4 a0 = float4_load(&a->m[0]);
+  Float4 a1 = float4_load(&a->m[4]);
+  Float4 a2 = float4_load(&a->m[8]);
+  Float4 a3 = float4_load(&a->m[12]);
+  for (uint32_t column = 0; column < 4; column++) {
+    const float* b_column = &b->m[column * 4];
+    Float4 sum = float4_mul(a0, float4_set1(b_column[0]));
+    sum = float4_madd(a1, float4_set1(b_column[1]), sum);
+    sum = float4_madd(a2, float4_set1(b_column[2]), sum);
+    sum = float4_madd(a3, float4_set1(b_column[3]), sum);
+    float4_store(&result.m[column * 4], sum);
+  }
+#endif
+  return result;
+}
+
+Vec4 mat4_mul_vec4(const Mat4* m, Vec4 v) {
+#if defined(MATH_SIMD_SCALAR)
+  return (Vec4){
+      m->m[0] * v.x + m->m[4] * v.y + m->m[8] * v.z + m->m[12] * v.w,
+      m->m[1] * v.x + m->m[5] * v.y + m->m[9] * v.z + m->m[13] * v.w,
+      m->m[2] * v.x + m->m[6] * v.y + m->m[10] * v.z + m->m[14] * v.w,
+      m->m[3] * v.x + m->m[7] * v.y + m->m[11] * v.z + m->m[15] * v.w,
+  };
+#else
+  Float4 sum = float4_mul(float4_load(&m->m[0]), float4_set1(v.x));
+  sum = float4_madd(float4_load(&m->m[4]), float4_set1(v.y), sum);
+  sum = float4_madd(float4_load(&m->m[8]), float4_set1(v.z), sum);
+  sum = float4_madd(float4_load(&m->m[12]), float4_set1(v.w), sum);
+  float result[4];
+  float4_store(result, sum);
+  return (Vec4){result[0], result[1], result[2], result[3]};
+#endif
+}
+
+Mat4 mat4_transpose(const Mat4* m) {
+  Mat4 result;
+  for (uint32_t column = 0; column < 4; column++) {
+    for (uint32_t row = 0; row < 4; row++) {
+      result.m[row * 4 + column] = m->m[column * 4 + row];
+    }
+  }
+  return result;
+}
+
+Mat4 mat4_from_trs(Vec3 translation, Quat rotation, Vec3 scale) {
+  float x2 = rotation.x + rotation.x;
+  float y2 = rotation.y + rotation.y;
+  float z2 = rotation.z + rotation.z;
+  float xx = rotation.x * x2;
+  float yy = rotation.y * y2;
+  float zz = rotation.z * z2;
+  float xy = rotation.x * y2;
+  float xz = rotation.x * z2;
+  float yz = rotation.y * z2;
+  float wx = rotation.w * x2;
+  float wy = rotation.w * y2;
+  float wz = rotation.w * z2;
+  return (Mat4){.m = {
+                    (1.0f - (yy + zz)) * scale.x,
+                    (xy + wz) * scale.x,
+                    (xz - wy) * scale.x,
+                    0.0f,
+                    (xy - wz) * scale.y,
+                    (1.0f - (xx + zz)) * scale.y,
+                    (yz + wx) * scale.y,
+                    0.0f,
+                    (xz + wy) * scale.z,
+                    (yz - wx) * scale.z,
+                    (1.0f - (xx + yy)) * scale.z,
+                    0.0f,
+                    translation.x,
+                    translation.y,
+                    translation.z,
+                    1.0f,
+                }};
+}
+
+Mat4 mat4_perspective(float fov_y, float aspect, float near, float far) {
+  float f = 1.0f / tanf(fov_y * 0.5f);
+  Mat4 result = {0};
+  result.m[0] = f / aspect;
+  result.m[5] = -f;
+  result.m[10] = far / (near - far);
+  result.m[11] = -1.0f;
+  result.m[14] = near * far / (near - far);
+  return result;
+}
+
+Mat4 mat4_look_at(Vec3 eye, Vec3 target, Vec3 up) {
+  Vec3 forward = vec3_normalize(vec3_sub(target, eye));
+  Vec3 side = vec3_normalize(vec3_cross(forward, up));
+  Vec3 camera_up = vec3_cross(side, forward);
+  return (Mat4){.m = {
+                    side.x,
+                    camera_up.x,
+                    -forward.x,
+                    0.0f,
+                    side.y,
+                    camera_up.y,
+                    -forward.y,
+                    0.0f,
+                    side.z,
+                    camera_up.z,
+                    -forward.z,
+                    0.0f,
+                    -vec3_dot(side, eye),
+                    -vec3_dot(camera_up, eye),
+                    vec3_dot(forward, eye),
+                    1.0f,
+                }};
+}
+
+// the normal scaled to unit length so w is the distance to the origin
+static Vec4 frustum_plane(const Mat4* m,
+                          uint32_t row,
+                          float sign,
+                          bool has_w_row) {
+  float w = has_w_row ? 1.0f : 0.0f;
+  Vec4 plane = {
+      m->m[3] * w + m->m[row] * sign,
+      m->m[7] * w + m->m[4 + row] * sign,
+      m->m[11] * w + m->m[8 + row] * sign,
+      m->m[15] * w + m->m[12 + row] * sign,
+  };
+  float length =
+      sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+  if (length > 0.0f) {
+    float inverse = 1.0f / length;
+    plane = (Vec4){plane.x * inverse, plane.y * inverse, plane.z * inverse,
+                   plane.w * inverse};
+  }
+  return plane;
+}
+
+Frustum frustum_from_mat4(const Mat4* view_projection) {
+  // -w <= x, y <= w and 0 <= z <= w in clip space, each bound is a plane
+  // made of the rows of the matrix
+  return (Frustum){.planes = {
+                       frustum_plane(view_projection, 0, 1.0f, true),
+                       frustum_plane(view_projection, 0, -1.0f, true),
+                       frustum_plane(view_projection, 1, 1.0f, true),
+                       frustum_plane(view_projection, 1, -1.0f, true),
+                       frustum_plane(view_projection, 2, 1.0f, false),
+                       frustum_plane(view_projection, 2, -1.0f, true),
+                   }};
+}
+
+bool frustum_test_aabb(const Frustum* frustum, Vec3 center, Vec3 extent) {
+  for (uint32_t i = 0; i < 6; i++) {
+    const Vec4* plane = &frustum->planes[i];
+    float distance = plane->x * center.x + plane->y * center.y +
+                     plane->z * center.z + plane->w;
+    // how far the box reaches towards the plane's normal
+    float radius = fabsf(plane->x) * extent.x + fabsf(plane->y) * extent.y +
+                   fabsf(plane->z) * extent.z;
+    if (distance + radius < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
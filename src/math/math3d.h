@@ -0,0 +1,100 @@
+#ifndef MATH_MATH3D_H
+#define MATH_MATH3D_H
+
+#include <math.h>
+#include <stdalign.h>
+
+#define MATH_PI 3.14159265358979323846f
+
+typedef struct Vec3 {
+  float x;
+  float y;
+  float z;
+} Vec3;
+
+typedef struct Vec4 {
+  float x;
+  float y;
+  float z;
+  float w;
+} Vec4;
+
+// rotation of w around xyz, unit length unless noted otherwise
+typedef struct Quat {
+  float x;
+  float y;
+  float z;
+  float w;
+} Quat;
+
+// column major like GLSL, m[column * 4 + row], so an array of them can go
+// into a buffer the shaders read as mat4
+typedef struct Mat4 {
+  alignas(16) float m[16];
+} Mat4;
+
+// plane xyz is the normal pointing inside, w the distance, a point p is
+// inside the plane when dot(xyz, p) + w >= 0
+typedef struct Frustum {
+  Vec4 planes[6];
+} Frustum;
+
+static inline Vec3 vec3_add(Vec3 a, Vec3 b) {
+  return (Vec3){a.x + b.x, a.y + b.y, a.z + b.z};
+}
+static inline Vec3 vec3_sub(Vec3 a, Vec3 b) {
+  return (Vec3){a.x - b.x, a.y - b.y, a.z - b.z};
+}
+static inline Vec3 vec3_scale(Vec3 v, float s) {
+  return (Vec3){v.x * s, v.y * s, v.z * s};
+}
+static inline float vec3_dot(Vec3 a, Vec3 b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+static inline Vec3 vec3_cross(Vec3 a, Vec3 b) {
+  return (Vec3){a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x};
+}
+static inline float vec3_length(Vec3 v) {
+  return sqrtf(vec3_dot(v, v));
+}
+// the zero vector stays zero
+static inline Vec3 vec3_normalize(Vec3 v) {
+  float length = vec3_length(v);
+  return length > 0.0f ? vec3_scale(v, 1.0f / length) : v;
+}
+
+static inline Quat quat_identity(void) {
+  return (Quat){0.0f, 0.0f, 0.0f, 1.0f};
+}
+// axis must be unit length, angle in radians
+Quat quat_from_axis_angle(Vec3 axis, float angle);
+// rotates by b first, then by a
+Quat quat_mul(Quat a, Quat b);
+Quat quat_normalize(Quat q);
+Vec3 quat_rotate(Quat q, Vec3 v);
+// normalized lerp along the shorter arc, close to slerp for the small steps
+// between animation keys
+Quat quat_nlerp(Quat a, Quat b, float t);
+
+Mat4 mat4_identity(void);
+// a * b, b is applied first
+Mat4 mat4_mul(const Mat4* a, const Mat4* b);
+Vec4 mat4_mul_vec4(const Mat4* m, Vec4 v);
+Mat4 mat4_transpose(const Mat4* m);
+// scale, then rotation, then translation
+Mat4 mat4_from_trs(Vec3 translation, Quat rotation, Vec3 scale);
+// Right handed view space looking down -z. Vulkan clip space: y points
+// down and depth goes from 0 at near to 1 at far. fov_y in radians.
+Mat4 mat4_perspective(float fov_y, float aspect, float near, float far);
+// right handed, up must not be parallel to the view direction
+Mat4 mat4_look_at(Vec3 eye, Vec3 target, Vec3 up);
+
+// planes of the clip volume of a view projection matrix, in the space the
+// matrix transforms from, with Vulkan's 0 to 1 depth range
+Frustum frustum_from_mat4(const Mat4* view_projection);
+// false only when the box is entirely outside one of the planes, boxes
+// near a frustum corner may pass without being visible
+bool frustum_test_aabb(const Frustum* frustum, Vec3 center, Vec3 extent);
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef MATH_SIMD_H
+#define MATH_SIMD_H
+
+// Picks the instruction set the math code is compiled for, once, from what
+// the compiler targets: AVX2 with FMA, SSE2 (every x86-64 CPU), NEON or
+// plain C. Defining MATH_FORCE_SCALAR builds the plain C path anywhere.
+//
+// Float4 is one 4 wide register for the Mat4 code. FloatN is the widest
+// register, MATH_LANES floats, for the kernels running over SoA arrays with
+// one instance per lane, MaskN the result of comparing two of them. Neither
+// exists on the scalar path, the code using them is compiled out there.
+#if defined(MATH_FORCE_SCALAR)
+#define MATH_SIMD_SCALAR 1
+#define MATH_SIMD_NAME "scalar"
+#elif defined(__AVX2__) && defined(__FMA__)
+#define MATH_SIMD_AVX2 1
+#define MATH_SIMD_NAME "avx2"
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define MATH_SIMD_SSE 1
+#define MATH_SIMD_NAME "sse2"
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define MATH_SIMD_NEON 1
+#define MATH_SIMD_NAME "neon"
+#include <arm_neon.h>
+#else
+#define MATH_SIMD_SCALAR 1
+#define MATH_SIMD_NAME "scalar"
+#endif
+
+#include <stdint.h>
+
+#if defined(MATH_SIMD_AVX2) || defined(MATH_SIMD_SSE)
+
+typedef __m128 Float4;
+
+static inline Float4 float4_load(const float* data) {
+  return _mm_loadu_ps(data);
+}
+static inline void float4_store(float* data, Float4 value) {
+  _mm_storeu_ps(data, value);
+}
+static inline Float4 float4_set1(float value) {
+  return _mm_set1_ps(value);
+}
+static inline Float4 float4_mul(Float4 a, Float4 b) {
+  return _mm_mul_ps(a, b);
+}
+// a * b + c
+static inline Float4 float4_madd(Float4 a, Float4 b, Float4 c) {
+#if defined(MATH_SIMD_AVX2)
+  return _mm_fmadd_ps(a, b, c);
+#else
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+#elif defined(MATH_SIMD_NEON)
+
+typedef float32x4_t Float4;
+
+static inline Float4 float4_load(const float* data) {
+  return vld1q_f32(data);
+}
+static inline void float4_store(float* data, Float4 value) {
+  vst1q_f32(data, value);
+}
+static inline Float4 float4_set1(float value) {
+  return vdupq_n_f32(value);
+}
+static inline Float4 float4_mul(Float4 a, Float4 b) {
+  return vmulq_f32(a, b);
+}
+static inline Float4 float4_madd(Float4 a, Float4 b, Float4 c) {
+#if defined(__aarch64__)
+  return vfmaq_f32(c, a, b);
+#else
+  return vmlaq_f32(c, a, b);
+#endif
+}
+
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+
+#define MATH_LANES 8
+
+typedef __m256 FloatN;
+typedef __m256 MaskN;
+
+static inline FloatN floatn_load(const float* data) {
+  return _mm256_loadu_ps(data);
+}
+static inline void floatn_store(float* data, FloatN value) {
+  _mm256_storeu_ps(data, value);
+}
+static inline FloatN floatn_set1(float value) {
+  return _mm256_set1_ps(value);
+}
+static inline FloatN floatn_add(FloatN a, FloatN b) {
+  return _mm256_add_ps(a, b);
+}
+static inline FloatN floatn_sub(FloatN a, FloatN b) {
+  return _mm256_sub_ps(a, b);
+}
+static inline FloatN floatn_mul(FloatN a, FloatN b) {
+  return _mm256_mul_ps(a, b);
+}
+static inline FloatN floatn_madd(FloatN a, FloatN b, FloatN c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+static inline MaskN floatn_less(FloatN a, FloatN b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+static inline MaskN maskn_or(MaskN a, MaskN b) {
+  return _mm256_or_ps(a, b);
+}
+// bit i set when lane i is
+static inline uint32_t maskn_bits(MaskN mask) {
+  return (uint32_t)_mm256_movemask_ps(mask);
+}
+
+#elif defined(MATH_SIMD_SSE)
+
+#define MATH_LANES 4
+
+typedef __m128 FloatN;
+typedef __m128 MaskN;
+
+static inline FloatN floatn_load(const float* data) {
+  return _mm_loadu_ps(data);
+}
+static inline void floatn_store(float* data, FloatN value) {
+  _mm_storeu_ps(data, value);
+}
+static inline FloatN floatn_set1(float value) {
+  return _mm_set1_ps(value);
+}
+static inline FloatN floatn_add(FloatN a, FloatN b) {
+  return _mm_add_ps(a, b);
+}
+static inline FloatN floatn_sub(FloatN a, FloatN b) {
+  return _mm_sub_ps(a, b);
+}
+static inline FloatN floatn_mul(FloatN a, FloatN b) {
+  return _mm_mul_ps(a, b);
+}
+static inline FloatN floatn_madd(FloatN a, FloatN b, FloatN c) {
+  return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+static inline MaskN floatn_less(FloatN a, FloatN b) {
+  return _mm_cmplt_ps(a, b);
+}
+static inline MaskN maskn_or(MaskN a, MaskN b) {
+  return _mm_or_ps(a, b);
+}
+static inline uint32_t maskn_bits(MaskN mask) {
+  return (uint32_t)_mm_movemask_ps(mask);
+}
+
+#elif defined(MATH_SIMD_NEON)
+
+#define MATH_LANES 4
+
+typedef float32x4_t FloatN;
+typedef uint32x4_t MaskN;
+
+static inline FloatN floatn_load(const float* data) {
+  return vld1q_f32(data);
+}
+static inline void floatn_store(float* data, FloatN value) {
+  vst1q_f32(data, value);
+}
+static inline FloatN floatn_set1(float value) {
+  return vdupq_n_f32(value);
+}
+static inline FloatN floatn_add(FloatN a, FloatN b) {
+  return vaddq_f32(a, b);
+}
+static inline FloatN floatn_sub(FloatN a, FloatN b) {
+  return vsubq_f32(a, b);
+}
+static inline FloatN floatn_mul(FloatN a, FloatN b) {
+  return vmulq_f32(a, b);
+}
+static inline FloatN floatn_madd(FloatN a, FloatN b, FloatN c) {
+  return float4_madd(a, b, c);
+}
+static inline MaskN floatn_less(FloatN a, FloatN b) {
+  return vcltq_f32(a, b);
+}
+static inline MaskN maskn_or(MaskN a, MaskN b) {
+  return vorrq_u32(a, b);
+}
+static inline uint32_t maskn_bits(MaskN mask) {
+  return (vgetq_lane_u32(mask, 0) & 1) | (vgetq_lane_u32(mask, 1) & 2) |
+         (vgetq_lane_u32(mask, 2) & 4) | (vgetq_lane_u32(mask, 3) & 8);
+}
+
+#else
+
+#define MATH_LANES 1
+
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+#include "./arena.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "./logger.h"
+#include "./memory.h"
+
+typedef struct ArenaThread {
+  Arena frame;
+  Arena scratch;
+} ArenaThread;
+
+// threads register themselves on their first allocation, slots are never
+// reused so the clearing thread can walk them without a lock
+static _Atomic(ArenaThread*) arena_threads[ARENA_MAX_THREADS];
+static atomic_uint arena_thread_count;
+static thread_local ArenaThread* arena_thread;
+static thread_local bool arena_thread_failed;
+
+static ArenaBlock* arena_block_create(size_t size) {
+  if (size > SIZE_MAX - sizeof(ArenaBlock)) {
+    return nullptr;
+  }
+  ArenaBlock* block = mem_alloc(sizeof(ArenaBlock) + size);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  block->next = nullptr;
+  block->size = size;
+  block->offset = 0;
+  return block;
+}
+
+// bumps the block offset, nullptr when the allocation does not fit
+static void* arena_block_bump(ArenaBlock* block,
+                              size_t size,
+                              size_t alignment,
+                              size_t* consumed) {
+  uintptr_t base = (uintptr_t)block->data;
+  size_t offset = ALIGN_MEM(base + block->offset, alignment) - base;
+  if (offset > block->size || size > block->size - offset) {
+    return nullptr;
+  }
+  *consumed = offset + size - block->offset;
+  block->offset = offset + size;
+  return block->data + offset;
+}
+
+static void* arena_use(Arena* arena,
+                       ArenaBlock* block,
+                       size_t size,
+                       size_t alignment) {
+  size_t consumed = 0;
+  void* data = arena_block_bump(block, size, alignment, &consumed);
+  if (data == nullptr) {
+    return nullptr;
+  }
+  arena->current = block;
+  arena->used += consumed;
+  if (arena->used > arena->peak) {
+    arena->peak = arena->used;
+  }
+  return data;
+}
+
+void arena_init(Arena* arena, size_t block_size) {
+  arena_reset(arena);
+  arena->block_size = block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+}
+
+void arena_reset(Arena* arena) {
+  arena->first = nullptr;
+  arena->current = nullptr;
+  arena->block_size = ARENA_DEFAULT_BLOCK_SIZE;
+  arena->used = 0;
+  arena->peak = 0;
+  arena->reserved = 0;
+}
+
+void arena_destroy(Arena* arena) {
+  ArenaBlock* block = arena->first;
+  while (block) {
+    ArenaBlock* next = block->next;
+    mem_free(block);
+    block = next;
+  }
+  arena_reset(arena);
+}
+
+void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment) {
+  if (alignment < ARENA_DEFAULT_ALIGNMENT) {
+    alignment = ARENA_DEFAULT_ALIGNMENT;
+  }
+
+  if (arena->current) {
+    void* data = arena_use(arena, arena->current, size, alignment);
+    if (data) {
+      return data;
+    }
+  }
+
+  // blocks past the current one are left over from before a clear or a
+  // rollback, too small ones are skipped for this round
+  ArenaBlock* last = arena->current;
+  ArenaBlock* block = last ? last->next : arena->first;
+  while (block) {
+    block->offset = 0;
+    void* data = arena_use(arena, block, size, alignment);
+    if (data) {
+      return data;
+    }
+    last = block;
+    block = block->next;
+  }
+
+  if (size > SIZE_MAX - alignment) {
+    return nullptr;
+  }
+  size_t block_size = arena->block_size;
+  if (block_size < size + alignment) {
+    block_size = size + alignment;
+  }
+  block = arena_block_create(block_size);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  if (last) {
+    last->next = block;
+  } else {
+    arena->first = block;
+  }
+  arena->reserved += block_size;
+  if (arena->block_size < ARENA_MAX_BLOCK_SIZE) {
+    arena->block_size *= 2;
+  }
+
+  return arena_use(arena, block, size, alignment);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+  return arena_alloc_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+void* arena_alloc_zeroed(Arena* arena, size_t size) {
+  void* data = arena_alloc(arena, size);
+  if (data) {
+    memset(data, 0, size);
+  }
+  return data;
+}
+
+void* arena_alloc_array(Arena* arena, size_t count, size_t size) {
+  if (size > 0 && count > SIZE_MAX / size) {
+    return nullptr;
+  }
+  return arena_alloc(arena, count * size);
+}
+
+void arena_clear(Arena* arena) {
+  arena->current = nullptr;
+  arena->used = 0;
+}
+
+ArenaMark arena_mark(const Arena* arena) {
+  return (ArenaMark){
+      .block = arena->current,
+      .offset = arena->current ? arena->current->offset : 0,
+      .used = arena->used,
+  };
+}
+
+void arena_rollback(Arena* arena, ArenaMark mark) {
+  arena->current = mark.block;
+  if (mark.block) {
+    mark.block->offset = mark.offset;
+  }
+  arena->used = mark.used;
+}
+
+bool arena_owns(const Arena* arena, const void* data) {
+  uintptr_t address = (uintptr_t)data;
+  for (const ArenaBlock* block = arena->first; block; block = block->next) {
+    uintptr_t base = (uintptr_t)block->data;
+    if (address >= base && address - base < block->size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void arena_log_stats(const Arena* arena, const char* name) {
+  log_debug("Arena %s: %zu KiB peak, %zu KiB reserved", name,
+            arena->peak / 1024, arena->reserved / 1024);
+}
+
+static ArenaThread* arena_thread_get(void) {
+  if (arena_thread || arena_thread_failed) {
+    return arena_thread;
+  }
+
+  unsigned slot = atomic_fetch_add(&arena_thread_count, 1);
+  if (slot >= ARENA_MAX_THREADS) {
+    log_error("More than %d threads allocate from arenas", ARENA_MAX_THREADS);
+    arena_thread_failed = true;
+    return nullptr;
+  }
+  ArenaThread* thread = mem_alloc(sizeof(ArenaThread));
+  if (thread == nullptr) {
+    arena_thread_failed = true;
+    SDL_OutOfMemory();
+    return nullptr;
+  }
+  arena_init(&thread->frame, 0);
+  arena_init(&thread->scratch, 0);
+
+  atomic_store_explicit(&arena_threads[slot], thread, memory_order_release);
+  arena_thread = thread;
+  return thread;
+}
+
+Arena* arena_frame(void) {
+  ArenaThread* thread = arena_thread_get();
+  return thread ? &thread->frame : nullptr;
+}
+
+Arena* arena_scratch(void) {
+  ArenaThread* thread = arena_thread_get();
+  return thread ? &thread->scratch : nullptr;
+}
+
+static uint32_t arena_thread_slot_count(void) {
+  unsigned count = atomic_load_explicit(&arena_thread_count,
+                                        memory_order_acquire);
+  return count < ARENA_MAX_THREADS ? count : ARENA_MAX_THREADS;
+}
+
+void arena_frame_clear_all(void) {
+  uint32_t count = arena_thread_slot_count();
+  for (uint32_t i = 0; i < count; i++) {
+    ArenaThread* thread =
+        atomic_load_explicit(&arena_threads[i], memory_order_acquire);
+    if (thread) {
+      arena_clear(&thread->frame);
+    }
+  }
+}
+
+void arena_thread_destroy_all(void) {
+  uint32_t count = arena_thread_slot_count();
+  for (uint32_t i = 0; i < count; i++) {
+    ArenaThread* thread = atomic_exchange(&arena_threads[i], nullptr);
+    if (thread) {
+      arena_destroy(&thread->frame);
+      arena_destroy(&thread->scratch);
+      mem_free(thread);
+    }
+  }
+  atomic_store(&arena_thread_count, 0);
+  // only the calling thread can forget its own arenas, the others must not
+  // allocate again
+  arena_thread = nullptr;
+  arena_thread_failed = false;
+}
+
+void arena_thread_log_stats(void) {
+  uint32_t count = arena_thread_slot_count();
+  size_t frame_peak = 0;
+  size_t scratch_peak = 0;
+  size_t reserved = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    ArenaThread* thread =
+        atomic_load_explicit(&arena_threads[i], memory_order_acquire);
+    if (thread) {
+      frame_peak += thread->frame.peak;
+      scratch_peak += thread->scratch.peak;
+      reserved += thread->frame.reserved + thread->scratch.reserved;
+    }
+  }
+  log_debug(
+      "Thread arenas: %u threads, %zu KiB frame peak, %zu KiB scratch peak, "
+      "%zu KiB reserved",
+      count, frame_peak / 1024, scratch_peak / 1024, reserved / 1024);
+}
+
+ArenaScratch arena_scratch_begin(void) {
+  Arena* arena = arena_scratch();
+  return (ArenaScratch){
+      .arena = arena,
+      .mark = arena ? arena_mark(arena) : (ArenaMark){0},
+  };
+}
+
+void arena_scratch_end(ArenaScratch scratch) {
+  if (scratch.arena) {
+    arena_rollback(scratch.arena, scratch.mark);
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef UTILS_ARENA_H
+#define UTILS_ARENA_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the first block is this big unless asked for more, every block after it
+// doubles up to ARENA_MAX_BLOCK_SIZE
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (16 * 1024 * 1024)
+#define ARENA_DEFAULT_ALIGNMENT 16
+// threads that can own a frame and a scratch arena
+#define ARENA_MAX_THREADS 64
+
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t size;
+  size_t offset;
+  alignas(ARENA_DEFAULT_ALIGNMENT) uint8_t data[];
+} ArenaBlock;
+
+// Bump allocator over a chain of blocks. Allocations are never freed one by
+// one, the arena is cleared as a whole or rolled back to a mark, the blocks
+// stay around for the next round so a warmed up arena never calls malloc.
+// Not thread safe, every thread allocates from its own arena.
+typedef struct Arena {
+  ArenaBlock* first;
+  ArenaBlock* current;
+  size_t block_size;
+  // bytes handed out since the last clear, padding included
+  size_t used;
+  size_t peak;
+  size_t reserved;
+} Arena;
+
+typedef struct ArenaMark {
+  ArenaBlock* block;
+  size_t offset;
+  size_t used;
+} ArenaMark;
+
+// block_size 0 picks ARENA_DEFAULT_BLOCK_SIZE, no memory is reserved before
+// the first allocation
+void arena_init(Arena* arena, size_t block_size);
+void arena_reset(Arena* arena);
+void arena_destroy(Arena* arena);
+
+// nullptr when out of memory, alignment must be a power of two
+void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment);
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_alloc_zeroed(Arena* arena, size_t size);
+// count elements of size bytes, nullptr when the product overflows
+void* arena_alloc_array(Arena* arena, size_t count, size_t size);
+
+// frees every allocation but keeps the blocks
+void arena_clear(Arena* arena);
+ArenaMark arena_mark(const Arena* arena);
+// frees everything allocated after the mark was taken
+void arena_rollback(Arena* arena, ArenaMark mark);
+
+// whether data points into one of the blocks of the arena
+bool arena_owns(const Arena* arena, const void* data);
+
+void arena_log_stats(const Arena* arena, const char* name);
+
+// Every thread lazily gets a frame arena and a scratch arena. The frame
+// arena lives until arena_frame_clear_all(), called once per frame while no
+// other thread allocates from its frame arena. The scratch arena is for
+// allocations that die before the function returns, take a mark with
+// arena_scratch_begin() and hand it back to arena_scratch_end(). Both return
+// nullptr when the arena could not be created.
+Arena* arena_frame(void);
+Arena* arena_scratch(void);
+void arena_frame_clear_all(void);
+// frees the arenas of every thread, none of them may be used afterwards
+void arena_thread_destroy_all(void);
+void arena_thread_log_stats(void);
+
+typedef struct ArenaScratch {
+  Arena* arena;
+  ArenaMark mark;
+} ArenaScratch;
+
+ArenaScratch arena_scratch_begin(void);
+void arena_scratch_end(ArenaScratch scratch);
+
+#endif
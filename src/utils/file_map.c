@@ -0,0 +1,130 @@
+// st_mtim is POSIX 2008, hidden by a strict -std
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "./file_map.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+Result(int, ErrorMessage) file_map_open(FileMap* map, const char* path) {
+  *map = (FileMap){0};
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return Err(int, ErrorMessage)("Unable to open file");
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    return Err(int, ErrorMessage)("Unable to read file size");
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                       : nullptr;
+  if (!data) {
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return Err(int, ErrorMessage)("Unable to map file");
+  }
+
+  map->data = data;
+  map->size = (size_t)size.QuadPart;
+  map->file = file;
+  map->mapping = mapping;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void file_map_close(FileMap* map) {
+  if (map->data) {
+    UnmapViewOfFile(map->data);
+    CloseHandle(map->mapping);
+    CloseHandle(map->file);
+  }
+  *map = (FileMap){0};
+}
+
+bool file_stat(const char* path, FileStat* status) {
+  struct _stat64 info;
+  if (_stat64(path, &info) != 0) {
+    return false;
+  }
+  status->modified_time = (int64_t)info.st_mtime * 1000000000;
+  status->size = (uint64_t)info.st_size;
+  return true;
+}
+
+#else
+
+Result(int, ErrorMessage) file_map_open(FileMap* map, const char* path) {
+  *map = (FileMap){0};
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return Err(int, ErrorMessage)("Unable to open file");
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return Err(int, ErrorMessage)("Unable to read file size");
+  }
+  if (info.st_size == 0) {
+    close(fd);
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  // the mapping keeps the file referenced, the descriptor is not needed
+  void* data =
+      mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return Err(int, ErrorMessage)("Unable to map file");
+  }
+
+  map->data = data;
+  map->size = (size_t)info.st_size;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void file_map_close(FileMap* map) {
+  if (map->data) {
+    munmap((void*)map->data, map->size);
+  }
+  *map = (FileMap){0};
+}
+
+bool file_stat(const char* path, FileStat* status) {
+  struct stat info;
+  if (stat(path, &info) != 0) {
+    return false;
+  }
+#if defined(__APPLE__)
+  struct timespec modified = info.st_mtimespec;
+#else
+  struct timespec modified = info.st_mtim;
+#endif
+  status->modified_time =
+      (int64_t)modified.tv_sec * 1000000000 + modified.tv_nsec;
+  status->size = (uint64_t)info.st_size;
+  return true;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef UTILS_FILE_MAP_H
+#define UTILS_FILE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../result.h"
+
+// Read only mapping of a whole file, pages are only read when touched
+typedef struct FileMap {
+  const uint8_t* data;
+  size_t size;
+#if defined(_WIN32)
+  void* file;
+  void* mapping;
+#endif
+} FileMap;
+
+typedef struct FileStat {
+  // nanoseconds, only as precise as the file system
+  int64_t modified_time;
+  uint64_t size;
+} FileStat;
+
+// an empty file maps to data nullptr and size 0
+Result(int, ErrorMessage) file_map_open(FileMap* map, const char* path);
+void file_map_close(FileMap* map);
+
+// false when the file does not exist or cannot be read
+bool file_stat(const char* path, FileStat* status);
+
+#endif
@@ -0,0 +1,28 @@
+#include "./frame_limiter.h"
+
+#include <SDL2/SDL.h>
+
+void frame_limiter_init(FrameLimiter* limiter, uint32_t max_fps) {
+  limiter->frequency = SDL_GetPerformanceFrequency();
+  limiter->interval = max_fps > 0 ? limiter->frequency / max_fps : 0;
+  limiter->deadline = SDL_GetPerformanceCounter() + limiter->interval;
+}
+
+void frame_limiter_wait(FrameLimiter* limiter) {
+  if (limiter->interval == 0) {
+    return;
+  }
+
+  uint64_t now = SDL_GetPerformanceCounter();
+  if (now < limiter->deadline) {
+    uint64_t remaining_ms = (limiter->deadline - now) * 1000 /
+                            limiter->frequency;
+    if (remaining_ms > 0) {
+      SDL_Delay((uint32_t)remaining_ms);
+    }
+    limiter->deadline += limiter->interval;
+  } else {
+    // a frame ran late, restart the schedule instead of trying to catch up
+    limiter->deadline = now + limiter->interval;
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef UTILS_FRAME_LIMITER_H
+#define UTILS_FRAME_LIMITER_H
+
+#include <stdint.h>
+
+// Sleeps away the remainder of a frame interval instead of spinning, a
+// max_fps of 0 disables the limit
+typedef struct FrameLimiter {
+  uint64_t frequency;
+  uint64_t interval;
+  uint64_t deadline;
+} FrameLimiter;
+
+void frame_limiter_init(FrameLimiter* limiter, uint32_t max_fps);
+void frame_limiter_wait(FrameLimiter* limiter);
+
+#endif
@@ -0,0 +1,26 @@
+#include "./hash.h"
+
+#include <string.h>
+
+#define HASH_FNV1A64_PRIME 0x100000001b3ull
+
+uint64_t hash_fnv1a64(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* bytes = data;
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= HASH_FNV1A64_PRIME;
+  }
+  return hash;
+}
+
+void hash_key_append(HashKey* key, const void* data, size_t size) {
+  if (key->data != nullptr && size > 0) {
+    memcpy(key->data + key->size, data, size);
+  }
+  key->size += size;
+}
+
+bool hash_key_equal(const HashKey* key, const uint8_t* data, size_t size) {
+  return key->size == size && memcmp(key->data, data, size) == 0;
+}
@@ -0,0 +1,61 @@
+#ifndef UTILS_HASH_H
+#define UTILS_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_FNV1A64_SEED 0xcbf29ce484222325ull
+
+// 64 bit FNV-1a, chain calls by passing the previous hash as seed
+uint64_t hash_fnv1a64(const void* data, size_t size, uint64_t seed);
+
+#define HASH_VALUE(hash, value)                          \
+  (hash) = hash_fnv1a64(&(value), sizeof(value), (hash))
+// only for arrays of structs without padding or pointers
+#define HASH_ARRAY(hash, array, count)                                    \
+  do {                                                                    \
+    if ((array) != nullptr) {                                             \
+      (hash) = hash_fnv1a64((array), sizeof(*(array)) * (count), (hash)); \
+    }                                                                     \
+  } while (0)
+// hashes the members first..last, all of them 4 bytes wide so the range has
+// no padding in it
+#define HASH_MEMBERS(hash, type, object, first, last)                   \
+  (hash) = hash_fnv1a64(&(object)->first,                               \
+                        offsetof(type, last) + sizeof((object)->last) - \
+                            offsetof(type, first),                      \
+                        (hash))
+
+// The bytes a cache key is made of, written back to back so comparing two
+// keys byte for byte compares the descriptions they came from and a hash hit
+// can be confirmed. Built in two passes over the same code: with data ==
+// nullptr only the size is summed up, the second pass writes into a buffer
+// of exactly that size.
+typedef struct HashKey {
+  uint8_t* data;
+  size_t size;
+} HashKey;
+
+void hash_key_append(HashKey* key, const void* data, size_t size);
+bool hash_key_equal(const HashKey* key, const uint8_t* data, size_t size);
+
+#define HASH_KEY_VALUE(key, value)                \
+  hash_key_append((key), &(value), sizeof(value))
+// a marker keeps an absent array apart from a present one, the count has to
+// be written separately
+#define HASH_KEY_ARRAY(key, array, count)                          \
+  do {                                                             \
+    bool is_array_present = (array) != nullptr;                    \
+    HASH_KEY_VALUE((key), is_array_present);                       \
+    if (is_array_present) {                                        \
+      hash_key_append((key), (array), sizeof(*(array)) * (count)); \
+    }                                                              \
+  } while (0)
+// same rules as HASH_MEMBERS
+#define HASH_KEY_MEMBERS(key, type, object, first, last)          \
+  hash_key_append((key), &(object)->first,                        \
+                  offsetof(type, last) + sizeof((object)->last) - \
+                      offsetof(type, first))
+
+#endif
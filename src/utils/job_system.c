@@ -0,0 +1,314 @@
+#include "./job_system.h"
+
+#include <assert.h>
+
+#include "./logger.h"
+#include "./memory.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#define JOB_QUEUE_MASK (JOB_QUEUE_CAPACITY - 1)
+// failed attempts to find a job before a waiter starts yielding its core
+#define JOB_WAIT_SPIN_COUNT 64
+
+static_assert((JOB_QUEUE_CAPACITY & JOB_QUEUE_MASK) == 0,
+              "JOB_QUEUE_CAPACITY must be a power of two");
+
+static bool job_queue_push(JobQueue* queue, const Job* job) {
+  int_fast64_t bottom =
+      atomic_load_explicit(&queue->bottom, memory_order_relaxed);
+  int_fast64_t top = atomic_load_explicit(&queue->top, memory_order_acquire);
+  if (bottom - top >= JOB_QUEUE_CAPACITY) {
+    return false;
+  }
+
+  queue->jobs[bottom & JOB_QUEUE_MASK] = *job;
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+  return true;
+}
+
+static bool job_queue_pop(JobQueue* queue, Job* job) {
+  int_fast64_t bottom =
+      atomic_load_explicit(&queue->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&queue->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int_fast64_t top = atomic_load_explicit(&queue->top, memory_order_relaxed);
+
+  if (top > bottom) {
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+    return false;
+  }
+
+  *job = queue->jobs[bottom & JOB_QUEUE_MASK];
+  if (top == bottom) {
+    // last job, race the thieves for it
+    bool won = atomic_compare_exchange_strong_explicit(
+        &queue->top, &top, top + 1, memory_order_seq_cst,
+        memory_order_relaxed);
+    atomic_store_explicit(&queue->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+  }
+  return true;
+}
+
+static bool job_queue_steal(JobQueue* queue, Job* job) {
+  int_fast64_t top = atomic_load_explicit(&queue->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int_fast64_t bottom =
+      atomic_load_explicit(&queue->bottom, memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+
+  *job = queue->jobs[top & JOB_QUEUE_MASK];
+  return atomic_compare_exchange_strong_explicit(
+      &queue->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static void job_cpu_pause(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static uint32_t job_worker_next_random(JobWorker* worker) {
+  // xorshift32, only used to spread steal attempts over the victims
+  uint32_t x = worker->random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  worker->random_state = x;
+  return x;
+}
+
+static bool job_system_find_job(JobSystem* system,
+                                uint32_t worker_index,
+                                Job* job) {
+  JobWorker* worker = &system->workers[worker_index];
+  if (job_queue_pop(&worker->queue, job)) {
+    return true;
+  }
+
+  uint32_t start = job_worker_next_random(worker) % system->worker_count;
+  for (uint32_t i = 0; i < system->worker_count; i++) {
+    uint32_t victim = (start + i) % system->worker_count;
+    if (victim == worker_index) {
+      continue;
+    }
+    if (job_queue_steal(&system->workers[victim].queue, job)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void job_system_wake(JobSystem* system) {
+  // pairs with the fence in job_worker_run, either the sleeper sees the new
+  // job or the submitter sees the sleeper
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&system->sleeping_count, memory_order_relaxed) >
+      0) {
+    SDL_SemPost(system->wake);
+  }
+}
+
+static void job_system_execute(JobSystem* system,
+                               uint32_t worker_index,
+                               Job* job) {
+  // split off the upper half until the range fits the grain, the halves stay
+  // large so a thief takes a big share of the remaining work in one steal
+  while (job->grain > 0 && job->end - job->begin > job->grain) {
+    uint32_t middle = job->begin + (job->end - job->begin) / 2;
+    Job upper = *job;
+    upper.begin = middle;
+    atomic_fetch_add_explicit(&job->counter->pending, 1,
+                              memory_order_relaxed);
+    if (!job_queue_push(&system->workers[worker_index].queue, &upper)) {
+      atomic_fetch_sub_explicit(&job->counter->pending, 1,
+                                memory_order_relaxed);
+      break;
+    }
+    job_system_wake(system);
+    job->end = middle;
+  }
+
+  job->function(job->data, job->begin, job->end, worker_index);
+  atomic_fetch_sub_explicit(&job->counter->pending, 1, memory_order_release);
+}
+
+static int job_worker_run(void* data) {
+  JobWorker* worker = data;
+  JobSystem* system = worker->system;
+
+  while (atomic_load_explicit(&system->is_running, memory_order_acquire)) {
+    Job job;
+    if (job_system_find_job(system, worker->index, &job)) {
+      job_system_execute(system, worker->index, &job);
+      continue;
+    }
+
+    atomic_fetch_add_explicit(&system->sleeping_count, 1,
+                              memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    // look once more after announcing the sleep, a job pushed in between
+    // would otherwise wait for the next submit
+    if (job_system_find_job(system, worker->index, &job)) {
+      atomic_fetch_sub_explicit(&system->sleeping_count, 1,
+                                memory_order_relaxed);
+      job_system_execute(system, worker->index, &job);
+      continue;
+    }
+    SDL_SemWait(system->wake);
+    atomic_fetch_sub_explicit(&system->sleeping_count, 1,
+                              memory_order_relaxed);
+  }
+
+  return 0;
+}
+
+Result(int, ErrorMessage)
+    job_system_init(JobSystem* system, uint32_t worker_count) {
+  if (worker_count == 0) {
+    int cpu_count = SDL_GetCPUCount();
+    worker_count = cpu_count > 0 ? (uint32_t)cpu_count : 1;
+  }
+  if (worker_count > JOB_SYSTEM_MAX_WORKERS) {
+    worker_count = JOB_SYSTEM_MAX_WORKERS;
+  }
+
+  system->worker_count = worker_count;
+  atomic_store(&system->sleeping_count, 0);
+  atomic_store(&system->is_running, true);
+
+  system->wake = SDL_CreateSemaphore(0);
+  if (!system->wake) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  system->is_wake_init = true;
+
+  for (uint32_t i = 0; i < worker_count; i++) {
+    JobWorker* worker = &system->workers[i];
+    worker->system = system;
+    worker->index = i;
+    worker->random_state = 0x9e3779b9u * (i + 1);
+    atomic_store(&worker->queue.top, 0);
+    atomic_store(&worker->queue.bottom, 0);
+    worker->queue.jobs = mem_alloc(sizeof(Job) * JOB_QUEUE_CAPACITY);
+    CHECK_ALLOC(worker->queue.jobs, Err(int, ErrorMessage)(SDL_GetError()));
+  }
+
+  // all queues exist before the first thread starts stealing from them
+  for (uint32_t i = 1; i < worker_count; i++) {
+    JobWorker* worker = &system->workers[i];
+    worker->thread = SDL_CreateThread(job_worker_run, "job_worker", worker);
+    if (!worker->thread) {
+      return Err(int, ErrorMessage)(SDL_GetError());
+    }
+    worker->is_thread_init = true;
+  }
+  log_debug("Initialized job system with %u workers", worker_count);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void job_system_reset(JobSystem* system) {
+  for (uint32_t i = 0; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    system->workers[i].queue.jobs = nullptr;
+    system->workers[i].is_thread_init = false;
+  }
+  system->worker_count = 0;
+  system->is_wake_init = false;
+}
+
+void job_system_destroy(JobSystem* system) {
+  atomic_store_explicit(&system->is_running, false, memory_order_release);
+  for (uint32_t i = 1; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    if (system->workers[i].is_thread_init) {
+      SDL_SemPost(system->wake);
+    }
+  }
+  for (uint32_t i = 1; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    if (system->workers[i].is_thread_init) {
+      SDL_WaitThread(system->workers[i].thread, nullptr);
+    }
+  }
+  for (uint32_t i = 0; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    if (system->workers[i].queue.jobs) {
+      mem_free(system->workers[i].queue.jobs);
+    }
+  }
+  if (system->is_wake_init) {
+    SDL_DestroySemaphore(system->wake);
+  }
+  job_system_reset(system);
+}
+
+void job_counter_init(JobCounter* counter) {
+  atomic_store_explicit(&counter->pending, 0, memory_order_relaxed);
+}
+
+bool job_counter_is_done(JobCounter* counter) {
+  return atomic_load_explicit(&counter->pending, memory_order_acquire) == 0;
+}
+
+void job_system_submit(JobSystem* system,
+                       uint32_t worker_index,
+                       const Job* job) {
+  atomic_fetch_add_explicit(&job->counter->pending, 1, memory_order_relaxed);
+  if (!job_queue_push(&system->workers[worker_index].queue, job)) {
+    Job inline_job = *job;
+    job_system_execute(system, worker_index, &inline_job);
+    return;
+  }
+  job_system_wake(system);
+}
+
+void job_system_parallel_for(JobSystem* system,
+                             uint32_t worker_index,
+                             JobFunction function,
+                             void* data,
+                             uint32_t count,
+                             uint32_t grain,
+                             JobCounter* counter) {
+  if (count == 0) {
+    return;
+  }
+
+  Job job = {
+      .function = function,
+      .data = data,
+      .counter = counter,
+      .begin = 0,
+      .end = count,
+      .grain = grain > 0 ? grain : 1,
+  };
+  job_system_submit(system, worker_index, &job);
+}
+
+void job_system_wait(JobSystem* system,
+                     uint32_t worker_index,
+                     JobCounter* counter) {
+  uint32_t idle_count = 0;
+  while (!job_counter_is_done(counter)) {
+    Job job;
+    if (job_system_find_job(system, worker_index, &job)) {
+      job_system_execute(system, worker_index, &job);
+      idle_count = 0;
+      continue;
+    }
+
+    // the last jobs of the counter are running on other workers, spin
+    // briefly for short ones, then give the core back to the scheduler
+    if (idle_count < JOB_WAIT_SPIN_COUNT) {
+      idle_count++;
+      job_cpu_pause();
+    } else {
+      SDL_Delay(0);
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef UTILS_JOB_SYSTEM_H
+#define UTILS_JOB_SYSTEM_H
+
+#include <SDL2/SDL.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "../result.h"
+
+#define JOB_SYSTEM_MAX_WORKERS 32
+// power of two, a full queue makes the submitting worker run the job inline
+#define JOB_QUEUE_CAPACITY 4096
+#define JOB_SYSTEM_CACHE_LINE 64
+
+// Jobs run over the index range [begin, end), worker_index identifies the
+// calling worker and is the index to submit nested jobs from
+typedef void (*JobFunction)(void* data,
+                            uint32_t begin,
+                            uint32_t end,
+                            uint32_t worker_index);
+
+typedef struct JobCounter {
+  atomic_uint pending;
+} JobCounter;
+
+typedef struct Job {
+  JobFunction function;
+  void* data;
+  JobCounter* counter;
+  uint32_t begin;
+  uint32_t end;
+  // ranges longer than this are split in half, the upper half is pushed back
+  // to the executing worker where idle workers can steal it, 0 never splits
+  uint32_t grain;
+} Job;
+
+// Chase-Lev work-stealing deque, only the owning worker pushes and pops at the
+// bottom, every other worker steals from the top
+typedef struct JobQueue {
+  alignas(JOB_SYSTEM_CACHE_LINE) atomic_int_fast64_t top;
+  alignas(JOB_SYSTEM_CACHE_LINE) atomic_int_fast64_t bottom;
+  Job* jobs;
+} JobQueue;
+
+typedef struct JobSystem JobSystem;
+
+typedef struct JobWorker {
+  JobSystem* system;
+  SDL_Thread* thread;
+  JobQueue queue;
+  uint32_t index;
+  uint32_t random_state;
+  bool is_thread_init;
+} JobWorker;
+
+// Worker 0 is the thread that owns the job system, it only executes jobs
+// while waiting on a counter. Workers 1..worker_count-1 are SDL threads.
+struct JobSystem {
+  JobWorker workers[JOB_SYSTEM_MAX_WORKERS];
+  uint32_t worker_count;
+  SDL_sem* wake;
+  atomic_uint sleeping_count;
+  atomic_bool is_running;
+  bool is_wake_init;
+};
+
+// worker_count includes the calling thread, 0 picks one worker per CPU core
+Result(int, ErrorMessage)
+    job_system_init(JobSystem* system, uint32_t worker_count);
+void job_system_reset(JobSystem* system);
+void job_system_destroy(JobSystem* system);
+
+void job_counter_init(JobCounter* counter);
+bool job_counter_is_done(JobCounter* counter);
+
+// must be called from worker_index, 0 on the owning thread or the index
+// passed to a running job
+void job_system_submit(JobSystem* system,
+                       uint32_t worker_index,
+                       const Job* job);
+// splits [0, count) into ranges of at most grain indices
+void job_system_parallel_for(JobSystem* system,
+                             uint32_t worker_index,
+                             JobFunction function,
+                             void* data,
+                             uint32_t count,
+                             uint32_t grain,
+                             JobCounter* counter);
+// executes and steals jobs on the calling worker until the counter drains,
+// backing off to a yield while the remaining jobs run elsewhere
+void job_system_wait(JobSystem* system,
+                     uint32_t worker_index,
+                     JobCounter* counter);
+
+#endif
@@ -0,0 +1,632 @@
+#include "./logger.h"
+
+#include <SDL2/SDL.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "./hash.h"
+#include "./memory.h"
+
+#define LOGGER_CACHE_LINE 64
+#define LOGGER_RECORD_ALIGNMENT 8
+#define LOGGER_BINARY_VERSION 2
+// distinct format strings the binary stream defines once, past that every
+// message defines its format again
+#define LOGGER_MAX_FORMATS 4096
+// marks the unused end of a ring, the reader wraps to the start
+#define LOGGER_PADDING 0xff
+#define LOGGER_LINE_SIZE (LOGGER_MAX_RECORD_SIZE + 128)
+
+typedef struct LogRecord {
+  uint32_t size;
+  uint8_t level;
+  uint8_t arg_count;
+  // messages dropped by the repeat limit since the last one that got through
+  uint32_t suppressed;
+  uint64_t ticks;
+  const char* format;
+  // string arguments point behind the arguments, into the record
+  LogArg args[];
+} LogRecord;
+
+typedef struct LoggerRepeat {
+  uint64_t key;
+  uint64_t window_start_ms;
+  uint32_t count;
+  uint32_t suppressed;
+} LoggerRepeat;
+
+// Single producer, single consumer. head and tail count bytes since init, a
+// record never wraps, the space left at the end is skipped with a padding
+// record.
+typedef struct LoggerRing {
+  alignas(LOGGER_CACHE_LINE) atomic_size_t head;
+  alignas(LOGGER_CACHE_LINE) atomic_size_t tail;
+  alignas(LOGGER_CACHE_LINE) atomic_uint_fast64_t dropped;
+  // what mem_alloc returned, the ring itself is aligned to a cache line
+  void* allocation;
+  // only touched by the producer
+  LoggerRepeat repeats[LOGGER_REPEAT_SLOTS];
+  alignas(LOGGER_CACHE_LINE) uint8_t data[LOGGER_RING_SIZE];
+} LoggerRing;
+
+typedef struct Logger {
+  // threads register on their first message, slots are not reused before
+  // destroy so the consumer walks them without a lock
+  _Atomic(LoggerRing*) rings[LOGGER_MAX_THREADS];
+  atomic_uint ring_count;
+  atomic_bool is_running;
+  // bumped by every init, thread local rings of an older one are stale
+  atomic_uint generation;
+  SDL_Thread* thread;
+  SDL_sem* wake;
+  FILE* binary_file;
+  const char* binary_formats[LOGGER_MAX_FORMATS];
+  uint64_t start_ticks;
+  uint64_t frequency;
+  char line[LOGGER_LINE_SIZE];
+} Logger;
+
+static Logger logger;
+static thread_local LoggerRing* logger_thread_ring;
+static thread_local unsigned logger_thread_generation;
+static thread_local bool logger_thread_failed;
+
+static const char* const logger_level_names[] = {
+    [LOG_LEVEL_DEBUG] = "DEBUG",
+    [LOG_LEVEL_INFO] = "INFO",
+    [LOG_LEVEL_WARNING] = "WARN",
+    [LOG_LEVEL_ERROR] = "ERROR",
+};
+
+static long long logger_arg_int(const LogArg* arg) {
+  switch (arg->type) {
+    case LOG_ARG_INT:
+      return arg->i;
+    case LOG_ARG_DOUBLE:
+      return (long long)arg->f;
+    default:
+      return (long long)arg->u;
+  }
+}
+
+static unsigned long long logger_arg_uint(const LogArg* arg) {
+  switch (arg->type) {
+    case LOG_ARG_INT:
+      return (unsigned long long)arg->i;
+    case LOG_ARG_DOUBLE:
+      return (unsigned long long)arg->f;
+    default:
+      return arg->u;
+  }
+}
+
+static double logger_arg_double(const LogArg* arg) {
+  switch (arg->type) {
+    case LOG_ARG_INT:
+      return (double)arg->i;
+    case LOG_ARG_DOUBLE:
+      return arg->f;
+    default:
+      return (double)arg->u;
+  }
+}
+
+// printf over captured arguments, one conversion at a time. Flags, width and
+// precision are kept, length modifiers are replaced by the width the
+// argument was captured with. Returns the length written.
+static size_t logger_format(char* out,
+                            size_t capacity,
+                            const char* format,
+                            const LogArg* args,
+                            uint32_t arg_count) {
+  size_t length = 0;
+  uint32_t next_arg = 0;
+  const char* c = format;
+  while (*c != '\0' && length + 1 < capacity) {
+    if (*c != '%') {
+      out[length++] = *c++;
+      continue;
+    }
+    if (c[1] == '%') {
+      out[length++] = '%';
+      c += 2;
+      continue;
+    }
+
+    char spec[32];
+    size_t spec_length = 0;
+    spec[spec_length++] = *c++;
+    while (*c != '\0' && strchr("-+ #0123456789.", *c) &&
+           spec_length < sizeof(spec) - 4) {
+      spec[spec_length++] = *c++;
+    }
+    while (*c != '\0' && strchr("hlLqjzt", *c)) {
+      c++;
+    }
+    char conversion = *c;
+    if (conversion == '\0') {
+      break;
+    }
+    c++;
+
+    const LogArg* arg = next_arg < arg_count ? &args[next_arg++] : nullptr;
+    size_t remaining = capacity - length;
+    int written = 0;
+    if (!arg) {
+      written = snprintf(out + length, remaining, "(missing)");
+    } else {
+      switch (conversion) {
+        case 'd':
+        case 'i':
+          spec[spec_length++] = 'l';
+          spec[spec_length++] = 'l';
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(out + length, remaining, spec,
+                             logger_arg_int(arg));
+          break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+          spec[spec_length++] = 'l';
+          spec[spec_length++] = 'l';
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(out + length, remaining, spec,
+                             logger_arg_uint(arg));
+          break;
+        case 'c':
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(out + length, remaining, spec,
+                             (int)logger_arg_int(arg));
+          break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(out + length, remaining, spec,
+                             logger_arg_double(arg));
+          break;
+        case 's':
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(
+              out + length, remaining, spec,
+              arg->type == LOG_ARG_STRING ? arg->s : "(not a string)");
+          break;
+        case 'p':
+          spec[spec_length++] = conversion;
+          spec[spec_length] = '\0';
+          written = snprintf(out + length, remaining, spec, arg->p);
+          break;
+        default:
+          written = snprintf(out + length, remaining, "(bad format)");
+          break;
+      }
+    }
+    if (written > 0) {
+      length += (size_t)written < remaining ? (size_t)written : remaining - 1;
+    }
+  }
+  out[length] = '\0';
+  return length;
+}
+
+static void logger_write_now(LogLevel level,
+                             const char* format,
+                             const LogArg* args,
+                             uint32_t arg_count) {
+  char line[LOGGER_LINE_SIZE];
+  int prefix_length =
+      snprintf(line, sizeof(line), "%s: ", logger_level_names[level]);
+  size_t length = (size_t)prefix_length;
+  length += logger_format(line + length, sizeof(line) - length - 1, format,
+                          args, arg_count);
+  line[length++] = '\n';
+  fwrite(line, 1, length, stderr);
+}
+
+static LoggerRing* logger_ring_get(void) {
+  unsigned generation =
+      atomic_load_explicit(&logger.generation, memory_order_relaxed);
+  if (logger_thread_generation == generation &&
+      (logger_thread_ring || logger_thread_failed)) {
+    return logger_thread_ring;
+  }
+  logger_thread_generation = generation;
+  logger_thread_ring = nullptr;
+  logger_thread_failed = true;
+
+  unsigned slot = atomic_fetch_add(&logger.ring_count, 1);
+  if (slot >= LOGGER_MAX_THREADS) {
+    return nullptr;
+  }
+  void* allocation = mem_alloc(sizeof(LoggerRing) + LOGGER_CACHE_LINE);
+  if (!allocation) {
+    return nullptr;
+  }
+  LoggerRing* ring = (LoggerRing*)ALIGN_MEM(allocation, LOGGER_CACHE_LINE);
+  ring->allocation = allocation;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->dropped, 0);
+  memset(ring->repeats, 0, sizeof(ring->repeats));
+
+  atomic_store_explicit(&logger.rings[slot], ring, memory_order_release);
+  logger_thread_ring = ring;
+  logger_thread_failed = false;
+  return ring;
+}
+
+// false when the message went over the repeat limit of its window
+static bool logger_repeat_admit(LoggerRing* ring,
+                                uint64_t key,
+                                uint32_t* suppressed) {
+  LoggerRepeat* repeat = &ring->repeats[key & (LOGGER_REPEAT_SLOTS - 1)];
+  uint64_t now = SDL_GetTicks64();
+  *suppressed = 0;
+  if (repeat->key != key ||
+      now - repeat->window_start_ms >= LOGGER_REPEAT_WINDOW_MS) {
+    if (repeat->key == key) {
+      *suppressed = repeat->suppressed;
+    }
+    *repeat = (LoggerRepeat){
+        .key = key,
+        .window_start_ms = now,
+        .count = 1,
+        .suppressed = 0,
+    };
+    return true;
+  }
+  if (repeat->count < LOGGER_REPEAT_LIMIT) {
+    repeat->count++;
+    return true;
+  }
+  repeat->suppressed++;
+  return false;
+}
+
+void logger_write(LogLevel level,
+                  const char* format,
+                  const LogArg* args,
+                  uint32_t arg_count) {
+  if (arg_count > LOGGER_MAX_ARGS) {
+    arg_count = LOGGER_MAX_ARGS;
+  }
+  if (!atomic_load_explicit(&logger.is_running, memory_order_acquire)) {
+    logger_write_now(level, format, args, arg_count);
+    return;
+  }
+  LoggerRing* ring = logger_ring_get();
+  if (!ring) {
+    logger_write_now(level, format, args, arg_count);
+    return;
+  }
+
+  // the repeat key covers the format and every argument, string contents
+  // included
+  size_t string_lengths[LOGGER_MAX_ARGS];
+  uint64_t key = hash_fnv1a64(&format, sizeof(format), HASH_FNV1A64_SEED);
+  for (uint32_t i = 0; i < arg_count; i++) {
+    if (args[i].type == LOG_ARG_STRING) {
+      const char* string = args[i].s ? args[i].s : "(null)";
+      string_lengths[i] = strlen(string);
+      key = hash_fnv1a64(string, string_lengths[i], key);
+    } else {
+      HASH_VALUE(key, args[i].u);
+    }
+  }
+  uint32_t suppressed = 0;
+  if (!logger_repeat_admit(ring, key, &suppressed)) {
+    return;
+  }
+
+  size_t size = sizeof(LogRecord) + sizeof(LogArg) * arg_count;
+  size_t string_budget = LOGGER_MAX_RECORD_SIZE - size;
+  for (uint32_t i = 0; i < arg_count; i++) {
+    if (args[i].type != LOG_ARG_STRING) {
+      continue;
+    }
+    size_t length = SDL_min(string_lengths[i],
+                            string_budget > 0 ? string_budget - 1 : 0);
+    string_lengths[i] = length;
+    string_budget -= SDL_min(string_budget, length + 1);
+    size += length + 1;
+  }
+  size = ALIGN(size, LOGGER_RECORD_ALIGNMENT);
+
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  size_t position = head & (LOGGER_RING_SIZE - 1);
+  size_t padding = LOGGER_RING_SIZE - position < size
+                       ? LOGGER_RING_SIZE - position
+                       : 0;
+  if (LOGGER_RING_SIZE - (head - tail) < padding + size) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  if (padding > 0) {
+    LogRecord* pad = (LogRecord*)(ring->data + position);
+    pad->size = (uint32_t)padding;
+    pad->level = LOGGER_PADDING;
+    position = 0;
+  }
+
+  LogRecord* record = (LogRecord*)(ring->data + position);
+  record->size = (uint32_t)size;
+  record->level = (uint8_t)level;
+  record->arg_count = (uint8_t)arg_count;
+  record->suppressed = suppressed;
+  record->ticks = SDL_GetPerformanceCounter();
+  record->format = format;
+  char* strings = (char*)(record->args + arg_count);
+  for (uint32_t i = 0; i < arg_count; i++) {
+    record->args[i] = args[i];
+    if (args[i].type == LOG_ARG_STRING) {
+      memcpy(strings, args[i].s ? args[i].s : "(null)", string_lengths[i]);
+      strings[string_lengths[i]] = '\0';
+      record->args[i].s = strings;
+      strings += string_lengths[i] + 1;
+    }
+  }
+
+  atomic_store_explicit(&ring->head, head + padding + size,
+                        memory_order_release);
+  // a burst wakes the consumer once when it fills half the ring
+  size_t used = head - tail;
+  bool crossed_half = used < LOGGER_RING_SIZE / 2 &&
+                      used + padding + size >= LOGGER_RING_SIZE / 2;
+  if (level >= LOG_LEVEL_WARNING || crossed_half) {
+    SDL_SemPost(logger.wake);
+  }
+}
+
+static void logger_binary_write(const void* data, size_t size) {
+  fwrite(data, 1, size, logger.binary_file);
+}
+
+// true the first time a format is seen, or when the set is full
+static bool logger_binary_define_format(const char* format) {
+  uint64_t hash = hash_fnv1a64(&format, sizeof(format), HASH_FNV1A64_SEED);
+  for (uint32_t probe = 0; probe < LOGGER_MAX_FORMATS; probe++) {
+    const char** slot =
+        &logger.binary_formats[(hash + probe) & (LOGGER_MAX_FORMATS - 1)];
+    if (*slot == format) {
+      return false;
+    }
+    if (*slot == nullptr) {
+      *slot = format;
+      return true;
+    }
+  }
+  return true;
+}
+
+static void logger_emit_binary(const LogRecord* record) {
+  uint64_t format_id = (uint64_t)(uintptr_t)record->format;
+  if (logger_binary_define_format(record->format)) {
+    uint32_t length = (uint32_t)strlen(record->format);
+    logger_binary_write("F", 1);
+    logger_binary_write(&format_id, sizeof(format_id));
+    logger_binary_write(&length, sizeof(length));
+    logger_binary_write(record->format, length);
+  }
+
+  logger_binary_write("M", 1);
+  logger_binary_write(&record->ticks, sizeof(record->ticks));
+  logger_binary_write(&record->level, sizeof(record->level));
+  logger_binary_write(&format_id, sizeof(format_id));
+  logger_binary_write(&record->suppressed, sizeof(record->suppressed));
+  logger_binary_write(&record->arg_count, sizeof(record->arg_count));
+  for (uint32_t i = 0; i < record->arg_count; i++) {
+    const LogArg* arg = &record->args[i];
+    uint8_t type = (uint8_t)arg->type;
+    logger_binary_write(&type, sizeof(type));
+    if (arg->type == LOG_ARG_STRING) {
+      uint32_t length = (uint32_t)strlen(arg->s);
+      logger_binary_write(&length, sizeof(length));
+      logger_binary_write(arg->s, length);
+    } else {
+      logger_binary_write(&arg->u, sizeof(arg->u));
+    }
+  }
+}
+
+static void logger_emit_binary_dropped(uint32_t ring_index,
+                                       uint64_t dropped) {
+  uint64_t ticks = SDL_GetPerformanceCounter();
+  logger_binary_write("D", 1);
+  logger_binary_write(&ticks, sizeof(ticks));
+  logger_binary_write(&ring_index, sizeof(ring_index));
+  logger_binary_write(&dropped, sizeof(dropped));
+}
+
+static void logger_emit_text(const LogRecord* record) {
+  double seconds = (double)(record->ticks - logger.start_ticks) /
+                   (double)logger.frequency;
+  size_t capacity = sizeof(logger.line) - 1;
+  int prefix_length = snprintf(logger.line, capacity, "[%10.4f] %s: ", seconds,
+                               logger_level_names[record->level]);
+  size_t length = (size_t)prefix_length;
+  length += logger_format(logger.line + length, capacity - length,
+                          record->format, record->args, record->arg_count);
+  if (record->suppressed > 0) {
+    int written = snprintf(logger.line + length, capacity - length,
+                           " (%u repeats suppressed)", record->suppressed);
+    if (written > 0) {
+      length += (size_t)written < capacity - length ? (size_t)written
+                                                    : capacity - length - 1;
+    }
+  }
+  logger.line[length++] = '\n';
+  fwrite(logger.line, 1, length, stderr);
+}
+
+// first record of the ring past any padding, nullptr when it is empty
+static const LogRecord* logger_ring_peek(LoggerRing* ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  while (tail != head) {
+    const LogRecord* record =
+        (const LogRecord*)(ring->data + (tail & (LOGGER_RING_SIZE - 1)));
+    if (record->level != LOGGER_PADDING) {
+      return record;
+    }
+    tail += record->size;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+  return nullptr;
+}
+
+// formats everything the rings hold in timestamp order, returns whether
+// anything was written
+static bool logger_drain(void) {
+  unsigned ring_count =
+      atomic_load_explicit(&logger.ring_count, memory_order_acquire);
+  if (ring_count > LOGGER_MAX_THREADS) {
+    ring_count = LOGGER_MAX_THREADS;
+  }
+
+  bool has_written = false;
+  while (true) {
+    LoggerRing* oldest_ring = nullptr;
+    const LogRecord* oldest = nullptr;
+    for (unsigned i = 0; i < ring_count; i++) {
+      LoggerRing* ring =
+          atomic_load_explicit(&logger.rings[i], memory_order_acquire);
+      if (!ring) {
+        continue;
+      }
+      const LogRecord* record = logger_ring_peek(ring);
+      if (record && (!oldest || record->ticks < oldest->ticks)) {
+        oldest = record;
+        oldest_ring = ring;
+      }
+    }
+    if (!oldest) {
+      break;
+    }
+
+    if (logger.binary_file) {
+      logger_emit_binary(oldest);
+    } else {
+      logger_emit_text(oldest);
+    }
+    size_t tail =
+        atomic_load_explicit(&oldest_ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&oldest_ring->tail, tail + oldest->size,
+                          memory_order_release);
+    has_written = true;
+  }
+
+  for (unsigned i = 0; i < ring_count; i++) {
+    LoggerRing* ring =
+        atomic_load_explicit(&logger.rings[i], memory_order_acquire);
+    if (!ring) {
+      continue;
+    }
+    uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0,
+                                                memory_order_relaxed);
+    if (dropped == 0) {
+      continue;
+    }
+    if (logger.binary_file) {
+      logger_emit_binary_dropped(i, dropped);
+    } else {
+      fprintf(stderr, "WARN: logger ring full, dropped %llu messages\n",
+              (unsigned long long)dropped);
+    }
+    has_written = true;
+  }
+
+  if (has_written) {
+    fflush(logger.binary_file ? logger.binary_file : stderr);
+  }
+  return has_written;
+}
+
+static int logger_thread_run([[maybe_unused]] void* data) {
+  while (true) {
+    // read before draining so nothing pushed before destroy is missed
+    bool is_running =
+        atomic_load_explicit(&logger.is_running, memory_order_acquire);
+    logger_drain();
+    if (!is_running) {
+      return 0;
+    }
+    SDL_SemWaitTimeout(logger.wake, LOGGER_FLUSH_INTERVAL_MS);
+  }
+}
+
+Result(int, ErrorMessage) logger_init(const char* binary_path) {
+  logger.frequency = SDL_GetPerformanceFrequency();
+  logger.start_ticks = SDL_GetPerformanceCounter();
+  memset(logger.binary_formats, 0, sizeof(logger.binary_formats));
+  atomic_store(&logger.ring_count, 0);
+  atomic_fetch_add(&logger.generation, 1);
+
+  logger.binary_file = nullptr;
+  if (binary_path) {
+    logger.binary_file = fopen(binary_path, "wb");
+    if (!logger.binary_file) {
+      return Err(int, ErrorMessage)("Unable to open the binary log file");
+    }
+    uint32_t version = LOGGER_BINARY_VERSION;
+    logger_binary_write("HLOG", 4);
+    logger_binary_write(&version, sizeof(version));
+    logger_binary_write(&logger.frequency, sizeof(logger.frequency));
+  }
+
+  logger.wake = SDL_CreateSemaphore(0);
+  if (!logger.wake) {
+    logger_destroy();
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  atomic_store_explicit(&logger.is_running, true, memory_order_release);
+  logger.thread = SDL_CreateThread(logger_thread_run, "logger", nullptr);
+  if (!logger.thread) {
+    atomic_store(&logger.is_running, false);
+    logger_destroy();
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+void logger_destroy(void) {
+  atomic_store_explicit(&logger.is_running, false, memory_order_release);
+  if (logger.thread) {
+    SDL_SemPost(logger.wake);
+    SDL_WaitThread(logger.thread, nullptr);
+    logger.thread = nullptr;
+  }
+  if (logger.wake) {
+    SDL_DestroySemaphore(logger.wake);
+    logger.wake = nullptr;
+  }
+  if (logger.binary_file) {
+    fclose(logger.binary_file);
+    logger.binary_file = nullptr;
+  }
+
+  unsigned ring_count = atomic_exchange(&logger.ring_count, 0);
+  if (ring_count > LOGGER_MAX_THREADS) {
+    ring_count = LOGGER_MAX_THREADS;
+  }
+  for (unsigned i = 0; i < ring_count; i++) {
+    LoggerRing* ring = atomic_exchange(&logger.rings[i], nullptr);
+    if (ring) {
+      mem_free(ring->allocation);
+    }
+  }
+}
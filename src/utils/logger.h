@@ -1,26 +1,155 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
-#include <SDL2/SDL.h>
+#include <stdint.h>
 
-#define log_debug(message, ...)                                              \
-  do {                                                                       \
-    SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, message "\n", ##__VA_ARGS__); \
-  } while (0)
+#include "../result.h"
 
-#define log_info(message, ...)                                              \
-  do {                                                                      \
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, message "\n", ##__VA_ARGS__); \
-  } while (0)
+typedef enum LogLevel {
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_WARNING,
+  LOG_LEVEL_ERROR,
+} LogLevel;
 
-#define log_error(message, ...)                                              \
-  do {                                                                       \
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, message "\n", ##__VA_ARGS__); \
-  } while (0)
+// messages below this level are compiled out, their arguments are still type
+// checked
+#ifndef LOG_MIN_LEVEL
+#ifdef DEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+// per thread ring, power of two
+#define LOGGER_RING_SIZE (64 * 1024)
+#define LOGGER_MAX_THREADS 64
+// longer messages have their string arguments truncated
+#define LOGGER_MAX_RECORD_SIZE 4096
+#define LOGGER_MAX_ARGS 10
+// the consumer formats at least this often, warnings and errors wake it
+// right away
+#define LOGGER_FLUSH_INTERVAL_MS 10u
+// identical messages past the limit within one window are dropped and
+// counted, the next one that gets through reports how many were
+#define LOGGER_REPEAT_WINDOW_MS 1000u
+#define LOGGER_REPEAT_LIMIT 8u
+#define LOGGER_REPEAT_SLOTS 64
+
+typedef enum LogArgType {
+  LOG_ARG_INT,
+  LOG_ARG_UINT,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_STRING,
+  LOG_ARG_POINTER,
+} LogArgType;
+
+// One printf argument captured raw, formatting happens on the logger thread
+typedef struct LogArg {
+  LogArgType type;
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char* s;
+    const void* p;
+  };
+} LogArg;
 
-#define log_warning(message, ...)                                           \
+static inline LogArg log_arg_int(int64_t value) {
+  return (LogArg){.type = LOG_ARG_INT, .i = value};
+}
+static inline LogArg log_arg_uint(uint64_t value) {
+  return (LogArg){.type = LOG_ARG_UINT, .u = value};
+}
+static inline LogArg log_arg_double(double value) {
+  return (LogArg){.type = LOG_ARG_DOUBLE, .f = value};
+}
+// the string is copied into the ring, it may die right after the call
+static inline LogArg log_arg_string(const char* value) {
+  return (LogArg){.type = LOG_ARG_STRING, .s = value};
+}
+static inline LogArg log_arg_pointer(const void* value) {
+  return (LogArg){.type = LOG_ARG_POINTER, .p = value};
+}
+
+#define LOG_ARG(x)                      \
+  _Generic((x),                         \
+      bool: log_arg_uint,               \
+      char: log_arg_int,                \
+      signed char: log_arg_int,         \
+      unsigned char: log_arg_uint,      \
+      short: log_arg_int,               \
+      unsigned short: log_arg_uint,     \
+      int: log_arg_int,                 \
+      unsigned: log_arg_uint,           \
+      long: log_arg_int,                \
+      unsigned long: log_arg_uint,      \
+      long long: log_arg_int,           \
+      unsigned long long: log_arg_uint, \
+      float: log_arg_double,            \
+      double: log_arg_double,           \
+      char*: log_arg_string,            \
+      const char*: log_arg_string,      \
+      default: log_arg_pointer)(x)
+
+#define LOG_COUNT(...)                                                        \
+  LOG_COUNT_N(0 __VA_OPT__(, ) __VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_COUNT_N(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n, ...) n
+#define LOG_CONCAT(a, b) LOG_CONCAT_IMPL(a, b)
+#define LOG_CONCAT_IMPL(a, b) a##b
+#define LOG_ARGS(...)                                        \
+  LOG_CONCAT(LOG_ARGS_, LOG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_ARGS_1(x) LOG_ARG(x)
+#define LOG_ARGS_2(x, ...) LOG_ARG(x), LOG_ARGS_1(__VA_ARGS__)
+#define LOG_ARGS_3(x, ...) LOG_ARG(x), LOG_ARGS_2(__VA_ARGS__)
+#define LOG_ARGS_4(x, ...) LOG_ARG(x), LOG_ARGS_3(__VA_ARGS__)
+#define LOG_ARGS_5(x, ...) LOG_ARG(x), LOG_ARGS_4(__VA_ARGS__)
+#define LOG_ARGS_6(x, ...) LOG_ARG(x), LOG_ARGS_5(__VA_ARGS__)
+#define LOG_ARGS_7(x, ...) LOG_ARG(x), LOG_ARGS_6(__VA_ARGS__)
+#define LOG_ARGS_8(x, ...) LOG_ARG(x), LOG_ARGS_7(__VA_ARGS__)
+#define LOG_ARGS_9(x, ...) LOG_ARG(x), LOG_ARGS_8(__VA_ARGS__)
+#define LOG_ARGS_10(x, ...) LOG_ARG(x), LOG_ARGS_9(__VA_ARGS__)
+
+// message must be a string literal, only its pointer is stored
+#define LOG_WRITE(level, message, ...)                                      \
   do {                                                                      \
-    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, message "\n", ##__VA_ARGS__); \
+    if ((level) >= LOG_MIN_LEVEL) {                                         \
+      logger_write((level), message,                                        \
+                   (const LogArg[]){__VA_OPT__(LOG_ARGS(__VA_ARGS__), ){}}, \
+                   LOG_COUNT(__VA_ARGS__));                                 \
+    }                                                                       \
   } while (0)
 
+#define log_debug(message, ...)                                  \
+  LOG_WRITE(LOG_LEVEL_DEBUG, message __VA_OPT__(, ) __VA_ARGS__)
+#define log_info(message, ...)                                  \
+  LOG_WRITE(LOG_LEVEL_INFO, message __VA_OPT__(, ) __VA_ARGS__)
+#define log_warning(message, ...)                                  \
+  LOG_WRITE(LOG_LEVEL_WARNING, message __VA_OPT__(, ) __VA_ARGS__)
+#define log_error(message, ...)                                  \
+  LOG_WRITE(LOG_LEVEL_ERROR, message __VA_OPT__(, ) __VA_ARGS__)
+
+// Every thread appends records (format pointer, raw arguments, copied
+// strings) to its own single producer ring, a background thread merges the
+// rings by timestamp, formats the records and writes them out. A full ring
+// drops the message instead of blocking the caller. Without a running
+// logger, before init or after destroy, messages are formatted and written
+// on the calling thread.
+//
+// binary_path nullptr writes text to stderr, otherwise a binary stream goes
+// to the file: a "HLOG" header with the version and the tick frequency, then
+// 'F' entries defining a format string the first time it is used, 'M'
+// entries holding the raw arguments of one message and 'D' entries counting
+// the messages a full ring dropped.
+Result(int, ErrorMessage) logger_init(const char* binary_path);
+// drains the rings, no other thread may log anymore
+void logger_destroy(void);
+
+void logger_write(LogLevel level,
+                  const char* format,
+                  const LogArg* args,
+                  uint32_t arg_count);
+
 #endif  // LOGGER_H
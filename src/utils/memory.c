@@ -2,14 +2,67 @@
 
 #include <SDL2/SDL.h>
 
+// arena allocations keep their size in front of the data, mem_realloc
+// copies that much into the new allocation
+#define MEM_ARENA_HEADER_SIZE ARENA_DEFAULT_ALIGNMENT
+
+static thread_local Arena* mem_arena;
+
+static void* mem_arena_alloc(Arena* arena, size_t size) {
+  if (size > SIZE_MAX - MEM_ARENA_HEADER_SIZE) {
+    return nullptr;
+  }
+  // new blocks of the arena come from mem_alloc and must reach the heap
+  mem_arena = nullptr;
+  uint8_t* data = arena_alloc(arena, MEM_ARENA_HEADER_SIZE + size);
+  mem_arena = arena;
+  if (data == nullptr) {
+    return nullptr;
+  }
+  SDL_memcpy(data, &size, sizeof(size_t));
+  return data + MEM_ARENA_HEADER_SIZE;
+}
+
 void* mem_alloc(size_t size) {
+  if (mem_arena) {
+    return mem_arena_alloc(mem_arena, size);
+  }
   return SDL_malloc(size);
 }
 
+void* mem_realloc(void* data, size_t size) {
+  // heap memory from before the scope stays on the heap
+  if (!mem_arena || (data && !arena_owns(mem_arena, data))) {
+    return SDL_realloc(data, size);
+  }
+
+  void* resized = mem_arena_alloc(mem_arena, size);
+  if (resized && data) {
+    size_t old_size = 0;
+    SDL_memcpy(&old_size, (uint8_t*)data - MEM_ARENA_HEADER_SIZE,
+               sizeof(size_t));
+    SDL_memcpy(resized, data, SDL_min(old_size, size));
+  }
+  return resized;
+}
+
 void mem_free(void* data) {
+  if (mem_arena && data && arena_owns(mem_arena, data)) {
+    return;
+  }
   SDL_free(data);
 }
 
 void mem_copy(void* dest, const void* src, size_t length) {
   SDL_memcpy(dest, src, length);
 }
+
+MemArenaScope mem_arena_begin(Arena* arena) {
+  MemArenaScope scope = {.previous = mem_arena};
+  mem_arena = arena;
+  return scope;
+}
+
+void mem_arena_end(MemArenaScope scope) {
+  mem_arena = scope.previous;
+}
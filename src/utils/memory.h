@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "./arena.h"
+
 #define CHECK_ALLOC(x, e) \
   do {                    \
     if ((x) == nullptr) { \
@@ -26,7 +28,20 @@
 #define is_128_byte_aligned(ptr) ((((uintptr_t)(ptr)) & 127) == 0)
 
 void* mem_alloc(size_t size);
+void* mem_realloc(void* data, size_t size);
 void mem_free(void* data);
 void mem_copy(void* dest, const void* src, size_t length);
 
+typedef struct MemArenaScope {
+  Arena* previous;
+} MemArenaScope;
+
+// Routes mem_alloc and mem_realloc of the calling thread to the arena until
+// the scope ends, for code that allocates through mem_* but whose
+// allocations all die together. mem_free of memory from the arena does
+// nothing while the scope is open and must not be called after it ended.
+// Scopes nest, a nullptr arena goes back to the heap.
+MemArenaScope mem_arena_begin(Arena* arena);
+void mem_arena_end(MemArenaScope scope);
+
 #endif
@@ -0,0 +1,53 @@
+#include "./phase_timer.h"
+
+#include <SDL2/SDL.h>
+
+#include "./logger.h"
+
+static void phase_timer_push(PhaseTimer* timer, const char* name, double ms) {
+  if (timer->phase_count == PHASE_TIMER_MAX_PHASES) {
+    timer->phase_ms[PHASE_TIMER_MAX_PHASES - 1] += ms;
+    return;
+  }
+  timer->names[timer->phase_count] = name;
+  timer->phase_ms[timer->phase_count] = ms;
+  timer->phase_count++;
+}
+
+void phase_timer_init(PhaseTimer* timer) {
+  timer->phase_count = 0;
+  timer->frequency = SDL_GetPerformanceFrequency();
+  timer->start = SDL_GetPerformanceCounter();
+  timer->phase_start = timer->start;
+}
+
+void phase_timer_mark(PhaseTimer* timer, const char* name) {
+  uint64_t now = SDL_GetPerformanceCounter();
+  // a carve may have pushed the phase start past now
+  double ms = now > timer->phase_start
+                  ? (double)(now - timer->phase_start) * 1000.0 /
+                        (double)timer->frequency
+                  : 0.0;
+  phase_timer_push(timer, name, ms);
+  timer->phase_start = now;
+}
+
+void phase_timer_carve(PhaseTimer* timer, const char* name, double ms) {
+  phase_timer_push(timer, name, ms);
+  timer->phase_start += (uint64_t)(ms * (double)timer->frequency / 1000.0);
+}
+
+double phase_timer_total_ms(const PhaseTimer* timer) {
+  double total_ms = 0.0;
+  for (uint32_t i = 0; i < timer->phase_count; i++) {
+    total_ms += timer->phase_ms[i];
+  }
+  return total_ms;
+}
+
+void phase_timer_log(const PhaseTimer* timer, const char* title) {
+  log_info("%s took %.3f ms", title, phase_timer_total_ms(timer));
+  for (uint32_t i = 0; i < timer->phase_count; i++) {
+    log_info("  %-20s %9.3f ms", timer->names[i], timer->phase_ms[i]);
+  }
+}
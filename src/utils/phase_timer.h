@@ -0,0 +1,27 @@
+#ifndef UTILS_PHASE_TIMER_H
+#define UTILS_PHASE_TIMER_H
+
+#include <stdint.h>
+
+#define PHASE_TIMER_MAX_PHASES 16
+
+// Splits a stretch of work that runs once, like startup, into named phases
+// that follow one another. Phases past the maximum are folded into the last.
+typedef struct PhaseTimer {
+  const char* names[PHASE_TIMER_MAX_PHASES];
+  double phase_ms[PHASE_TIMER_MAX_PHASES];
+  uint32_t phase_count;
+  uint64_t frequency;
+  uint64_t start;
+  uint64_t phase_start;
+} PhaseTimer;
+
+void phase_timer_init(PhaseTimer* timer);
+// ends the running phase under name, the next one starts now
+void phase_timer_mark(PhaseTimer* timer, const char* name);
+// moves ms timed elsewhere out of the running phase into a phase of its own
+void phase_timer_carve(PhaseTimer* timer, const char* name, double ms);
+double phase_timer_total_ms(const PhaseTimer* timer);
+void phase_timer_log(const PhaseTimer* timer, const char* title);
+
+#endif
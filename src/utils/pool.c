@@ -0,0 +1,94 @@
+#include "./pool.h"
+
+#include "./logger.h"
+#include "./memory.h"
+
+#define POOL_ALIGNMENT 16
+#define POOL_DEFAULT_OBJECTS_PER_CHUNK 64
+// the chunk header is padded so the first object stays aligned
+#define POOL_CHUNK_HEADER ALIGN(sizeof(PoolChunk), POOL_ALIGNMENT)
+
+static bool pool_grow(Pool* pool) {
+  if (pool->object_size > (SIZE_MAX - POOL_CHUNK_HEADER) /
+                              pool->objects_per_chunk) {
+    return false;
+  }
+  PoolChunk* chunk = mem_alloc(POOL_CHUNK_HEADER +
+                               pool->object_size * pool->objects_per_chunk);
+  if (chunk == nullptr) {
+    return false;
+  }
+  chunk->next = pool->chunks;
+  pool->chunks = chunk;
+
+  // thread the new objects onto the free list, lowest address first out
+  uint8_t* objects = (uint8_t*)chunk + POOL_CHUNK_HEADER;
+  for (uint32_t i = pool->objects_per_chunk; i > 0; i--) {
+    void* object = objects + (size_t)(i - 1) * pool->object_size;
+    *(void**)object = pool->free_list;
+    pool->free_list = object;
+  }
+  pool->capacity += pool->objects_per_chunk;
+  return true;
+}
+
+void pool_init(Pool* pool, size_t object_size, uint32_t objects_per_chunk) {
+  pool_reset(pool);
+  if (object_size < sizeof(void*)) {
+    object_size = sizeof(void*);
+  }
+  pool->object_size = ALIGN(object_size, POOL_ALIGNMENT);
+  pool->objects_per_chunk = objects_per_chunk > 0
+                                ? objects_per_chunk
+                                : POOL_DEFAULT_OBJECTS_PER_CHUNK;
+}
+
+void pool_reset(Pool* pool) {
+  pool->chunks = nullptr;
+  pool->free_list = nullptr;
+  pool->object_size = 0;
+  pool->objects_per_chunk = 0;
+  pool->capacity = 0;
+  pool->used = 0;
+  pool->peak = 0;
+}
+
+void pool_destroy(Pool* pool) {
+  if (pool->used > 0) {
+    log_warning("Pool destroyed with %u objects still in use", pool->used);
+  }
+  PoolChunk* chunk = pool->chunks;
+  while (chunk) {
+    PoolChunk* next = chunk->next;
+    mem_free(chunk);
+    chunk = next;
+  }
+  pool_reset(pool);
+}
+
+void* pool_alloc(Pool* pool) {
+  if (pool->free_list == nullptr && !pool_grow(pool)) {
+    return nullptr;
+  }
+  void* object = pool->free_list;
+  pool->free_list = *(void**)object;
+  pool->used++;
+  if (pool->used > pool->peak) {
+    pool->peak = pool->used;
+  }
+  return object;
+}
+
+void pool_free(Pool* pool, void* object) {
+  if (object == nullptr) {
+    return;
+  }
+  *(void**)object = pool->free_list;
+  pool->free_list = object;
+  pool->used--;
+}
+
+void pool_log_stats(const Pool* pool, const char* name) {
+  log_debug("Pool %s: %u of %u objects peak, %zu bytes each", name,
+            pool->peak, pool->capacity, pool->object_size);
+}
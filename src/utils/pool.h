@@ -0,0 +1,36 @@
+#ifndef UTILS_POOL_H
+#define UTILS_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct PoolChunk {
+  struct PoolChunk* next;
+} PoolChunk;
+
+// Fixed size object allocator, objects are carved out of chunks of
+// objects_per_chunk and recycled through an intrusive free list, so alloc
+// and free are a pointer swap. Chunks are only returned on destroy. Not
+// thread safe.
+typedef struct Pool {
+  PoolChunk* chunks;
+  void* free_list;
+  size_t object_size;
+  uint32_t objects_per_chunk;
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t peak;
+} Pool;
+
+// objects are aligned to 16 bytes, objects_per_chunk 0 picks 64
+void pool_init(Pool* pool, size_t object_size, uint32_t objects_per_chunk);
+void pool_reset(Pool* pool);
+void pool_destroy(Pool* pool);
+
+// nullptr when out of memory
+void* pool_alloc(Pool* pool);
+void pool_free(Pool* pool, void* object);
+
+void pool_log_stats(const Pool* pool, const char* name);
+
+#endif
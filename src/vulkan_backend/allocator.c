@@ -0,0 +1,585 @@
+#include "./allocator.h"
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+static uint8_t vulkan_buddy_order_for_size(VkDeviceSize size) {
+  uint8_t order = 0;
+  while ((VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE << order) < size) {
+    order++;
+  }
+  return order;
+}
+
+static VkDeviceSize vulkan_buddy_order_size(uint8_t order) {
+  return VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE << order;
+}
+
+static void vulkan_buddy_init(uint8_t* tree, uint8_t max_order) {
+  for (uint32_t depth = 0; depth <= max_order; depth++) {
+    uint32_t first = (1u << depth) - 1;
+    uint32_t last = (2u << depth) - 1;
+    for (uint32_t i = first; i < last; i++) {
+      tree[i] = (uint8_t)(max_order - depth + 1);
+    }
+  }
+}
+
+static void vulkan_buddy_update_parents(uint8_t* tree,
+                                        uint32_t node,
+                                        uint8_t value) {
+  while (node != 0) {
+    node = (node - 1) / 2;
+    value++;
+    uint8_t left = tree[2 * node + 1];
+    uint8_t right = tree[2 * node + 2];
+    if (left == value - 1 && right == value - 1) {
+      tree[node] = value;
+    } else {
+      tree[node] = left > right ? left : right;
+    }
+  }
+}
+
+static bool vulkan_buddy_allocate(uint8_t* tree,
+                                  uint8_t max_order,
+                                  uint8_t order,
+                                  VkDeviceSize* offset) {
+  uint8_t wanted = order + 1;
+  if (tree[0] < wanted) {
+    return false;
+  }
+
+  uint32_t node = 0;
+  uint8_t node_value = max_order + 1;
+  while (node_value != wanted) {
+    uint32_t left = 2 * node + 1;
+    node = tree[left] >= wanted ? left : left + 1;
+    node_value--;
+  }
+  tree[node] = 0;
+  vulkan_buddy_update_parents(tree, node, wanted);
+
+  uint64_t leaf = ((uint64_t)(node + 1) << order) - (1ull << max_order);
+  *offset = leaf * VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE;
+  return true;
+}
+
+static void vulkan_buddy_free(uint8_t* tree,
+                              uint8_t max_order,
+                              VkDeviceSize offset,
+                              uint8_t order) {
+  uint32_t node = (uint32_t)(offset / VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE) +
+                  (1u << max_order) - 1;
+  for (uint8_t i = 0; i < order; i++) {
+    node = (node - 1) / 2;
+  }
+  tree[node] = order + 1;
+  vulkan_buddy_update_parents(tree, node, order + 1);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_allocator_allocate_device_memory(VulkanAllocator* allocator,
+                                            uint32_t memory_type,
+                                            VkDeviceSize size,
+                                            VkDeviceMemory* memory,
+                                            uint8_t** mapped) {
+  if (allocator->device_memory_count >= allocator->max_device_memory_count) {
+    return Err(int, ErrorMessage)("maxMemoryAllocationCount reached");
+  }
+
+  VkMemoryAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .allocationSize = size,
+      .memoryTypeIndex = memory_type,
+  };
+  VkResult result =
+      allocator->fn->vkAllocateMemory(allocator->device, &allocate_info,
+                                      nullptr, memory);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  *mapped = nullptr;
+  VkMemoryPropertyFlags flags =
+      allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+  if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    void* data = nullptr;
+    result =
+        allocator->fn->vkMapMemory(allocator->device, *memory, 0, VK_WHOLE_SIZE,
+                                   0, &data);
+    if (result != VK_SUCCESS) {
+      allocator->fn->vkFreeMemory(allocator->device, *memory, nullptr);
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    *mapped = data;
+  }
+  allocator->device_memory_count++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_allocator_free_device_memory(VulkanAllocator* allocator,
+                                                VkDeviceMemory memory) {
+  allocator->fn->vkFreeMemory(allocator->device, memory, nullptr);
+  allocator->device_memory_count--;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_allocator_create_block(VulkanAllocator* allocator,
+                                  VulkanMemoryPool* pool,
+                                  uint32_t memory_type,
+                                  uint32_t* block_index) {
+  uint32_t index = pool->block_count;
+  for (uint32_t i = 0; i < pool->block_count; i++) {
+    if (pool->blocks[i].memory == VK_NULL_HANDLE) {
+      index = i;
+      break;
+    }
+  }
+
+  if (index == pool->block_count && pool->block_count == pool->block_capacity) {
+    uint32_t capacity = pool->block_capacity ? pool->block_capacity * 2 : 4;
+    VulkanMemoryBlock* blocks =
+        mem_realloc(pool->blocks, sizeof(VulkanMemoryBlock) * capacity);
+    CHECK_ALLOC(blocks, Err(int, ErrorMessage)(
+                            "Unable to allocate memory for memory blocks"));
+    pool->blocks = blocks;
+    pool->block_capacity = capacity;
+  }
+
+  VulkanMemoryBlock* block = &pool->blocks[index];
+  block->size = allocator->block_sizes[memory_type];
+  block->max_order = vulkan_buddy_order_for_size(block->size);
+  block->used = 0;
+  block->allocation_count = 0;
+  block->tree = mem_alloc((2u << block->max_order) - 1);
+  CHECK_ALLOC(block->tree, Err(int, ErrorMessage)(
+                               "Unable to allocate memory for buddy tree"));
+  vulkan_buddy_init(block->tree, block->max_order);
+
+  auto result = vulkan_allocator_allocate_device_memory(
+      allocator, memory_type, block->size, &block->memory, &block->mapped);
+  if (!result.is_ok) {
+    mem_free(block->tree);
+    block->tree = nullptr;
+    block->memory = VK_NULL_HANDLE;
+    return result;
+  }
+
+  if (index == pool->block_count) {
+    pool->block_count++;
+  }
+  *block_index = index;
+  log_debug("Allocated %llu KiB memory block for memory type %u",
+            (unsigned long long)(block->size / 1024), memory_type);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_allocator_destroy_block(VulkanAllocator* allocator,
+                                           VulkanMemoryBlock* block) {
+  vulkan_allocator_free_device_memory(allocator, block->memory);
+  mem_free(block->tree);
+  block->memory = VK_NULL_HANDLE;
+  block->tree = nullptr;
+  block->mapped = nullptr;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_allocator_allocate_dedicated(VulkanAllocator* allocator,
+                                        uint32_t memory_type,
+                                        VkDeviceSize size,
+                                        VulkanAllocation* allocation) {
+  uint8_t* mapped = nullptr;
+  auto result = vulkan_allocator_allocate_device_memory(
+      allocator, memory_type, size, &allocation->memory, &mapped);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  allocation->offset = 0;
+  allocation->mapped = mapped;
+  allocation->block_index = VULKAN_ALLOCATOR_DEDICATED_BLOCK;
+  allocation->order = 0;
+  allocator->dedicated_count++;
+  allocator->dedicated_bytes += size;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_allocator_allocate_from_type(VulkanAllocator* allocator,
+                                        uint32_t memory_type,
+                                        VkDeviceSize size,
+                                        VkDeviceSize alignment,
+                                        VulkanAllocationKind kind,
+                                        VulkanAllocation* allocation) {
+  allocation->memory_type = memory_type;
+  allocation->kind = (uint8_t)kind;
+
+  // buddy nodes are aligned to their own size, so rounding the request up to
+  // the alignment is enough to satisfy it
+  VkDeviceSize aligned_size = size > alignment ? size : alignment;
+  if (aligned_size > allocator->block_sizes[memory_type] / 2) {
+    return vulkan_allocator_allocate_dedicated(allocator, memory_type, size,
+                                               allocation);
+  }
+
+  uint8_t order = vulkan_buddy_order_for_size(aligned_size);
+  VulkanMemoryPool* pool =
+      &allocator->pools[memory_type][allocator->separate_kinds ? kind : 0];
+
+  uint32_t block_index = pool->block_count;
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; i < pool->block_count; i++) {
+    VulkanMemoryBlock* block = &pool->blocks[i];
+    if (block->memory != VK_NULL_HANDLE &&
+        vulkan_buddy_allocate(block->tree, block->max_order, order, &offset)) {
+      block_index = i;
+      break;
+    }
+  }
+
+  if (block_index == pool->block_count) {
+    auto result = vulkan_allocator_create_block(allocator, pool, memory_type,
+                                                &block_index);
+    if (!result.is_ok) {
+      return result;
+    }
+    VulkanMemoryBlock* block = &pool->blocks[block_index];
+    if (!vulkan_buddy_allocate(block->tree, block->max_order, order,
+                               &offset)) {
+      return Err(int, ErrorMessage)("Unable to sub-allocate from a new block");
+    }
+  }
+
+  VulkanMemoryBlock* block = &pool->blocks[block_index];
+  block->used += vulkan_buddy_order_size(order);
+  block->allocation_count++;
+
+  allocation->memory = block->memory;
+  allocation->offset = offset;
+  allocation->mapped = block->mapped ? block->mapped + offset : nullptr;
+  allocation->block_index = block_index;
+  allocation->order = order;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_allocator_init(VulkanAllocator* allocator,
+                                                const VulkanDevice* vk_device) {
+  allocator->device = vk_device->device;
+  allocator->fn = &vk_device->fn;
+  allocator->memory_properties = vk_device->info.memory_properties;
+  allocator->max_device_memory_count =
+      vk_device->info.properties.limits.maxMemoryAllocationCount;
+  allocator->separate_kinds =
+      vk_device->info.properties.limits.bufferImageGranularity >
+      VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE;
+
+  const VkPhysicalDeviceMemoryProperties* memory_properties =
+      &allocator->memory_properties;
+  for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+    uint32_t heap_index = memory_properties->memoryTypes[i].heapIndex;
+    VkDeviceSize heap_size = memory_properties->memoryHeaps[heap_index].size;
+
+    // small heaps (e.g. 256 MiB BAR memory) get proportionally smaller blocks
+    VkDeviceSize block_size = VULKAN_ALLOCATOR_DEFAULT_BLOCK_SIZE;
+    while (block_size > heap_size / 8 &&
+           block_size > VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE * 64) {
+      block_size >>= 1;
+    }
+    allocator->block_sizes[i] = block_size;
+  }
+
+  allocator->mutex = SDL_CreateMutex();
+  if (!allocator->mutex) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  allocator->is_allocator_init = true;
+  log_debug("Initialized GPU memory allocator (%u memory types)",
+            memory_properties->memoryTypeCount);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_allocator_reset(VulkanAllocator* allocator) {
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    for (uint32_t k = 0; k < VULKAN_ALLOCATION_KIND_COUNT; k++) {
+      allocator->pools[i][k].blocks = nullptr;
+      allocator->pools[i][k].block_count = 0;
+      allocator->pools[i][k].block_capacity = 0;
+    }
+  }
+  allocator->device_memory_count = 0;
+  allocator->dedicated_count = 0;
+  allocator->dedicated_bytes = 0;
+  allocator->requested_bytes = 0;
+  allocator->mutex = nullptr;
+  allocator->is_allocator_init = false;
+}
+
+void vulkan_allocator_destroy(VulkanAllocator* allocator) {
+  if (!allocator->is_allocator_init) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    for (uint32_t k = 0; k < VULKAN_ALLOCATION_KIND_COUNT; k++) {
+      VulkanMemoryPool* pool = &allocator->pools[i][k];
+      for (uint32_t b = 0; b < pool->block_count; b++) {
+        if (pool->blocks[b].memory == VK_NULL_HANDLE) {
+          continue;
+        }
+        if (pool->blocks[b].allocation_count > 0) {
+          log_warning("Memory block of type %u destroyed with %u live "
+                      "allocations",
+                      i, pool->blocks[b].allocation_count);
+        }
+        vulkan_allocator_destroy_block(allocator, &pool->blocks[b]);
+      }
+      mem_free(pool->blocks);
+    }
+  }
+  if (allocator->dedicated_count > 0) {
+    log_warning("GPU allocator destroyed with %u live dedicated allocations",
+                allocator->dedicated_count);
+  }
+  SDL_DestroyMutex(allocator->mutex);
+  vulkan_allocator_reset(allocator);
+}
+
+Result(int, ErrorMessage)
+    vulkan_allocator_allocate(VulkanAllocator* allocator,
+                              const VkMemoryRequirements* requirements,
+                              VkMemoryPropertyFlags required,
+                              VkMemoryPropertyFlags preferred,
+                              VulkanAllocationKind kind,
+                              VulkanAllocation* allocation) {
+  if (requirements->size == 0) {
+    return Err(int, ErrorMessage)("Unable to allocate zero sized memory");
+  }
+
+  const VkPhysicalDeviceMemoryProperties* memory_properties =
+      &allocator->memory_properties;
+  auto result = Err(int, ErrorMessage)("Unable to find a suitable memory type");
+
+  SDL_LockMutex(allocator->mutex);
+  // first pass only considers memory types with all preferred flags
+  uint32_t pass_count = preferred ? 2 : 1;
+  for (uint32_t pass = 0; pass < pass_count && !result.is_ok; pass++) {
+    VkMemoryPropertyFlags wanted = pass == 0 ? required | preferred : required;
+    for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+      VkMemoryPropertyFlags flags =
+          memory_properties->memoryTypes[i].propertyFlags;
+      if (!(requirements->memoryTypeBits & (1u << i)) ||
+          (flags & wanted) != wanted) {
+        continue;
+      }
+      if (pass == 1 && (flags & preferred) == preferred) {
+        continue;
+      }
+      result = vulkan_allocator_allocate_from_type(
+          allocator, i, requirements->size, requirements->alignment, kind,
+          allocation);
+      if (result.is_ok) {
+        break;
+      }
+    }
+  }
+
+  if (result.is_ok) {
+    allocation->size = requirements->size;
+    allocator->requested_bytes += requirements->size;
+  }
+  SDL_UnlockMutex(allocator->mutex);
+
+  return result;
+}
+
+void vulkan_allocator_free(VulkanAllocator* allocator,
+                           VulkanAllocation* allocation) {
+  if (allocation->memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  SDL_LockMutex(allocator->mutex);
+  if (allocation->block_index == VULKAN_ALLOCATOR_DEDICATED_BLOCK) {
+    vulkan_allocator_free_device_memory(allocator, allocation->memory);
+    allocator->dedicated_count--;
+    allocator->dedicated_bytes -= allocation->size;
+  } else {
+    VulkanMemoryPool* pool =
+        &allocator->pools[allocation->memory_type]
+                         [allocator->separate_kinds ? allocation->kind : 0];
+    VulkanMemoryBlock* block = &pool->blocks[allocation->block_index];
+    vulkan_buddy_free(block->tree, block->max_order, allocation->offset,
+                      allocation->order);
+    block->used -= vulkan_buddy_order_size(allocation->order);
+    block->allocation_count--;
+
+    // keep one empty block per pool around to avoid allocation churn
+    if (block->allocation_count == 0) {
+      bool has_other_block = false;
+      for (uint32_t i = 0; i < pool->block_count && !has_other_block; i++) {
+        has_other_block = i != allocation->block_index &&
+                          pool->blocks[i].memory != VK_NULL_HANDLE;
+      }
+      if (has_other_block) {
+        vulkan_allocator_destroy_block(allocator, block);
+      }
+    }
+  }
+  allocator->requested_bytes -= allocation->size;
+  SDL_UnlockMutex(allocator->mutex);
+
+  allocation->memory = VK_NULL_HANDLE;
+  allocation->mapped = nullptr;
+}
+
+Result(int, ErrorMessage)
+    vulkan_allocator_create_buffer(VulkanAllocator* allocator,
+                                   const VkBufferCreateInfo* create_info,
+                                   VkMemoryPropertyFlags required,
+                                   VkMemoryPropertyFlags preferred,
+                                   VkBuffer* buffer,
+                                   VulkanAllocation* allocation) {
+  VkResult result =
+      allocator->fn->vkCreateBuffer(allocator->device, create_info, nullptr,
+                                    buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkMemoryRequirements requirements;
+  allocator->fn->vkGetBufferMemoryRequirements(allocator->device, *buffer,
+                                               &requirements);
+  auto alloc_result = vulkan_allocator_allocate(
+      allocator, &requirements, required, preferred,
+      VULKAN_ALLOCATION_KIND_LINEAR, allocation);
+  if (!alloc_result.is_ok) {
+    allocator->fn->vkDestroyBuffer(allocator->device, *buffer, nullptr);
+    return alloc_result;
+  }
+
+  result = allocator->fn->vkBindBufferMemory(
+      allocator->device, *buffer, allocation->memory, allocation->offset);
+  if (result != VK_SUCCESS) {
+    vulkan_allocator_destroy_buffer(allocator, *buffer, allocation);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_allocator_destroy_buffer(VulkanAllocator* allocator,
+                                     VkBuffer buffer,
+                                     VulkanAllocation* allocation) {
+  allocator->fn->vkDestroyBuffer(allocator->device, buffer, nullptr);
+  vulkan_allocator_free(allocator, allocation);
+}
+
+Result(int, ErrorMessage)
+    vulkan_allocator_create_image(VulkanAllocator* allocator,
+                                  const VkImageCreateInfo* create_info,
+                                  VkMemoryPropertyFlags required,
+                                  VkMemoryPropertyFlags preferred,
+                                  VkImage* image,
+                                  VulkanAllocation* allocation) {
+  VkResult result =
+      allocator->fn->vkCreateImage(allocator->device, create_info, nullptr,
+                                   image);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkMemoryRequirements requirements;
+  allocator->fn->vkGetImageMemoryRequirements(allocator->device, *image,
+                                              &requirements);
+  VulkanAllocationKind kind = create_info->tiling == VK_IMAGE_TILING_OPTIMAL
+                                  ? VULKAN_ALLOCATION_KIND_OPTIMAL
+                                  : VULKAN_ALLOCATION_KIND_LINEAR;
+  auto alloc_result = vulkan_allocator_allocate(
+      allocator, &requirements, required, preferred, kind, allocation);
+  if (!alloc_result.is_ok) {
+    allocator->fn->vkDestroyImage(allocator->device, *image, nullptr);
+    return alloc_result;
+  }
+
+  result = allocator->fn->vkBindImageMemory(
+      allocator->device, *image, allocation->memory, allocation->offset);
+  if (result != VK_SUCCESS) {
+    vulkan_allocator_destroy_image(allocator, *image, allocation);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_allocator_destroy_image(VulkanAllocator* allocator,
+                                    VkImage image,
+                                    VulkanAllocation* allocation) {
+  allocator->fn->vkDestroyImage(allocator->device, image, nullptr);
+  vulkan_allocator_free(allocator, allocation);
+}
+
+void vulkan_allocator_get_stats(VulkanAllocator* allocator,
+                                VulkanAllocatorStats* stats) {
+  *stats = (VulkanAllocatorStats){0};
+  VkDeviceSize free_bytes = 0;
+
+  SDL_LockMutex(allocator->mutex);
+  for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+    for (uint32_t k = 0; k < VULKAN_ALLOCATION_KIND_COUNT; k++) {
+      const VulkanMemoryPool* pool = &allocator->pools[i][k];
+      for (uint32_t b = 0; b < pool->block_count; b++) {
+        const VulkanMemoryBlock* block = &pool->blocks[b];
+        if (block->memory == VK_NULL_HANDLE) {
+          continue;
+        }
+        VkDeviceSize largest_free =
+            block->tree[0] ? vulkan_buddy_order_size(block->tree[0] - 1) : 0;
+        if (largest_free > stats->largest_free_range) {
+          stats->largest_free_range = largest_free;
+        }
+        stats->block_count++;
+        stats->allocation_count += block->allocation_count;
+        stats->block_bytes += block->size;
+        stats->used_bytes += block->used;
+        free_bytes += block->size - block->used;
+      }
+    }
+  }
+  stats->device_memory_count = allocator->device_memory_count;
+  stats->dedicated_count = allocator->dedicated_count;
+  stats->dedicated_bytes = allocator->dedicated_bytes;
+  stats->requested_bytes = allocator->requested_bytes;
+  stats->allocation_count += allocator->dedicated_count;
+  SDL_UnlockMutex(allocator->mutex);
+
+  stats->fragmentation =
+      free_bytes > 0
+          ? 1.0f - (float)stats->largest_free_range / (float)free_bytes
+          : 0.0f;
+}
+
+void vulkan_allocator_log_stats(VulkanAllocator* allocator) {
+  VulkanAllocatorStats stats;
+  vulkan_allocator_get_stats(allocator, &stats);
+
+  log_info("GPU memory: %u allocations in %u blocks + %u dedicated, "
+           "%u/%u device allocations",
+           stats.allocation_count, stats.block_count, stats.dedicated_count,
+           stats.device_memory_count, allocator->max_device_memory_count);
+  log_info("GPU memory: %llu KiB used of %llu KiB in blocks (%llu KiB "
+           "requested), %llu KiB dedicated, fragmentation %.2f",
+           (unsigned long long)(stats.used_bytes / 1024),
+           (unsigned long long)(stats.block_bytes / 1024),
+           (unsigned long long)(stats.requested_bytes / 1024),
+           (unsigned long long)(stats.dedicated_bytes / 1024),
+           stats.fragmentation);
+}
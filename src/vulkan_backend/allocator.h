@@ -0,0 +1,127 @@
+#ifndef VULKAN_BACKEND_ALLOCATOR_H
+#define VULKAN_BACKEND_ALLOCATOR_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+
+#define VULKAN_ALLOCATOR_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+// leaf size of the buddy tree, every sub-allocation is at least this big
+#define VULKAN_ALLOCATOR_MIN_ALLOCATION_SIZE 1024ull
+#define VULKAN_ALLOCATOR_DEDICATED_BLOCK UINT32_MAX
+
+// Linear resources (buffers, linear images) and optimal images must not share
+// a bufferImageGranularity page, they are kept in separate block pools when
+// the granularity is coarser than the buddy leaf size
+typedef enum VulkanAllocationKind {
+  VULKAN_ALLOCATION_KIND_LINEAR,
+  VULKAN_ALLOCATION_KIND_OPTIMAL,
+  VULKAN_ALLOCATION_KIND_COUNT,
+} VulkanAllocationKind;
+
+typedef struct VulkanMemoryBlock {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  // buddy tree, every node stores the order of its largest free range + 1
+  uint8_t* tree;
+  uint8_t max_order;
+  uint8_t* mapped;
+  VkDeviceSize used;
+  uint32_t allocation_count;
+} VulkanMemoryBlock;
+
+typedef struct VulkanMemoryPool {
+  VulkanMemoryBlock* blocks;
+  uint32_t block_count;
+  uint32_t block_capacity;
+} VulkanMemoryPool;
+
+typedef struct VulkanAllocation {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  // nullptr unless the memory type is host visible
+  void* mapped;
+  uint32_t memory_type;
+  uint32_t block_index;
+  uint8_t order;
+  uint8_t kind;
+} VulkanAllocation;
+
+typedef struct VulkanAllocatorStats {
+  uint32_t device_memory_count;
+  uint32_t block_count;
+  uint32_t dedicated_count;
+  uint32_t allocation_count;
+  VkDeviceSize block_bytes;
+  VkDeviceSize used_bytes;
+  VkDeviceSize requested_bytes;
+  VkDeviceSize dedicated_bytes;
+  VkDeviceSize largest_free_range;
+  // 0 when all free space in the blocks is one contiguous range, close to 1
+  // when it is scattered into many small ranges
+  float fragmentation;
+} VulkanAllocatorStats;
+
+typedef struct VulkanAllocator {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VkPhysicalDeviceMemoryProperties memory_properties;
+  VkDeviceSize block_sizes[VK_MAX_MEMORY_TYPES];
+  VulkanMemoryPool pools[VK_MAX_MEMORY_TYPES][VULKAN_ALLOCATION_KIND_COUNT];
+  bool separate_kinds;
+  uint32_t device_memory_count;
+  uint32_t max_device_memory_count;
+  uint32_t dedicated_count;
+  VkDeviceSize dedicated_bytes;
+  VkDeviceSize requested_bytes;
+  SDL_mutex* mutex;
+  bool is_allocator_init;
+} VulkanAllocator;
+
+Result(int, ErrorMessage) vulkan_allocator_init(VulkanAllocator* allocator,
+                                                const VulkanDevice* vk_device);
+void vulkan_allocator_reset(VulkanAllocator* allocator);
+void vulkan_allocator_destroy(VulkanAllocator* allocator);
+
+// required flags must all be present, preferred flags are picked when a memory
+// type with them exists
+Result(int, ErrorMessage)
+    vulkan_allocator_allocate(VulkanAllocator* allocator,
+                              const VkMemoryRequirements* requirements,
+                              VkMemoryPropertyFlags required,
+                              VkMemoryPropertyFlags preferred,
+                              VulkanAllocationKind kind,
+                              VulkanAllocation* allocation);
+void vulkan_allocator_free(VulkanAllocator* allocator,
+                           VulkanAllocation* allocation);
+
+Result(int, ErrorMessage)
+    vulkan_allocator_create_buffer(VulkanAllocator* allocator,
+                                   const VkBufferCreateInfo* create_info,
+                                   VkMemoryPropertyFlags required,
+                                   VkMemoryPropertyFlags preferred,
+                                   VkBuffer* buffer,
+                                   VulkanAllocation* allocation);
+void vulkan_allocator_destroy_buffer(VulkanAllocator* allocator,
+                                     VkBuffer buffer,
+                                     VulkanAllocation* allocation);
+Result(int, ErrorMessage)
+    vulkan_allocator_create_image(VulkanAllocator* allocator,
+                                  const VkImageCreateInfo* create_info,
+                                  VkMemoryPropertyFlags required,
+                                  VkMemoryPropertyFlags preferred,
+                                  VkImage* image,
+                                  VulkanAllocation* allocation);
+void vulkan_allocator_destroy_image(VulkanAllocator* allocator,
+                                    VkImage image,
+                                    VulkanAllocation* allocation);
+
+void vulkan_allocator_get_stats(VulkanAllocator* allocator,
+                                VulkanAllocatorStats* stats);
+void vulkan_allocator_log_stats(VulkanAllocator* allocator);
+
+#endif
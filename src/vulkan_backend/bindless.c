@@ -0,0 +1,341 @@
+#include "./bindless.h"
+
+#include <string.h>
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+static uint32_t vulkan_bindless_min(uint32_t a, uint32_t b) {
+  return a < b ? a : b;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_bindless_slots_init(VulkanBindlessSlots* slots,
+                               uint32_t capacity,
+                               uint32_t frame_count) {
+  slots->capacity = capacity;
+  // one block for the free list and the retired list of every frame slot,
+  // each can hold every index
+  uint32_t* indices =
+      mem_alloc(sizeof(uint32_t) * capacity * (frame_count + 1));
+  CHECK_ALLOC(indices, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for bindless slots"));
+  slots->free = indices;
+  for (uint32_t i = 0; i < frame_count; i++) {
+    slots->retired[i] = indices + capacity * (i + 1);
+  }
+  bool* is_live = mem_alloc(sizeof(bool) * capacity);
+  CHECK_ALLOC(is_live, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for bindless slots"));
+  memset(is_live, 0, sizeof(bool) * capacity);
+  slots->is_live = is_live;
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_bindless_slots_reset(VulkanBindlessSlots* slots) {
+  slots->capacity = 0;
+  slots->high_water = 0;
+  slots->free = nullptr;
+  slots->free_count = 0;
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    slots->retired[i] = nullptr;
+    slots->retired_count[i] = 0;
+  }
+  slots->is_live = nullptr;
+  slots->live_count = 0;
+  slots->peak_live_count = 0;
+}
+
+static bool vulkan_bindless_slots_acquire(VulkanBindlessSlots* slots,
+                                          uint32_t* index) {
+  if (slots->free_count > 0) {
+    *index = slots->free[--slots->free_count];
+  } else if (slots->high_water < slots->capacity) {
+    *index = slots->high_water++;
+  } else {
+    return false;
+  }
+  slots->is_live[*index] = true;
+  slots->live_count++;
+  if (slots->live_count > slots->peak_live_count) {
+    slots->peak_live_count = slots->live_count;
+  }
+  return true;
+}
+
+Result(int, ErrorMessage)
+    vulkan_bindless_table_init(VulkanBindlessTable* table,
+                               const VulkanDevice* vk_device,
+                               VulkanLayoutCache* layout_cache,
+                               uint32_t frames_in_flight) {
+  if (!vk_device->has_bindless) {
+    return Err(int, ErrorMessage)("Descriptor indexing is not supported");
+  }
+  table->device = vk_device->device;
+  table->fn = &vk_device->fn;
+  table->frame_count = frames_in_flight;
+  table->is_table_init = true;
+
+  // a combined image sampler counts against the sampler limits as well
+  const VkPhysicalDeviceVulkan12Properties* limits =
+      &vk_device->info.properties12;
+  uint32_t texture_count = VULKAN_BINDLESS_MAX_TEXTURES;
+  texture_count = vulkan_bindless_min(
+      texture_count, limits->maxDescriptorSetUpdateAfterBindSampledImages);
+  texture_count = vulkan_bindless_min(
+      texture_count, limits->maxPerStageDescriptorUpdateAfterBindSampledImages);
+  texture_count = vulkan_bindless_min(
+      texture_count, limits->maxDescriptorSetUpdateAfterBindSamplers);
+  texture_count = vulkan_bindless_min(
+      texture_count, limits->maxPerStageDescriptorUpdateAfterBindSamplers);
+  texture_count = vulkan_bindless_min(
+      texture_count, limits->maxUpdateAfterBindDescriptorsInAllPools / 2);
+  uint32_t buffer_count = VULKAN_BINDLESS_MAX_BUFFERS;
+  buffer_count = vulkan_bindless_min(
+      buffer_count, limits->maxDescriptorSetUpdateAfterBindStorageBuffers);
+  buffer_count = vulkan_bindless_min(
+      buffer_count, limits->maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+  buffer_count = vulkan_bindless_min(
+      buffer_count,
+      limits->maxUpdateAfterBindDescriptorsInAllPools - texture_count);
+  if (texture_count == 0 || buffer_count == 0) {
+    return Err(int, ErrorMessage)("Bindless descriptor limits are too low");
+  }
+
+  VkDescriptorSetLayoutBinding bindings[] = {
+      {
+          .binding = VULKAN_BINDLESS_TEXTURE_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .descriptorCount = texture_count,
+          .stageFlags = VK_SHADER_STAGE_ALL,
+          .pImmutableSamplers = nullptr,
+      },
+      {
+          .binding = VULKAN_BINDLESS_BUFFER_BINDING,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          .descriptorCount = buffer_count,
+          .stageFlags = VK_SHADER_STAGE_ALL,
+          .pImmutableSamplers = nullptr,
+      },
+  };
+  // unused entries are never written, released ones are rewritten while
+  // older frames still execute with the set bound
+  const VkDescriptorBindingFlags flags =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  VkDescriptorBindingFlags binding_flags[] = {flags, flags};
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+      .sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .pNext = nullptr,
+      .bindingCount = VULKAN_BINDLESS_KIND_COUNT,
+      .pBindingFlags = binding_flags,
+  };
+  VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = &binding_flags_info,
+      .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+      .bindingCount = VULKAN_BINDLESS_KIND_COUNT,
+      .pBindings = bindings,
+  };
+  auto result = vulkan_layout_cache_get_set_layout(layout_cache, &layout_info,
+                                                   &table->set_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkPushConstantRange push_constant_range = {
+      .stageFlags = VK_SHADER_STAGE_ALL,
+      .offset = 0,
+      .size = VULKAN_BINDLESS_PUSH_CONSTANT_SIZE,
+  };
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .setLayoutCount = 1,
+      .pSetLayouts = &table->set_layout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_constant_range,
+  };
+  result = vulkan_layout_cache_get_pipeline_layout(
+      layout_cache, &pipeline_layout_info, &table->pipeline_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkDescriptorPoolSize sizes[] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture_count},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_count},
+  };
+  VkDescriptorPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+      .maxSets = 1,
+      .poolSizeCount = VULKAN_BINDLESS_KIND_COUNT,
+      .pPoolSizes = sizes,
+  };
+  VkResult vk_result = table->fn->vkCreateDescriptorPool(
+      table->device, &pool_info, nullptr, &table->pool);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  table->is_pool_init = true;
+
+  VkDescriptorSetAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .descriptorPool = table->pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &table->set_layout,
+  };
+  vk_result = table->fn->vkAllocateDescriptorSets(table->device,
+                                                  &allocate_info, &table->set);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+
+  result = vulkan_bindless_slots_init(
+      &table->slots[VULKAN_BINDLESS_KIND_TEXTURE], texture_count,
+      frames_in_flight);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_bindless_slots_init(
+      &table->slots[VULKAN_BINDLESS_KIND_BUFFER], buffer_count,
+      frames_in_flight);
+  if (!result.is_ok) {
+    return result;
+  }
+  vulkan_descriptor_writer_init(&table->writer, vk_device);
+
+  log_debug("Initialized bindless table with %u textures and %u buffers",
+            texture_count, buffer_count);
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_bindless_table_reset(VulkanBindlessTable* table) {
+  table->set_layout = VK_NULL_HANDLE;
+  table->pipeline_layout = VK_NULL_HANDLE;
+  table->pool = VK_NULL_HANDLE;
+  table->set = VK_NULL_HANDLE;
+  for (uint32_t i = 0; i < VULKAN_BINDLESS_KIND_COUNT; i++) {
+    vulkan_bindless_slots_reset(&table->slots[i]);
+  }
+  vulkan_descriptor_writer_reset(&table->writer);
+  table->frame_count = 0;
+  table->current_slot = 0;
+  table->is_pool_init = false;
+  table->is_table_init = false;
+}
+
+void vulkan_bindless_table_destroy(VulkanBindlessTable* table) {
+  if (!table->is_table_init) {
+    return;
+  }
+  // the set goes with its pool
+  if (table->is_pool_init) {
+    table->fn->vkDestroyDescriptorPool(table->device, table->pool, nullptr);
+  }
+  for (uint32_t i = 0; i < VULKAN_BINDLESS_KIND_COUNT; i++) {
+    if (table->slots[i].free) {
+      mem_free(table->slots[i].free);
+    }
+    if (table->slots[i].is_live) {
+      mem_free(table->slots[i].is_live);
+    }
+  }
+  vulkan_bindless_table_reset(table);
+}
+
+void vulkan_bindless_table_begin_frame(VulkanBindlessTable* table,
+                                       uint32_t slot) {
+  table->current_slot = slot;
+  for (uint32_t i = 0; i < VULKAN_BINDLESS_KIND_COUNT; i++) {
+    VulkanBindlessSlots* slots = &table->slots[i];
+    for (uint32_t j = 0; j < slots->retired_count[slot]; j++) {
+      slots->free[slots->free_count++] = slots->retired[slot][j];
+    }
+    slots->retired_count[slot] = 0;
+  }
+}
+
+Result(int, ErrorMessage)
+    vulkan_bindless_table_register_texture(VulkanBindlessTable* table,
+                                           VkImageView view,
+                                           VkSampler sampler,
+                                           VkImageLayout layout,
+                                           uint32_t* index) {
+  if (!vulkan_bindless_slots_acquire(
+          &table->slots[VULKAN_BINDLESS_KIND_TEXTURE], index)) {
+    *index = VULKAN_BINDLESS_INVALID_INDEX;
+    return Err(int, ErrorMessage)("Bindless texture table is full");
+  }
+  vulkan_descriptor_writer_write_image(
+      &table->writer, table->set, VULKAN_BINDLESS_TEXTURE_BINDING, *index,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler, layout);
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_bindless_table_register_buffer(VulkanBindlessTable* table,
+                                          VkBuffer buffer,
+                                          VkDeviceSize offset,
+                                          VkDeviceSize range,
+                                          uint32_t* index) {
+  if (!vulkan_bindless_slots_acquire(
+          &table->slots[VULKAN_BINDLESS_KIND_BUFFER], index)) {
+    *index = VULKAN_BINDLESS_INVALID_INDEX;
+    return Err(int, ErrorMessage)("Bindless buffer table is full");
+  }
+  vulkan_descriptor_writer_write_buffer(
+      &table->writer, table->set, VULKAN_BINDLESS_BUFFER_BINDING, *index,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer, offset, range);
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_bindless_table_release(VulkanBindlessTable* table,
+                                   VulkanBindlessKind kind,
+                                   uint32_t index) {
+  if (index == VULKAN_BINDLESS_INVALID_INDEX) {
+    return;
+  }
+  VulkanBindlessSlots* slots = &table->slots[kind];
+  // a second release would put the index on the free list twice and
+  // overflow the retired list, it is dropped instead
+  if (index >= slots->high_water || !slots->is_live[index]) {
+    log_error("Released bindless index %u that is not registered", index);
+    return;
+  }
+  slots->is_live[index] = false;
+  uint32_t slot = table->current_slot;
+  slots->retired[slot][slots->retired_count[slot]++] = index;
+  slots->live_count--;
+}
+
+void vulkan_bindless_table_flush(VulkanBindlessTable* table) {
+  vulkan_descriptor_writer_flush(&table->writer);
+}
+
+void vulkan_bindless_table_bind(const VulkanBindlessTable* table,
+                                VkCommandBuffer command_buffer,
+                                VkPipelineBindPoint bind_point) {
+  table->fn->vkCmdBindDescriptorSets(command_buffer, bind_point,
+                                     table->pipeline_layout, 0, 1,
+                                     &table->set, 0, nullptr);
+}
+
+void vulkan_bindless_table_log_stats(const VulkanBindlessTable* table) {
+  const VulkanBindlessSlots* textures =
+      &table->slots[VULKAN_BINDLESS_KIND_TEXTURE];
+  const VulkanBindlessSlots* buffers =
+      &table->slots[VULKAN_BINDLESS_KIND_BUFFER];
+  log_info("Bindless textures: %u live, %u peak of %u", textures->live_count,
+           textures->peak_live_count, textures->capacity);
+  log_info("Bindless buffers: %u live, %u peak of %u", buffers->live_count,
+           buffers->peak_live_count, buffers->capacity);
+}
@@ -0,0 +1,111 @@
+#ifndef VULKAN_BACKEND_BINDLESS_H
+#define VULKAN_BACKEND_BINDLESS_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./descriptor_allocator.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+#include "./layout_cache.h"
+
+// upper bounds, the device limits may lower them
+#define VULKAN_BINDLESS_MAX_TEXTURES 16384
+#define VULKAN_BINDLESS_MAX_BUFFERS 8192
+#define VULKAN_BINDLESS_TEXTURE_BINDING 0
+#define VULKAN_BINDLESS_BUFFER_BINDING 1
+// bytes of push constants in the bindless pipeline layout, shaders read the
+// indices of the resources of a draw from them
+#define VULKAN_BINDLESS_PUSH_CONSTANT_SIZE 128
+#define VULKAN_BINDLESS_INVALID_INDEX UINT32_MAX
+
+typedef enum VulkanBindlessKind {
+  // combined image samplers, binding 0
+  VULKAN_BINDLESS_KIND_TEXTURE,
+  // storage buffers, binding 1
+  VULKAN_BINDLESS_KIND_BUFFER,
+  VULKAN_BINDLESS_KIND_COUNT,
+} VulkanBindlessKind;
+
+// Array indices of one binding. A released index may still be read by the
+// frames in flight, it waits in the retired list of the current frame slot
+// and is only handed out again once that slot begins anew.
+typedef struct VulkanBindlessSlots {
+  uint32_t capacity;
+  // indices below this have been handed out at least once
+  uint32_t high_water;
+  // released indices ready for reuse, taken last in first out
+  uint32_t* free;
+  uint32_t free_count;
+  uint32_t* retired[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t retired_count[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  // per index, set from acquire to release
+  bool* is_live;
+  uint32_t live_count;
+  uint32_t peak_live_count;
+} VulkanBindlessSlots;
+
+// One descriptor set holding a large partially bound array of textures and
+// one of storage buffers, created update after bind. Resources are
+// registered once and shaders index the arrays with integers, so a command
+// buffer binds the set once instead of a set per draw. Registering and
+// releasing only write descriptors no submitted frame uses. Not thread safe.
+typedef struct VulkanBindlessTable {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  // owned by the layout cache
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout pipeline_layout;
+  VkDescriptorPool pool;
+  VkDescriptorSet set;
+  VulkanBindlessSlots slots[VULKAN_BINDLESS_KIND_COUNT];
+  // registrations are batched into one vkUpdateDescriptorSets per flush
+  VulkanDescriptorWriter writer;
+  uint32_t frame_count;
+  uint32_t current_slot;
+  bool is_pool_init;
+  bool is_table_init;
+} VulkanBindlessTable;
+
+// the device must have been created with has_bindless
+Result(int, ErrorMessage)
+    vulkan_bindless_table_init(VulkanBindlessTable* table,
+                               const VulkanDevice* vk_device,
+                               VulkanLayoutCache* layout_cache,
+                               uint32_t frames_in_flight);
+void vulkan_bindless_table_reset(VulkanBindlessTable* table);
+void vulkan_bindless_table_destroy(VulkanBindlessTable* table);
+
+// recycles the indices released when slot last ran, its fence must have
+// signaled
+void vulkan_bindless_table_begin_frame(VulkanBindlessTable* table,
+                                       uint32_t slot);
+// the index is usable by command buffers submitted after the next flush
+Result(int, ErrorMessage)
+    vulkan_bindless_table_register_texture(VulkanBindlessTable* table,
+                                           VkImageView view,
+                                           VkSampler sampler,
+                                           VkImageLayout layout,
+                                           uint32_t* index);
+Result(int, ErrorMessage)
+    vulkan_bindless_table_register_buffer(VulkanBindlessTable* table,
+                                          VkBuffer buffer,
+                                          VkDeviceSize offset,
+                                          VkDeviceSize range,
+                                          uint32_t* index);
+// The resource must stay alive until the frames in flight are done with it.
+// Releasing an index that is not registered is logged and ignored.
+void vulkan_bindless_table_release(VulkanBindlessTable* table,
+                                   VulkanBindlessKind kind,
+                                   uint32_t index);
+// writes the pending registrations, must run before the submission of the
+// command buffers that use them
+void vulkan_bindless_table_flush(VulkanBindlessTable* table);
+void vulkan_bindless_table_bind(const VulkanBindlessTable* table,
+                                VkCommandBuffer command_buffer,
+                                VkPipelineBindPoint bind_point);
+
+void vulkan_bindless_table_log_stats(const VulkanBindlessTable* table);
+
+#endif
@@ -0,0 +1,516 @@
+#include "./compute_queue.h"
+
+#include "../utils/logger.h"
+#include "./debug.h"
+#include "./functions.h"
+
+#define VULKAN_COMPUTE_QUERY_COUNT 2
+
+static Result(int, ErrorMessage)
+    vulkan_compute_batch_init(VulkanComputeBatch* batch,
+                              const VulkanDeviceFunctions* fn,
+                              VkDevice device,
+                              VkCommandPool command_pool,
+                              bool has_timestamps) {
+  batch->state = VULKAN_COMPUTE_BATCH_STATE_IDLE;
+  batch->is_fence_pending = false;
+  batch->has_timestamps = false;
+
+  VkCommandBufferAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkResult result = fn->vkAllocateCommandBuffers(device, &allocate_info,
+                                                 &batch->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkFenceCreateInfo fence_create_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = fn->vkCreateFence(device, &fence_create_info, nullptr,
+                             &batch->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  batch->is_fence_init = true;
+
+  VkSemaphoreCreateInfo semaphore_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = fn->vkCreateSemaphore(device, &semaphore_create_info, nullptr,
+                                 &batch->semaphore);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  batch->is_semaphore_init = true;
+
+  if (has_timestamps) {
+    VkQueryPoolCreateInfo query_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = VULKAN_COMPUTE_QUERY_COUNT,
+        .pipelineStatistics = 0,
+    };
+    result = fn->vkCreateQueryPool(device, &query_create_info, nullptr,
+                                   &batch->query_pool);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    batch->is_query_pool_init = true;
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// waits for the last submission of the batch and hands its GPU span to the
+// profiler
+static Result(int, ErrorMessage)
+    vulkan_compute_batch_retire(VulkanComputeQueue* compute,
+                                VulkanComputeBatch* batch) {
+  if (!batch->is_fence_pending) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkResult result =
+      compute->fn->vkWaitForFences(compute->device, 1, &batch->fence, VK_TRUE,
+                                   UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  result = compute->fn->vkResetFences(compute->device, 1, &batch->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  batch->is_fence_pending = false;
+
+  if (!batch->has_timestamps) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  batch->has_timestamps = false;
+  uint64_t timestamps[VULKAN_COMPUTE_QUERY_COUNT];
+  result = compute->fn->vkGetQueryPoolResults(
+      compute->device, batch->query_pool, 0, VULKAN_COMPUTE_QUERY_COUNT,
+      sizeof(timestamps), timestamps, sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  vulkan_profiler_add_queue_scope(
+      compute->profiler, compute->is_async ? "async compute" : "compute",
+      batch->frame_number, timestamps[0] & compute->timestamp_mask,
+      timestamps[1] & compute->timestamp_mask);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_compute_queue_init(VulkanComputeQueue* compute,
+                              const VulkanDevice* vk_device,
+                              uint32_t frames_in_flight,
+                              bool allow_async,
+                              VulkanProfiler* profiler) {
+  if (frames_in_flight > VULKAN_MAX_FRAMES_IN_FLIGHT) {
+    return Err(int, ErrorMessage)("Unsupported number of frames in flight");
+  }
+
+  compute->device = vk_device->device;
+  compute->fn = &vk_device->fn;
+  compute->graphics_queue_family = vk_device->graphics_queue_family;
+  compute->is_async =
+      allow_async &&
+      vk_device->compute_queue_family != vk_device->graphics_queue_family;
+  compute->queue_family = compute->is_async ? vk_device->compute_queue_family
+                                            : vk_device->graphics_queue_family;
+  compute->queue =
+      compute->is_async ? vk_device->compute_queue : vk_device->graphics_queue;
+  compute->frame_count = frames_in_flight;
+  compute->current = nullptr;
+  compute->profiler = profiler;
+  compute->submit_count = 0;
+  compute->dispatch_count = 0;
+
+  uint32_t valid_bits =
+      vk_device->info.queue_families[compute->queue_family].timestampValidBits;
+  bool has_timestamps = profiler != nullptr && valid_bits > 0;
+  compute->timestamp_mask =
+      valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+  VkCommandPoolCreateInfo pool_create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+               VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = compute->queue_family,
+  };
+  VkResult result = compute->fn->vkCreateCommandPool(
+      compute->device, &pool_create_info, nullptr, &compute->command_pool);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  compute->is_command_pool_init = true;
+
+  for (uint32_t slot = 0; slot < frames_in_flight; slot++) {
+    auto batch_result = vulkan_compute_batch_init(
+        &compute->batches[slot], compute->fn, compute->device,
+        compute->command_pool, has_timestamps);
+    if (!batch_result.is_ok) {
+      return batch_result;
+    }
+  }
+
+  log_debug("Initialized compute on the %s queue family %u",
+            compute->is_async ? "async compute" : "graphics",
+            compute->queue_family);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_compute_queue_reset(VulkanComputeQueue* compute) {
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    VulkanComputeBatch* batch = &compute->batches[slot];
+    batch->state = VULKAN_COMPUTE_BATCH_STATE_IDLE;
+    batch->is_fence_pending = false;
+    batch->has_timestamps = false;
+    batch->is_fence_init = false;
+    batch->is_semaphore_init = false;
+    batch->is_query_pool_init = false;
+  }
+  compute->frame_count = 0;
+  compute->current = nullptr;
+  compute->profiler = nullptr;
+  compute->submit_count = 0;
+  compute->dispatch_count = 0;
+  compute->is_async = false;
+  compute->is_command_pool_init = false;
+}
+
+void vulkan_compute_queue_destroy(VulkanComputeQueue* compute) {
+  if (compute->submit_count > 0) {
+    log_debug("Submitted %llu compute batches with %llu dispatches",
+              (unsigned long long)compute->submit_count,
+              (unsigned long long)compute->dispatch_count);
+  }
+
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    VulkanComputeBatch* batch = &compute->batches[slot];
+    if (batch->is_query_pool_init) {
+      compute->fn->vkDestroyQueryPool(compute->device, batch->query_pool,
+                                      nullptr);
+    }
+    if (batch->is_semaphore_init) {
+      compute->fn->vkDestroySemaphore(compute->device, batch->semaphore,
+                                      nullptr);
+    }
+    if (batch->is_fence_init) {
+      compute->fn->vkDestroyFence(compute->device, batch->fence, nullptr);
+    }
+  }
+  // destroying the pool frees the batch command buffers
+  if (compute->is_command_pool_init) {
+    compute->fn->vkDestroyCommandPool(compute->device, compute->command_pool,
+                                      nullptr);
+  }
+  vulkan_compute_queue_reset(compute);
+}
+
+void vulkan_compute_queue_families(const VulkanComputeQueue* compute,
+                                   uint32_t families[2],
+                                   uint32_t* count) {
+  families[0] = compute->graphics_queue_family;
+  *count = 1;
+  if (compute->is_async) {
+    families[(*count)++] = compute->queue_family;
+  }
+}
+
+Result(int, ErrorMessage)
+    vulkan_compute_queue_begin(VulkanComputeQueue* compute,
+                               const VulkanFrame* frame,
+                               VkCommandBuffer* command_buffer) {
+  if (frame->slot >= compute->frame_count) {
+    return Err(int, ErrorMessage)("Frame slot out of range");
+  }
+  VulkanComputeBatch* batch = &compute->batches[frame->slot];
+  if (batch->state == VULKAN_COMPUTE_BATCH_STATE_RECORDING) {
+    return Err(int, ErrorMessage)("Compute batch is already recording");
+  }
+  // its semaphore would be signaled twice
+  if (batch->state == VULKAN_COMPUTE_BATCH_STATE_SUBMITTED) {
+    return Err(int, ErrorMessage)(
+        "Compute batch was submitted but never acquired");
+  }
+
+  // the graphics frame waited on the batch and its slot fence signaled, this
+  // does not block
+  auto retire_result = vulkan_compute_batch_retire(compute, batch);
+  if (!retire_result.is_ok) {
+    return retire_result;
+  }
+
+  // the pool resets command buffers individually, begin discards the old
+  // recording
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  VkResult result = compute->fn->vkBeginCommandBuffer(batch->command_buffer,
+                                                      &begin_info);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if (batch->is_query_pool_init) {
+    compute->fn->vkCmdResetQueryPool(batch->command_buffer, batch->query_pool,
+                                     0, VULKAN_COMPUTE_QUERY_COUNT);
+    compute->fn->vkCmdWriteTimestamp(batch->command_buffer,
+                                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                     batch->query_pool, 0);
+  }
+
+  batch->frame_number = frame->frame_number;
+  batch->bound_pipeline = VK_NULL_HANDLE;
+  batch->buffer_barrier_count = 0;
+  batch->image_barrier_count = 0;
+  batch->wait_stages = 0;
+  batch->state = VULKAN_COMPUTE_BATCH_STATE_RECORDING;
+  compute->current = batch;
+  *command_buffer = batch->command_buffer;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_compute_queue_dispatch(VulkanComputeQueue* compute,
+                                   const VulkanDispatch* dispatch) {
+  VulkanComputeBatch* batch = compute->current;
+  // consecutive dispatches of one pipeline only rebind their resources
+  if (batch->bound_pipeline != dispatch->pipeline) {
+    compute->fn->vkCmdBindPipeline(batch->command_buffer,
+                                   VK_PIPELINE_BIND_POINT_COMPUTE,
+                                   dispatch->pipeline);
+    batch->bound_pipeline = dispatch->pipeline;
+  }
+  if (dispatch->descriptor_set_count > 0) {
+    compute->fn->vkCmdBindDescriptorSets(
+        batch->command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, dispatch->layout,
+        0, dispatch->descriptor_set_count, dispatch->descriptor_sets, 0,
+        nullptr);
+  }
+  if (dispatch->push_constant_size > 0) {
+    compute->fn->vkCmdPushConstants(
+        batch->command_buffer, dispatch->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+        dispatch->push_constant_size, dispatch->push_constants);
+  }
+  compute->fn->vkCmdDispatch(batch->command_buffer, dispatch->group_count_x,
+                             dispatch->group_count_y, dispatch->group_count_z);
+  compute->dispatch_count++;
+}
+
+void vulkan_compute_queue_barrier(VulkanComputeQueue* compute) {
+  VkMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+  };
+  compute->fn->vkCmdPipelineBarrier(compute->current->command_buffer,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                    &barrier, 0, nullptr, 0, nullptr);
+}
+
+Result(int, ErrorMessage)
+    vulkan_compute_queue_release_buffer(VulkanComputeQueue* compute,
+                                        VkBuffer buffer,
+                                        VkDeviceSize offset,
+                                        VkDeviceSize size,
+                                        VkPipelineStageFlags dst_stage,
+                                        VkAccessFlags dst_access) {
+  VulkanComputeBatch* batch = compute->current;
+  batch->wait_stages |= dst_stage;
+  // on a shared family the semaphore wait alone makes the writes visible
+  if (!compute->is_async) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  if (batch->buffer_barrier_count == VULKAN_COMPUTE_MAX_BARRIERS) {
+    return Err(int, ErrorMessage)("Too many buffers released by compute");
+  }
+  // release ignores the destination access and acquire the source access,
+  // both sides record the same barrier
+  batch->buffer_barriers[batch->buffer_barrier_count++] =
+      (VkBufferMemoryBarrier){
+          .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+          .dstAccessMask = dst_access,
+          .srcQueueFamilyIndex = compute->queue_family,
+          .dstQueueFamilyIndex = compute->graphics_queue_family,
+          .buffer = buffer,
+          .offset = offset,
+          .size = size,
+      };
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_compute_queue_release_image(VulkanComputeQueue* compute,
+                                       VkImage image,
+                                       const VkImageSubresourceRange* range,
+                                       VkImageLayout old_layout,
+                                       VkImageLayout new_layout,
+                                       VkPipelineStageFlags dst_stage,
+                                       VkAccessFlags dst_access) {
+  VulkanComputeBatch* batch = compute->current;
+  if (batch->image_barrier_count == VULKAN_COMPUTE_MAX_BARRIERS) {
+    return Err(int, ErrorMessage)("Too many images released by compute");
+  }
+
+  uint32_t src_queue_family =
+      compute->is_async ? compute->queue_family : VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dst_queue_family = compute->is_async
+                                  ? compute->graphics_queue_family
+                                  : VK_QUEUE_FAMILY_IGNORED;
+  batch->image_barriers[batch->image_barrier_count++] = (VkImageMemoryBarrier){
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = dst_access,
+      .oldLayout = old_layout,
+      .newLayout = new_layout,
+      .srcQueueFamilyIndex = src_queue_family,
+      .dstQueueFamilyIndex = dst_queue_family,
+      .image = image,
+      .subresourceRange = *range,
+  };
+  batch->wait_stages |= dst_stage;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// A recording that failed to submit signals nothing and nothing waits on
+// it. The next begin records the command buffer again, which resets it.
+static void vulkan_compute_batch_drop(VulkanComputeQueue* compute,
+                                      VulkanComputeBatch* batch) {
+  batch->state = VULKAN_COMPUTE_BATCH_STATE_IDLE;
+  compute->current = nullptr;
+}
+
+Result(int, ErrorMessage) vulkan_compute_queue_submit(
+    VulkanComputeQueue* compute) {
+  VulkanComputeBatch* batch = compute->current;
+  if (!batch || batch->state != VULKAN_COMPUTE_BATCH_STATE_RECORDING) {
+    return Err(int, ErrorMessage)("No compute batch is recording");
+  }
+
+  if (compute->is_async) {
+    if (batch->buffer_barrier_count > 0 || batch->image_barrier_count > 0) {
+      compute->fn->vkCmdPipelineBarrier(
+          batch->command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+          batch->buffer_barrier_count, batch->buffer_barriers,
+          batch->image_barrier_count, batch->image_barriers);
+    }
+  } else if (batch->image_barrier_count > 0) {
+    // only the layout changes here, the semaphore wait covers the memory
+    // dependency and a bottom of pipe destination takes no access
+    for (uint32_t i = 0; i < batch->image_barrier_count; i++) {
+      batch->image_barriers[i].dstAccessMask = 0;
+    }
+    compute->fn->vkCmdPipelineBarrier(
+        batch->command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+        batch->image_barrier_count, batch->image_barriers);
+  }
+  if (batch->is_query_pool_init) {
+    compute->fn->vkCmdWriteTimestamp(batch->command_buffer,
+                                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                     batch->query_pool, 1);
+  }
+
+  VkResult result = compute->fn->vkEndCommandBuffer(batch->command_buffer);
+  if (result != VK_SUCCESS) {
+    vulkan_compute_batch_drop(compute, batch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = nullptr,
+      .pWaitDstStageMask = nullptr,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &batch->command_buffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &batch->semaphore,
+  };
+  result = compute->fn->vkQueueSubmit(compute->queue, 1, &submit_info,
+                                      batch->fence);
+  if (result != VK_SUCCESS) {
+    vulkan_compute_batch_drop(compute, batch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  batch->state = VULKAN_COMPUTE_BATCH_STATE_SUBMITTED;
+  batch->is_fence_pending = true;
+  batch->has_timestamps = batch->is_query_pool_init;
+  compute->submit_count++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_compute_queue_acquire(VulkanComputeQueue* compute,
+                                  VkCommandBuffer command_buffer,
+                                  VulkanComputeWait* wait) {
+  wait->has_wait = false;
+  VulkanComputeBatch* batch = compute->current;
+  if (!batch || batch->state != VULKAN_COMPUTE_BATCH_STATE_SUBMITTED) {
+    return;
+  }
+
+  VkPipelineStageFlags stages = batch->wait_stages
+                                    ? batch->wait_stages
+                                    : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  if (compute->is_async &&
+      (batch->buffer_barrier_count > 0 || batch->image_barrier_count > 0)) {
+    compute->fn->vkCmdPipelineBarrier(
+        command_buffer, stages, stages, 0, 0, nullptr,
+        batch->buffer_barrier_count, batch->buffer_barriers,
+        batch->image_barrier_count, batch->image_barriers);
+  }
+
+  wait->semaphore = batch->semaphore;
+  wait->stage = stages;
+  wait->has_wait = true;
+  batch->state = VULKAN_COMPUTE_BATCH_STATE_ACQUIRED;
+  compute->current = nullptr;
+}
+
+Result(int, ErrorMessage)
+    vulkan_compute_queue_collect(VulkanComputeQueue* compute) {
+  for (uint32_t slot = 0; slot < compute->frame_count; slot++) {
+    auto result = vulkan_compute_batch_retire(compute, &compute->batches[slot]);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+uint32_t vulkan_compute_group_count(uint32_t size, uint32_t local_size) {
+  return (size + local_size - 1) / local_size;
+}
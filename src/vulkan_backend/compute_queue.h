@@ -0,0 +1,163 @@
+#ifndef VULKAN_BACKEND_COMPUTE_QUEUE_H
+#define VULKAN_BACKEND_COMPUTE_QUEUE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+#include "./profiler.h"
+
+#define VULKAN_COMPUTE_MAX_DESCRIPTOR_SETS 4
+#define VULKAN_COMPUTE_MAX_BARRIERS 32
+
+typedef enum VulkanComputeBatchState {
+  VULKAN_COMPUTE_BATCH_STATE_IDLE,
+  VULKAN_COMPUTE_BATCH_STATE_RECORDING,
+  // submitted, the graphics submission of the frame has not waited on it yet
+  VULKAN_COMPUTE_BATCH_STATE_SUBMITTED,
+  // a graphics submission waits on the semaphore
+  VULKAN_COMPUTE_BATCH_STATE_ACQUIRED,
+} VulkanComputeBatchState;
+
+// One compute submission per frame slot
+typedef struct VulkanComputeBatch {
+  VkCommandBuffer command_buffer;
+  VkFence fence;
+  VkSemaphore semaphore;
+  // begin and end of the submission
+  VkQueryPool query_pool;
+  uint64_t frame_number;
+  VkPipeline bound_pipeline;
+  // release barriers of the queue family ownership transfers, recorded again
+  // on the graphics queue as the matching acquire
+  VkBufferMemoryBarrier buffer_barriers[VULKAN_COMPUTE_MAX_BARRIERS];
+  uint32_t buffer_barrier_count;
+  VkImageMemoryBarrier image_barriers[VULKAN_COMPUTE_MAX_BARRIERS];
+  uint32_t image_barrier_count;
+  // stages of the graphics queue that consume the released resources
+  VkPipelineStageFlags wait_stages;
+  VulkanComputeBatchState state;
+  // submitted since the fence was last waited on
+  bool is_fence_pending;
+  bool has_timestamps;
+  bool is_fence_init;
+  bool is_semaphore_init;
+  bool is_query_pool_init;
+} VulkanComputeBatch;
+
+typedef struct VulkanDispatch {
+  VkPipeline pipeline;
+  VkPipelineLayout layout;
+  VkDescriptorSet descriptor_sets[VULKAN_COMPUTE_MAX_DESCRIPTOR_SETS];
+  uint32_t descriptor_set_count;
+  // pushed at offset 0 for VK_SHADER_STAGE_COMPUTE_BIT, size 0 skips it
+  const void* push_constants;
+  uint32_t push_constant_size;
+  uint32_t group_count_x;
+  uint32_t group_count_y;
+  uint32_t group_count_z;
+} VulkanDispatch;
+
+// Semaphore the graphics submission of the frame waits on before it uses
+// compute results
+typedef struct VulkanComputeWait {
+  VkSemaphore semaphore;
+  VkPipelineStageFlags stage;
+  bool has_wait;
+} VulkanComputeWait;
+
+// Records compute work into its own submission per frame. On devices with a
+// compute family without graphics the work runs on that queue and overlaps
+// with graphics, otherwise it goes to the graphics queue ahead of the frame.
+// Either way the graphics submission of the frame waits on a semaphore, so
+// callers see the same ordering on both paths.
+//
+// Resources released to graphics from an async compute queue change queue
+// family ownership, they must be created VK_SHARING_MODE_EXCLUSIVE and their
+// contents are only kept through the release. Resources the compute queue
+// reads from graphics should be created VK_SHARING_MODE_CONCURRENT across
+// the families of vulkan_compute_queue_families(). Not thread safe.
+typedef struct VulkanComputeQueue {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VkQueue queue;
+  uint32_t queue_family;
+  uint32_t graphics_queue_family;
+  VkCommandPool command_pool;
+  VulkanComputeBatch batches[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_count;
+  VulkanComputeBatch* current;
+  // optional, receives the GPU span of every submission
+  VulkanProfiler* profiler;
+  uint64_t timestamp_mask;
+  uint64_t submit_count;
+  uint64_t dispatch_count;
+  bool is_async;
+  bool is_command_pool_init;
+} VulkanComputeQueue;
+
+// allow_async false keeps the work on the graphics queue even when the
+// device has an async compute family, profiler may be nullptr
+Result(int, ErrorMessage)
+    vulkan_compute_queue_init(VulkanComputeQueue* compute,
+                              const VulkanDevice* vk_device,
+                              uint32_t frames_in_flight,
+                              bool allow_async,
+                              VulkanProfiler* profiler);
+void vulkan_compute_queue_reset(VulkanComputeQueue* compute);
+void vulkan_compute_queue_destroy(VulkanComputeQueue* compute);
+
+// the queue families resources shared with the compute queue are created
+// with, count is 1 when compute runs on the graphics family
+void vulkan_compute_queue_families(const VulkanComputeQueue* compute,
+                                   uint32_t families[2],
+                                   uint32_t* count);
+
+// Begins the compute submission of frame, call after the frame scheduler
+// began the frame. The batch the slot submitted last must have been acquired.
+Result(int, ErrorMessage)
+    vulkan_compute_queue_begin(VulkanComputeQueue* compute,
+                               const VulkanFrame* frame,
+                               VkCommandBuffer* command_buffer);
+void vulkan_compute_queue_dispatch(VulkanComputeQueue* compute,
+                                   const VulkanDispatch* dispatch);
+// makes the shader writes of earlier dispatches visible to later ones
+void vulkan_compute_queue_barrier(VulkanComputeQueue* compute);
+// hands a buffer written by the recorded dispatches to graphics, dst_stage
+// and dst_access describe its first use there
+Result(int, ErrorMessage)
+    vulkan_compute_queue_release_buffer(VulkanComputeQueue* compute,
+                                        VkBuffer buffer,
+                                        VkDeviceSize offset,
+                                        VkDeviceSize size,
+                                        VkPipelineStageFlags dst_stage,
+                                        VkAccessFlags dst_access);
+// also moves the image from old_layout to new_layout
+Result(int, ErrorMessage)
+    vulkan_compute_queue_release_image(VulkanComputeQueue* compute,
+                                       VkImage image,
+                                       const VkImageSubresourceRange* range,
+                                       VkImageLayout old_layout,
+                                       VkImageLayout new_layout,
+                                       VkPipelineStageFlags dst_stage,
+                                       VkAccessFlags dst_access);
+// on failure the recording is dropped and the batch can begin again
+Result(int, ErrorMessage) vulkan_compute_queue_submit(
+    VulkanComputeQueue* compute);
+// Records the acquire barriers of the submitted batch into the graphics
+// command buffer of the frame, its submission has to wait on the returned
+// semaphore. Does nothing when no compute work was submitted this frame.
+void vulkan_compute_queue_acquire(VulkanComputeQueue* compute,
+                                  VkCommandBuffer command_buffer,
+                                  VulkanComputeWait* wait);
+
+// hands the GPU spans of every finished submission to the profiler, the
+// device must be idle
+Result(int, ErrorMessage)
+    vulkan_compute_queue_collect(VulkanComputeQueue* compute);
+
+uint32_t vulkan_compute_group_count(uint32_t size, uint32_t local_size);
+
+#endif
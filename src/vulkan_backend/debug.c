@@ -3,8 +3,8 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "../utils/arena.h"
 #include "../utils/logger.h"
-#include "../utils/memory.h"
 #include "./functions.h"
 
 const char* vulkan_result_to_string(VkResult result) {
@@ -150,17 +150,23 @@ bool vulkan_layers_requested_layers_in_available(
 }
 
 bool vulkan_layers_all_available(const char** names, uint32_t names_size) {
+  ArenaScratch scratch = arena_scratch_begin();
+  if (!scratch.arena) {
+    return false;
+  }
   uint32_t layers_size = 0;
   VkLayerProperties* available_layers =
-      vulkan_layers_get_available_validation_layers(&layers_size);
+      vulkan_layers_get_available_validation_layers(scratch.arena,
+                                                    &layers_size);
   bool success = vulkan_layers_requested_layers_in_available(
       names, names_size, available_layers, layers_size);
-  mem_free(available_layers);
+  arena_scratch_end(scratch);
 
   return success;
 }
 
 VkLayerProperties* vulkan_layers_get_available_validation_layers(
+    Arena* arena,
     uint32_t* layers_size) {
   *layers_size = 0;
   uint32_t count = 0;
@@ -176,18 +182,16 @@ VkLayerProperties* vulkan_layers_get_available_validation_layers(
   }
 
   VkLayerProperties* validation_layers =
-      mem_alloc(count * sizeof(VkLayerProperties));
-  r = vkEnumerateInstanceLayerProperties(&count, validation_layers);
-
+      arena_alloc_array(arena, count, sizeof(VkLayerProperties));
   if (!validation_layers) {
     log_error("Unable to allocate validation layers");
     return nullptr;
   }
 
-  if (r != VK_SUCCESS || count == 0) {
+  r = vkEnumerateInstanceLayerProperties(&count, validation_layers);
+  if ((r != VK_SUCCESS && r != VK_INCOMPLETE) || count == 0) {
     log_error("Unable to get validation layers: %s",
               vulkan_result_to_string(r));
-    mem_free(validation_layers);
     return nullptr;
   }
 
@@ -195,15 +199,67 @@ VkLayerProperties* vulkan_layers_get_available_validation_layers(
   return validation_layers;
 }
 
-VKAPI_ATTR VkBool32 VKAPI_CALL
-vulkan_debug_callback([[maybe_unused]] VkDebugReportFlagsEXT flags,
-                      [[maybe_unused]] VkDebugReportObjectTypeEXT objType,
-                      [[maybe_unused]] uint64_t obj,
-                      [[maybe_unused]] size_t location,
-                      [[maybe_unused]] int32_t code,
-                      const char* layer_prefix,
-                      const char* msg,
-                      [[maybe_unused]] void* userData) {
-  log_info("VALIDATION LAYER %s: %s", layer_prefix, msg);
-  return VK_FALSE;
+const char* vulkan_object_type_to_string(VkObjectType type) {
+  switch (type) {
+    case VK_OBJECT_TYPE_UNKNOWN:
+      return "no object";
+    case VK_OBJECT_TYPE_INSTANCE:
+      return "VkInstance";
+    case VK_OBJECT_TYPE_PHYSICAL_DEVICE:
+      return "VkPhysicalDevice";
+    case VK_OBJECT_TYPE_DEVICE:
+      return "VkDevice";
+    case VK_OBJECT_TYPE_QUEUE:
+      return "VkQueue";
+    case VK_OBJECT_TYPE_SEMAPHORE:
+      return "VkSemaphore";
+    case VK_OBJECT_TYPE_COMMAND_BUFFER:
+      return "VkCommandBuffer";
+    case VK_OBJECT_TYPE_FENCE:
+      return "VkFence";
+    case VK_OBJECT_TYPE_DEVICE_MEMORY:
+      return "VkDeviceMemory";
+    case VK_OBJECT_TYPE_BUFFER:
+      return "VkBuffer";
+    case VK_OBJECT_TYPE_IMAGE:
+      return "VkImage";
+    case VK_OBJECT_TYPE_EVENT:
+      return "VkEvent";
+    case VK_OBJECT_TYPE_QUERY_POOL:
+      return "VkQueryPool";
+    case VK_OBJECT_TYPE_BUFFER_VIEW:
+      return "VkBufferView";
+    case VK_OBJECT_TYPE_IMAGE_VIEW:
+      return "VkImageView";
+    case VK_OBJECT_TYPE_SHADER_MODULE:
+      return "VkShaderModule";
+    case VK_OBJECT_TYPE_PIPELINE_CACHE:
+      return "VkPipelineCache";
+    case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+      return "VkPipelineLayout";
+    case VK_OBJECT_TYPE_RENDER_PASS:
+      return "VkRenderPass";
+    case VK_OBJECT_TYPE_PIPELINE:
+      return "VkPipeline";
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+      return "VkDescriptorSetLayout";
+    case VK_OBJECT_TYPE_SAMPLER:
+      return "VkSampler";
+    case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+      return "VkDescriptorPool";
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET:
+      return "VkDescriptorSet";
+    case VK_OBJECT_TYPE_FRAMEBUFFER:
+      return "VkFramebuffer";
+    case VK_OBJECT_TYPE_COMMAND_POOL:
+      return "VkCommandPool";
+    case VK_OBJECT_TYPE_SURFACE_KHR:
+      return "VkSurfaceKHR";
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+      return "VkSwapchainKHR";
+    case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT:
+      return "VkDebugUtilsMessengerEXT";
+    default:
+      return "VkObjectType<Other>";
+  }
 }
@@ -0,0 +1,277 @@
+#include "./descriptor_allocator.h"
+
+#include "../utils/logger.h"
+#include "./debug.h"
+#include "./functions.h"
+
+typedef struct VulkanDescriptorRatio {
+  VkDescriptorType type;
+  // descriptors of the type per 2 sets
+  uint32_t per_two_sets;
+} VulkanDescriptorRatio;
+
+// typical mix of a material and a pass set, a pool that runs out of one type
+// early just chains the next pool a little sooner
+static const VulkanDescriptorRatio vulkan_descriptor_ratios[] = {
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 2},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2},
+    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1},
+};
+
+#define VULKAN_DESCRIPTOR_RATIO_COUNT                                      \
+  (sizeof(vulkan_descriptor_ratios) / sizeof(vulkan_descriptor_ratios[0]))
+
+static Result(int, ErrorMessage)
+    vulkan_descriptor_chain_grow(VulkanDescriptorAllocator* allocator,
+                                 VulkanDescriptorPoolChain* chain) {
+  if (chain->pool_count == VULKAN_DESCRIPTOR_MAX_POOLS) {
+    return Err(int, ErrorMessage)("Too many descriptor sets in one frame");
+  }
+
+  uint32_t max_sets = VULKAN_DESCRIPTOR_POOL_MIN_SETS << chain->pool_count;
+  if (max_sets > VULKAN_DESCRIPTOR_POOL_MAX_SETS) {
+    max_sets = VULKAN_DESCRIPTOR_POOL_MAX_SETS;
+  }
+  VkDescriptorPoolSize sizes[VULKAN_DESCRIPTOR_RATIO_COUNT];
+  for (uint32_t i = 0; i < VULKAN_DESCRIPTOR_RATIO_COUNT; i++) {
+    sizes[i] = (VkDescriptorPoolSize){
+        .type = vulkan_descriptor_ratios[i].type,
+        .descriptorCount =
+            max_sets * vulkan_descriptor_ratios[i].per_two_sets / 2,
+    };
+  }
+
+  VkDescriptorPoolCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .maxSets = max_sets,
+      .poolSizeCount = VULKAN_DESCRIPTOR_RATIO_COUNT,
+      .pPoolSizes = sizes,
+  };
+  VkResult result =
+      allocator->fn->vkCreateDescriptorPool(allocator->device, &create_info,
+                                            nullptr,
+                                            &chain->pools[chain->pool_count]);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  chain->pool_count++;
+  log_debug("Chained descriptor pool %u with %u sets", chain->pool_count,
+            max_sets);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_init(VulkanDescriptorAllocator* allocator,
+                                     const VulkanDevice* vk_device,
+                                     uint32_t frames_in_flight) {
+  allocator->device = vk_device->device;
+  allocator->fn = &vk_device->fn;
+  allocator->frame_count = frames_in_flight;
+  allocator->is_allocator_init = true;
+
+  // one pool per slot up front, the chains only grow under load
+  for (uint32_t i = 0; i < frames_in_flight; i++) {
+    auto result =
+        vulkan_descriptor_chain_grow(allocator, &allocator->chains[i]);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+  allocator->current = &allocator->chains[0];
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_descriptor_allocator_reset(VulkanDescriptorAllocator* allocator) {
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    allocator->chains[i].pool_count = 0;
+    allocator->chains[i].current = 0;
+  }
+  allocator->frame_count = 0;
+  allocator->current = nullptr;
+  allocator->set_count = 0;
+  allocator->peak_set_count = 0;
+  allocator->is_allocator_init = false;
+}
+
+void vulkan_descriptor_allocator_destroy(
+    VulkanDescriptorAllocator* allocator) {
+  if (!allocator->is_allocator_init) {
+    return;
+  }
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    VulkanDescriptorPoolChain* chain = &allocator->chains[i];
+    for (uint32_t j = 0; j < chain->pool_count; j++) {
+      allocator->fn->vkDestroyDescriptorPool(allocator->device, chain->pools[j],
+                                             nullptr);
+    }
+  }
+  vulkan_descriptor_allocator_reset(allocator);
+}
+
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_begin_frame(
+        VulkanDescriptorAllocator* allocator,
+        uint32_t slot) {
+  VulkanDescriptorPoolChain* chain = &allocator->chains[slot];
+  // only the pools that were allocated from have anything to reset
+  for (uint32_t i = 0; i <= chain->current && i < chain->pool_count; i++) {
+    VkResult result =
+        allocator->fn->vkResetDescriptorPool(allocator->device, chain->pools[i],
+                                             0);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+  }
+  chain->current = 0;
+  allocator->current = chain;
+  allocator->set_count = 0;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_allocate(VulkanDescriptorAllocator* allocator,
+                                         VkDescriptorSetLayout layout,
+                                         VkDescriptorSet* set) {
+  VulkanDescriptorPoolChain* chain = allocator->current;
+  for (;;) {
+    if (chain->current == chain->pool_count) {
+      auto grow_result = vulkan_descriptor_chain_grow(allocator, chain);
+      if (!grow_result.is_ok) {
+        return grow_result;
+      }
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = chain->pools[chain->current],
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+    VkResult result =
+        allocator->fn->vkAllocateDescriptorSets(allocator->device,
+                                                &allocate_info, set);
+    if (result == VK_SUCCESS) {
+      allocator->set_count++;
+      if (allocator->set_count > allocator->peak_set_count) {
+        allocator->peak_set_count = allocator->set_count;
+      }
+      return Ok(int, ErrorMessage)(0);
+    }
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+        result != VK_ERROR_FRAGMENTED_POOL) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    // a set too big for any pool ends once the chain is at its limit
+    chain->current++;
+  }
+}
+
+void vulkan_descriptor_allocator_log_stats(
+    const VulkanDescriptorAllocator* allocator) {
+  uint32_t pool_count = 0;
+  for (uint32_t i = 0; i < allocator->frame_count; i++) {
+    pool_count += allocator->chains[i].pool_count;
+  }
+  log_debug("Descriptor allocator: %u sets peak per frame, %u pools",
+            allocator->peak_set_count, pool_count);
+}
+
+void vulkan_descriptor_writer_init(VulkanDescriptorWriter* writer,
+                                   const VulkanDevice* vk_device) {
+  writer->device = vk_device->device;
+  writer->fn = &vk_device->fn;
+  vulkan_descriptor_writer_reset(writer);
+}
+
+void vulkan_descriptor_writer_reset(VulkanDescriptorWriter* writer) {
+  writer->write_count = 0;
+  writer->buffer_info_count = 0;
+  writer->image_info_count = 0;
+}
+
+static VkWriteDescriptorSet* vulkan_descriptor_writer_next(
+    VulkanDescriptorWriter* writer,
+    VkDescriptorSet set,
+    uint32_t binding,
+    uint32_t array_element,
+    VkDescriptorType type) {
+  if (writer->write_count == VULKAN_DESCRIPTOR_WRITER_MAX_WRITES) {
+    vulkan_descriptor_writer_flush(writer);
+  }
+  VkWriteDescriptorSet* write = &writer->writes[writer->write_count++];
+  *write = (VkWriteDescriptorSet){
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .pNext = nullptr,
+      .dstSet = set,
+      .dstBinding = binding,
+      .dstArrayElement = array_element,
+      .descriptorCount = 1,
+      .descriptorType = type,
+      .pImageInfo = nullptr,
+      .pBufferInfo = nullptr,
+      .pTexelBufferView = nullptr,
+  };
+  return write;
+}
+
+void vulkan_descriptor_writer_write_buffer(VulkanDescriptorWriter* writer,
+                                           VkDescriptorSet set,
+                                           uint32_t binding,
+                                           uint32_t array_element,
+                                           VkDescriptorType type,
+                                           VkBuffer buffer,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize range) {
+  VkWriteDescriptorSet* write =
+      vulkan_descriptor_writer_next(writer, set, binding, array_element, type);
+  VkDescriptorBufferInfo* info =
+      &writer->buffer_infos[writer->buffer_info_count++];
+  *info = (VkDescriptorBufferInfo){
+      .buffer = buffer,
+      .offset = offset,
+      .range = range,
+  };
+  write->pBufferInfo = info;
+}
+
+void vulkan_descriptor_writer_write_image(VulkanDescriptorWriter* writer,
+                                          VkDescriptorSet set,
+                                          uint32_t binding,
+                                          uint32_t array_element,
+                                          VkDescriptorType type,
+                                          VkImageView view,
+                                          VkSampler sampler,
+                                          VkImageLayout layout) {
+  VkWriteDescriptorSet* write =
+      vulkan_descriptor_writer_next(writer, set, binding, array_element, type);
+  VkDescriptorImageInfo* info =
+      &writer->image_infos[writer->image_info_count++];
+  *info = (VkDescriptorImageInfo){
+      .sampler = sampler,
+      .imageView = view,
+      .imageLayout = layout,
+  };
+  write->pImageInfo = info;
+}
+
+void vulkan_descriptor_writer_flush(VulkanDescriptorWriter* writer) {
+  if (writer->write_count > 0) {
+    writer->fn->vkUpdateDescriptorSets(writer->device, writer->write_count,
+                                       writer->writes, 0, nullptr);
+  }
+  vulkan_descriptor_writer_reset(writer);
+}
@@ -0,0 +1,100 @@
+#ifndef VULKAN_BACKEND_DESCRIPTOR_ALLOCATOR_H
+#define VULKAN_BACKEND_DESCRIPTOR_ALLOCATOR_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+
+// the first pool of a slot holds this many sets, every pool chained after it
+// twice as many up to VULKAN_DESCRIPTOR_POOL_MAX_SETS
+#define VULKAN_DESCRIPTOR_POOL_MIN_SETS 128
+#define VULKAN_DESCRIPTOR_POOL_MAX_SETS 4096
+#define VULKAN_DESCRIPTOR_MAX_POOLS 16
+#define VULKAN_DESCRIPTOR_WRITER_MAX_WRITES 64
+
+typedef struct VulkanDescriptorPoolChain {
+  VkDescriptorPool pools[VULKAN_DESCRIPTOR_MAX_POOLS];
+  uint32_t pool_count;
+  // pools before this one ran out of memory this frame
+  uint32_t current;
+} VulkanDescriptorPoolChain;
+
+// Per frame descriptor sets. Every frame slot owns a chain of pools created
+// without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, so drivers
+// allocate sets linearly, and a chain is reset as a whole when its slot comes
+// around again. A full pool chains a bigger one, the chain keeps its pools so
+// a warmed up frame never creates one. Not thread safe.
+typedef struct VulkanDescriptorAllocator {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanDescriptorPoolChain chains[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_count;
+  VulkanDescriptorPoolChain* current;
+  uint32_t set_count;
+  uint32_t peak_set_count;
+  bool is_allocator_init;
+} VulkanDescriptorAllocator;
+
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_init(VulkanDescriptorAllocator* allocator,
+                                     const VulkanDevice* vk_device,
+                                     uint32_t frames_in_flight);
+void vulkan_descriptor_allocator_reset(VulkanDescriptorAllocator* allocator);
+void vulkan_descriptor_allocator_destroy(
+    VulkanDescriptorAllocator* allocator);
+
+// resets the pools of slot, the slot fence must have signaled
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_begin_frame(
+        VulkanDescriptorAllocator* allocator,
+        uint32_t slot);
+// the set is valid until its slot begins again
+Result(int, ErrorMessage)
+    vulkan_descriptor_allocator_allocate(VulkanDescriptorAllocator* allocator,
+                                         VkDescriptorSetLayout layout,
+                                         VkDescriptorSet* set);
+
+void vulkan_descriptor_allocator_log_stats(
+    const VulkanDescriptorAllocator* allocator);
+
+// Collects descriptor writes and hands them to one vkUpdateDescriptorSets
+// call. The infos live inside the writer, it must not be copied between a
+// write and the flush.
+typedef struct VulkanDescriptorWriter {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VkWriteDescriptorSet writes[VULKAN_DESCRIPTOR_WRITER_MAX_WRITES];
+  VkDescriptorBufferInfo buffer_infos[VULKAN_DESCRIPTOR_WRITER_MAX_WRITES];
+  VkDescriptorImageInfo image_infos[VULKAN_DESCRIPTOR_WRITER_MAX_WRITES];
+  uint32_t write_count;
+  uint32_t buffer_info_count;
+  uint32_t image_info_count;
+} VulkanDescriptorWriter;
+
+void vulkan_descriptor_writer_init(VulkanDescriptorWriter* writer,
+                                   const VulkanDevice* vk_device);
+void vulkan_descriptor_writer_reset(VulkanDescriptorWriter* writer);
+
+// a full writer flushes before it takes the next write
+void vulkan_descriptor_writer_write_buffer(VulkanDescriptorWriter* writer,
+                                           VkDescriptorSet set,
+                                           uint32_t binding,
+                                           uint32_t array_element,
+                                           VkDescriptorType type,
+                                           VkBuffer buffer,
+                                           VkDeviceSize offset,
+                                           VkDeviceSize range);
+void vulkan_descriptor_writer_write_image(VulkanDescriptorWriter* writer,
+                                          VkDescriptorSet set,
+                                          uint32_t binding,
+                                          uint32_t array_element,
+                                          VkDescriptorType type,
+                                          VkImageView view,
+                                          VkSampler sampler,
+                                          VkImageLayout layout);
+void vulkan_descriptor_writer_flush(VulkanDescriptorWriter* writer);
+
+#endif
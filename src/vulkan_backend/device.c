@@ -0,0 +1,204 @@
+#include "./device.h"
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./function_loader.h"
+#include "./functions.h"
+
+Result(int, ErrorMessage)
+    vulkan_device_init(VulkanDevice* vk_device,
+                       const VulkanInstanceFunctions* instance_fn,
+                       VkInstance instance,
+                       VkSurfaceKHR surface) {
+  vk_device->instance_fn = instance_fn;
+  vk_device->enabled_extension_count = 0;
+  if (surface != VK_NULL_HANDLE) {
+    vk_device->enabled_extensions[vk_device->enabled_extension_count++] =
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+  }
+  // optional extensions are appended after the required ones
+  vk_device->required_extension_count = vk_device->enabled_extension_count;
+
+  auto select_result = vulkan_physical_device_select(
+      instance_fn, instance, surface, vk_device->enabled_extension_count,
+      vk_device->enabled_extensions, &vk_device->info);
+  if (!select_result.is_ok) {
+    return select_result;
+  }
+  log_info("Physical device: %s", vk_device->info.properties.deviceName);
+  vk_device->graphics_queue_family = vk_device->info.graphics_queue_family;
+  vk_device->transfer_queue_family = vk_device->info.transfer_queue_family;
+  vk_device->compute_queue_family = vk_device->info.compute_queue_family;
+  if (vulkan_physical_device_supports_extension(
+          &vk_device->info, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    vk_device->enabled_extensions[vk_device->enabled_extension_count++] =
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+  }
+
+  const float queue_priority = 1.0f;
+  VkDeviceQueueCreateInfo queue_create_infos[VULKAN_DEVICE_MAX_QUEUE_FAMILIES];
+  uint32_t queue_create_info_count = 0;
+  queue_create_infos[queue_create_info_count++] = (VkDeviceQueueCreateInfo){
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queueFamilyIndex = vk_device->graphics_queue_family,
+      .queueCount = 1,
+      .pQueuePriorities = &queue_priority,
+  };
+  if (vk_device->transfer_queue_family != vk_device->graphics_queue_family) {
+    queue_create_infos[queue_create_info_count++] = (VkDeviceQueueCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queueFamilyIndex = vk_device->transfer_queue_family,
+        .queueCount = 1,
+        .pQueuePriorities = &queue_priority,
+    };
+  }
+  // without a pure transfer family the uploader falls back to the compute
+  // family, both then share its only queue
+  if (vk_device->compute_queue_family != vk_device->graphics_queue_family &&
+      vk_device->compute_queue_family != vk_device->transfer_queue_family) {
+    queue_create_infos[queue_create_info_count++] = (VkDeviceQueueCreateInfo){
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queueFamilyIndex = vk_device->compute_queue_family,
+        .queueCount = 1,
+        .pQueuePriorities = &queue_priority,
+    };
+  }
+
+  // only what the backend uses is enabled, on 1.2 devices that have it
+  VkPhysicalDeviceVulkan12Features features12 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = nullptr,
+  };
+  vk_device->has_bindless =
+      vulkan_physical_device_supports_bindless(&vk_device->info);
+  if (vk_device->has_bindless) {
+    features12.descriptorIndexing = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features12.shaderStorageBufferArrayNonUniformIndexing =
+        vk_device->info.features12.shaderStorageBufferArrayNonUniformIndexing;
+  }
+  bool has_features12 =
+      vk_device->info.properties.apiVersion >= VK_API_VERSION_1_2;
+  // GPU driven rendering writes one indirect command per object, the object
+  // index goes into firstInstance
+  const VkPhysicalDeviceFeatures* supported = &vk_device->info.features;
+  VkPhysicalDeviceFeatures features = {0};
+  if (supported->multiDrawIndirect && supported->drawIndirectFirstInstance) {
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+  }
+
+  VkDeviceCreateInfo device_create_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = has_features12 ? &features12 : nullptr,
+      .flags = 0,
+      .queueCreateInfoCount = queue_create_info_count,
+      .pQueueCreateInfos = queue_create_infos,
+      .enabledLayerCount = 0,
+      .ppEnabledLayerNames = nullptr,
+      .enabledExtensionCount = vk_device->enabled_extension_count,
+      .ppEnabledExtensionNames = vk_device->enabled_extensions,
+      .pEnabledFeatures = &features,
+  };
+
+  VkResult result = instance_fn->vkCreateDevice(
+      vk_device->info.physical_device, &device_create_info, nullptr,
+      &vk_device->device);
+  if (result != VK_SUCCESS || vk_device->device == VK_NULL_HANDLE) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  vk_device->is_device_init = true;
+
+  auto load_result = vulkan_load_device_functions(
+      &vk_device->fn, instance_fn, vk_device->device,
+      vk_device->enabled_extensions, vk_device->enabled_extension_count,
+      vk_device->required_extension_count, &vk_device->function_stats);
+  if (!load_result.is_ok) {
+    return load_result;
+  }
+  vk_device->has_multi_draw_indirect = features.multiDrawIndirect;
+  // the loader drops the extension when the driver lacks the entry point
+  vk_device->has_draw_indirect_count =
+      vk_device->fn.vkCmdDrawIndexedIndirectCountKHR != nullptr;
+
+  vk_device->fn.vkGetDeviceQueue(vk_device->device,
+                                 vk_device->graphics_queue_family, 0,
+                                 &vk_device->graphics_queue);
+  vk_device->fn.vkGetDeviceQueue(vk_device->device,
+                                 vk_device->transfer_queue_family, 0,
+                                 &vk_device->transfer_queue);
+  vk_device->fn.vkGetDeviceQueue(vk_device->device,
+                                 vk_device->compute_queue_family, 0,
+                                 &vk_device->compute_queue);
+  if (vk_device->transfer_queue_family != vk_device->graphics_queue_family) {
+    log_debug("Using dedicated transfer queue family %u",
+              vk_device->transfer_queue_family);
+  }
+  if (vk_device->compute_queue_family != vk_device->graphics_queue_family) {
+    log_debug("Using async compute queue family %u",
+              vk_device->compute_queue_family);
+  }
+  if (vk_device->has_bindless) {
+    log_debug("Descriptor indexing available for bindless resources");
+  }
+  if (vk_device->has_draw_indirect_count) {
+    log_debug("Indirect draw counts are read from GPU buffers");
+  }
+  log_debug("Initialized Vulkan device");
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_device_reset(VulkanDevice* vk_device) {
+  vulkan_physical_device_info_reset(&vk_device->info);
+  vk_device->device = VK_NULL_HANDLE;
+  vk_device->instance_fn = nullptr;
+  vk_device->fn = (VulkanDeviceFunctions){0};
+  vk_device->graphics_queue = VK_NULL_HANDLE;
+  vk_device->transfer_queue = VK_NULL_HANDLE;
+  vk_device->compute_queue = VK_NULL_HANDLE;
+  vk_device->enabled_extension_count = 0;
+  vk_device->required_extension_count = 0;
+  vk_device->function_stats = (VulkanFunctionLoadStats){0};
+  vk_device->has_bindless = false;
+  vk_device->has_multi_draw_indirect = false;
+  vk_device->has_draw_indirect_count = false;
+  vk_device->is_device_init = false;
+}
+
+void vulkan_device_destroy(VulkanDevice* vk_device) {
+  if (vk_device->is_device_init) {
+    vk_device->fn.vkDestroyDevice(vk_device->device, nullptr);
+  }
+  vulkan_physical_device_info_destroy(&vk_device->info);
+  vulkan_device_reset(vk_device);
+}
+
+bool vulkan_device_find_memory_type(const VulkanDevice* vk_device,
+                                    uint32_t memory_type_bits,
+                                    VkMemoryPropertyFlags properties,
+                                    uint32_t* memory_type_index) {
+  const VkPhysicalDeviceMemoryProperties* memory_properties =
+      &vk_device->info.memory_properties;
+  for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+    if ((memory_type_bits & (1u << i)) &&
+        (memory_properties->memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      *memory_type_index = i;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,64 @@
+#ifndef VULKAN_BACKEND_DEVICE_H
+#define VULKAN_BACKEND_DEVICE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./function_loader.h"
+#include "./functions.h"
+#include "./physical_device.h"
+
+#define VULKAN_DEVICE_MAX_EXTENSIONS 8
+#define VULKAN_DEVICE_MAX_QUEUE_FAMILIES 3
+
+// Subsystems keep a pointer to fn and call through it, so several devices
+// can be driven at once
+typedef struct VulkanDevice {
+  VulkanPhysicalDeviceInfo info;
+  VkDevice device;
+  // functions of the instance the device was created from
+  const VulkanInstanceFunctions* instance_fn;
+  VulkanDeviceFunctions fn;
+  uint32_t graphics_queue_family;
+  VkQueue graphics_queue;
+  // same as the graphics family and queue when there is no dedicated
+  // transfer family
+  uint32_t transfer_queue_family;
+  VkQueue transfer_queue;
+  // same as the graphics family and queue when there is no family with
+  // compute but without graphics
+  uint32_t compute_queue_family;
+  VkQueue compute_queue;
+  // the first required_extension_count are required, the others are
+  // optional ones the adapter supports
+  const char* enabled_extensions[VULKAN_DEVICE_MAX_EXTENSIONS];
+  uint32_t enabled_extension_count;
+  uint32_t required_extension_count;
+  VulkanFunctionLoadStats function_stats;
+  // the descriptor indexing features of a bindless table are enabled
+  bool has_bindless;
+  // multiDrawIndirect and drawIndirectFirstInstance are enabled
+  bool has_multi_draw_indirect;
+  // vkCmdDrawIndexedIndirectCountKHR is loaded
+  bool has_draw_indirect_count;
+  bool is_device_init;
+} VulkanDevice;
+
+// surface may be VK_NULL_HANDLE, the device is then created without any
+// presentation support (headless rendering). instance_fn must outlive the
+// device.
+Result(int, ErrorMessage)
+    vulkan_device_init(VulkanDevice* vk_device,
+                       const VulkanInstanceFunctions* instance_fn,
+                       VkInstance instance,
+                       VkSurfaceKHR surface);
+void vulkan_device_reset(VulkanDevice* vk_device);
+void vulkan_device_destroy(VulkanDevice* vk_device);
+
+bool vulkan_device_find_memory_type(const VulkanDevice* vk_device,
+                                    uint32_t memory_type_bits,
+                                    VkMemoryPropertyFlags properties,
+                                    uint32_t* memory_type_index);
+
+#endif
@@ -0,0 +1,319 @@
+#include "./diagnostics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utils/arena.h"
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+
+#define VULKAN_DIAGNOSTICS_SLOT_COUNT (VULKAN_DIAGNOSTICS_MAX_ENTRIES * 2)
+#define VULKAN_DIAGNOSTICS_INITIAL_ENTRIES 32
+
+static uint32_t vulkan_diagnostics_slot(int32_t message_id,
+                                        VkObjectType object_type) {
+  uint64_t hash = HASH_FNV1A64_SEED;
+  HASH_VALUE(hash, message_id);
+  HASH_VALUE(hash, object_type);
+  return (uint32_t)hash & (VULKAN_DIAGNOSTICS_SLOT_COUNT - 1);
+}
+
+// nullptr once the table is full
+static VulkanValidationEntry* vulkan_diagnostics_find(
+    VulkanDiagnostics* diag,
+    const VkDebugUtilsMessengerCallbackDataEXT* data,
+    VkObjectType object_type,
+    bool* is_new) {
+  *is_new = false;
+  uint32_t slot = vulkan_diagnostics_slot(data->messageIdNumber, object_type);
+  while (diag->slots[slot] != 0) {
+    VulkanValidationEntry* entry = &diag->entries[diag->slots[slot] - 1];
+    if (entry->message_id == data->messageIdNumber &&
+        entry->object_type == object_type) {
+      return entry;
+    }
+    slot = (slot + 1) & (VULKAN_DIAGNOSTICS_SLOT_COUNT - 1);
+  }
+
+  if (diag->entry_count == VULKAN_DIAGNOSTICS_MAX_ENTRIES) {
+    return nullptr;
+  }
+  if (diag->entry_count == diag->entry_capacity) {
+    uint32_t capacity = diag->entry_capacity > 0
+                            ? diag->entry_capacity * 2
+                            : VULKAN_DIAGNOSTICS_INITIAL_ENTRIES;
+    VulkanValidationEntry* entries = mem_realloc(
+        diag->entries, sizeof(VulkanValidationEntry) * capacity);
+    if (!entries) {
+      return nullptr;
+    }
+    diag->entries = entries;
+    diag->entry_capacity = capacity;
+  }
+
+  VulkanValidationEntry* entry = &diag->entries[diag->entry_count++];
+  diag->slots[slot] = diag->entry_count;
+  *entry = (VulkanValidationEntry){
+      .message_id = data->messageIdNumber,
+      .object_type = object_type,
+  };
+  SDL_strlcpy(entry->id_name,
+              data->pMessageIdName ? data->pMessageIdName : "(no id)",
+              sizeof(entry->id_name));
+  SDL_strlcpy(entry->message, data->pMessage ? data->pMessage : "",
+              sizeof(entry->message));
+  *is_new = true;
+  return entry;
+}
+
+static void vulkan_validation_entry_add_object(VulkanValidationEntry* entry,
+                                               uint64_t object) {
+  for (uint32_t i = 0; i < entry->object_count; i++) {
+    if (entry->objects[i] == object) {
+      return;
+    }
+  }
+  if (entry->object_count == VULKAN_DIAGNOSTICS_MAX_OBJECTS) {
+    entry->has_more_objects = true;
+    return;
+  }
+  entry->objects[entry->object_count++] = object;
+}
+
+static bool vulkan_diagnostics_is_power_of_ten(uint64_t count) {
+  if (count < 10) {
+    return false;
+  }
+  while (count % 10 == 0) {
+    count /= 10;
+  }
+  return count == 1;
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL vulkan_diagnostics_callback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+    [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT types,
+    const VkDebugUtilsMessengerCallbackDataEXT* data,
+    void* user_data) {
+  VulkanDiagnostics* diag = user_data;
+  VkObjectType object_type = data->objectCount > 0
+                                 ? data->pObjects[0].objectType
+                                 : VK_OBJECT_TYPE_UNKNOWN;
+
+  SDL_LockMutex(diag->mutex);
+  diag->message_count++;
+  diag->frame_message_count++;
+  bool is_new = false;
+  VulkanValidationEntry* entry =
+      vulkan_diagnostics_find(diag, data, object_type, &is_new);
+  if (!entry) {
+    diag->overflow_count++;
+    SDL_UnlockMutex(diag->mutex);
+    return VK_FALSE;
+  }
+
+  if (severity > entry->severity) {
+    entry->severity = severity;
+  }
+  entry->count++;
+  entry->frame_count++;
+  for (uint32_t i = 0; i < data->objectCount; i++) {
+    vulkan_validation_entry_add_object(entry, data->pObjects[i].objectHandle);
+  }
+
+  // the logger copies the strings, logging under the lock is cheap
+  const char* type_name = vulkan_object_type_to_string(object_type);
+  if (is_new && severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+    log_error("Validation %s on %s: %s", entry->id_name, type_name,
+              data->pMessage);
+  } else if (is_new &&
+             severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+    log_warning("Validation %s on %s: %s", entry->id_name, type_name,
+                data->pMessage);
+  } else if (is_new) {
+    log_info("Validation %s on %s: %s", entry->id_name, type_name,
+             data->pMessage);
+  } else if (vulkan_diagnostics_is_power_of_ten(entry->count)) {
+    log_warning("Validation %s on %s seen %llu times", entry->id_name,
+                type_name, (unsigned long long)entry->count);
+  }
+  SDL_UnlockMutex(diag->mutex);
+  return VK_FALSE;
+}
+
+Result(int, ErrorMessage) vulkan_diagnostics_init(VulkanDiagnostics* diag) {
+  vulkan_diagnostics_reset(diag);
+  diag->slots = mem_alloc(sizeof(uint32_t) * VULKAN_DIAGNOSTICS_SLOT_COUNT);
+  CHECK_ALLOC(diag->slots,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for validation messages"));
+  memset(diag->slots, 0, sizeof(uint32_t) * VULKAN_DIAGNOSTICS_SLOT_COUNT);
+  diag->is_diagnostics_init = true;
+
+  diag->mutex = SDL_CreateMutex();
+  if (!diag->mutex) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_diagnostics_reset(VulkanDiagnostics* diag) {
+  diag->instance = VK_NULL_HANDLE;
+  diag->fn = nullptr;
+  diag->messenger = VK_NULL_HANDLE;
+  diag->entries = nullptr;
+  diag->entry_count = 0;
+  diag->entry_capacity = 0;
+  diag->slots = nullptr;
+  diag->message_count = 0;
+  diag->overflow_count = 0;
+  diag->frame_message_count = 0;
+  diag->peak_frame_message_count = 0;
+  diag->frame_number = 0;
+  diag->mutex = nullptr;
+  diag->is_messenger_init = false;
+  diag->is_diagnostics_init = false;
+}
+
+void vulkan_diagnostics_destroy(VulkanDiagnostics* diag) {
+  if (!diag->is_diagnostics_init) {
+    return;
+  }
+  vulkan_diagnostics_detach(diag);
+  vulkan_diagnostics_log_summary(diag);
+  if (diag->mutex) {
+    SDL_DestroyMutex(diag->mutex);
+  }
+  mem_free(diag->entries);
+  mem_free(diag->slots);
+  vulkan_diagnostics_reset(diag);
+}
+
+VkDebugUtilsMessengerCreateInfoEXT vulkan_diagnostics_messenger_info(
+    VulkanDiagnostics* diag) {
+  return (VkDebugUtilsMessengerCreateInfoEXT){
+      .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+      .pNext = nullptr,
+      .flags = 0,
+      .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+                         VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                         VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+      .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                     VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                     VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+      .pfnUserCallback = vulkan_diagnostics_callback,
+      .pUserData = diag,
+  };
+}
+
+Result(int, ErrorMessage)
+    vulkan_diagnostics_attach(VulkanDiagnostics* diag,
+                              const VulkanInstanceFunctions* fn,
+                              VkInstance instance) {
+  if (!fn->vkCreateDebugUtilsMessengerEXT) {
+    return Err(int, ErrorMessage)("VK_EXT_debug_utils is not loaded");
+  }
+  diag->instance = instance;
+  diag->fn = fn;
+  VkDebugUtilsMessengerCreateInfoEXT create_info =
+      vulkan_diagnostics_messenger_info(diag);
+  VkResult result = fn->vkCreateDebugUtilsMessengerEXT(
+      instance, &create_info, nullptr, &diag->messenger);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  diag->is_messenger_init = true;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_diagnostics_detach(VulkanDiagnostics* diag) {
+  if (diag->is_messenger_init) {
+    diag->fn->vkDestroyDebugUtilsMessengerEXT(diag->instance, diag->messenger,
+                                              nullptr);
+    diag->messenger = VK_NULL_HANDLE;
+    diag->is_messenger_init = false;
+  }
+}
+
+void vulkan_diagnostics_end_frame(VulkanDiagnostics* diag) {
+  if (!diag->is_diagnostics_init) {
+    return;
+  }
+  SDL_LockMutex(diag->mutex);
+  if (diag->frame_message_count > 0) {
+    for (uint32_t i = 0; i < diag->entry_count; i++) {
+      VulkanValidationEntry* entry = &diag->entries[i];
+      if (entry->frame_count == 0) {
+        continue;
+      }
+      entry->frames_seen++;
+      if (entry->frame_count > entry->peak_frame_count) {
+        entry->peak_frame_count = entry->frame_count;
+      }
+      entry->frame_count = 0;
+    }
+    if (diag->frame_message_count > diag->peak_frame_message_count) {
+      diag->peak_frame_message_count = diag->frame_message_count;
+    }
+    diag->frame_message_count = 0;
+  }
+  diag->frame_number++;
+  SDL_UnlockMutex(diag->mutex);
+}
+
+static int vulkan_validation_entry_compare(const void* a, const void* b) {
+  const VulkanValidationEntry* entry_a = *(const VulkanValidationEntry**)a;
+  const VulkanValidationEntry* entry_b = *(const VulkanValidationEntry**)b;
+  if (entry_a->count != entry_b->count) {
+    return entry_a->count > entry_b->count ? -1 : 1;
+  }
+  return entry_b->severity - entry_a->severity;
+}
+
+void vulkan_diagnostics_log_summary(VulkanDiagnostics* diag) {
+  SDL_LockMutex(diag->mutex);
+  if (diag->message_count == 0) {
+    SDL_UnlockMutex(diag->mutex);
+    return;
+  }
+  log_warning(
+      "Validation: %llu messages of %u kinds over %llu frames, at most %u in "
+      "one frame",
+      (unsigned long long)diag->message_count, diag->entry_count,
+      (unsigned long long)diag->frame_number, diag->peak_frame_message_count);
+  if (diag->overflow_count > 0) {
+    log_warning("Validation: %llu messages of kinds past the first %u",
+                (unsigned long long)diag->overflow_count,
+                VULKAN_DIAGNOSTICS_MAX_ENTRIES);
+  }
+
+  ArenaScratch scratch = arena_scratch_begin();
+  const VulkanValidationEntry** ranked =
+      scratch.arena ? arena_alloc_array(scratch.arena, diag->entry_count,
+                                        sizeof(VulkanValidationEntry*))
+                    : nullptr;
+  if (ranked) {
+    for (uint32_t i = 0; i < diag->entry_count; i++) {
+      ranked[i] = &diag->entries[i];
+    }
+    qsort(ranked, diag->entry_count, sizeof(VulkanValidationEntry*),
+          vulkan_validation_entry_compare);
+    uint32_t count = SDL_min(diag->entry_count,
+                             (uint32_t)VULKAN_DIAGNOSTICS_SUMMARY_COUNT);
+    for (uint32_t i = 0; i < count; i++) {
+      const VulkanValidationEntry* entry = ranked[i];
+      log_warning(
+          "  %8llu x %s (0x%08x) on %s, %u frames, at most %u per frame, "
+          "%u%s objects",
+          (unsigned long long)entry->count, entry->id_name,
+          (uint32_t)entry->message_id,
+          vulkan_object_type_to_string(entry->object_type),
+          entry->frames_seen, entry->peak_frame_count, entry->object_count,
+          entry->has_more_objects ? "+" : "");
+    }
+  }
+  arena_scratch_end(scratch);
+  SDL_UnlockMutex(diag->mutex);
+}
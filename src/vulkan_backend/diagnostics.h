@@ -0,0 +1,85 @@
+#ifndef VULKAN_BACKEND_DIAGNOSTICS_H
+#define VULKAN_BACKEND_DIAGNOSTICS_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./functions.h"
+
+// distinct (message id, object type) pairs, power of two
+#define VULKAN_DIAGNOSTICS_MAX_ENTRIES 512
+// distinct objects remembered per entry, more are only counted as more
+#define VULKAN_DIAGNOSTICS_MAX_OBJECTS 8
+#define VULKAN_DIAGNOSTICS_ID_NAME_SIZE 96
+#define VULKAN_DIAGNOSTICS_MESSAGE_SIZE 512
+// entries listed by the shutdown summary
+#define VULKAN_DIAGNOSTICS_SUMMARY_COUNT 20
+
+typedef struct VulkanValidationEntry {
+  int32_t message_id;
+  // type of the first object the message names
+  VkObjectType object_type;
+  VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+  uint64_t count;
+  uint32_t frame_count;
+  uint32_t peak_frame_count;
+  // frames with at least one occurrence
+  uint32_t frames_seen;
+  uint64_t objects[VULKAN_DIAGNOSTICS_MAX_OBJECTS];
+  uint32_t object_count;
+  bool has_more_objects;
+  char id_name[VULKAN_DIAGNOSTICS_ID_NAME_SIZE];
+  // text of the first occurrence
+  char message[VULKAN_DIAGNOSTICS_MESSAGE_SIZE];
+} VulkanValidationEntry;
+
+// Aggregates VK_EXT_debug_utils messages by (message id, object type). The
+// first occurrence of a pair is logged in full, repeats are only counted and
+// logged again each time their count reaches a power of ten. Counts are kept
+// per frame and in total, destroy logs the pairs ranked by count.
+//
+// The callback may run on any thread that calls into Vulkan, the table is
+// guarded by a mutex.
+typedef struct VulkanDiagnostics {
+  VkInstance instance;
+  const VulkanInstanceFunctions* fn;
+  VkDebugUtilsMessengerEXT messenger;
+  VulkanValidationEntry* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  // entry index + 1 by key, 0 marks a free slot
+  uint32_t* slots;
+  uint64_t message_count;
+  // messages of pairs that no longer fit the table
+  uint64_t overflow_count;
+  uint32_t frame_message_count;
+  uint32_t peak_frame_message_count;
+  uint64_t frame_number;
+  SDL_mutex* mutex;
+  bool is_messenger_init;
+  bool is_diagnostics_init;
+} VulkanDiagnostics;
+
+// runs before the instance exists so messenger_info can be chained into
+// VkInstanceCreateInfo, which covers instance creation and destruction
+Result(int, ErrorMessage) vulkan_diagnostics_init(VulkanDiagnostics* diag);
+void vulkan_diagnostics_reset(VulkanDiagnostics* diag);
+// logs the summary, the instance must already be destroyed
+void vulkan_diagnostics_destroy(VulkanDiagnostics* diag);
+
+VkDebugUtilsMessengerCreateInfoEXT vulkan_diagnostics_messenger_info(
+    VulkanDiagnostics* diag);
+// fn must have VK_EXT_debug_utils loaded and outlive the messenger
+Result(int, ErrorMessage)
+    vulkan_diagnostics_attach(VulkanDiagnostics* diag,
+                              const VulkanInstanceFunctions* fn,
+                              VkInstance instance);
+// destroys the messenger, must run before the instance is destroyed
+void vulkan_diagnostics_detach(VulkanDiagnostics* diag);
+
+void vulkan_diagnostics_end_frame(VulkanDiagnostics* diag);
+void vulkan_diagnostics_log_summary(VulkanDiagnostics* diag);
+
+#endif
@@ -0,0 +1,239 @@
+#include "./frame_scheduler.h"
+
+#include "../utils/logger.h"
+#include "./debug.h"
+#include "./functions.h"
+
+static Result(int, ErrorMessage)
+    vulkan_frame_init(VulkanFrame* frame,
+                      const VulkanDevice* vk_device,
+                      uint32_t slot) {
+  VkDevice device = vk_device->device;
+  const VulkanDeviceFunctions* fn = &vk_device->fn;
+  frame->slot = slot;
+  frame->frame_number = 0;
+
+  VkCommandPoolCreateInfo pool_create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = vk_device->graphics_queue_family,
+  };
+  VkResult result = fn->vkCreateCommandPool(device, &pool_create_info, nullptr,
+                                            &frame->command_pool);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  frame->is_command_pool_init = true;
+
+  VkCommandBufferAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = frame->command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  result = fn->vkAllocateCommandBuffers(device, &allocate_info,
+                                        &frame->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  // created signaled so the first wait on every slot returns immediately
+  VkFenceCreateInfo fence_create_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+  };
+  result = fn->vkCreateFence(device, &fence_create_info, nullptr,
+                             &frame->in_flight_fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  frame->is_fence_init = true;
+
+  VkSemaphoreCreateInfo semaphore_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = fn->vkCreateSemaphore(device, &semaphore_create_info, nullptr,
+                                 &frame->image_available);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  frame->is_image_available_init = true;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_frame_reset(VulkanFrame* frame) {
+  frame->is_command_pool_init = false;
+  frame->is_fence_init = false;
+  frame->is_image_available_init = false;
+}
+
+static void vulkan_frame_destroy(VulkanFrame* frame,
+                                 const VulkanDeviceFunctions* fn,
+                                 VkDevice device) {
+  if (frame->is_image_available_init) {
+    fn->vkDestroySemaphore(device, frame->image_available, nullptr);
+  }
+  if (frame->is_fence_init) {
+    fn->vkDestroyFence(device, frame->in_flight_fence, nullptr);
+  }
+  if (frame->is_command_pool_init) {
+    fn->vkDestroyCommandPool(device, frame->command_pool, nullptr);
+  }
+  vulkan_frame_reset(frame);
+}
+
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_init(VulkanFrameScheduler* scheduler,
+                                const VulkanDevice* vk_device,
+                                uint32_t frames_in_flight) {
+  if (frames_in_flight < VULKAN_MIN_FRAMES_IN_FLIGHT ||
+      frames_in_flight > VULKAN_MAX_FRAMES_IN_FLIGHT) {
+    return Err(int, ErrorMessage)("Unsupported number of frames in flight");
+  }
+
+  scheduler->device = vk_device->device;
+  scheduler->fn = &vk_device->fn;
+  scheduler->queue = vk_device->graphics_queue;
+  scheduler->frame_count = frames_in_flight;
+  scheduler->current_slot = 0;
+  scheduler->frame_number = 0;
+  scheduler->is_recording = false;
+
+  for (uint32_t i = 0; i < frames_in_flight; i++) {
+    auto result = vulkan_frame_init(&scheduler->frames[i], vk_device, i);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+  log_debug("Initialized frame scheduler with %u frames in flight",
+            frames_in_flight);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_frame_scheduler_reset(VulkanFrameScheduler* scheduler) {
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    vulkan_frame_reset(&scheduler->frames[i]);
+  }
+  scheduler->frame_count = 0;
+  scheduler->is_recording = false;
+}
+
+void vulkan_frame_scheduler_destroy(VulkanFrameScheduler* scheduler) {
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    vulkan_frame_destroy(&scheduler->frames[i], scheduler->fn,
+                         scheduler->device);
+  }
+  vulkan_frame_scheduler_reset(scheduler);
+}
+
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_begin_frame(VulkanFrameScheduler* scheduler,
+                                       VulkanFrame** frame) {
+  VulkanFrame* current = &scheduler->frames[scheduler->current_slot];
+
+  VkResult result = scheduler->fn->vkWaitForFences(
+      scheduler->device, 1, &current->in_flight_fence, VK_TRUE, UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  result = scheduler->fn->vkResetCommandPool(scheduler->device,
+                                             current->command_pool, 0);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  result = scheduler->fn->vkBeginCommandBuffer(current->command_buffer,
+                                               &begin_info);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  current->frame_number = scheduler->frame_number;
+  scheduler->is_recording = true;
+  *frame = current;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_submit(VulkanFrameScheduler* scheduler,
+                                  uint32_t wait_semaphore_count,
+                                  const VkSemaphore* wait_semaphores,
+                                  const VkPipelineStageFlags* wait_stages,
+                                  uint32_t signal_semaphore_count,
+                                  const VkSemaphore* signal_semaphores) {
+  if (!scheduler->is_recording) {
+    return Err(int, ErrorMessage)("Frame submitted without begin_frame");
+  }
+  VulkanFrame* current = &scheduler->frames[scheduler->current_slot];
+  scheduler->is_recording = false;
+
+  VkResult result = scheduler->fn->vkEndCommandBuffer(current->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  // the fence is only reset right before the submit that signals it again,
+  // an early return above leaves it signaled and the slot reusable
+  result = scheduler->fn->vkResetFences(scheduler->device, 1,
+                                        &current->in_flight_fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = wait_semaphore_count,
+      .pWaitSemaphores = wait_semaphores,
+      .pWaitDstStageMask = wait_stages,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &current->command_buffer,
+      .signalSemaphoreCount = signal_semaphore_count,
+      .pSignalSemaphores = signal_semaphores,
+  };
+  result = scheduler->fn->vkQueueSubmit(scheduler->queue, 1, &submit_info,
+                                        current->in_flight_fence);
+  if (result != VK_SUCCESS) {
+    // an empty submit signals the fence again, otherwise the next wait on
+    // the slot never returns
+    scheduler->fn->vkQueueSubmit(scheduler->queue, 0, nullptr,
+                                 current->in_flight_fence);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  scheduler->current_slot =
+      (scheduler->current_slot + 1) % scheduler->frame_count;
+  scheduler->frame_number++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_wait_idle(VulkanFrameScheduler* scheduler) {
+  VkFence fences[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  for (uint32_t i = 0; i < scheduler->frame_count; i++) {
+    fences[i] = scheduler->frames[i].in_flight_fence;
+  }
+
+  VkResult result = scheduler->fn->vkWaitForFences(
+      scheduler->device, scheduler->frame_count, fences, VK_TRUE, UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,64 @@
+#ifndef VULKAN_BACKEND_FRAME_SCHEDULER_H
+#define VULKAN_BACKEND_FRAME_SCHEDULER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+
+#define VULKAN_MIN_FRAMES_IN_FLIGHT 2
+#define VULKAN_MAX_FRAMES_IN_FLIGHT 3
+#define VULKAN_DEFAULT_FRAMES_IN_FLIGHT 2
+
+// Per frame slot resources, a slot is only reused once its fence signaled so
+// everything in here is owned by the CPU between begin and submit
+typedef struct VulkanFrame {
+  VkCommandPool command_pool;
+  VkCommandBuffer command_buffer;
+  VkFence in_flight_fence;
+  VkSemaphore image_available;
+  uint32_t slot;
+  // absolute frame number last recorded into this slot
+  uint64_t frame_number;
+  bool is_command_pool_init;
+  bool is_fence_init;
+  bool is_image_available_init;
+} VulkanFrame;
+
+typedef struct VulkanFrameScheduler {
+  VulkanFrame frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_count;
+  uint32_t current_slot;
+  uint64_t frame_number;
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VkQueue queue;
+  bool is_recording;
+} VulkanFrameScheduler;
+
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_init(VulkanFrameScheduler* scheduler,
+                                const VulkanDevice* vk_device,
+                                uint32_t frames_in_flight);
+void vulkan_frame_scheduler_reset(VulkanFrameScheduler* scheduler);
+void vulkan_frame_scheduler_destroy(VulkanFrameScheduler* scheduler);
+
+// blocks until the GPU is done with the slot recorded frames_in_flight frames
+// ago, then resets its command pool and begins its command buffer
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_begin_frame(VulkanFrameScheduler* scheduler,
+                                       VulkanFrame** frame);
+// ends the current command buffer and submits it, the slot fence signals
+// once the GPU finished the frame
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_submit(VulkanFrameScheduler* scheduler,
+                                  uint32_t wait_semaphore_count,
+                                  const VkSemaphore* wait_semaphores,
+                                  const VkPipelineStageFlags* wait_stages,
+                                  uint32_t signal_semaphore_count,
+                                  const VkSemaphore* signal_semaphores);
+Result(int, ErrorMessage)
+    vulkan_frame_scheduler_wait_idle(VulkanFrameScheduler* scheduler);
+
+#endif
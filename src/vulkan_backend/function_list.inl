@@ -24,6 +24,9 @@ INSTANCE_LEVEL_VULKAN_FUNCTION(vkEnumeratePhysicalDevices)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkEnumerateDeviceExtensionProperties)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceFeatures)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceProperties)
+// core since 1.1, the instance is created with 1.3
+INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceFeatures2)
+INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceProperties2)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceMemoryProperties)
 INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceFormatProperties)
@@ -35,23 +38,31 @@ INSTANCE_LEVEL_VULKAN_FUNCTION(vkDestroyInstance)
 #undef INSTANCE_LEVEL_VULKAN_FUNCTION
 //
 #ifndef INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
-#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(function)
+#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(function, extension)
 #endif
 
-#ifdef DEBUG
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCreateDebugReportCallbackEXT)
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroyDebugReportCallbackEXT)
-#endif
+// only enabled, and so only loaded, by debug builds
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
+    vkCreateDebugUtilsMessengerEXT,
+    VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
+    vkDestroyDebugUtilsMessengerEXT,
+    VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
 
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
-    vkGetPhysicalDeviceSurfaceSupportKHR)
+    vkGetPhysicalDeviceSurfaceSupportKHR,
+    VK_KHR_SURFACE_EXTENSION_NAME)
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR)
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR,
+    VK_KHR_SURFACE_EXTENSION_NAME)
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
-    vkGetPhysicalDeviceSurfaceFormatsKHR)
+    vkGetPhysicalDeviceSurfaceFormatsKHR,
+    VK_KHR_SURFACE_EXTENSION_NAME)
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
-    vkGetPhysicalDeviceSurfacePresentModesKHR)
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroySurfaceKHR)
+    vkGetPhysicalDeviceSurfacePresentModesKHR,
+    VK_KHR_SURFACE_EXTENSION_NAME)
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroySurfaceKHR,
+                                              VK_KHR_SURFACE_EXTENSION_NAME)
 
 #undef INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
 //
@@ -138,6 +149,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdSetScissor)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdBindVertexBuffers)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdDraw)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdDrawIndexed)
+DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdDrawIndexedIndirect)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdDispatch)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdCopyImage)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdPushConstants)
@@ -149,6 +161,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdSetDepthBias)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdSetBlendConstants)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdExecuteCommands)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdClearAttachments)
+DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdFillBuffer)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdResetQueryPool)
 DEVICE_LEVEL_VULKAN_FUNCTION(vkCmdWriteTimestamp)
 
@@ -169,4 +182,9 @@ DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkQueuePresentKHR,
 DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroySwapchainKHR,
                                             VK_KHR_SWAPCHAIN_EXTENSION_NAME)
 
+// core in 1.2, loaded through the extension so 1.1 drivers that have it work
+DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(
+    vkCmdDrawIndexedIndirectCountKHR,
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+
 #undef DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
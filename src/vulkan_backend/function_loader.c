@@ -1,17 +1,13 @@
 #include "function_loader.h"
 
+#include <SDL2/SDL.h>
 #include <stddef.h>
+#include <string.h>
 
-#include "./functions.h"
+#include "../utils/logger.h"
 
 #define EXPORTED_VULKAN_FUNCTION(name) PFN_##name name = NULL;
 #define GLOBAL_LEVEL_VULKAN_FUNCTION(name) PFN_##name name = NULL;
-#define INSTANCE_LEVEL_VULKAN_FUNCTION(name) PFN_##name name = NULL;
-#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name) \
-  PFN_##name name = NULL;
-#define DEVICE_LEVEL_VULKAN_FUNCTION(name) PFN_##name name = NULL;
-#define DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension) \
-  PFN_##name name = NULL;
 
 #include "function_list.inl"
 
@@ -37,42 +33,185 @@ Result(int, ErrorMessage) vulkan_load_global_functions() {
   return Ok(int, ErrorMessage)(0);
 }
 
-Result(int, ErrorMessage) vulkan_load_instance_functions(VkInstance instance) {
-#define INSTANCE_LEVEL_VULKAN_FUNCTION(name)                                  \
-  name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);                  \
-  if (!name) {                                                                \
-    return Err(                                                               \
-        int, ErrorMessage)("Could not load instance level function: " #name); \
-  }
+// One table slot, extension is nullptr for core functions
+typedef struct VulkanFunctionEntry {
+  const char* name;
+  const char* extension;
+  size_t offset;
+} VulkanFunctionEntry;
 
-#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name)                   \
-  name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);                  \
-  if (!name) {                                                                \
-    return Err(                                                               \
-        int, ErrorMessage)("Could not load instance level function: " #name); \
-  }
+static const VulkanFunctionEntry vulkan_instance_function_entries[] = {
+#define INSTANCE_LEVEL_VULKAN_FUNCTION(name)                 \
+  {#name, nullptr, offsetof(VulkanInstanceFunctions, name)},
+#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension) \
+  {#name, extension, offsetof(VulkanInstanceFunctions, name)},
 
 #include "function_list.inl"
+};
 
-  return Ok(int, ErrorMessage)(0);
+#define VULKAN_INSTANCE_FUNCTION_COUNT          \
+  (sizeof(vulkan_instance_function_entries) /   \
+   sizeof(vulkan_instance_function_entries[0]))
+
+static const VulkanFunctionEntry vulkan_device_function_entries[] = {
+#define DEVICE_LEVEL_VULKAN_FUNCTION(name)                 \
+  {#name, nullptr, offsetof(VulkanDeviceFunctions, name)},
+#define DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension) \
+  {#name, extension, offsetof(VulkanDeviceFunctions, name)},
+
+#include "function_list.inl"
+};
+
+#define VULKAN_DEVICE_FUNCTION_COUNT          \
+  (sizeof(vulkan_device_function_entries) /   \
+   sizeof(vulkan_device_function_entries[0]))
+
+// Either an instance or a device to resolve functions from
+typedef struct VulkanProcSource {
+  const char* level;
+  VkInstance instance;
+  PFN_vkGetDeviceProcAddr get_device_proc;
+  VkDevice device;
+} VulkanProcSource;
+
+static PFN_vkVoidFunction vulkan_proc_source_get(const VulkanProcSource* source,
+                                                 const char* name) {
+  if (source->get_device_proc) {
+    return source->get_device_proc(source->device, name);
+  }
+  return vkGetInstanceProcAddr(source->instance, name);
 }
 
-Result(int, ErrorMessage) vulkan_load_device_functions(VkDevice device) {
-#define DEVICE_LEVEL_VULKAN_FUNCTION(name)                                    \
-  name = (PFN_##name)vkGetDeviceProcAddr(device, #name);                      \
-  if (!name) {                                                                \
-    return Err(int,                                                           \
-               ErrorMessage)("Could not load device level function: " #name); \
+// index into enabled_extensions, -1 when the extension is not enabled
+static int32_t vulkan_find_extension(const char* extension,
+                                     const char** enabled_extensions,
+                                     uint32_t enabled_extension_count) {
+  for (uint32_t i = 0; i < enabled_extension_count; i++) {
+    if (strcmp(extension, enabled_extensions[i]) == 0) {
+      return (int32_t)i;
+    }
   }
+  return -1;
+}
 
-#define DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension)          \
-  name = (PFN_##name)vkGetDeviceProcAddr(device, #name);                      \
-  if (!name) {                                                                \
-    return Err(int,                                                           \
-               ErrorMessage)("Could not load device level function: " #name); \
+static Result(int, ErrorMessage)
+    vulkan_load_functions(void* table,
+                          const VulkanFunctionEntry* entries,
+                          uint32_t entry_count,
+                          const VulkanProcSource* source,
+                          const char** enabled_extensions,
+                          uint32_t enabled_extension_count,
+                          uint32_t required_extension_count,
+                          VulkanFunctionLoadStats* stats) {
+  if (enabled_extension_count > 64) {
+    return Err(int, ErrorMessage)("Too many enabled Vulkan extensions");
   }
 
-#include "function_list.inl"
+  uint64_t start = SDL_GetPerformanceCounter();
+  *stats = (VulkanFunctionLoadStats){0};
+  // optional extensions with a missing entry point
+  uint64_t dropped_extensions = 0;
+
+  for (uint32_t i = 0; i < entry_count; i++) {
+    const VulkanFunctionEntry* entry = &entries[i];
+    PFN_vkVoidFunction* slot =
+        (PFN_vkVoidFunction*)((char*)table + entry->offset);
+    *slot = nullptr;
+
+    int32_t extension_index = -1;
+    if (entry->extension) {
+      extension_index = vulkan_find_extension(
+          entry->extension, enabled_extensions, enabled_extension_count);
+      if (extension_index < 0) {
+        stats->skipped_count++;
+        continue;
+      }
+    }
+
+    *slot = vulkan_proc_source_get(source, entry->name);
+    if (*slot) {
+      continue;
+    }
+    if (extension_index < 0 ||
+        (uint32_t)extension_index < required_extension_count) {
+      log_error("Could not load %s level function: %s", source->level,
+                entry->name);
+      return Err(int, ErrorMessage)("Could not load a required function");
+    }
+    if (!(dropped_extensions & (1ull << extension_index))) {
+      log_warning("Disabling %s, the driver lacks %s", entry->extension,
+                  entry->name);
+      dropped_extensions |= 1ull << extension_index;
+      stats->missing_extension_count++;
+    }
+  }
+
+  for (uint32_t i = 0; i < entry_count; i++) {
+    const VulkanFunctionEntry* entry = &entries[i];
+    PFN_vkVoidFunction* slot =
+        (PFN_vkVoidFunction*)((char*)table + entry->offset);
+    if (dropped_extensions && entry->extension) {
+      // entries of extensions that were never enabled are already null
+      int32_t extension_index = vulkan_find_extension(
+          entry->extension, enabled_extensions, enabled_extension_count);
+      if (extension_index >= 0 &&
+          (dropped_extensions & (1ull << extension_index))) {
+        *slot = nullptr;
+      }
+    }
+    if (*slot) {
+      stats->loaded_count++;
+    }
+  }
 
+  stats->elapsed_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+                      (double)SDL_GetPerformanceFrequency();
+  log_debug("Loaded %u %s functions in %.3f ms, %u skipped",
+            stats->loaded_count, source->level, stats->elapsed_ms,
+            stats->skipped_count);
   return Ok(int, ErrorMessage)(0);
 }
+
+Result(int, ErrorMessage)
+    vulkan_load_instance_functions(VulkanInstanceFunctions* functions,
+                                   VkInstance instance,
+                                   const char** enabled_extensions,
+                                   uint32_t enabled_extension_count,
+                                   uint32_t required_extension_count,
+                                   VulkanFunctionLoadStats* stats) {
+  VulkanFunctionLoadStats local_stats;
+  VulkanProcSource source = {
+      .level = "instance",
+      .instance = instance,
+      .get_device_proc = nullptr,
+      .device = VK_NULL_HANDLE,
+  };
+  return vulkan_load_functions(
+      functions, vulkan_instance_function_entries,
+      VULKAN_INSTANCE_FUNCTION_COUNT, &source,
+      enabled_extensions, enabled_extension_count, required_extension_count,
+      stats ? stats : &local_stats);
+}
+
+Result(int, ErrorMessage)
+    vulkan_load_device_functions(VulkanDeviceFunctions* functions,
+                                 const VulkanInstanceFunctions* instance_fn,
+                                 VkDevice device,
+                                 const char** enabled_extensions,
+                                 uint32_t enabled_extension_count,
+                                 uint32_t required_extension_count,
+                                 VulkanFunctionLoadStats* stats) {
+  VulkanFunctionLoadStats local_stats;
+  // straight to the driver, see VulkanDeviceFunctions
+  VulkanProcSource source = {
+      .level = "device",
+      .instance = VK_NULL_HANDLE,
+      .get_device_proc = instance_fn->vkGetDeviceProcAddr,
+      .device = device,
+  };
+  return vulkan_load_functions(
+      functions, vulkan_device_function_entries,
+      VULKAN_DEVICE_FUNCTION_COUNT, &source, enabled_extensions,
+      enabled_extension_count, required_extension_count,
+      stats ? stats : &local_stats);
+}
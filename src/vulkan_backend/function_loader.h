@@ -5,11 +5,44 @@
 #include <vulkan/vulkan.h>
 
 #include "../result.h"
+#include "./functions.h"
+
+typedef struct VulkanFunctionLoadStats {
+  uint32_t loaded_count;
+  // functions of extensions that are not enabled
+  uint32_t skipped_count;
+  // optional extensions dropped because an entry point was missing
+  uint32_t missing_extension_count;
+  double elapsed_ms;
+} VulkanFunctionLoadStats;
 
 Result(int, ErrorMessage)
     vulkan_load_external_function(PFN_vkGetInstanceProcAddr vk_get_proc);
 Result(int, ErrorMessage) vulkan_load_global_functions();
-Result(int, ErrorMessage) vulkan_load_instance_functions(VkInstance instance);
-Result(int, ErrorMessage) vulkan_load_device_functions(VkDevice device);
+// Resolves a whole table in one pass over the function list. Functions of
+// extensions that are not enabled are left nullptr. The first
+// required_extension_count enabled extensions are required, a missing entry
+// point of one of them or of the core fails the load. The other extensions
+// are optional: when the driver lacks one of their entry points every
+// function of that extension is left nullptr, so checking any one of them
+// tells whether the extension can be used.
+//
+// Every table is independent, several instances and devices can be loaded
+// side by side. stats may be nullptr.
+Result(int, ErrorMessage)
+    vulkan_load_instance_functions(VulkanInstanceFunctions* functions,
+                                   VkInstance instance,
+                                   const char** enabled_extensions,
+                                   uint32_t enabled_extension_count,
+                                   uint32_t required_extension_count,
+                                   VulkanFunctionLoadStats* stats);
+Result(int, ErrorMessage)
+    vulkan_load_device_functions(VulkanDeviceFunctions* functions,
+                                 const VulkanInstanceFunctions* instance_fn,
+                                 VkDevice device,
+                                 const char** enabled_extensions,
+                                 uint32_t enabled_extension_count,
+                                 uint32_t required_extension_count,
+                                 VulkanFunctionLoadStats* stats);
 
 #endif
@@ -3,15 +3,30 @@
 
 #include <vulkan/vulkan.h>
 
+// loader entry points, the same for every instance and device
 #define EXPORTED_VULKAN_FUNCTION(name) extern PFN_##name name;
 #define GLOBAL_LEVEL_VULKAN_FUNCTION(name) extern PFN_##name name;
-#define INSTANCE_LEVEL_VULKAN_FUNCTION(name) extern PFN_##name name;
-#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name) \
-  extern PFN_##name name;
-#define DEVICE_LEVEL_VULKAN_FUNCTION(name) extern PFN_##name name;
+
+#include "function_list.inl"
+
+// Instance level functions of one VkInstance
+typedef struct VulkanInstanceFunctions {
+#define INSTANCE_LEVEL_VULKAN_FUNCTION(name) PFN_##name name;
+#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension) \
+  PFN_##name name;
+
+#include "function_list.inl"
+} VulkanInstanceFunctions;
+
+// Device level functions of one VkDevice, fetched with vkGetDeviceProcAddr
+// so calls go straight to the driver instead of through the loader
+// trampoline that dispatches on the handle
+typedef struct VulkanDeviceFunctions {
+#define DEVICE_LEVEL_VULKAN_FUNCTION(name) PFN_##name name;
 #define DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension) \
-  extern PFN_##name name;
+  PFN_##name name;
 
 #include "function_list.inl"
+} VulkanDeviceFunctions;
 
 #endif
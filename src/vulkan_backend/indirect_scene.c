@@ -0,0 +1,662 @@
+#include "./indirect_scene.h"
+
+#include <string.h>
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./compute_queue.h"
+#include "./debug.h"
+#include "./descriptor_allocator.h"
+#include "./functions.h"
+
+// push constants of shaders/cull.comp
+typedef struct VulkanCullConstants {
+  float planes[6][4];
+  uint32_t object_count;
+  // 1 when the draw count comes from the count buffer, culled objects are
+  // then dropped instead of written with zero instances
+  uint32_t compact;
+} VulkanCullConstants;
+
+static const VkDeviceSize vulkan_indirect_stream_sizes[] = {
+    [VULKAN_INDIRECT_STREAM_BOUNDS] = sizeof(float[4]),
+    [VULKAN_INDIRECT_STREAM_DRAW] = sizeof(VkDrawIndexedIndirectCommand),
+};
+
+// the handles are only set on success, destroy checks for VK_NULL_HANDLE
+static Result(int, ErrorMessage)
+    vulkan_indirect_scene_create_buffer(VulkanIndirectScene* scene,
+                                        VkDeviceSize size,
+                                        VkBufferUsageFlags usage,
+                                        VkMemoryPropertyFlags required,
+                                        VkBuffer* buffer,
+                                        VulkanAllocation* allocation) {
+  VkBufferCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = size,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  VkBuffer created = VK_NULL_HANDLE;
+  VulkanAllocation created_allocation;
+  auto result = vulkan_allocator_create_buffer(scene->allocator, &create_info,
+                                               required, 0, &created,
+                                               &created_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  *buffer = created;
+  *allocation = created_allocation;
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_indirect_scene_init_buffers(VulkanIndirectScene* scene) {
+  VkDeviceSize staging_size = 0;
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_STREAM_COUNT; i++) {
+    VkDeviceSize size = vulkan_indirect_stream_sizes[i] * scene->capacity;
+    staging_size += size;
+    auto result = vulkan_indirect_scene_create_buffer(
+        scene, size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scene->streams[i],
+        &scene->stream_allocations[i]);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  auto result = vulkan_indirect_scene_create_buffer(
+      scene, sizeof(VkDrawIndexedIndirectCommand) * scene->capacity,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scene->commands,
+      &scene->command_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_indirect_scene_create_buffer(
+      scene, sizeof(uint32_t),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &scene->count,
+      &scene->count_allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // room for every object of every stream, so a frame can upload all of
+  // them at once
+  for (uint32_t i = 0; i < scene->frame_count; i++) {
+    result = vulkan_indirect_scene_create_buffer(
+        scene, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &scene->staging[i], &scene->staging_allocations[i]);
+    if (!result.is_ok) {
+      return result;
+    }
+    if (!scene->staging_allocations[i].mapped) {
+      return Err(int, ErrorMessage)("Staging memory is not mapped");
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_indirect_scene_init_set(VulkanIndirectScene* scene,
+                                   const VulkanDevice* vk_device,
+                                   VulkanLayoutCache* layout_cache) {
+  VkDescriptorSetLayoutBinding bindings[VULKAN_INDIRECT_SCENE_BINDING_COUNT];
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_SCENE_BINDING_COUNT; i++) {
+    bindings[i] = (VkDescriptorSetLayoutBinding){
+        .binding = i,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .pImmutableSamplers = nullptr,
+    };
+  }
+  VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .bindingCount = VULKAN_INDIRECT_SCENE_BINDING_COUNT,
+      .pBindings = bindings,
+  };
+  auto result = vulkan_layout_cache_get_set_layout(layout_cache, &layout_info,
+                                                   &scene->set_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkPushConstantRange push_constant_range = {
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = sizeof(VulkanCullConstants),
+  };
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .setLayoutCount = 1,
+      .pSetLayouts = &scene->set_layout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_constant_range,
+  };
+  result = vulkan_layout_cache_get_pipeline_layout(
+      layout_cache, &pipeline_layout_info, &scene->pipeline_layout);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkDescriptorPoolSize size = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                               VULKAN_INDIRECT_SCENE_BINDING_COUNT};
+  VkDescriptorPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .maxSets = 1,
+      .poolSizeCount = 1,
+      .pPoolSizes = &size,
+  };
+  VkResult vk_result = scene->fn->vkCreateDescriptorPool(
+      scene->device, &pool_info, nullptr, &scene->pool);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  scene->is_pool_init = true;
+
+  VkDescriptorSetAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .descriptorPool = scene->pool,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &scene->set_layout,
+  };
+  vk_result = scene->fn->vkAllocateDescriptorSets(scene->device,
+                                                  &allocate_info, &scene->set);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+
+  VulkanDescriptorWriter writer;
+  vulkan_descriptor_writer_init(&writer, vk_device);
+  const VkBuffer buffers[] = {
+      [VULKAN_INDIRECT_SCENE_BOUNDS_BINDING] =
+          scene->streams[VULKAN_INDIRECT_STREAM_BOUNDS],
+      [VULKAN_INDIRECT_SCENE_DRAW_BINDING] =
+          scene->streams[VULKAN_INDIRECT_STREAM_DRAW],
+      [VULKAN_INDIRECT_SCENE_COMMAND_BINDING] = scene->commands,
+      [VULKAN_INDIRECT_SCENE_COUNT_BINDING] = scene->count,
+  };
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_SCENE_BINDING_COUNT; i++) {
+    vulkan_descriptor_writer_write_buffer(
+        &writer, scene->set, i, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        buffers[i], 0, VK_WHOLE_SIZE);
+  }
+  vulkan_descriptor_writer_flush(&writer);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// requests the pipeline of the current shader module, the compiler hands
+// back the existing handle when nothing changed
+static Result(int, ErrorMessage)
+    vulkan_indirect_scene_request_pipeline(VulkanIndirectScene* scene) {
+  VkComputePipelineCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .stage =
+          {
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .pNext = nullptr,
+              .flags = 0,
+              .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+              .module = vulkan_shader_cache_module(scene->shader_cache,
+                                                   scene->shader),
+              .pName = "main",
+              .pSpecializationInfo = nullptr,
+          },
+      .layout = scene->pipeline_layout,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1,
+  };
+  scene->shader_generation =
+      vulkan_shader_cache_generation(scene->shader_cache, scene->shader);
+  return vulkan_pipeline_compiler_request_compute(
+      scene->pipeline_compiler, &create_info, &scene->pipeline_handle);
+}
+
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_init(VulkanIndirectScene* scene,
+                               const VulkanDevice* vk_device,
+                               VulkanAllocator* allocator,
+                               VulkanLayoutCache* layout_cache,
+                               VulkanShaderCache* shader_cache,
+                               VulkanPipelineCompiler* pipeline_compiler,
+                               const char* shader_path,
+                               uint32_t capacity,
+                               uint32_t frames_in_flight) {
+  if (!vk_device->has_multi_draw_indirect) {
+    return Err(int, ErrorMessage)("Multi draw indirect is not supported");
+  }
+  scene->device = vk_device->device;
+  scene->fn = &vk_device->fn;
+  scene->allocator = allocator;
+  scene->shader_cache = shader_cache;
+  scene->pipeline_compiler = pipeline_compiler;
+  scene->frame_count = frames_in_flight;
+  scene->has_draw_count = vk_device->has_draw_indirect_count;
+  scene->is_scene_init = true;
+
+  uint32_t max_draw_count =
+      vk_device->info.properties.limits.maxDrawIndirectCount;
+  if (capacity > max_draw_count) {
+    log_warning("Limiting indirect scene to %u objects", max_draw_count);
+    capacity = max_draw_count;
+  }
+  if (capacity == 0) {
+    return Err(int, ErrorMessage)("Indirect scene capacity is 0");
+  }
+  scene->capacity = capacity;
+
+  scene->bounds = mem_alloc(sizeof(float[4]) * capacity);
+  CHECK_ALLOC(scene->bounds,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for object bounds"));
+  scene->draws = mem_alloc(sizeof(VkDrawIndexedIndirectCommand) * capacity);
+  CHECK_ALLOC(scene->draws,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for object draws"));
+  uint32_t chunk_count = (capacity + VULKAN_INDIRECT_SCENE_CHUNK_SIZE - 1) /
+                         VULKAN_INDIRECT_SCENE_CHUNK_SIZE;
+  bool* dirty_chunks = mem_alloc(sizeof(bool) * chunk_count);
+  CHECK_ALLOC(dirty_chunks, Err(int, ErrorMessage)(
+                                "Unable to allocate memory for dirty chunks"));
+  memset(dirty_chunks, 0, sizeof(bool) * chunk_count);
+  scene->dirty_chunks = dirty_chunks;
+  scene->chunk_count = chunk_count;
+  scene->regions = mem_alloc(sizeof(VkBufferCopy) * chunk_count);
+  CHECK_ALLOC(scene->regions,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for upload regions"));
+
+  auto result = vulkan_indirect_scene_init_buffers(scene);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_indirect_scene_init_set(scene, vk_device, layout_cache);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_shader_cache_load(shader_cache, shader_path, &scene->shader);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_indirect_scene_request_pipeline(scene);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  log_debug("Initialized indirect scene for %u objects, %s draw count",
+            capacity, scene->has_draw_count ? "GPU" : "fixed");
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_indirect_scene_reset(VulkanIndirectScene* scene) {
+  scene->allocator = nullptr;
+  scene->shader_cache = nullptr;
+  scene->pipeline_compiler = nullptr;
+  scene->set_layout = VK_NULL_HANDLE;
+  scene->pipeline_layout = VK_NULL_HANDLE;
+  scene->pool = VK_NULL_HANDLE;
+  scene->set = VK_NULL_HANDLE;
+  scene->shader = 0;
+  scene->shader_generation = 0;
+  scene->pipeline_handle = 0;
+  scene->pipeline = VK_NULL_HANDLE;
+  scene->bounds = nullptr;
+  scene->draws = nullptr;
+  scene->object_count = 0;
+  scene->capacity = 0;
+  scene->dirty_chunks = nullptr;
+  scene->chunk_count = 0;
+  scene->dirty_chunk_count = 0;
+  scene->regions = nullptr;
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_STREAM_COUNT; i++) {
+    scene->streams[i] = VK_NULL_HANDLE;
+  }
+  scene->commands = VK_NULL_HANDLE;
+  scene->count = VK_NULL_HANDLE;
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    scene->staging[i] = VK_NULL_HANDLE;
+  }
+  scene->frame_count = 0;
+  scene->has_draw_count = false;
+  scene->is_culled = false;
+  scene->is_pool_init = false;
+  scene->is_scene_init = false;
+}
+
+void vulkan_indirect_scene_destroy(VulkanIndirectScene* scene) {
+  if (!scene->is_scene_init) {
+    return;
+  }
+  // the set goes with its pool
+  if (scene->is_pool_init) {
+    scene->fn->vkDestroyDescriptorPool(scene->device, scene->pool, nullptr);
+  }
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_STREAM_COUNT; i++) {
+    if (scene->streams[i] != VK_NULL_HANDLE) {
+      vulkan_allocator_destroy_buffer(scene->allocator, scene->streams[i],
+                                      &scene->stream_allocations[i]);
+    }
+  }
+  if (scene->commands != VK_NULL_HANDLE) {
+    vulkan_allocator_destroy_buffer(scene->allocator, scene->commands,
+                                    &scene->command_allocation);
+  }
+  if (scene->count != VK_NULL_HANDLE) {
+    vulkan_allocator_destroy_buffer(scene->allocator, scene->count,
+                                    &scene->count_allocation);
+  }
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    if (scene->staging[i] != VK_NULL_HANDLE) {
+      vulkan_allocator_destroy_buffer(scene->allocator, scene->staging[i],
+                                      &scene->staging_allocations[i]);
+    }
+  }
+  mem_free(scene->bounds);
+  mem_free(scene->draws);
+  mem_free(scene->dirty_chunks);
+  mem_free(scene->regions);
+  vulkan_indirect_scene_reset(scene);
+}
+
+static void vulkan_indirect_scene_mark_dirty(VulkanIndirectScene* scene,
+                                             uint32_t index) {
+  uint32_t chunk = index / VULKAN_INDIRECT_SCENE_CHUNK_SIZE;
+  if (!scene->dirty_chunks[chunk]) {
+    scene->dirty_chunks[chunk] = true;
+    scene->dirty_chunk_count++;
+  }
+}
+
+static void vulkan_indirect_scene_clear_dirty(VulkanIndirectScene* scene) {
+  memset(scene->dirty_chunks, 0, sizeof(bool) * scene->chunk_count);
+  scene->dirty_chunk_count = 0;
+}
+
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_add(VulkanIndirectScene* scene,
+                              const VulkanIndirectObject* object,
+                              uint32_t* index) {
+  if (scene->object_count == scene->capacity) {
+    return Err(int, ErrorMessage)("Indirect scene is full");
+  }
+  *index = scene->object_count++;
+  float* bounds = scene->bounds[*index];
+  bounds[0] = object->center[0];
+  bounds[1] = object->center[1];
+  bounds[2] = object->center[2];
+  bounds[3] = object->radius;
+  scene->draws[*index] = (VkDrawIndexedIndirectCommand){
+      .indexCount = object->index_count,
+      .instanceCount = 1,
+      .firstIndex = object->first_index,
+      .vertexOffset = object->vertex_offset,
+      .firstInstance = *index,
+  };
+  vulkan_indirect_scene_mark_dirty(scene, *index);
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_indirect_scene_move(VulkanIndirectScene* scene,
+                                uint32_t index,
+                                const float center[3],
+                                float radius) {
+  float* bounds = scene->bounds[index];
+  bounds[0] = center[0];
+  bounds[1] = center[1];
+  bounds[2] = center[2];
+  bounds[3] = radius;
+  vulkan_indirect_scene_mark_dirty(scene, index);
+}
+
+void vulkan_indirect_scene_clear(VulkanIndirectScene* scene) {
+  scene->object_count = 0;
+  vulkan_indirect_scene_clear_dirty(scene);
+}
+
+// Copies the dirty objects of every stream through the slot's staging
+// buffer. Adjacent dirty chunks are merged into one region, objects between
+// two runs are not uploaded again.
+static void vulkan_indirect_scene_upload(VulkanIndirectScene* scene,
+                                         VkCommandBuffer command_buffer,
+                                         uint32_t slot) {
+  if (scene->dirty_chunk_count == 0) {
+    return;
+  }
+  const uint8_t* sources[] = {
+      [VULKAN_INDIRECT_STREAM_BOUNDS] = (const uint8_t*)scene->bounds,
+      [VULKAN_INDIRECT_STREAM_DRAW] = (const uint8_t*)scene->draws,
+  };
+  uint8_t* staging = scene->staging_allocations[slot].mapped;
+  VkDeviceSize staging_offset = 0;
+  for (uint32_t i = 0; i < VULKAN_INDIRECT_STREAM_COUNT; i++) {
+    VkDeviceSize stride = vulkan_indirect_stream_sizes[i];
+    uint32_t region_count = 0;
+    uint32_t chunk = 0;
+    while (chunk < scene->chunk_count) {
+      if (!scene->dirty_chunks[chunk]) {
+        chunk++;
+        continue;
+      }
+      uint32_t end = chunk + 1;
+      while (end < scene->chunk_count && scene->dirty_chunks[end]) {
+        end++;
+      }
+      uint32_t first = chunk * VULKAN_INDIRECT_SCENE_CHUNK_SIZE;
+      uint32_t last = end * VULKAN_INDIRECT_SCENE_CHUNK_SIZE;
+      if (last > scene->object_count) {
+        last = scene->object_count;
+      }
+      VkDeviceSize size = stride * (last - first);
+      mem_copy(staging + staging_offset, sources[i] + stride * first, size);
+      scene->regions[region_count++] = (VkBufferCopy){
+          .srcOffset = staging_offset,
+          .dstOffset = stride * first,
+          .size = size,
+      };
+      staging_offset += size;
+      chunk = end;
+    }
+    scene->fn->vkCmdCopyBuffer(command_buffer, scene->staging[slot],
+                               scene->streams[i], region_count,
+                               scene->regions);
+  }
+  vulkan_indirect_scene_clear_dirty(scene);
+}
+
+static void vulkan_indirect_scene_barrier(const VulkanIndirectScene* scene,
+                                          VkCommandBuffer command_buffer,
+                                          VkPipelineStageFlags src_stages,
+                                          VkAccessFlags src_access,
+                                          VkPipelineStageFlags dst_stages,
+                                          VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = src_access,
+      .dstAccessMask = dst_access,
+  };
+  scene->fn->vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 1,
+                                  &barrier, 0, nullptr, 0, nullptr);
+}
+
+// picks up a finished recompile, false while no pipeline is ready
+static bool vulkan_indirect_scene_poll_pipeline(VulkanIndirectScene* scene) {
+  if (vulkan_shader_cache_generation(scene->shader_cache, scene->shader) !=
+      scene->shader_generation) {
+    // the previous pipeline keeps culling until the new one is ready
+    auto result = vulkan_indirect_scene_request_pipeline(scene);
+    if (!result.is_ok) {
+      log_warning("Unable to recompile culling pipeline: %s", result.error);
+    }
+  }
+  VkPipeline pipeline;
+  if (vulkan_pipeline_compiler_poll(scene->pipeline_compiler,
+                                    scene->pipeline_handle, &pipeline) ==
+      VULKAN_PIPELINE_STATUS_READY) {
+    scene->pipeline = pipeline;
+  }
+  return scene->pipeline != VK_NULL_HANDLE;
+}
+
+// Records the upload and the count reset ahead of the dispatch. src_stages
+// are the stages of the same queue that may still use the buffers from the
+// previous frame.
+static void vulkan_indirect_scene_record_upload(
+    VulkanIndirectScene* scene,
+    VkCommandBuffer command_buffer,
+    uint32_t slot,
+    VkPipelineStageFlags src_stages) {
+  vulkan_indirect_scene_barrier(
+      scene, command_buffer,
+      src_stages | VK_PIPELINE_STAGE_TRANSFER_BIT |
+          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+  vulkan_indirect_scene_upload(scene, command_buffer, slot);
+  scene->fn->vkCmdFillBuffer(command_buffer, scene->count, 0,
+                             sizeof(uint32_t), 0);
+  vulkan_indirect_scene_barrier(
+      scene, command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+static VulkanCullConstants vulkan_indirect_scene_constants(
+    const VulkanIndirectScene* scene,
+    const Mat4* view_projection) {
+  VulkanCullConstants constants = {
+      .object_count = scene->object_count,
+      .compact = scene->has_draw_count ? 1 : 0,
+  };
+  Frustum frustum = frustum_from_mat4(view_projection);
+  for (uint32_t i = 0; i < 6; i++) {
+    const Vec4* plane = &frustum.planes[i];
+    constants.planes[i][0] = plane->x;
+    constants.planes[i][1] = plane->y;
+    constants.planes[i][2] = plane->z;
+    constants.planes[i][3] = plane->w;
+  }
+  return constants;
+}
+
+void vulkan_indirect_scene_cull(VulkanIndirectScene* scene,
+                                VkCommandBuffer command_buffer,
+                                uint32_t slot,
+                                const Mat4* view_projection) {
+  scene->is_culled = false;
+  if (!vulkan_indirect_scene_poll_pipeline(scene)) {
+    return;
+  }
+
+  vulkan_indirect_scene_record_upload(scene, command_buffer, slot,
+                                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+  VulkanCullConstants constants =
+      vulkan_indirect_scene_constants(scene, view_projection);
+  scene->fn->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                               scene->pipeline);
+  scene->fn->vkCmdBindDescriptorSets(
+      command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene->pipeline_layout, 0,
+      1, &scene->set, 0, nullptr);
+  scene->fn->vkCmdPushConstants(command_buffer, scene->pipeline_layout,
+                                VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                sizeof(constants), &constants);
+  if (scene->object_count > 0) {
+    scene->fn->vkCmdDispatch(
+        command_buffer,
+        vulkan_compute_group_count(scene->object_count,
+                                   VULKAN_INDIRECT_SCENE_LOCAL_SIZE),
+        1, 1);
+  }
+
+  vulkan_indirect_scene_barrier(
+      scene, command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+  scene->is_culled = true;
+}
+
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_cull_compute(VulkanIndirectScene* scene,
+                                       VulkanComputeQueue* compute,
+                                       uint32_t slot,
+                                       const Mat4* view_projection,
+                                       VkPipelineStageFlags dst_stage,
+                                       VkAccessFlags dst_access) {
+  scene->is_culled = false;
+  if (!vulkan_indirect_scene_poll_pipeline(scene)) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  // compute queues have no draw indirect stage, the graphics queue's reads
+  // of the previous frame are ordered by the caller
+  vulkan_indirect_scene_record_upload(scene, compute->current->command_buffer,
+                                      slot, 0);
+  VulkanCullConstants constants =
+      vulkan_indirect_scene_constants(scene, view_projection);
+  if (scene->object_count > 0) {
+    VulkanDispatch dispatch = {
+        .pipeline = scene->pipeline,
+        .layout = scene->pipeline_layout,
+        .descriptor_sets = {scene->set},
+        .descriptor_set_count = 1,
+        .push_constants = &constants,
+        .push_constant_size = sizeof(constants),
+        .group_count_x = vulkan_compute_group_count(
+            scene->object_count, VULKAN_INDIRECT_SCENE_LOCAL_SIZE),
+        .group_count_y = 1,
+        .group_count_z = 1,
+    };
+    vulkan_compute_queue_dispatch(compute, &dispatch);
+  }
+
+  auto result = vulkan_compute_queue_release_buffer(
+      compute, scene->commands, 0, VK_WHOLE_SIZE, dst_stage, dst_access);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_compute_queue_release_buffer(
+      compute, scene->count, 0, VK_WHOLE_SIZE, dst_stage, dst_access);
+  if (!result.is_ok) {
+    return result;
+  }
+  scene->is_culled = true;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_indirect_scene_draw(const VulkanIndirectScene* scene,
+                                VkCommandBuffer command_buffer) {
+  if (!scene->is_culled || scene->object_count == 0) {
+    return;
+  }
+  if (scene->has_draw_count) {
+    scene->fn->vkCmdDrawIndexedIndirectCountKHR(
+        command_buffer, scene->commands, 0, scene->count, 0,
+        scene->object_count, sizeof(VkDrawIndexedIndirectCommand));
+    return;
+  }
+  scene->fn->vkCmdDrawIndexedIndirect(command_buffer, scene->commands, 0,
+                                      scene->object_count,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,152 @@
+#ifndef VULKAN_BACKEND_INDIRECT_SCENE_H
+#define VULKAN_BACKEND_INDIRECT_SCENE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../math/math3d.h"
+#include "../result.h"
+#include "./allocator.h"
+#include "./compute_queue.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+#include "./layout_cache.h"
+#include "./pipeline_compiler.h"
+#include "./shader_cache.h"
+
+// must match local_size_x of shaders/cull.comp
+#define VULKAN_INDIRECT_SCENE_LOCAL_SIZE 64
+#define VULKAN_INDIRECT_SCENE_BOUNDS_BINDING 0
+#define VULKAN_INDIRECT_SCENE_DRAW_BINDING 1
+#define VULKAN_INDIRECT_SCENE_COMMAND_BINDING 2
+#define VULKAN_INDIRECT_SCENE_COUNT_BINDING 3
+#define VULKAN_INDIRECT_SCENE_BINDING_COUNT 4
+// objects per dirty chunk, changing one object uploads its whole chunk
+#define VULKAN_INDIRECT_SCENE_CHUNK_SIZE 256
+
+// Per object data, one tightly packed GPU buffer per stream
+typedef enum VulkanIndirectStream {
+  // bounding sphere, xyz center and w radius in world space
+  VULKAN_INDIRECT_STREAM_BOUNDS,
+  // the object's draw, firstInstance is its index
+  VULKAN_INDIRECT_STREAM_DRAW,
+  VULKAN_INDIRECT_STREAM_COUNT,
+} VulkanIndirectStream;
+
+typedef struct VulkanIndirectObject {
+  float center[3];
+  float radius;
+  uint32_t index_count;
+  uint32_t first_index;
+  int32_t vertex_offset;
+} VulkanIndirectObject;
+
+// Objects drawn by the GPU from commands a compute shader writes. Each frame
+// the culling pass tests every bounding sphere against the frustum and
+// compacts the visible draws into one indirect buffer, the graphics pass then
+// issues them all with a single draw call. The CPU only records the objects
+// that changed, its per frame cost does not grow with the object count.
+//
+// The vertex shader finds the object through gl_InstanceIndex. Without
+// indirect counts culled objects stay in the buffer as draws of zero
+// instances. Not thread safe.
+typedef struct VulkanIndirectScene {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanAllocator* allocator;
+  VulkanShaderCache* shader_cache;
+  VulkanPipelineCompiler* pipeline_compiler;
+  // owned by the layout cache
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout pipeline_layout;
+  VkDescriptorPool pool;
+  VkDescriptorSet set;
+  VulkanShaderHandle shader;
+  // recompiled when a reload changes the shader's generation
+  uint32_t shader_generation;
+  VulkanPipelineHandle pipeline_handle;
+  // VK_NULL_HANDLE until the compiler finished, owned by the compiler
+  VkPipeline pipeline;
+  // CPU copy of the streams, uploaded where dirty
+  float (*bounds)[4];
+  VkDrawIndexedIndirectCommand* draws;
+  uint32_t object_count;
+  uint32_t capacity;
+  // per chunk, an object of the chunk changed since the last upload
+  bool* dirty_chunks;
+  uint32_t chunk_count;
+  uint32_t dirty_chunk_count;
+  // one copy per run of dirty chunks, sized for the worst case
+  VkBufferCopy* regions;
+  VkBuffer streams[VULKAN_INDIRECT_STREAM_COUNT];
+  VulkanAllocation stream_allocations[VULKAN_INDIRECT_STREAM_COUNT];
+  // written by the culling pass, read by the draw
+  VkBuffer commands;
+  VulkanAllocation command_allocation;
+  VkBuffer count;
+  VulkanAllocation count_allocation;
+  // host visible, a slot's buffer is rewritten once its fence signaled
+  VkBuffer staging[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  VulkanAllocation staging_allocations[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_count;
+  bool has_draw_count;
+  // the last culling pass ran, commands hold this frame's draws
+  bool is_culled;
+  bool is_pool_init;
+  bool is_scene_init;
+} VulkanIndirectScene;
+
+// the device must have been created with has_multi_draw_indirect,
+// shader_path names the SPIR-V of shaders/cull.comp
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_init(VulkanIndirectScene* scene,
+                               const VulkanDevice* vk_device,
+                               VulkanAllocator* allocator,
+                               VulkanLayoutCache* layout_cache,
+                               VulkanShaderCache* shader_cache,
+                               VulkanPipelineCompiler* pipeline_compiler,
+                               const char* shader_path,
+                               uint32_t capacity,
+                               uint32_t frames_in_flight);
+void vulkan_indirect_scene_reset(VulkanIndirectScene* scene);
+// no submitted frame may still use the scene
+void vulkan_indirect_scene_destroy(VulkanIndirectScene* scene);
+
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_add(VulkanIndirectScene* scene,
+                              const VulkanIndirectObject* object,
+                              uint32_t* index);
+void vulkan_indirect_scene_move(VulkanIndirectScene* scene,
+                                uint32_t index,
+                                const float center[3],
+                                float radius);
+void vulkan_indirect_scene_clear(VulkanIndirectScene* scene);
+
+// Records the upload of the changed objects and the culling dispatch,
+// outside of a render pass. view_projection maps to Vulkan clip space. The
+// slot's fence must have signaled.
+void vulkan_indirect_scene_cull(VulkanIndirectScene* scene,
+                                VkCommandBuffer command_buffer,
+                                uint32_t slot,
+                                const Mat4* view_projection);
+// The same pass recorded into the frame's submission of the compute queue,
+// between its begin and submit. The commands and the count are released to
+// graphics, dst_stage and dst_access describe their first use there, usually
+// VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT and VK_ACCESS_INDIRECT_COMMAND_READ_BIT.
+// The graphics submission acquires them before the draw, and the graphics
+// work that drew the previous results must have finished, the compute queue
+// does not wait on it.
+Result(int, ErrorMessage)
+    vulkan_indirect_scene_cull_compute(VulkanIndirectScene* scene,
+                                       VulkanComputeQueue* compute,
+                                       uint32_t slot,
+                                       const Mat4* view_projection,
+                                       VkPipelineStageFlags dst_stage,
+                                       VkAccessFlags dst_access);
+// Draws the visible objects with the bound graphics pipeline, index buffer
+// and descriptor sets, after the culling pass of the same command buffer.
+// Draws nothing while the culling pipeline is still compiling.
+void vulkan_indirect_scene_draw(const VulkanIndirectScene* scene,
+                                VkCommandBuffer command_buffer);
+
+#endif
@@ -0,0 +1,346 @@
+#include "./layout_cache.h"
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+#include "../utils/arena.h"
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+static void vulkan_layout_table_reset(VulkanLayoutTable* table) {
+  table->entries = nullptr;
+  table->count = 0;
+  table->capacity = 0;
+  table->slots = nullptr;
+  table->slot_capacity = 0;
+}
+
+static void vulkan_layout_table_destroy(VulkanLayoutTable* table) {
+  for (uint32_t i = 0; i < table->count; i++) {
+    mem_free(table->entries[i].key);
+  }
+  if (table->entries) {
+    mem_free(table->entries);
+  }
+  if (table->slots) {
+    mem_free(table->slots);
+  }
+  vulkan_layout_table_reset(table);
+}
+
+static bool vulkan_layout_table_find(const VulkanLayoutTable* table,
+                                     uint64_t hash,
+                                     const HashKey* key,
+                                     VulkanLayoutEntry** entry) {
+  if (table->slot_capacity == 0) {
+    return false;
+  }
+
+  uint32_t mask = table->slot_capacity - 1;
+  for (uint32_t slot = (uint32_t)hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t index = table->slots[slot];
+    if (index == 0) {
+      return false;
+    }
+    VulkanLayoutEntry* candidate = &table->entries[index - 1];
+    if (candidate->hash == hash &&
+        hash_key_equal(key, candidate->key, candidate->key_size)) {
+      *entry = candidate;
+      return true;
+    }
+  }
+}
+
+static void vulkan_layout_table_insert_slot(VulkanLayoutTable* table,
+                                            uint32_t index) {
+  uint32_t mask = table->slot_capacity - 1;
+  uint32_t slot = (uint32_t)table->entries[index].hash & mask;
+  while (table->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  table->slots[slot] = index + 1;
+}
+
+// grows the table so one more entry fits
+static Result(int, ErrorMessage)
+    vulkan_layout_table_reserve(VulkanLayoutTable* table) {
+  if (table->count == table->capacity) {
+    uint32_t capacity = table->capacity ? table->capacity * 2 : 16;
+    VulkanLayoutEntry* entries =
+        mem_realloc(table->entries, sizeof(VulkanLayoutEntry) * capacity);
+    CHECK_ALLOC(entries, Err(int, ErrorMessage)(
+                             "Unable to allocate memory for layouts"));
+    table->entries = entries;
+    table->capacity = capacity;
+  }
+
+  // keep the slots at most half full
+  if ((table->count + 1) * 2 > table->slot_capacity) {
+    uint32_t capacity = table->slot_capacity ? table->slot_capacity * 2 : 32;
+    uint32_t* slots = mem_alloc(sizeof(uint32_t) * capacity);
+    CHECK_ALLOC(slots, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for layouts"));
+    SDL_memset(slots, 0, sizeof(uint32_t) * capacity);
+    if (table->slots) {
+      mem_free(table->slots);
+    }
+    table->slots = slots;
+    table->slot_capacity = capacity;
+    for (uint32_t i = 0; i < table->count; i++) {
+      vulkan_layout_table_insert_slot(table, i);
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// the key is copied, reserve must have made room for the entry
+static Result(int, ErrorMessage)
+    vulkan_layout_table_push(VulkanLayoutTable* table,
+                             uint64_t hash,
+                             const HashKey* key,
+                             VulkanLayoutEntry** entry) {
+  uint8_t* key_copy = mem_alloc(key->size);
+  CHECK_ALLOC(key_copy, Err(int, ErrorMessage)(
+                            "Unable to allocate memory for layouts"));
+  mem_copy(key_copy, key->data, key->size);
+
+  uint32_t index = table->count++;
+  table->entries[index].hash = hash;
+  table->entries[index].key = key_copy;
+  table->entries[index].key_size = key->size;
+  vulkan_layout_table_insert_slot(table, index);
+  *entry = &table->entries[index];
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) vulkan_set_layout_binding_flags(
+    const VkDescriptorSetLayoutCreateInfo* info,
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo** flags) {
+  const VkDescriptorSetLayoutBindingFlagsCreateInfo* binding_flags = nullptr;
+  if (info->pNext != nullptr) {
+    binding_flags = info->pNext;
+    if (binding_flags->sType !=
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO ||
+        binding_flags->pNext != nullptr) {
+      return Err(int, ErrorMessage)(
+          "Descriptor set layout extension structure is not supported");
+    }
+    if (binding_flags->bindingCount != 0 &&
+        binding_flags->bindingCount != info->bindingCount) {
+      return Err(int, ErrorMessage)("Binding flag count does not match");
+    }
+  }
+
+  *flags = binding_flags;
+  return Ok(int, ErrorMessage)(0);
+}
+
+// order lists the bindings sorted by binding number
+static void vulkan_set_layout_key(
+    const VkDescriptorSetLayoutCreateInfo* info,
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo* binding_flags,
+    const uint32_t* order,
+    HashKey* key) {
+  HASH_KEY_VALUE(key, info->flags);
+  HASH_KEY_VALUE(key, info->bindingCount);
+  bool has_binding_flags =
+      binding_flags != nullptr && binding_flags->bindingCount > 0;
+  HASH_KEY_VALUE(key, has_binding_flags);
+  for (uint32_t i = 0; i < info->bindingCount; i++) {
+    const VkDescriptorSetLayoutBinding* binding = &info->pBindings[order[i]];
+    HASH_KEY_MEMBERS(key, VkDescriptorSetLayoutBinding, binding, binding,
+                     stageFlags);
+    HASH_KEY_ARRAY(key, binding->pImmutableSamplers,
+                   binding->descriptorCount);
+    if (has_binding_flags) {
+      HASH_KEY_VALUE(key, binding_flags->pBindingFlags[order[i]]);
+    }
+  }
+}
+
+static void vulkan_pipeline_layout_key(const VkPipelineLayoutCreateInfo* info,
+                                       HashKey* key) {
+  HASH_KEY_VALUE(key, info->flags);
+  HASH_KEY_VALUE(key, info->setLayoutCount);
+  HASH_KEY_ARRAY(key, info->pSetLayouts, info->setLayoutCount);
+  HASH_KEY_VALUE(key, info->pushConstantRangeCount);
+  HASH_KEY_ARRAY(key, info->pPushConstantRanges,
+                 info->pushConstantRangeCount);
+}
+
+void vulkan_layout_cache_init(VulkanLayoutCache* cache,
+                              const VulkanDevice* vk_device) {
+  vulkan_layout_cache_reset(cache);
+  cache->device = vk_device->device;
+  cache->fn = &vk_device->fn;
+  cache->is_cache_init = true;
+}
+
+void vulkan_layout_cache_reset(VulkanLayoutCache* cache) {
+  vulkan_layout_table_reset(&cache->set_layouts);
+  vulkan_layout_table_reset(&cache->pipeline_layouts);
+  cache->hit_count = 0;
+  cache->is_cache_init = false;
+}
+
+void vulkan_layout_cache_destroy(VulkanLayoutCache* cache) {
+  if (!cache->is_cache_init) {
+    return;
+  }
+  // pipeline layouts reference the set layouts, they go first
+  for (uint32_t i = 0; i < cache->pipeline_layouts.count; i++) {
+    cache->fn->vkDestroyPipelineLayout(
+        cache->device, cache->pipeline_layouts.entries[i].pipeline_layout,
+        nullptr);
+  }
+  for (uint32_t i = 0; i < cache->set_layouts.count; i++) {
+    cache->fn->vkDestroyDescriptorSetLayout(
+        cache->device, cache->set_layouts.entries[i].set_layout, nullptr);
+  }
+  vulkan_layout_table_destroy(&cache->pipeline_layouts);
+  vulkan_layout_table_destroy(&cache->set_layouts);
+  vulkan_layout_cache_reset(cache);
+}
+
+Result(int, ErrorMessage) vulkan_layout_cache_get_set_layout(
+    VulkanLayoutCache* cache,
+    const VkDescriptorSetLayoutCreateInfo* create_info,
+    VkDescriptorSetLayout* layout) {
+  const VkDescriptorSetLayoutBindingFlagsCreateInfo* binding_flags = nullptr;
+  auto flags_result =
+      vulkan_set_layout_binding_flags(create_info, &binding_flags);
+  if (!flags_result.is_ok) {
+    return flags_result;
+  }
+
+  uint32_t binding_count = create_info->bindingCount;
+  ArenaScratch scratch = arena_scratch_begin();
+  uint32_t* order =
+      scratch.arena
+          ? arena_alloc_array(scratch.arena, binding_count, sizeof(uint32_t))
+          : nullptr;
+  if (!order && binding_count > 0) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate memory for layouts");
+  }
+  // the same bindings listed in another order describe the same layout,
+  // insertion sort since layouts have a handful of bindings
+  for (uint32_t i = 0; i < binding_count; i++) {
+    uint32_t j = i;
+    while (j > 0 && create_info->pBindings[order[j - 1]].binding >
+                        create_info->pBindings[i].binding) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  HashKey key = {.data = nullptr, .size = 0};
+  vulkan_set_layout_key(create_info, binding_flags, order, &key);
+  key.data = scratch.arena ? arena_alloc(scratch.arena, key.size) : nullptr;
+  if (!key.data) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate memory for layouts");
+  }
+  key.size = 0;
+  vulkan_set_layout_key(create_info, binding_flags, order, &key);
+  uint64_t hash = hash_fnv1a64(key.data, key.size, HASH_FNV1A64_SEED);
+
+  VulkanLayoutEntry* entry = nullptr;
+  if (vulkan_layout_table_find(&cache->set_layouts, hash, &key, &entry)) {
+    arena_scratch_end(scratch);
+    cache->hit_count++;
+    *layout = entry->set_layout;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  auto reserve_result = vulkan_layout_table_reserve(&cache->set_layouts);
+  if (!reserve_result.is_ok) {
+    arena_scratch_end(scratch);
+    return reserve_result;
+  }
+  VkDescriptorSetLayout created = VK_NULL_HANDLE;
+  VkResult result = cache->fn->vkCreateDescriptorSetLayout(
+      cache->device, create_info, nullptr, &created);
+  if (result != VK_SUCCESS) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  auto push_result =
+      vulkan_layout_table_push(&cache->set_layouts, hash, &key, &entry);
+  arena_scratch_end(scratch);
+  if (!push_result.is_ok) {
+    cache->fn->vkDestroyDescriptorSetLayout(cache->device, created, nullptr);
+    return push_result;
+  }
+  entry->set_layout = created;
+
+  *layout = created;
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_layout_cache_get_pipeline_layout(
+    VulkanLayoutCache* cache,
+    const VkPipelineLayoutCreateInfo* create_info,
+    VkPipelineLayout* layout) {
+  if (create_info->pNext != nullptr) {
+    return Err(int, ErrorMessage)(
+        "Pipeline layout extension structures are not supported");
+  }
+
+  ArenaScratch scratch = arena_scratch_begin();
+  HashKey key = {.data = nullptr, .size = 0};
+  vulkan_pipeline_layout_key(create_info, &key);
+  key.data = scratch.arena ? arena_alloc(scratch.arena, key.size) : nullptr;
+  if (!key.data) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate memory for layouts");
+  }
+  key.size = 0;
+  vulkan_pipeline_layout_key(create_info, &key);
+  uint64_t hash = hash_fnv1a64(key.data, key.size, HASH_FNV1A64_SEED);
+
+  VulkanLayoutEntry* entry = nullptr;
+  if (vulkan_layout_table_find(&cache->pipeline_layouts, hash, &key,
+                               &entry)) {
+    arena_scratch_end(scratch);
+    cache->hit_count++;
+    *layout = entry->pipeline_layout;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  auto reserve_result = vulkan_layout_table_reserve(&cache->pipeline_layouts);
+  if (!reserve_result.is_ok) {
+    arena_scratch_end(scratch);
+    return reserve_result;
+  }
+  VkPipelineLayout created = VK_NULL_HANDLE;
+  VkResult result =
+      cache->fn->vkCreatePipelineLayout(cache->device, create_info, nullptr,
+                                        &created);
+  if (result != VK_SUCCESS) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  auto push_result =
+      vulkan_layout_table_push(&cache->pipeline_layouts, hash, &key, &entry);
+  arena_scratch_end(scratch);
+  if (!push_result.is_ok) {
+    cache->fn->vkDestroyPipelineLayout(cache->device, created, nullptr);
+    return push_result;
+  }
+  entry->pipeline_layout = created;
+
+  *layout = created;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_layout_cache_log_stats(const VulkanLayoutCache* cache) {
+  log_debug("Layout cache: %u set layouts, %u pipeline layouts, %u hits",
+            cache->set_layouts.count, cache->pipeline_layouts.count,
+            cache->hit_count);
+}
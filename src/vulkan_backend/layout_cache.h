@@ -0,0 +1,61 @@
+#ifndef VULKAN_BACKEND_LAYOUT_CACHE_H
+#define VULKAN_BACKEND_LAYOUT_CACHE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+
+typedef struct VulkanLayoutEntry {
+  uint64_t hash;
+  // the description the layout was created from, compared on a hash hit
+  uint8_t* key;
+  size_t key_size;
+  union {
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+  };
+} VulkanLayoutEntry;
+
+typedef struct VulkanLayoutTable {
+  VulkanLayoutEntry* entries;
+  uint32_t count;
+  uint32_t capacity;
+  // open addressing, entry index + 1 per slot, 0 marks an empty slot
+  uint32_t* slots;
+  uint32_t slot_capacity;
+} VulkanLayoutTable;
+
+// Deduplicates descriptor set layouts and pipeline layouts by their create
+// info. Equal descriptions map to the same handle, so pipeline layouts
+// made of cached set layouts are deduplicated too. Layouts are owned by the
+// cache and live until it is destroyed. Not thread safe.
+typedef struct VulkanLayoutCache {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanLayoutTable set_layouts;
+  VulkanLayoutTable pipeline_layouts;
+  uint32_t hit_count;
+  bool is_cache_init;
+} VulkanLayoutCache;
+
+void vulkan_layout_cache_init(VulkanLayoutCache* cache,
+                              const VulkanDevice* vk_device);
+void vulkan_layout_cache_reset(VulkanLayoutCache* cache);
+void vulkan_layout_cache_destroy(VulkanLayoutCache* cache);
+
+// the binding order does not matter, a VkDescriptorSetLayoutBindingFlags
+// CreateInfo is the only extension structure understood
+Result(int, ErrorMessage) vulkan_layout_cache_get_set_layout(
+    VulkanLayoutCache* cache,
+    const VkDescriptorSetLayoutCreateInfo* create_info,
+    VkDescriptorSetLayout* layout);
+Result(int, ErrorMessage) vulkan_layout_cache_get_pipeline_layout(
+    VulkanLayoutCache* cache,
+    const VkPipelineLayoutCreateInfo* create_info,
+    VkPipelineLayout* layout);
+
+void vulkan_layout_cache_log_stats(const VulkanLayoutCache* cache);
+
+#endif
@@ -0,0 +1,213 @@
+#include "./mesh.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/file_map.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./functions.h"
+
+// the sections the GPU reads, the meshlets only go to the CPU copy
+static const MeshSection vulkan_mesh_gpu_sections[] = {
+    MESH_SECTION_POSITIONS,
+    MESH_SECTION_NORMALS,
+    MESH_SECTION_INDICES,
+};
+
+#define VULKAN_MESH_GPU_SECTION_COUNT                                      \
+  (sizeof(vulkan_mesh_gpu_sections) / sizeof(vulkan_mesh_gpu_sections[0]))
+
+static Result(int, ErrorMessage)
+    vulkan_mesh_load_mapped(VulkanMesh* mesh,
+                            VulkanAllocator* allocator,
+                            VulkanUploader* uploader,
+                            const uint8_t* data,
+                            size_t size) {
+  const MeshFileHeader* header = nullptr;
+  auto result = mesh_file_validate(data, size, &header);
+  if (!result.is_ok) {
+    return result;
+  }
+  if (header->vertex_count == 0 || header->index_count == 0) {
+    return Err(int, ErrorMessage)("Mesh has no triangles");
+  }
+
+  mesh->vertex_count = header->vertex_count;
+  mesh->index_count = header->index_count;
+  mesh->index_type = header->index_size == sizeof(uint16_t)
+                         ? VK_INDEX_TYPE_UINT16
+                         : VK_INDEX_TYPE_UINT32;
+  for (uint32_t i = 0; i < 3; i++) {
+    mesh->position_offset[i] = header->position_offset[i];
+    mesh->position_scale[i] = header->position_scale[i];
+    mesh->center[i] = header->center[i];
+  }
+  mesh->radius = header->radius;
+
+  if (header->meshlet_count > 0) {
+    size_t meshlets_size = sizeof(MeshMeshlet) * header->meshlet_count;
+    mesh->meshlets = mem_alloc(meshlets_size);
+    CHECK_ALLOC(mesh->meshlets, Err(int, ErrorMessage)(
+                                    "Unable to allocate memory for meshlets"));
+    mem_copy(mesh->meshlets,
+             mesh_file_section(data, header, MESH_SECTION_MESHLETS),
+             meshlets_size);
+    mesh->meshlet_count = header->meshlet_count;
+  }
+
+  // the converter writes the GPU sections back to back, they are copied as
+  // one range whatever the order
+  uint64_t begin = UINT64_MAX;
+  uint64_t end = 0;
+  for (uint32_t i = 0; i < VULKAN_MESH_GPU_SECTION_COUNT; i++) {
+    const MeshSectionRange* range =
+        &header->sections[vulkan_mesh_gpu_sections[i]];
+    begin = SDL_min(begin, range->offset);
+    end = SDL_max(end, range->offset + range->size);
+  }
+  for (uint32_t i = 0; i < VULKAN_MESH_GPU_SECTION_COUNT; i++) {
+    MeshSection section = vulkan_mesh_gpu_sections[i];
+    mesh->offsets[section] = header->sections[section].offset - begin;
+  }
+
+  VkBufferCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = end - begin,
+      .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  result = vulkan_allocator_create_buffer(
+      allocator, &create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+      &mesh->buffer, &mesh->allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  mesh->is_buffer_init = true;
+
+  // a single upload may not exceed the staging ring
+  VkDeviceSize chunk_size = SDL_max(uploader->ring_size / 2, 1);
+  for (VkDeviceSize offset = 0; offset < end - begin; offset += chunk_size) {
+    VkDeviceSize copy_size = SDL_min(chunk_size, end - begin - offset);
+    result = vulkan_uploader_upload_buffer(uploader, mesh->buffer, offset,
+                                           data + begin + offset, copy_size);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_mesh_load(VulkanMesh* mesh,
+                                           VulkanAllocator* allocator,
+                                           VulkanUploader* uploader,
+                                           const char* path) {
+  uint64_t start = SDL_GetPerformanceCounter();
+  mesh->is_mesh_init = true;
+  FileMap map;
+  auto result = file_map_open(&map, path);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_mesh_load_mapped(mesh, allocator, uploader, map.data,
+                                   map.size);
+  file_map_close(&map);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // what the same vertices take as float positions and normals with 32 bit
+  // indices
+  uint64_t unpacked_size = (uint64_t)mesh->vertex_count * sizeof(float[6]) +
+                           (uint64_t)mesh->index_count * sizeof(uint32_t);
+  double elapsed_ms = (double)(SDL_GetPerformanceCounter() - start) *
+                      1000.0 / (double)SDL_GetPerformanceFrequency();
+  log_debug("Loaded mesh %s: %u vertices, %u triangles, %u meshlets, "
+            "%llu KiB on the GPU (%llu KiB unpacked) in %.3f ms",
+            path, mesh->vertex_count, mesh->index_count / 3,
+            mesh->meshlet_count,
+            (unsigned long long)(mesh->allocation.size / 1024),
+            (unsigned long long)(unpacked_size / 1024), elapsed_ms);
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_mesh_reset(VulkanMesh* mesh) {
+  mesh->buffer = VK_NULL_HANDLE;
+  for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+    mesh->offsets[i] = 0;
+  }
+  mesh->index_type = VK_INDEX_TYPE_UINT16;
+  mesh->vertex_count = 0;
+  mesh->index_count = 0;
+  mesh->meshlets = nullptr;
+  mesh->meshlet_count = 0;
+  for (uint32_t i = 0; i < 3; i++) {
+    mesh->position_offset[i] = 0.0f;
+    mesh->position_scale[i] = 0.0f;
+    mesh->center[i] = 0.0f;
+  }
+  mesh->radius = 0.0f;
+  mesh->is_buffer_init = false;
+  mesh->is_mesh_init = false;
+}
+
+void vulkan_mesh_destroy(VulkanMesh* mesh, VulkanAllocator* allocator) {
+  if (!mesh->is_mesh_init) {
+    return;
+  }
+  if (mesh->is_buffer_init) {
+    vulkan_allocator_destroy_buffer(allocator, mesh->buffer,
+                                    &mesh->allocation);
+  }
+  mem_free(mesh->meshlets);
+  vulkan_mesh_reset(mesh);
+}
+
+void vulkan_mesh_bind(const VulkanMesh* mesh,
+                      const VulkanDeviceFunctions* fn,
+                      VkCommandBuffer command_buffer) {
+  VkBuffer buffers[VULKAN_MESH_BINDING_COUNT] = {mesh->buffer, mesh->buffer};
+  VkDeviceSize offsets[VULKAN_MESH_BINDING_COUNT] = {
+      [VULKAN_MESH_POSITION_BINDING] = mesh->offsets[MESH_SECTION_POSITIONS],
+      [VULKAN_MESH_NORMAL_BINDING] = mesh->offsets[MESH_SECTION_NORMALS],
+  };
+  fn->vkCmdBindVertexBuffers(command_buffer, 0, VULKAN_MESH_BINDING_COUNT,
+                             buffers, offsets);
+  fn->vkCmdBindIndexBuffer(command_buffer, mesh->buffer,
+                           mesh->offsets[MESH_SECTION_INDICES],
+                           mesh->index_type);
+}
+
+void vulkan_mesh_vertex_input(
+    VkVertexInputBindingDescription bindings[VULKAN_MESH_BINDING_COUNT],
+    VkVertexInputAttributeDescription attributes[VULKAN_MESH_BINDING_COUNT]) {
+  bindings[VULKAN_MESH_POSITION_BINDING] = (VkVertexInputBindingDescription){
+      .binding = VULKAN_MESH_POSITION_BINDING,
+      .stride = sizeof(uint16_t[4]),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  bindings[VULKAN_MESH_NORMAL_BINDING] = (VkVertexInputBindingDescription){
+      .binding = VULKAN_MESH_NORMAL_BINDING,
+      .stride = sizeof(int16_t[2]),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  attributes[VULKAN_MESH_POSITION_BINDING] =
+      (VkVertexInputAttributeDescription){
+          .location = VULKAN_MESH_POSITION_BINDING,
+          .binding = VULKAN_MESH_POSITION_BINDING,
+          .format = VULKAN_MESH_POSITION_FORMAT,
+          .offset = 0,
+      };
+  attributes[VULKAN_MESH_NORMAL_BINDING] = (VkVertexInputAttributeDescription){
+      .location = VULKAN_MESH_NORMAL_BINDING,
+      .binding = VULKAN_MESH_NORMAL_BINDING,
+      .format = VULKAN_MESH_NORMAL_FORMAT,
+      .offset = 0,
+  };
+}
@@ -0,0 +1,60 @@
+#ifndef VULKAN_BACKEND_MESH_H
+#define VULKAN_BACKEND_MESH_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../assets/mesh_format.h"
+#include "../result.h"
+#include "./allocator.h"
+#include "./uploader.h"
+
+#define VULKAN_MESH_POSITION_BINDING 0
+#define VULKAN_MESH_NORMAL_BINDING 1
+#define VULKAN_MESH_BINDING_COUNT 2
+// positions dequantize with the mesh's offset and scale in the shader
+#define VULKAN_MESH_POSITION_FORMAT VK_FORMAT_R16G16B16A16_UNORM
+#define VULKAN_MESH_NORMAL_FORMAT VK_FORMAT_R16G16_SNORM
+
+// A mesh file uploaded into one device local buffer. The sections after the
+// header go to the GPU exactly as they are in the file, the vertex and index
+// bindings point at their offsets. The meshlets stay on the CPU as well, to
+// be handed to culling.
+typedef struct VulkanMesh {
+  VkBuffer buffer;
+  VulkanAllocation allocation;
+  // of each section inside the buffer
+  VkDeviceSize offsets[MESH_SECTION_COUNT];
+  VkIndexType index_type;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  MeshMeshlet* meshlets;
+  uint32_t meshlet_count;
+  float position_offset[3];
+  float position_scale[3];
+  float center[3];
+  float radius;
+  bool is_buffer_init;
+  bool is_mesh_init;
+} VulkanMesh;
+
+// Queues the upload, the mesh is drawable in the frames that acquire the
+// uploader's next flush
+Result(int, ErrorMessage) vulkan_mesh_load(VulkanMesh* mesh,
+                                           VulkanAllocator* allocator,
+                                           VulkanUploader* uploader,
+                                           const char* path);
+void vulkan_mesh_reset(VulkanMesh* mesh);
+// no submitted frame may still draw the mesh
+void vulkan_mesh_destroy(VulkanMesh* mesh, VulkanAllocator* allocator);
+
+// binds the vertex streams and the index buffer
+void vulkan_mesh_bind(const VulkanMesh* mesh,
+                      const VulkanDeviceFunctions* fn,
+                      VkCommandBuffer command_buffer);
+// vertex input of pipelines drawing meshes, one binding per stream
+void vulkan_mesh_vertex_input(
+    VkVertexInputBindingDescription bindings[VULKAN_MESH_BINDING_COUNT],
+    VkVertexInputAttributeDescription attributes[VULKAN_MESH_BINDING_COUNT]);
+
+#endif
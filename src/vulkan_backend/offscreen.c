@@ -0,0 +1,188 @@
+#include "./offscreen.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/arena.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./functions.h"
+
+static Result(int, ErrorMessage)
+    vulkan_offscreen_init_readback(VulkanOffscreenTarget* target,
+                                   VulkanAllocator* allocator,
+                                   uint32_t slot) {
+  VkBufferCreateInfo buffer_create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = vulkan_offscreen_target_readback_size(target),
+      .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  // cached memory is preferred since the CPU reads every byte of it
+  auto result = vulkan_allocator_create_buffer(
+      allocator, &buffer_create_info,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &target->readback_buffers[slot],
+      &target->readback_allocations[slot]);
+  if (!result.is_ok) {
+    return result;
+  }
+  target->is_readback_buffer_init[slot] = true;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_init(VulkanOffscreenTarget* target,
+                                 VulkanAllocator* allocator,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t frames_in_flight) {
+  target->fn = allocator->fn;
+  target->width = width;
+  target->height = height;
+  target->readback_count = frames_in_flight;
+  target->is_target_init = true;
+
+  for (uint32_t i = 0; i < frames_in_flight; i++) {
+    auto result = vulkan_offscreen_init_readback(target, allocator, i);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+  log_debug("Initialized offscreen target %ux%u", width, height);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_offscreen_target_reset(VulkanOffscreenTarget* target) {
+  target->readback_count = 0;
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    target->is_readback_buffer_init[i] = false;
+  }
+  target->is_target_init = false;
+}
+
+void vulkan_offscreen_target_destroy(VulkanOffscreenTarget* target,
+                                     VulkanAllocator* allocator) {
+  for (uint32_t i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
+    if (target->is_readback_buffer_init[i]) {
+      vulkan_allocator_destroy_buffer(allocator, target->readback_buffers[i],
+                                      &target->readback_allocations[i]);
+    }
+  }
+  vulkan_offscreen_target_reset(target);
+}
+
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_resize(VulkanOffscreenTarget* target,
+                                   VulkanAllocator* allocator,
+                                   uint32_t width,
+                                   uint32_t height) {
+  uint32_t frames_in_flight = target->readback_count;
+  vulkan_offscreen_target_destroy(target, allocator);
+  return vulkan_offscreen_target_init(target, allocator, width, height,
+                                      frames_in_flight);
+}
+
+VkDeviceSize vulkan_offscreen_target_readback_size(
+    const VulkanOffscreenTarget* target) {
+  return (VkDeviceSize)target->width * target->height *
+         VULKAN_OFFSCREEN_BYTES_PER_PIXEL;
+}
+
+void vulkan_offscreen_record_clear(const VulkanDeviceFunctions* fn,
+                                   VkCommandBuffer command_buffer,
+                                   VkImage image,
+                                   VkClearColorValue clear_color) {
+  VkImageSubresourceRange color_range = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+  };
+  fn->vkCmdClearColorImage(command_buffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color,
+                           1, &color_range);
+}
+
+void vulkan_offscreen_target_record_readback(
+    const VulkanOffscreenTarget* target,
+    VkCommandBuffer command_buffer,
+    VkImage image,
+    uint32_t slot) {
+  VkBufferImageCopy region = {
+      .bufferOffset = 0,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .mipLevel = 0,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {target->width, target->height, 1},
+  };
+  target->fn->vkCmdCopyImageToBuffer(command_buffer, image,
+                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                     target->readback_buffers[slot], 1,
+                                     &region);
+}
+
+const uint8_t* vulkan_offscreen_target_pixels(
+    const VulkanOffscreenTarget* target,
+    uint32_t slot) {
+  return target->readback_allocations[slot].mapped;
+}
+
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_write_ppm(const VulkanOffscreenTarget* target,
+                                      uint32_t slot,
+                                      const char* path) {
+  SDL_RWops* file = SDL_RWFromFile(path, "wb");
+  if (!file) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+
+  char header[64];
+  int header_size = SDL_snprintf(header, sizeof(header), "P6\n%u %u\n255\n",
+                                 target->width, target->height);
+
+  ArenaScratch scratch = arena_scratch_begin();
+  uint8_t* row =
+      scratch.arena ? arena_alloc(scratch.arena, (size_t)target->width * 3)
+                    : nullptr;
+  if (!row) {
+    arena_scratch_end(scratch);
+    SDL_RWclose(file);
+    return Err(int, ErrorMessage)("Unable to allocate memory for PPM row");
+  }
+
+  bool success = SDL_RWwrite(file, header, header_size, 1) == 1;
+  for (uint32_t y = 0; y < target->height && success; y++) {
+    const uint8_t* pixels =
+        vulkan_offscreen_target_pixels(target, slot) +
+        (size_t)y * target->width * VULKAN_OFFSCREEN_BYTES_PER_PIXEL;
+    for (uint32_t x = 0; x < target->width; x++) {
+      row[x * 3 + 0] = pixels[x * VULKAN_OFFSCREEN_BYTES_PER_PIXEL + 0];
+      row[x * 3 + 1] = pixels[x * VULKAN_OFFSCREEN_BYTES_PER_PIXEL + 1];
+      row[x * 3 + 2] = pixels[x * VULKAN_OFFSCREEN_BYTES_PER_PIXEL + 2];
+    }
+    success = SDL_RWwrite(file, row, (size_t)target->width * 3, 1) == 1;
+  }
+
+  arena_scratch_end(scratch);
+  SDL_RWclose(file);
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to write PPM file");
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,69 @@
+#ifndef VULKAN_BACKEND_OFFSCREEN_H
+#define VULKAN_BACKEND_OFFSCREEN_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./allocator.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+
+#define VULKAN_OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+#define VULKAN_OFFSCREEN_BYTES_PER_PIXEL 4
+
+// Color image rendered without a swapchain, every frame is copied into a
+// host visible buffer of its frame slot so it can be inspected on the CPU
+// once the slot fence signaled. The image itself is a render graph
+// transient, the target owns what outlives the frame.
+typedef struct VulkanOffscreenTarget {
+  const VulkanDeviceFunctions* fn;
+  uint32_t width;
+  uint32_t height;
+  VkBuffer readback_buffers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  VulkanAllocation readback_allocations[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t readback_count;
+  bool is_readback_buffer_init[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  bool is_target_init;
+} VulkanOffscreenTarget;
+
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_init(VulkanOffscreenTarget* target,
+                                 VulkanAllocator* allocator,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 uint32_t frames_in_flight);
+void vulkan_offscreen_target_reset(VulkanOffscreenTarget* target);
+void vulkan_offscreen_target_destroy(VulkanOffscreenTarget* target,
+                                     VulkanAllocator* allocator);
+// recreates the readback buffers for the new size, no submitted frame may
+// still copy into them
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_resize(VulkanOffscreenTarget* target,
+                                   VulkanAllocator* allocator,
+                                   uint32_t width,
+                                   uint32_t height);
+
+VkDeviceSize vulkan_offscreen_target_readback_size(
+    const VulkanOffscreenTarget* target);
+// image must be VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+void vulkan_offscreen_record_clear(const VulkanDeviceFunctions* fn,
+                                   VkCommandBuffer command_buffer,
+                                   VkImage image,
+                                   VkClearColorValue clear_color);
+// copies image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, into the readback
+// buffer of slot, the caller makes the copy visible to the host
+void vulkan_offscreen_target_record_readback(
+    const VulkanOffscreenTarget* target,
+    VkCommandBuffer command_buffer,
+    VkImage image,
+    uint32_t slot);
+const uint8_t* vulkan_offscreen_target_pixels(
+    const VulkanOffscreenTarget* target,
+    uint32_t slot);
+Result(int, ErrorMessage)
+    vulkan_offscreen_target_write_ppm(const VulkanOffscreenTarget* target,
+                                      uint32_t slot,
+                                      const char* path);
+
+#endif
@@ -0,0 +1,294 @@
+#include "./parallel_recorder.h"
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+// secondary command buffers are allocated in batches as the draw list grows,
+// a pool keeps them across frames and only resets their contents
+#define VULKAN_RECORDER_COMMAND_BUFFER_BATCH 8
+
+typedef struct VulkanRecordJob {
+  VulkanParallelRecorder* recorder;
+  VkCommandBufferInheritanceInfo inheritance;
+  VkCommandBufferUsageFlags usage;
+  VulkanRecordFunction function;
+  void* user_data;
+  uint32_t item_count;
+  uint32_t items_per_chunk;
+} VulkanRecordJob;
+
+static VkResult vulkan_worker_command_pool_acquire(
+    VulkanWorkerCommandPool* pool,
+    const VulkanDeviceFunctions* fn,
+    VkDevice device,
+    VkCommandBuffer* command_buffer) {
+  if (pool->used_count == pool->command_buffer_count) {
+    uint32_t count =
+        pool->command_buffer_count + VULKAN_RECORDER_COMMAND_BUFFER_BATCH;
+    VkCommandBuffer* command_buffers =
+        mem_realloc(pool->command_buffers, sizeof(VkCommandBuffer) * count);
+    if (!command_buffers) {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+    pool->command_buffers = command_buffers;
+
+    VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = pool->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = VULKAN_RECORDER_COMMAND_BUFFER_BATCH,
+    };
+    VkResult result = fn->vkAllocateCommandBuffers(
+        device, &allocate_info,
+        &pool->command_buffers[pool->command_buffer_count]);
+    if (result != VK_SUCCESS) {
+      return result;
+    }
+    pool->command_buffer_count = count;
+  }
+
+  *command_buffer = pool->command_buffers[pool->used_count++];
+  return VK_SUCCESS;
+}
+
+static void vulkan_record_chunks(void* data,
+                                 uint32_t begin,
+                                 uint32_t end,
+                                 uint32_t worker_index) {
+  VulkanRecordJob* job = data;
+  VulkanParallelRecorder* recorder = job->recorder;
+  VulkanWorkerCommandPool* pool =
+      &recorder->pools[recorder->current_slot][worker_index];
+
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = job->usage,
+      .pInheritanceInfo = &job->inheritance,
+  };
+
+  for (uint32_t chunk = begin; chunk < end; chunk++) {
+    uint32_t first = chunk * job->items_per_chunk;
+    uint32_t count = job->item_count - first < job->items_per_chunk
+                         ? job->item_count - first
+                         : job->items_per_chunk;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VkResult result = vulkan_worker_command_pool_acquire(
+        pool, recorder->fn, recorder->device, &command_buffer);
+    if (result == VK_SUCCESS) {
+      result = recorder->fn->vkBeginCommandBuffer(command_buffer, &begin_info);
+    }
+    if (result == VK_SUCCESS) {
+      job->function(command_buffer, first, count, job->user_data);
+      result = recorder->fn->vkEndCommandBuffer(command_buffer);
+    }
+
+    recorder->chunk_command_buffers[chunk] = command_buffer;
+    recorder->chunk_results[chunk] = result;
+  }
+}
+
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_init(VulkanParallelRecorder* recorder,
+                                  const VulkanDevice* vk_device,
+                                  JobSystem* job_system,
+                                  uint32_t frames_in_flight) {
+  if (frames_in_flight > VULKAN_MAX_FRAMES_IN_FLIGHT) {
+    return Err(int, ErrorMessage)("Unsupported number of frames in flight");
+  }
+
+  recorder->device = vk_device->device;
+  recorder->fn = &vk_device->fn;
+  recorder->job_system = job_system;
+  recorder->frame_count = frames_in_flight;
+  recorder->current_slot = 0;
+
+  VkCommandPoolCreateInfo pool_create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = vk_device->graphics_queue_family,
+  };
+  for (uint32_t slot = 0; slot < frames_in_flight; slot++) {
+    for (uint32_t worker = 0; worker < job_system->worker_count; worker++) {
+      VulkanWorkerCommandPool* pool = &recorder->pools[slot][worker];
+      VkResult result = recorder->fn->vkCreateCommandPool(
+          recorder->device, &pool_create_info, nullptr, &pool->command_pool);
+      if (result != VK_SUCCESS) {
+        return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+      }
+      pool->is_command_pool_init = true;
+    }
+  }
+  recorder->is_recorder_init = true;
+  log_debug("Initialized parallel recorder with %u command pools per frame",
+            job_system->worker_count);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_parallel_recorder_reset(VulkanParallelRecorder* recorder) {
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    for (uint32_t worker = 0; worker < JOB_SYSTEM_MAX_WORKERS; worker++) {
+      VulkanWorkerCommandPool* pool = &recorder->pools[slot][worker];
+      pool->command_buffers = nullptr;
+      pool->command_buffer_count = 0;
+      pool->used_count = 0;
+      pool->is_command_pool_init = false;
+    }
+  }
+  recorder->chunk_command_buffers = nullptr;
+  recorder->chunk_results = nullptr;
+  recorder->chunk_capacity = 0;
+  recorder->is_recorder_init = false;
+}
+
+void vulkan_parallel_recorder_destroy(VulkanParallelRecorder* recorder) {
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    for (uint32_t worker = 0; worker < JOB_SYSTEM_MAX_WORKERS; worker++) {
+      VulkanWorkerCommandPool* pool = &recorder->pools[slot][worker];
+      // destroying the pool frees its command buffers
+      if (pool->is_command_pool_init) {
+        recorder->fn->vkDestroyCommandPool(recorder->device, pool->command_pool,
+                                           nullptr);
+      }
+      if (pool->command_buffers) {
+        mem_free(pool->command_buffers);
+      }
+    }
+  }
+  if (recorder->chunk_command_buffers) {
+    mem_free(recorder->chunk_command_buffers);
+  }
+  if (recorder->chunk_results) {
+    mem_free(recorder->chunk_results);
+  }
+  vulkan_parallel_recorder_reset(recorder);
+}
+
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_begin_frame(VulkanParallelRecorder* recorder,
+                                         uint32_t slot) {
+  if (slot >= recorder->frame_count) {
+    return Err(int, ErrorMessage)("Frame slot out of range");
+  }
+  recorder->current_slot = slot;
+
+  for (uint32_t worker = 0; worker < recorder->job_system->worker_count;
+       worker++) {
+    VulkanWorkerCommandPool* pool = &recorder->pools[slot][worker];
+    VkResult result =
+        recorder->fn->vkResetCommandPool(recorder->device, pool->command_pool,
+                                         0);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    pool->used_count = 0;
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_parallel_recorder_reserve(VulkanParallelRecorder* recorder,
+                                     uint32_t chunk_count) {
+  if (chunk_count <= recorder->chunk_capacity) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkCommandBuffer* command_buffers =
+      mem_realloc(recorder->chunk_command_buffers,
+                  sizeof(VkCommandBuffer) * chunk_count);
+  CHECK_ALLOC(command_buffers,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for secondary command buffers"));
+  recorder->chunk_command_buffers = command_buffers;
+
+  VkResult* results =
+      mem_realloc(recorder->chunk_results, sizeof(VkResult) * chunk_count);
+  CHECK_ALLOC(results,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for secondary command buffers"));
+  recorder->chunk_results = results;
+  recorder->chunk_capacity = chunk_count;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_record(
+        VulkanParallelRecorder* recorder,
+        VkCommandBuffer primary,
+        const VkCommandBufferInheritanceInfo* inheritance,
+        uint32_t item_count,
+        VulkanRecordFunction function,
+        void* user_data) {
+  if (item_count == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  JobSystem* job_system = recorder->job_system;
+  uint32_t target_chunks =
+      job_system->worker_count * VULKAN_RECORDER_CHUNKS_PER_WORKER;
+  uint32_t items_per_chunk = (item_count + target_chunks - 1) / target_chunks;
+  if (items_per_chunk < VULKAN_RECORDER_MIN_ITEMS_PER_CHUNK) {
+    items_per_chunk = VULKAN_RECORDER_MIN_ITEMS_PER_CHUNK;
+  }
+  uint32_t chunk_count = (item_count + items_per_chunk - 1) / items_per_chunk;
+
+  auto reserve_result = vulkan_parallel_recorder_reserve(recorder, chunk_count);
+  if (!reserve_result.is_ok) {
+    return reserve_result;
+  }
+
+  VulkanRecordJob job = {
+      .recorder = recorder,
+      .inheritance =
+          {
+              .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+              .pNext = nullptr,
+              .renderPass = VK_NULL_HANDLE,
+              .subpass = 0,
+              .framebuffer = VK_NULL_HANDLE,
+              .occlusionQueryEnable = VK_FALSE,
+              .queryFlags = 0,
+              .pipelineStatistics = 0,
+          },
+      .usage = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .function = function,
+      .user_data = user_data,
+      .item_count = item_count,
+      .items_per_chunk = items_per_chunk,
+  };
+  if (inheritance) {
+    job.inheritance = *inheritance;
+    if (inheritance->renderPass != VK_NULL_HANDLE) {
+      job.usage |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+  }
+
+  // the calling thread is worker 0 and records chunks too while it waits
+  JobCounter counter;
+  job_counter_init(&counter);
+  job_system_parallel_for(job_system, 0, vulkan_record_chunks, &job,
+                          chunk_count, 1, &counter);
+  job_system_wait(job_system, 0, &counter);
+
+  for (uint32_t chunk = 0; chunk < chunk_count; chunk++) {
+    if (recorder->chunk_results[chunk] != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(
+          vulkan_result_to_string(recorder->chunk_results[chunk]));
+    }
+  }
+
+  // chunks are executed in draw list order no matter which worker recorded
+  // them, the result is the same as recording the list on one thread
+  recorder->fn->vkCmdExecuteCommands(primary, chunk_count,
+                                     recorder->chunk_command_buffers);
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,75 @@
+#ifndef VULKAN_BACKEND_PARALLEL_RECORDER_H
+#define VULKAN_BACKEND_PARALLEL_RECORDER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "../utils/job_system.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+
+// draw lists are cut into about this many chunks per worker so a worker that
+// finishes early can steal from a slow one
+#define VULKAN_RECORDER_CHUNKS_PER_WORKER 4
+// below this a chunk costs more in vkBeginCommandBuffer and
+// vkCmdExecuteCommands than it saves
+#define VULKAN_RECORDER_MIN_ITEMS_PER_CHUNK 64
+
+// records the draw list items [first, first + count) into a secondary command
+// buffer, called concurrently from every worker
+typedef void (*VulkanRecordFunction)(VkCommandBuffer command_buffer,
+                                     uint32_t first,
+                                     uint32_t count,
+                                     void* user_data);
+
+// Secondary command buffers of one worker for one frame slot, only that worker
+// touches it while the slot is being recorded
+typedef struct VulkanWorkerCommandPool {
+  VkCommandPool command_pool;
+  VkCommandBuffer* command_buffers;
+  uint32_t command_buffer_count;
+  uint32_t used_count;
+  bool is_command_pool_init;
+} VulkanWorkerCommandPool;
+
+typedef struct VulkanParallelRecorder {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  JobSystem* job_system;
+  VulkanWorkerCommandPool pools[VULKAN_MAX_FRAMES_IN_FLIGHT]
+                               [JOB_SYSTEM_MAX_WORKERS];
+  uint32_t frame_count;
+  uint32_t current_slot;
+  // one entry per chunk of the draw list being recorded
+  VkCommandBuffer* chunk_command_buffers;
+  VkResult* chunk_results;
+  uint32_t chunk_capacity;
+  bool is_recorder_init;
+} VulkanParallelRecorder;
+
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_init(VulkanParallelRecorder* recorder,
+                                  const VulkanDevice* vk_device,
+                                  JobSystem* job_system,
+                                  uint32_t frames_in_flight);
+void vulkan_parallel_recorder_reset(VulkanParallelRecorder* recorder);
+void vulkan_parallel_recorder_destroy(VulkanParallelRecorder* recorder);
+
+// resets the worker pools of the slot, the slot fence must have signaled
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_begin_frame(VulkanParallelRecorder* recorder,
+                                         uint32_t slot);
+// records item_count draw list items on the job system and executes the
+// secondary buffers in draw list order on the primary command buffer.
+// inheritance may be nullptr outside of a render pass.
+Result(int, ErrorMessage)
+    vulkan_parallel_recorder_record(
+        VulkanParallelRecorder* recorder,
+        VkCommandBuffer primary,
+        const VkCommandBufferInheritanceInfo* inheritance,
+        uint32_t item_count,
+        VulkanRecordFunction function,
+        void* user_data);
+
+#endif
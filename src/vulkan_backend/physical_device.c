@@ -0,0 +1,325 @@
+#include "./physical_device.h"
+
+#include <string.h>
+
+#include "../utils/arena.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+// The device type dominates the score, a discrete GPU always beats an
+// integrated one. Within a type the bigger device local heap wins, dedicated
+// queues only break ties, async compute counting more than a DMA queue.
+#define VULKAN_PHYSICAL_DEVICE_TYPE_WEIGHT (1ull << 40)
+#define VULKAN_PHYSICAL_DEVICE_HEAP_WEIGHT 4ull
+#define VULKAN_PHYSICAL_DEVICE_QUEUE_WEIGHT 1ull
+
+static uint64_t vulkan_physical_device_type_rank(VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static const char* vulkan_physical_device_type_name(
+    VkPhysicalDeviceType type) {
+  switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+      return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+      return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+      return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+      return "cpu";
+    default:
+      return "other";
+  }
+}
+
+// Prefers a family with the wanted flags and none of the avoided ones, those
+// are the dedicated hardware queues (DMA engines, async compute)
+static bool vulkan_physical_device_find_dedicated_family(
+    const VulkanPhysicalDeviceInfo* info,
+    VkQueueFlags wanted,
+    VkQueueFlags avoided,
+    uint32_t* queue_family) {
+  for (uint32_t i = 0; i < info->queue_family_count; i++) {
+    const VkQueueFamilyProperties* family = &info->queue_families[i];
+    if ((family->queueFlags & wanted) == wanted &&
+        (family->queueFlags & avoided) == 0 && family->queueCount > 0) {
+      *queue_family = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool vulkan_physical_device_find_graphics_family(
+    const VulkanInstanceFunctions* fn,
+    VulkanPhysicalDeviceInfo* info,
+    VkSurfaceKHR surface) {
+  for (uint32_t i = 0; i < info->queue_family_count; i++) {
+    const VkQueueFamilyProperties* family = &info->queue_families[i];
+    if (!(family->queueFlags & VK_QUEUE_GRAPHICS_BIT) ||
+        family->queueCount == 0) {
+      continue;
+    }
+    if (surface != VK_NULL_HANDLE) {
+      VkBool32 present_supported = VK_FALSE;
+      if (fn->vkGetPhysicalDeviceSurfaceSupportKHR(
+              info->physical_device, i, surface, &present_supported) !=
+              VK_SUCCESS ||
+          !present_supported) {
+        continue;
+      }
+    }
+    info->graphics_queue_family = i;
+    return true;
+  }
+  return false;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_physical_device_query(const VulkanInstanceFunctions* fn,
+                                 VkPhysicalDevice physical_device,
+                                 VulkanPhysicalDeviceInfo* info) {
+  info->physical_device = physical_device;
+  fn->vkGetPhysicalDeviceProperties(physical_device, &info->properties);
+  fn->vkGetPhysicalDeviceFeatures(physical_device, &info->features);
+  fn->vkGetPhysicalDeviceMemoryProperties(physical_device,
+                                          &info->memory_properties);
+  info->features12 = (VkPhysicalDeviceVulkan12Features){
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+  };
+  info->properties12 = (VkPhysicalDeviceVulkan12Properties){
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES,
+  };
+  if (info->properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceFeatures2 features2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &info->features12,
+    };
+    fn->vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+    VkPhysicalDeviceProperties2 properties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &info->properties12,
+    };
+    fn->vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+    info->features12.pNext = nullptr;
+    info->properties12.pNext = nullptr;
+  }
+
+  // families past the limit are never picked, real devices have a handful
+  info->queue_family_count = VULKAN_PHYSICAL_DEVICE_MAX_QUEUE_FAMILIES;
+  fn->vkGetPhysicalDeviceQueueFamilyProperties(
+      physical_device, &info->queue_family_count, info->queue_families);
+
+  info->device_local_bytes = 0;
+  for (uint32_t i = 0; i < info->memory_properties.memoryHeapCount; i++) {
+    const VkMemoryHeap* heap = &info->memory_properties.memoryHeaps[i];
+    if ((heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+        heap->size > info->device_local_bytes) {
+      info->device_local_bytes = heap->size;
+    }
+  }
+
+  uint32_t count = 0;
+  VkResult result = fn->vkEnumerateDeviceExtensionProperties(
+      physical_device, nullptr, &count, nullptr);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if (count > 0) {
+    info->extensions = mem_alloc(sizeof(VkExtensionProperties) * count);
+    CHECK_ALLOC(info->extensions,
+                Err(int, ErrorMessage)(
+                    "Unable to allocate memory for device extensions"));
+    result = fn->vkEnumerateDeviceExtensionProperties(
+        physical_device, nullptr, &count, info->extensions);
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+  }
+  info->extension_count = count;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// returns nullptr when the device is suitable, otherwise the reason it is not
+static const char* vulkan_physical_device_evaluate(
+    const VulkanInstanceFunctions* fn,
+    VulkanPhysicalDeviceInfo* info,
+    VkSurfaceKHR surface,
+    uint32_t required_extension_count,
+    const char* const* required_extensions) {
+  for (uint32_t i = 0; i < required_extension_count; i++) {
+    if (!vulkan_physical_device_supports_extension(info,
+                                                   required_extensions[i])) {
+      return required_extensions[i];
+    }
+  }
+  if (!vulkan_physical_device_find_graphics_family(fn, info, surface)) {
+    return surface != VK_NULL_HANDLE ? "no graphics queue that can present"
+                                     : "no graphics queue";
+  }
+
+  info->compute_queue_family = info->graphics_queue_family;
+  vulkan_physical_device_find_dedicated_family(info, VK_QUEUE_COMPUTE_BIT,
+                                               VK_QUEUE_GRAPHICS_BIT,
+                                               &info->compute_queue_family);
+  info->transfer_queue_family = info->graphics_queue_family;
+  if (!vulkan_physical_device_find_dedicated_family(
+          info, VK_QUEUE_TRANSFER_BIT,
+          VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+          &info->transfer_queue_family)) {
+    vulkan_physical_device_find_dedicated_family(info, VK_QUEUE_TRANSFER_BIT,
+                                                 VK_QUEUE_GRAPHICS_BIT,
+                                                 &info->transfer_queue_family);
+  }
+
+  info->score =
+      vulkan_physical_device_type_rank(info->properties.deviceType) *
+          VULKAN_PHYSICAL_DEVICE_TYPE_WEIGHT +
+      (info->device_local_bytes / (1024 * 1024)) *
+          VULKAN_PHYSICAL_DEVICE_HEAP_WEIGHT +
+      (vulkan_physical_device_has_dedicated_compute(info) ? 2 : 0) *
+          VULKAN_PHYSICAL_DEVICE_QUEUE_WEIGHT +
+      (vulkan_physical_device_has_dedicated_transfer(info) ? 1 : 0) *
+          VULKAN_PHYSICAL_DEVICE_QUEUE_WEIGHT;
+
+  return nullptr;
+}
+
+Result(int, ErrorMessage)
+    vulkan_physical_device_select(const VulkanInstanceFunctions* fn,
+                                  VkInstance instance,
+                                  VkSurfaceKHR surface,
+                                  uint32_t required_extension_count,
+                                  const char* const* required_extensions,
+                                  VulkanPhysicalDeviceInfo* info) {
+  uint32_t count = 0;
+  VkResult result = fn->vkEnumeratePhysicalDevices(instance, &count, nullptr);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if (count == 0) {
+    return Err(int, ErrorMessage)("No Vulkan capable device found");
+  }
+
+  ArenaScratch scratch = arena_scratch_begin();
+  VkPhysicalDevice* physical_devices =
+      scratch.arena ? arena_alloc_array(scratch.arena, count,
+                                        sizeof(VkPhysicalDevice))
+                    : nullptr;
+  CHECK_ALLOC(physical_devices,
+              Err(int, ErrorMessage)(
+                  "Unable to allocate memory for physical devices"));
+  result = fn->vkEnumeratePhysicalDevices(instance, &count, physical_devices);
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  bool found = false;
+  for (uint32_t i = 0; i < count; i++) {
+    VulkanPhysicalDeviceInfo candidate;
+    vulkan_physical_device_info_reset(&candidate);
+    auto query_result =
+        vulkan_physical_device_query(fn, physical_devices[i], &candidate);
+    if (!query_result.is_ok) {
+      vulkan_physical_device_info_destroy(&candidate);
+      arena_scratch_end(scratch);
+      return query_result;
+    }
+
+    const char* reason = vulkan_physical_device_evaluate(
+        fn, &candidate, surface, required_extension_count, required_extensions);
+    if (reason) {
+      log_debug("GPU %u: %s is unsuitable (%s)", i,
+                candidate.properties.deviceName, reason);
+      vulkan_physical_device_info_destroy(&candidate);
+      continue;
+    }
+    log_debug("GPU %u: %s, %s, %llu MiB device local, score %llu", i,
+              candidate.properties.deviceName,
+              vulkan_physical_device_type_name(
+                  candidate.properties.deviceType),
+              (unsigned long long)(candidate.device_local_bytes /
+                                   (1024 * 1024)),
+              (unsigned long long)candidate.score);
+
+    if (found && candidate.score <= info->score) {
+      vulkan_physical_device_info_destroy(&candidate);
+      continue;
+    }
+    if (found) {
+      vulkan_physical_device_info_destroy(info);
+    }
+    *info = candidate;
+    found = true;
+  }
+  arena_scratch_end(scratch);
+
+  if (!found) {
+    return Err(int, ErrorMessage)("Unable to find a suitable physical device");
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_physical_device_info_reset(VulkanPhysicalDeviceInfo* info) {
+  info->physical_device = VK_NULL_HANDLE;
+  info->queue_family_count = 0;
+  info->extensions = nullptr;
+  info->extension_count = 0;
+  info->score = 0;
+}
+
+void vulkan_physical_device_info_destroy(VulkanPhysicalDeviceInfo* info) {
+  if (info->extensions) {
+    mem_free(info->extensions);
+  }
+  vulkan_physical_device_info_reset(info);
+}
+
+bool vulkan_physical_device_supports_extension(
+    const VulkanPhysicalDeviceInfo* info,
+    const char* name) {
+  for (uint32_t i = 0; i < info->extension_count; i++) {
+    if (strcmp(info->extensions[i].extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool vulkan_physical_device_supports_bindless(
+    const VulkanPhysicalDeviceInfo* info) {
+  const VkPhysicalDeviceVulkan12Features* features = &info->features12;
+  return features->descriptorIndexing && features->runtimeDescriptorArray &&
+         features->descriptorBindingPartiallyBound &&
+         features->descriptorBindingUpdateUnusedWhilePending &&
+         features->descriptorBindingSampledImageUpdateAfterBind &&
+         features->descriptorBindingStorageBufferUpdateAfterBind &&
+         features->shaderSampledImageArrayNonUniformIndexing;
+}
+
+bool vulkan_physical_device_has_dedicated_compute(
+    const VulkanPhysicalDeviceInfo* info) {
+  return info->compute_queue_family != info->graphics_queue_family;
+}
+
+bool vulkan_physical_device_has_dedicated_transfer(
+    const VulkanPhysicalDeviceInfo* info) {
+  return info->transfer_queue_family != info->graphics_queue_family;
+}
@@ -0,0 +1,62 @@
+#ifndef VULKAN_BACKEND_PHYSICAL_DEVICE_H
+#define VULKAN_BACKEND_PHYSICAL_DEVICE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./functions.h"
+
+#define VULKAN_PHYSICAL_DEVICE_MAX_QUEUE_FAMILIES 16
+
+// Everything the backend needs to know about the adapter, queried once at
+// selection. Subsystems read it from here instead of asking the driver.
+typedef struct VulkanPhysicalDeviceInfo {
+  VkPhysicalDevice physical_device;
+  VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceFeatures features;
+  // zeroed on devices older than Vulkan 1.2, pNext is always nullptr
+  VkPhysicalDeviceVulkan12Features features12;
+  VkPhysicalDeviceVulkan12Properties properties12;
+  VkPhysicalDeviceMemoryProperties memory_properties;
+  VkQueueFamilyProperties
+      queue_families[VULKAN_PHYSICAL_DEVICE_MAX_QUEUE_FAMILIES];
+  uint32_t queue_family_count;
+  VkExtensionProperties* extensions;
+  uint32_t extension_count;
+  // can present to the surface when one was given
+  uint32_t graphics_queue_family;
+  // the dedicated families fall back to the graphics family
+  uint32_t compute_queue_family;
+  uint32_t transfer_queue_family;
+  // size of the largest device local heap
+  VkDeviceSize device_local_bytes;
+  uint64_t score;
+} VulkanPhysicalDeviceInfo;
+
+// Picks the highest scoring adapter that has a graphics queue (able to
+// present to surface unless it is VK_NULL_HANDLE) and every required
+// extension
+Result(int, ErrorMessage)
+    vulkan_physical_device_select(const VulkanInstanceFunctions* fn,
+                                  VkInstance instance,
+                                  VkSurfaceKHR surface,
+                                  uint32_t required_extension_count,
+                                  const char* const* required_extensions,
+                                  VulkanPhysicalDeviceInfo* info);
+void vulkan_physical_device_info_reset(VulkanPhysicalDeviceInfo* info);
+void vulkan_physical_device_info_destroy(VulkanPhysicalDeviceInfo* info);
+
+bool vulkan_physical_device_supports_extension(
+    const VulkanPhysicalDeviceInfo* info,
+    const char* name);
+// descriptor indexing with update after bind for sampled images and storage
+// buffers, what the bindless table needs
+bool vulkan_physical_device_supports_bindless(
+    const VulkanPhysicalDeviceInfo* info);
+bool vulkan_physical_device_has_dedicated_compute(
+    const VulkanPhysicalDeviceInfo* info);
+bool vulkan_physical_device_has_dedicated_transfer(
+    const VulkanPhysicalDeviceInfo* info);
+
+#endif
@@ -0,0 +1,364 @@
+// fileno and fsync are POSIX, hidden by a strict -std
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "./pipeline_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+// headerSize, headerVersion, vendorID, deviceID, then the UUID
+#define VULKAN_PIPELINE_CACHE_BLOB_HEADER_SIZE (4 * sizeof(uint32_t) + 16)
+
+// returns why a cache file can not be used, nullptr when it can
+static const char* vulkan_pipeline_cache_validate(
+    const VulkanPipelineCache* pipeline_cache,
+    const uint8_t* file,
+    size_t file_size) {
+  VulkanPipelineCacheFileHeader header;
+  if (file_size < sizeof(header)) {
+    return "file too small";
+  }
+  mem_copy(&header, file, sizeof(header));
+
+  if (header.magic != VULKAN_PIPELINE_CACHE_MAGIC ||
+      header.version != VULKAN_PIPELINE_CACHE_VERSION) {
+    return "unknown file format";
+  }
+  if (header.vendor_id != pipeline_cache->vendor_id ||
+      header.device_id != pipeline_cache->device_id) {
+    return "written by another device";
+  }
+  if (header.driver_version != pipeline_cache->driver_version ||
+      memcmp(header.pipeline_cache_uuid, pipeline_cache->pipeline_cache_uuid,
+             VK_UUID_SIZE) != 0) {
+    return "written by another driver";
+  }
+  if (header.data_size != file_size - sizeof(header)) {
+    return "truncated";
+  }
+
+  const uint8_t* data = file + sizeof(header);
+  if (hash_fnv1a64(data, header.data_size, HASH_FNV1A64_SEED) !=
+      header.data_hash) {
+    return "checksum mismatch";
+  }
+
+  // the driver blob repeats the identification, check it too in case the
+  // blob itself came from somewhere else
+  uint32_t blob_header[4];
+  if (header.data_size < VULKAN_PIPELINE_CACHE_BLOB_HEADER_SIZE) {
+    return "driver blob too small";
+  }
+  mem_copy(blob_header, data, sizeof(blob_header));
+  if (blob_header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      blob_header[2] != pipeline_cache->vendor_id ||
+      blob_header[3] != pipeline_cache->device_id ||
+      memcmp(data + sizeof(blob_header), pipeline_cache->pipeline_cache_uuid,
+             VK_UUID_SIZE) != 0) {
+    return "driver blob does not match the device";
+  }
+
+  return nullptr;
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_init(VulkanPipelineCache* pipeline_cache,
+                               const VulkanDevice* vk_device,
+                               const char* path) {
+  pipeline_cache->device = vk_device->device;
+  pipeline_cache->fn = &vk_device->fn;
+  pipeline_cache->vendor_id = vk_device->info.properties.vendorID;
+  pipeline_cache->device_id = vk_device->info.properties.deviceID;
+  pipeline_cache->driver_version = vk_device->info.properties.driverVersion;
+  mem_copy(pipeline_cache->pipeline_cache_uuid,
+           vk_device->info.properties.pipelineCacheUUID, VK_UUID_SIZE);
+  pipeline_cache->path = path;
+  pipeline_cache->saved_size = 0;
+  pipeline_cache->last_save_ticks = SDL_GetTicks64();
+
+  pipeline_cache->mutex = SDL_CreateMutex();
+  if (!pipeline_cache->mutex) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  pipeline_cache->is_mutex_init = true;
+
+  size_t file_size = 0;
+  uint8_t* file = path ? SDL_LoadFile(path, &file_size) : nullptr;
+
+  VkPipelineCacheCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .initialDataSize = 0,
+      .pInitialData = nullptr,
+  };
+  if (file) {
+    const char* reason =
+        vulkan_pipeline_cache_validate(pipeline_cache, file, file_size);
+    if (reason) {
+      log_warning("Ignoring pipeline cache %s: %s", path, reason);
+    } else {
+      create_info.initialDataSize =
+          file_size - sizeof(VulkanPipelineCacheFileHeader);
+      create_info.pInitialData = file + sizeof(VulkanPipelineCacheFileHeader);
+      pipeline_cache->saved_size = create_info.initialDataSize;
+    }
+  }
+
+  VkResult result = pipeline_cache->fn->vkCreatePipelineCache(
+      pipeline_cache->device, &create_info, nullptr, &pipeline_cache->cache);
+  if (result != VK_SUCCESS && create_info.initialDataSize > 0) {
+    log_warning("Driver rejected pipeline cache %s: %s", path,
+                vulkan_result_to_string(result));
+    create_info.initialDataSize = 0;
+    create_info.pInitialData = nullptr;
+    pipeline_cache->saved_size = 0;
+    result = pipeline_cache->fn->vkCreatePipelineCache(
+        pipeline_cache->device, &create_info, nullptr, &pipeline_cache->cache);
+  }
+  if (file) {
+    SDL_free(file);
+  }
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  pipeline_cache->is_cache_init = true;
+
+  if (pipeline_cache->saved_size > 0) {
+    log_info("Loaded pipeline cache %s (%zu bytes)", path,
+             pipeline_cache->saved_size);
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_pipeline_cache_reset(VulkanPipelineCache* pipeline_cache) {
+  pipeline_cache->path = nullptr;
+  pipeline_cache->is_cache_init = false;
+  pipeline_cache->is_mutex_init = false;
+}
+
+void vulkan_pipeline_cache_destroy(VulkanPipelineCache* pipeline_cache) {
+  if (pipeline_cache->is_cache_init) {
+    pipeline_cache->fn->vkDestroyPipelineCache(pipeline_cache->device,
+                                               pipeline_cache->cache, nullptr);
+  }
+  if (pipeline_cache->is_mutex_init) {
+    SDL_DestroyMutex(pipeline_cache->mutex);
+  }
+  vulkan_pipeline_cache_reset(pipeline_cache);
+}
+
+// SDL_RWops can not sync, the handle it wraps can. Files opened through
+// something other than the platform file API are left unsynced.
+static bool vulkan_pipeline_cache_sync(SDL_RWops* file) {
+#if defined(_WIN32)
+  return file->type != SDL_RWOPS_WINFILE ||
+         FlushFileBuffers(file->hidden.windowsio.h);
+#else
+  return file->type != SDL_RWOPS_STDFILE ||
+         (fflush(file->hidden.stdio.fp) == 0 &&
+          fsync(fileno(file->hidden.stdio.fp)) == 0);
+#endif
+}
+
+static Result(int, ErrorMessage) vulkan_pipeline_cache_write_file(
+    const char* path,
+    const VulkanPipelineCacheFileHeader* header,
+    const void* data) {
+  size_t path_length = strlen(path);
+  char* temp_path = mem_alloc(path_length + sizeof(".tmp"));
+  CHECK_ALLOC(temp_path, Err(int, ErrorMessage)(
+                             "Unable to allocate memory for pipeline cache"));
+  SDL_snprintf(temp_path, path_length + sizeof(".tmp"), "%s.tmp", path);
+
+  SDL_RWops* file = SDL_RWFromFile(temp_path, "wb");
+  if (!file) {
+    mem_free(temp_path);
+    return Err(int, ErrorMessage)("Unable to create pipeline cache");
+  }
+  // the data reaches the disk before the rename does, a crash in between
+  // leaves the old cache instead of a renamed but empty file
+  bool success = SDL_RWwrite(file, header, sizeof(*header), 1) == 1 &&
+                 SDL_RWwrite(file, data, header->data_size, 1) == 1 &&
+                 vulkan_pipeline_cache_sync(file);
+  success = SDL_RWclose(file) == 0 && success;
+  if (!success) {
+    remove(temp_path);
+    mem_free(temp_path);
+    return Err(int, ErrorMessage)("Unable to write pipeline cache");
+  }
+
+#if defined(_WIN32)
+  // rename does not replace an existing file on Windows, MoveFileEx does
+  // without a window where no cache exists
+  success = MoveFileExA(temp_path, path,
+                        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  success = rename(temp_path, path) == 0;
+#endif
+  if (!success) {
+    remove(temp_path);
+  }
+  mem_free(temp_path);
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to replace pipeline cache");
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_save(VulkanPipelineCache* pipeline_cache) {
+  if (!pipeline_cache->path) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  SDL_LockMutex(pipeline_cache->mutex);
+  size_t size = 0;
+  VkResult result = pipeline_cache->fn->vkGetPipelineCacheData(
+      pipeline_cache->device, pipeline_cache->cache, &size, nullptr);
+  uint8_t* data = nullptr;
+  if (result == VK_SUCCESS) {
+    data = mem_alloc(size);
+    result = data ? pipeline_cache->fn->vkGetPipelineCacheData(
+                        pipeline_cache->device, pipeline_cache->cache, &size,
+                        data)
+                  : VK_ERROR_OUT_OF_HOST_MEMORY;
+  }
+  SDL_UnlockMutex(pipeline_cache->mutex);
+  if (result != VK_SUCCESS) {
+    if (data) {
+      mem_free(data);
+    }
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  // the padding before data_size goes to disk as well, zero it instead of
+  // writing whatever was on the stack
+  VulkanPipelineCacheFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = VULKAN_PIPELINE_CACHE_MAGIC;
+  header.version = VULKAN_PIPELINE_CACHE_VERSION;
+  header.vendor_id = pipeline_cache->vendor_id;
+  header.device_id = pipeline_cache->device_id;
+  header.driver_version = pipeline_cache->driver_version;
+  header.data_size = size;
+  header.data_hash = hash_fnv1a64(data, size, HASH_FNV1A64_SEED);
+  mem_copy(header.pipeline_cache_uuid, pipeline_cache->pipeline_cache_uuid,
+           VK_UUID_SIZE);
+
+  auto write_result =
+      vulkan_pipeline_cache_write_file(pipeline_cache->path, &header, data);
+  mem_free(data);
+  if (!write_result.is_ok) {
+    return write_result;
+  }
+
+  pipeline_cache->saved_size = size;
+  pipeline_cache->last_save_ticks = SDL_GetTicks64();
+  log_debug("Saved pipeline cache %s (%zu bytes)", pipeline_cache->path,
+            size);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_save_if_due(VulkanPipelineCache* pipeline_cache) {
+  uint64_t now = SDL_GetTicks64();
+  if (!pipeline_cache->path ||
+      now - pipeline_cache->last_save_ticks <
+          VULKAN_PIPELINE_CACHE_SAVE_INTERVAL_MS) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  pipeline_cache->last_save_ticks = now;
+
+  // the size query is cheap, only pay for the copy and the write when new
+  // pipelines landed in the cache
+  size_t size = 0;
+  SDL_LockMutex(pipeline_cache->mutex);
+  VkResult result = pipeline_cache->fn->vkGetPipelineCacheData(
+      pipeline_cache->device, pipeline_cache->cache, &size, nullptr);
+  SDL_UnlockMutex(pipeline_cache->mutex);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if (size == pipeline_cache->saved_size) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  return vulkan_pipeline_cache_save(pipeline_cache);
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_create_derived(VulkanPipelineCache* pipeline_cache,
+                                         VkPipelineCache* cache) {
+  SDL_LockMutex(pipeline_cache->mutex);
+  size_t size = 0;
+  VkResult result = pipeline_cache->fn->vkGetPipelineCacheData(
+      pipeline_cache->device, pipeline_cache->cache, &size, nullptr);
+  uint8_t* data = nullptr;
+  if (result == VK_SUCCESS && size > 0) {
+    data = mem_alloc(size);
+    result = data ? pipeline_cache->fn->vkGetPipelineCacheData(
+                        pipeline_cache->device, pipeline_cache->cache, &size,
+                        data)
+                  : VK_ERROR_OUT_OF_HOST_MEMORY;
+  }
+  SDL_UnlockMutex(pipeline_cache->mutex);
+
+  if (result == VK_SUCCESS) {
+    VkPipelineCacheCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = data ? size : 0,
+        .pInitialData = data,
+    };
+    result = pipeline_cache->fn->vkCreatePipelineCache(
+        pipeline_cache->device, &create_info, nullptr, cache);
+  }
+  if (data) {
+    mem_free(data);
+  }
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_merge(VulkanPipelineCache* pipeline_cache,
+                                uint32_t source_count,
+                                const VkPipelineCache* sources) {
+  if (source_count == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  SDL_LockMutex(pipeline_cache->mutex);
+  VkResult result =
+      pipeline_cache->fn->vkMergePipelineCaches(
+          pipeline_cache->device, pipeline_cache->cache, source_count, sources);
+  SDL_UnlockMutex(pipeline_cache->mutex);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,74 @@
+#ifndef VULKAN_BACKEND_PIPELINE_CACHE_H
+#define VULKAN_BACKEND_PIPELINE_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+
+#define VULKAN_PIPELINE_CACHE_MAGIC 0x43505648u  // "HVPC"
+#define VULKAN_PIPELINE_CACHE_VERSION 1u
+#define VULKAN_PIPELINE_CACHE_SAVE_INTERVAL_MS 60000u
+
+// Written in front of the driver blob. The driver rejects foreign caches on
+// its own, the header lets us drop them (and truncated files) before the
+// driver ever parses them.
+typedef struct VulkanPipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+  uint64_t data_size;
+  uint64_t data_hash;
+} VulkanPipelineCacheFileHeader;
+
+typedef struct VulkanPipelineCache {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VkPipelineCache cache;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+  // nullptr keeps the cache in memory only
+  const char* path;
+  size_t saved_size;
+  uint64_t last_save_ticks;
+  // merging needs the destination cache externally synchronized
+  SDL_mutex* mutex;
+  bool is_cache_init;
+  bool is_mutex_init;
+} VulkanPipelineCache;
+
+// loads path if it holds a cache for this exact device and driver, otherwise
+// starts empty
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_init(VulkanPipelineCache* pipeline_cache,
+                               const VulkanDevice* vk_device,
+                               const char* path);
+void vulkan_pipeline_cache_reset(VulkanPipelineCache* pipeline_cache);
+void vulkan_pipeline_cache_destroy(VulkanPipelineCache* pipeline_cache);
+
+// writes to a temporary file and renames it over path, a crash mid write
+// leaves the previous cache intact
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_save(VulkanPipelineCache* pipeline_cache);
+// saves when the save interval elapsed and the cache grew since the last save
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_save_if_due(VulkanPipelineCache* pipeline_cache);
+// creates a cache for a worker thread seeded with the current contents of the
+// main cache, the caller owns it and merges it back
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_create_derived(VulkanPipelineCache* pipeline_cache,
+                                         VkPipelineCache* cache);
+// folds caches filled by worker threads into the main cache
+Result(int, ErrorMessage)
+    vulkan_pipeline_cache_merge(VulkanPipelineCache* pipeline_cache,
+                                uint32_t source_count,
+                                const VkPipelineCache* sources);
+
+#endif
@@ -0,0 +1,697 @@
+#include "./pipeline_compiler.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+#define VULKAN_PIPELINE_STORAGE_ALIGNMENT 16
+
+// Two passes over the same copy functions: with data == nullptr only the size
+// is summed up, the second pass copies into a block of exactly that size
+typedef struct VulkanPipelineStorage {
+  uint8_t* data;
+  size_t size;
+} VulkanPipelineStorage;
+
+static void* vulkan_pipeline_storage_copy(VulkanPipelineStorage* storage,
+                                          const void* source,
+                                          size_t size) {
+  if (source == nullptr || size == 0) {
+    return nullptr;
+  }
+  size_t offset = ALIGN(storage->size, VULKAN_PIPELINE_STORAGE_ALIGNMENT);
+  storage->size = offset + size;
+  if (storage->data == nullptr) {
+    return nullptr;
+  }
+
+  void* destination = storage->data + offset;
+  mem_copy(destination, source, size);
+  return destination;
+}
+
+static uint32_t vulkan_sample_mask_words(VkSampleCountFlagBits samples) {
+  return ((uint32_t)samples + 31) / 32;
+}
+
+static bool vulkan_graphics_pipeline_has_extensions(
+    const VkGraphicsPipelineCreateInfo* info) {
+  bool has_extensions = info->pNext != nullptr;
+  for (uint32_t i = 0; i < info->stageCount; i++) {
+    has_extensions |= info->pStages[i].pNext != nullptr;
+  }
+  has_extensions |= info->pVertexInputState &&
+                    info->pVertexInputState->pNext != nullptr;
+  has_extensions |= info->pInputAssemblyState &&
+                    info->pInputAssemblyState->pNext != nullptr;
+  has_extensions |= info->pTessellationState &&
+                    info->pTessellationState->pNext != nullptr;
+  has_extensions |=
+      info->pViewportState && info->pViewportState->pNext != nullptr;
+  has_extensions |= info->pRasterizationState &&
+                    info->pRasterizationState->pNext != nullptr;
+  has_extensions |=
+      info->pMultisampleState && info->pMultisampleState->pNext != nullptr;
+  has_extensions |= info->pDepthStencilState &&
+                    info->pDepthStencilState->pNext != nullptr;
+  has_extensions |=
+      info->pColorBlendState && info->pColorBlendState->pNext != nullptr;
+  has_extensions |=
+      info->pDynamicState && info->pDynamicState->pNext != nullptr;
+  return has_extensions;
+}
+
+static void vulkan_shader_stage_key(
+    HashKey* key,
+    const VkPipelineShaderStageCreateInfo* stage) {
+  HASH_KEY_VALUE(key, stage->flags);
+  HASH_KEY_VALUE(key, stage->stage);
+  HASH_KEY_VALUE(key, stage->module);
+  hash_key_append(key, stage->pName, strlen(stage->pName) + 1);
+
+  const VkSpecializationInfo* specialization = stage->pSpecializationInfo;
+  bool has_specialization = specialization != nullptr;
+  HASH_KEY_VALUE(key, has_specialization);
+  if (has_specialization) {
+    HASH_KEY_VALUE(key, specialization->mapEntryCount);
+    HASH_KEY_ARRAY(key, specialization->pMapEntries,
+                   specialization->mapEntryCount);
+    HASH_KEY_VALUE(key, specialization->dataSize);
+    HASH_KEY_ARRAY(key, (const uint8_t*)specialization->pData,
+                   specialization->dataSize);
+  }
+}
+
+static void vulkan_graphics_pipeline_key(
+    HashKey* key,
+    const VkGraphicsPipelineCreateInfo* info) {
+  VulkanPipelineKind kind = VULKAN_PIPELINE_KIND_GRAPHICS;
+  HASH_KEY_VALUE(key, kind);
+  HASH_KEY_VALUE(key, info->flags);
+  HASH_KEY_VALUE(key, info->stageCount);
+  for (uint32_t i = 0; i < info->stageCount; i++) {
+    vulkan_shader_stage_key(key, &info->pStages[i]);
+  }
+
+  // a marker per optional state keeps "absent" apart from "all zero"
+  bool is_present = info->pVertexInputState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    const VkPipelineVertexInputStateCreateInfo* state =
+        info->pVertexInputState;
+    HASH_KEY_VALUE(key, state->flags);
+    HASH_KEY_VALUE(key, state->vertexBindingDescriptionCount);
+    HASH_KEY_ARRAY(key, state->pVertexBindingDescriptions,
+                   state->vertexBindingDescriptionCount);
+    HASH_KEY_VALUE(key, state->vertexAttributeDescriptionCount);
+    HASH_KEY_ARRAY(key, state->pVertexAttributeDescriptions,
+                   state->vertexAttributeDescriptionCount);
+  }
+
+  is_present = info->pInputAssemblyState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    HASH_KEY_MEMBERS(key, VkPipelineInputAssemblyStateCreateInfo,
+                     info->pInputAssemblyState, flags, primitiveRestartEnable);
+  }
+
+  is_present = info->pTessellationState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    HASH_KEY_MEMBERS(key, VkPipelineTessellationStateCreateInfo,
+                     info->pTessellationState, flags, patchControlPoints);
+  }
+
+  is_present = info->pViewportState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    const VkPipelineViewportStateCreateInfo* state = info->pViewportState;
+    HASH_KEY_VALUE(key, state->flags);
+    HASH_KEY_VALUE(key, state->viewportCount);
+    HASH_KEY_ARRAY(key, state->pViewports, state->viewportCount);
+    HASH_KEY_VALUE(key, state->scissorCount);
+    HASH_KEY_ARRAY(key, state->pScissors, state->scissorCount);
+  }
+
+  is_present = info->pRasterizationState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    HASH_KEY_MEMBERS(key, VkPipelineRasterizationStateCreateInfo,
+                     info->pRasterizationState, flags, lineWidth);
+  }
+
+  is_present = info->pMultisampleState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    const VkPipelineMultisampleStateCreateInfo* state =
+        info->pMultisampleState;
+    HASH_KEY_MEMBERS(key, VkPipelineMultisampleStateCreateInfo, state, flags,
+                     minSampleShading);
+    HASH_KEY_ARRAY(key, state->pSampleMask,
+                   vulkan_sample_mask_words(state->rasterizationSamples));
+    HASH_KEY_VALUE(key, state->alphaToCoverageEnable);
+    HASH_KEY_VALUE(key, state->alphaToOneEnable);
+  }
+
+  is_present = info->pDepthStencilState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    HASH_KEY_MEMBERS(key, VkPipelineDepthStencilStateCreateInfo,
+                     info->pDepthStencilState, flags, maxDepthBounds);
+  }
+
+  is_present = info->pColorBlendState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    const VkPipelineColorBlendStateCreateInfo* state = info->pColorBlendState;
+    HASH_KEY_MEMBERS(key, VkPipelineColorBlendStateCreateInfo, state, flags,
+                     attachmentCount);
+    HASH_KEY_ARRAY(key, state->pAttachments, state->attachmentCount);
+    HASH_KEY_VALUE(key, state->blendConstants);
+  }
+
+  is_present = info->pDynamicState != nullptr;
+  HASH_KEY_VALUE(key, is_present);
+  if (is_present) {
+    const VkPipelineDynamicStateCreateInfo* state = info->pDynamicState;
+    HASH_KEY_VALUE(key, state->flags);
+    HASH_KEY_VALUE(key, state->dynamicStateCount);
+    HASH_KEY_ARRAY(key, state->pDynamicStates, state->dynamicStateCount);
+  }
+
+  HASH_KEY_VALUE(key, info->layout);
+  HASH_KEY_VALUE(key, info->renderPass);
+  HASH_KEY_VALUE(key, info->subpass);
+  HASH_KEY_VALUE(key, info->basePipelineHandle);
+  HASH_KEY_VALUE(key, info->basePipelineIndex);
+}
+
+static void vulkan_compute_pipeline_key(
+    HashKey* key,
+    const VkComputePipelineCreateInfo* info) {
+  VulkanPipelineKind kind = VULKAN_PIPELINE_KIND_COMPUTE;
+  HASH_KEY_VALUE(key, kind);
+  HASH_KEY_VALUE(key, info->flags);
+  vulkan_shader_stage_key(key, &info->stage);
+  HASH_KEY_VALUE(key, info->layout);
+  HASH_KEY_VALUE(key, info->basePipelineHandle);
+  HASH_KEY_VALUE(key, info->basePipelineIndex);
+}
+
+static VkPipelineShaderStageCreateInfo vulkan_shader_stage_copy(
+    VulkanPipelineStorage* storage,
+    const VkPipelineShaderStageCreateInfo* source) {
+  VkPipelineShaderStageCreateInfo stage = *source;
+  stage.pName =
+      vulkan_pipeline_storage_copy(storage, source->pName,
+                                   strlen(source->pName) + 1);
+
+  if (source->pSpecializationInfo) {
+    VkSpecializationInfo specialization = *source->pSpecializationInfo;
+    specialization.pMapEntries = vulkan_pipeline_storage_copy(
+        storage, specialization.pMapEntries,
+        sizeof(VkSpecializationMapEntry) * specialization.mapEntryCount);
+    specialization.pData = vulkan_pipeline_storage_copy(
+        storage, specialization.pData, specialization.dataSize);
+    stage.pSpecializationInfo = vulkan_pipeline_storage_copy(
+        storage, &specialization, sizeof(specialization));
+  }
+  return stage;
+}
+
+static const VkGraphicsPipelineCreateInfo* vulkan_graphics_pipeline_copy(
+    VulkanPipelineStorage* storage,
+    const VkGraphicsPipelineCreateInfo* source) {
+  VkGraphicsPipelineCreateInfo info = *source;
+
+  VkPipelineShaderStageCreateInfo stages[VULKAN_PIPELINE_MAX_STAGES];
+  for (uint32_t i = 0; i < source->stageCount; i++) {
+    stages[i] = vulkan_shader_stage_copy(storage, &source->pStages[i]);
+  }
+  info.pStages = vulkan_pipeline_storage_copy(
+      storage, stages,
+      sizeof(VkPipelineShaderStageCreateInfo) * source->stageCount);
+
+  if (source->pVertexInputState) {
+    VkPipelineVertexInputStateCreateInfo state = *source->pVertexInputState;
+    state.pVertexBindingDescriptions = vulkan_pipeline_storage_copy(
+        storage, state.pVertexBindingDescriptions,
+        sizeof(VkVertexInputBindingDescription) *
+            state.vertexBindingDescriptionCount);
+    state.pVertexAttributeDescriptions = vulkan_pipeline_storage_copy(
+        storage, state.pVertexAttributeDescriptions,
+        sizeof(VkVertexInputAttributeDescription) *
+            state.vertexAttributeDescriptionCount);
+    info.pVertexInputState =
+        vulkan_pipeline_storage_copy(storage, &state, sizeof(state));
+  }
+
+  info.pInputAssemblyState = vulkan_pipeline_storage_copy(
+      storage, source->pInputAssemblyState,
+      sizeof(VkPipelineInputAssemblyStateCreateInfo));
+  info.pTessellationState = vulkan_pipeline_storage_copy(
+      storage, source->pTessellationState,
+      sizeof(VkPipelineTessellationStateCreateInfo));
+
+  if (source->pViewportState) {
+    VkPipelineViewportStateCreateInfo state = *source->pViewportState;
+    state.pViewports = vulkan_pipeline_storage_copy(
+        storage, state.pViewports, sizeof(VkViewport) * state.viewportCount);
+    state.pScissors = vulkan_pipeline_storage_copy(
+        storage, state.pScissors, sizeof(VkRect2D) * state.scissorCount);
+    info.pViewportState =
+        vulkan_pipeline_storage_copy(storage, &state, sizeof(state));
+  }
+
+  info.pRasterizationState = vulkan_pipeline_storage_copy(
+      storage, source->pRasterizationState,
+      sizeof(VkPipelineRasterizationStateCreateInfo));
+
+  if (source->pMultisampleState) {
+    VkPipelineMultisampleStateCreateInfo state = *source->pMultisampleState;
+    state.pSampleMask = vulkan_pipeline_storage_copy(
+        storage, state.pSampleMask,
+        sizeof(VkSampleMask) *
+            vulkan_sample_mask_words(state.rasterizationSamples));
+    info.pMultisampleState =
+        vulkan_pipeline_storage_copy(storage, &state, sizeof(state));
+  }
+
+  info.pDepthStencilState = vulkan_pipeline_storage_copy(
+      storage, source->pDepthStencilState,
+      sizeof(VkPipelineDepthStencilStateCreateInfo));
+
+  if (source->pColorBlendState) {
+    VkPipelineColorBlendStateCreateInfo state = *source->pColorBlendState;
+    state.pAttachments = vulkan_pipeline_storage_copy(
+        storage, state.pAttachments,
+        sizeof(VkPipelineColorBlendAttachmentState) * state.attachmentCount);
+    info.pColorBlendState =
+        vulkan_pipeline_storage_copy(storage, &state, sizeof(state));
+  }
+
+  if (source->pDynamicState) {
+    VkPipelineDynamicStateCreateInfo state = *source->pDynamicState;
+    state.pDynamicStates = vulkan_pipeline_storage_copy(
+        storage, state.pDynamicStates,
+        sizeof(VkDynamicState) * state.dynamicStateCount);
+    info.pDynamicState =
+        vulkan_pipeline_storage_copy(storage, &state, sizeof(state));
+  }
+
+  return vulkan_pipeline_storage_copy(storage, &info, sizeof(info));
+}
+
+static const VkComputePipelineCreateInfo* vulkan_compute_pipeline_copy(
+    VulkanPipelineStorage* storage,
+    const VkComputePipelineCreateInfo* source) {
+  VkComputePipelineCreateInfo info = *source;
+  info.stage = vulkan_shader_stage_copy(storage, &source->stage);
+  return vulkan_pipeline_storage_copy(storage, &info, sizeof(info));
+}
+
+static void vulkan_pipeline_compiler_compile(void* data,
+                                             uint32_t begin,
+                                             uint32_t end,
+                                             uint32_t worker_index) {
+  (void)end;
+  VulkanPipelineCompiler* compiler = data;
+  VulkanPipelineWorkerCache* worker_cache =
+      &compiler->worker_caches[worker_index];
+
+  // only this worker writes to its slot, is_cache_init is set under the
+  // mutex for the merge below
+  bool has_cache = worker_cache->is_cache_init;
+  VkPipelineCache cache = worker_cache->cache;
+  if (!has_cache) {
+    auto cache_result = vulkan_pipeline_cache_create_derived(
+        compiler->pipeline_cache, &cache);
+    if (cache_result.is_ok) {
+      has_cache = true;
+    } else {
+      log_warning("Unable to create pipeline cache for worker %u: %s",
+                  worker_index, cache_result.error);
+      cache = VK_NULL_HANDLE;
+    }
+  }
+
+  SDL_LockMutex(compiler->mutex);
+  VulkanPipelineRequest* request = compiler->requests[begin];
+  if (has_cache && !worker_cache->is_cache_init) {
+    worker_cache->cache = cache;
+    worker_cache->is_cache_init = true;
+  }
+  SDL_UnlockMutex(compiler->mutex);
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult result =
+      request->kind == VULKAN_PIPELINE_KIND_GRAPHICS
+          ? compiler->fn->vkCreateGraphicsPipelines(
+                compiler->device, cache, 1, request->create_info.graphics,
+                nullptr, &pipeline)
+          : compiler->fn->vkCreateComputePipelines(
+                compiler->device, cache, 1, request->create_info.compute,
+                nullptr, &pipeline);
+
+  VkPipelineCache dirty_caches[JOB_SYSTEM_MAX_WORKERS];
+  uint32_t dirty_count = 0;
+  SDL_LockMutex(compiler->mutex);
+  request->pipeline = result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+  request->result = result;
+  request->status = result == VK_SUCCESS ? VULKAN_PIPELINE_STATUS_READY
+                                         : VULKAN_PIPELINE_STATUS_FAILED;
+  worker_cache->is_dirty = has_cache;
+  compiler->compiling_count--;
+  if (compiler->compiling_count == 0) {
+    // nothing left to compile, hand what the workers learned to the main
+    // cache so the next save picks it up
+    for (uint32_t i = 0; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+      if (compiler->worker_caches[i].is_dirty) {
+        compiler->worker_caches[i].is_dirty = false;
+        dirty_caches[dirty_count++] = compiler->worker_caches[i].cache;
+      }
+    }
+  }
+  SDL_UnlockMutex(compiler->mutex);
+
+  // the worker caches are internally synchronized, another worker may
+  // already compile into one of them again
+  if (dirty_count > 0) {
+    auto merge_result = vulkan_pipeline_cache_merge(
+        compiler->pipeline_cache, dirty_count, dirty_caches);
+    if (!merge_result.is_ok) {
+      log_warning("Unable to merge pipeline cache: %s", merge_result.error);
+    }
+  }
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_init(VulkanPipelineCompiler* compiler,
+                                  const VulkanDevice* vk_device,
+                                  VulkanPipelineCache* pipeline_cache,
+                                  JobSystem* job_system) {
+  compiler->device = vk_device->device;
+  compiler->fn = &vk_device->fn;
+  compiler->pipeline_cache = pipeline_cache;
+  compiler->job_system = job_system;
+  compiler->request_count = 0;
+  compiler->compiling_count = 0;
+  pool_init(&compiler->request_pool, sizeof(VulkanPipelineRequest), 0);
+
+  compiler->mutex = SDL_CreateMutex();
+  if (!compiler->mutex) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  compiler->is_mutex_init = true;
+  log_debug("Initialized pipeline compiler on %u workers",
+            job_system->worker_count);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_pipeline_compiler_reset(VulkanPipelineCompiler* compiler) {
+  for (uint32_t i = 0; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    compiler->worker_caches[i].is_dirty = false;
+    compiler->worker_caches[i].is_cache_init = false;
+  }
+  compiler->job_system = nullptr;
+  pool_reset(&compiler->request_pool);
+  compiler->requests = nullptr;
+  compiler->request_count = 0;
+  compiler->request_capacity = 0;
+  compiler->table = nullptr;
+  compiler->table_capacity = 0;
+  compiler->compiling_count = 0;
+  compiler->is_mutex_init = false;
+}
+
+void vulkan_pipeline_compiler_destroy(VulkanPipelineCompiler* compiler) {
+  // the jobs still running use the requests and the worker caches
+  for (uint32_t i = 0; i < compiler->request_count; i++) {
+    job_system_wait(compiler->job_system, 0, &compiler->requests[i]->counter);
+  }
+
+  for (uint32_t i = 0; i < JOB_SYSTEM_MAX_WORKERS; i++) {
+    VulkanPipelineWorkerCache* worker_cache = &compiler->worker_caches[i];
+    if (worker_cache->is_cache_init) {
+      compiler->fn->vkDestroyPipelineCache(compiler->device,
+                                           worker_cache->cache, nullptr);
+    }
+  }
+
+  for (uint32_t i = 0; i < compiler->request_count; i++) {
+    VulkanPipelineRequest* request = compiler->requests[i];
+    if (request->pipeline != VK_NULL_HANDLE) {
+      compiler->fn->vkDestroyPipeline(compiler->device, request->pipeline,
+                                      nullptr);
+    }
+    mem_free(request->key);
+    mem_free(request->storage);
+    pool_free(&compiler->request_pool, request);
+  }
+  pool_destroy(&compiler->request_pool);
+  if (compiler->requests) {
+    mem_free(compiler->requests);
+  }
+  if (compiler->table) {
+    mem_free(compiler->table);
+  }
+
+  if (compiler->is_mutex_init) {
+    SDL_DestroyMutex(compiler->mutex);
+  }
+  vulkan_pipeline_compiler_reset(compiler);
+}
+
+static bool vulkan_pipeline_compiler_find(VulkanPipelineCompiler* compiler,
+                                          uint64_t hash,
+                                          const HashKey* key,
+                                          uint32_t* index) {
+  if (compiler->table_capacity == 0) {
+    return false;
+  }
+
+  uint32_t mask = compiler->table_capacity - 1;
+  for (uint32_t slot = (uint32_t)hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t entry = compiler->table[slot];
+    if (entry == 0) {
+      return false;
+    }
+    const VulkanPipelineRequest* request = compiler->requests[entry - 1];
+    if (request->hash == hash &&
+        hash_key_equal(key, request->key, request->key_size)) {
+      *index = entry - 1;
+      return true;
+    }
+  }
+}
+
+static void vulkan_pipeline_compiler_table_insert(
+    VulkanPipelineCompiler* compiler,
+    uint32_t index) {
+  uint32_t mask = compiler->table_capacity - 1;
+  uint32_t slot = (uint32_t)compiler->requests[index]->hash & mask;
+  while (compiler->table[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  compiler->table[slot] = index + 1;
+}
+
+// grows every container so one more request fits, called with the mutex held
+static Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_reserve(VulkanPipelineCompiler* compiler) {
+  if (compiler->request_count == compiler->request_capacity) {
+    uint32_t capacity =
+        compiler->request_capacity ? compiler->request_capacity * 2 : 16;
+    VulkanPipelineRequest** requests = mem_realloc(
+        compiler->requests, sizeof(VulkanPipelineRequest*) * capacity);
+    CHECK_ALLOC(requests, Err(int, ErrorMessage)(
+                              "Unable to allocate memory for pipelines"));
+    compiler->requests = requests;
+    compiler->request_capacity = capacity;
+  }
+
+  // keep the table at most half full
+  if ((compiler->request_count + 1) * 2 > compiler->table_capacity) {
+    uint32_t capacity =
+        compiler->table_capacity ? compiler->table_capacity * 2 : 32;
+    uint32_t* table = mem_alloc(sizeof(uint32_t) * capacity);
+    CHECK_ALLOC(table, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for pipelines"));
+    SDL_memset(table, 0, sizeof(uint32_t) * capacity);
+    if (compiler->table) {
+      mem_free(compiler->table);
+    }
+    compiler->table = table;
+    compiler->table_capacity = capacity;
+    for (uint32_t i = 0; i < compiler->request_count; i++) {
+      vulkan_pipeline_compiler_table_insert(compiler, i);
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_enqueue(VulkanPipelineCompiler* compiler,
+                                     VulkanPipelineKind kind,
+                                     const void* create_info,
+                                     VulkanPipelineHandle* handle) {
+  HashKey key = {.data = nullptr, .size = 0};
+  for (uint32_t pass = 0; pass < 2; pass++) {
+    if (pass == 1) {
+      key.data = mem_alloc(key.size);
+      CHECK_ALLOC(key.data, Err(int, ErrorMessage)(
+                                "Unable to allocate memory for pipelines"));
+      key.size = 0;
+    }
+    if (kind == VULKAN_PIPELINE_KIND_GRAPHICS) {
+      vulkan_graphics_pipeline_key(&key, create_info);
+    } else {
+      vulkan_compute_pipeline_key(&key, create_info);
+    }
+  }
+  uint64_t hash = hash_fnv1a64(key.data, key.size, HASH_FNV1A64_SEED);
+
+  SDL_LockMutex(compiler->mutex);
+  uint32_t index = 0;
+  if (vulkan_pipeline_compiler_find(compiler, hash, &key, &index)) {
+    SDL_UnlockMutex(compiler->mutex);
+    mem_free(key.data);
+    *handle = index;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  auto reserve_result = vulkan_pipeline_compiler_reserve(compiler);
+  if (!reserve_result.is_ok) {
+    SDL_UnlockMutex(compiler->mutex);
+    mem_free(key.data);
+    return reserve_result;
+  }
+
+  VulkanPipelineRequest* request = pool_alloc(&compiler->request_pool);
+  VulkanPipelineStorage storage = {.data = nullptr, .size = 0};
+  if (kind == VULKAN_PIPELINE_KIND_GRAPHICS) {
+    vulkan_graphics_pipeline_copy(&storage, create_info);
+  } else {
+    vulkan_compute_pipeline_copy(&storage, create_info);
+  }
+  storage.data = request ? mem_alloc(storage.size) : nullptr;
+  if (!storage.data) {
+    if (request) {
+      pool_free(&compiler->request_pool, request);
+    }
+    SDL_UnlockMutex(compiler->mutex);
+    mem_free(key.data);
+    SDL_OutOfMemory();
+    return Err(int, ErrorMessage)("Unable to allocate memory for pipelines");
+  }
+  storage.size = 0;
+
+  request->hash = hash;
+  request->key = key.data;
+  request->key_size = key.size;
+  request->kind = kind;
+  request->storage = storage.data;
+  if (kind == VULKAN_PIPELINE_KIND_GRAPHICS) {
+    request->create_info.graphics =
+        vulkan_graphics_pipeline_copy(&storage, create_info);
+  } else {
+    request->create_info.compute =
+        vulkan_compute_pipeline_copy(&storage, create_info);
+  }
+  request->pipeline = VK_NULL_HANDLE;
+  request->result = VK_SUCCESS;
+  request->status = VULKAN_PIPELINE_STATUS_PENDING;
+  job_counter_init(&request->counter);
+
+  index = compiler->request_count++;
+  compiler->requests[index] = request;
+  vulkan_pipeline_compiler_table_insert(compiler, index);
+  compiler->compiling_count++;
+  SDL_UnlockMutex(compiler->mutex);
+
+  // the job takes the mutex, it may run inline when the queue is full
+  Job job = {
+      .function = vulkan_pipeline_compiler_compile,
+      .data = compiler,
+      .counter = &request->counter,
+      .begin = index,
+      .end = index + 1,
+      .grain = 0,
+  };
+  job_system_submit(compiler->job_system, 0, &job);
+
+  *handle = index;
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_pipeline_compiler_request_graphics(
+    VulkanPipelineCompiler* compiler,
+    const VkGraphicsPipelineCreateInfo* create_info,
+    VulkanPipelineHandle* handle) {
+  if (create_info->stageCount > VULKAN_PIPELINE_MAX_STAGES) {
+    return Err(int, ErrorMessage)("Too many shader stages in pipeline");
+  }
+  if (vulkan_graphics_pipeline_has_extensions(create_info)) {
+    return Err(int, ErrorMessage)(
+        "Pipeline extension structures are not supported");
+  }
+
+  return vulkan_pipeline_compiler_enqueue(
+      compiler, VULKAN_PIPELINE_KIND_GRAPHICS, create_info, handle);
+}
+
+Result(int, ErrorMessage) vulkan_pipeline_compiler_request_compute(
+    VulkanPipelineCompiler* compiler,
+    const VkComputePipelineCreateInfo* create_info,
+    VulkanPipelineHandle* handle) {
+  if (create_info->pNext != nullptr || create_info->stage.pNext != nullptr) {
+    return Err(int, ErrorMessage)(
+        "Pipeline extension structures are not supported");
+  }
+
+  return vulkan_pipeline_compiler_enqueue(
+      compiler, VULKAN_PIPELINE_KIND_COMPUTE, create_info, handle);
+}
+
+VulkanPipelineStatus vulkan_pipeline_compiler_poll(
+    VulkanPipelineCompiler* compiler,
+    VulkanPipelineHandle handle,
+    VkPipeline* pipeline) {
+  SDL_LockMutex(compiler->mutex);
+  VulkanPipelineRequest* request = compiler->requests[handle];
+  VulkanPipelineStatus status = request->status;
+  if (status == VULKAN_PIPELINE_STATUS_READY) {
+    *pipeline = request->pipeline;
+  }
+  SDL_UnlockMutex(compiler->mutex);
+
+  return status;
+}
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_wait(VulkanPipelineCompiler* compiler,
+                                  VulkanPipelineHandle handle,
+                                  VkPipeline* pipeline) {
+  // requests are only added on this thread, the array stays where it is
+  VulkanPipelineRequest* request = compiler->requests[handle];
+  job_system_wait(compiler->job_system, 0, &request->counter);
+
+  SDL_LockMutex(compiler->mutex);
+  VulkanPipelineStatus status = request->status;
+  VkResult result = request->result;
+  *pipeline = request->pipeline;
+  SDL_UnlockMutex(compiler->mutex);
+
+  if (status == VULKAN_PIPELINE_STATUS_FAILED) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
@@ -0,0 +1,114 @@
+#ifndef VULKAN_BACKEND_PIPELINE_COMPILER_H
+#define VULKAN_BACKEND_PIPELINE_COMPILER_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "../utils/job_system.h"
+#include "../utils/pool.h"
+#include "./device.h"
+#include "./pipeline_cache.h"
+
+#define VULKAN_PIPELINE_MAX_STAGES 8
+
+typedef uint32_t VulkanPipelineHandle;
+
+typedef enum VulkanPipelineStatus {
+  VULKAN_PIPELINE_STATUS_PENDING,
+  VULKAN_PIPELINE_STATUS_READY,
+  VULKAN_PIPELINE_STATUS_FAILED,
+} VulkanPipelineStatus;
+
+typedef enum VulkanPipelineKind {
+  VULKAN_PIPELINE_KIND_GRAPHICS,
+  VULKAN_PIPELINE_KIND_COMPUTE,
+} VulkanPipelineKind;
+
+typedef struct VulkanPipelineRequest {
+  uint64_t hash;
+  // every value the hash is made of, compared on a hash hit so two
+  // descriptions never share a pipeline just because their hashes collide
+  uint8_t* key;
+  size_t key_size;
+  VulkanPipelineKind kind;
+  // points into storage, the caller's create info may be gone by the time a
+  // worker picks the compile job up
+  union {
+    const VkGraphicsPipelineCreateInfo* graphics;
+    const VkComputePipelineCreateInfo* compute;
+  } create_info;
+  uint8_t* storage;
+  VkPipeline pipeline;
+  VkResult result;
+  VulkanPipelineStatus status;
+  // drains once the compile job has finished
+  JobCounter counter;
+} VulkanPipelineRequest;
+
+typedef struct VulkanPipelineWorkerCache {
+  // private cache of one job system worker, created by the worker the first
+  // time it compiles, it runs one job at a time so nothing else writes to it
+  VkPipelineCache cache;
+  // compiled something since the last merge into the main cache
+  bool is_dirty;
+  bool is_cache_init;
+} VulkanPipelineWorkerCache;
+
+// Compiles pipelines as jobs on the job system. Requests are deduplicated by
+// their create info, the same description always maps to the same handle.
+// Pipelines are owned by the compiler and live until it is destroyed.
+// Requests, waits and destruction happen on the thread owning the job system.
+typedef struct VulkanPipelineCompiler {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanPipelineCache* pipeline_cache;
+  JobSystem* job_system;
+  VulkanPipelineWorkerCache worker_caches[JOB_SYSTEM_MAX_WORKERS];
+  // requests are small and fixed size, they come out of request_pool
+  Pool request_pool;
+  VulkanPipelineRequest** requests;
+  uint32_t request_count;
+  uint32_t request_capacity;
+  // open addressing, request index + 1 per slot, 0 marks an empty slot
+  uint32_t* table;
+  uint32_t table_capacity;
+  // compile jobs submitted and not finished yet, the last one to finish
+  // merges the worker caches into the main cache
+  uint32_t compiling_count;
+  SDL_mutex* mutex;
+  bool is_mutex_init;
+} VulkanPipelineCompiler;
+
+Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_init(VulkanPipelineCompiler* compiler,
+                                  const VulkanDevice* vk_device,
+                                  VulkanPipelineCache* pipeline_cache,
+                                  JobSystem* job_system);
+void vulkan_pipeline_compiler_reset(VulkanPipelineCompiler* compiler);
+void vulkan_pipeline_compiler_destroy(VulkanPipelineCompiler* compiler);
+
+// The create info is deep copied, extension structures in pNext chains are
+// not supported and make the request fail
+Result(int, ErrorMessage) vulkan_pipeline_compiler_request_graphics(
+    VulkanPipelineCompiler* compiler,
+    const VkGraphicsPipelineCreateInfo* create_info,
+    VulkanPipelineHandle* handle);
+Result(int, ErrorMessage) vulkan_pipeline_compiler_request_compute(
+    VulkanPipelineCompiler* compiler,
+    const VkComputePipelineCreateInfo* create_info,
+    VulkanPipelineHandle* handle);
+
+// never blocks on a compile, pipeline is set once the status is READY
+VulkanPipelineStatus vulkan_pipeline_compiler_poll(
+    VulkanPipelineCompiler* compiler,
+    VulkanPipelineHandle handle,
+    VkPipeline* pipeline);
+// runs jobs on the calling thread until the compile is done
+Result(int, ErrorMessage)
+    vulkan_pipeline_compiler_wait(VulkanPipelineCompiler* compiler,
+                                  VulkanPipelineHandle handle,
+                                  VkPipeline* pipeline);
+
+#endif
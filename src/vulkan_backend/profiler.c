@@ -0,0 +1,459 @@
+#include "./profiler.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+#define VULKAN_PROFILER_QUERY_COUNT (VULKAN_PROFILER_MAX_SCOPES * 2)
+#define VULKAN_PROFILER_INITIAL_EVENTS 4096
+// scope index pushed for scopes past the per frame limit, their end is
+// ignored too
+#define VULKAN_PROFILER_DROPPED_SCOPE UINT32_MAX
+
+static double vulkan_profiler_ticks_to_us(const VulkanProfiler* profiler,
+                                          uint64_t ticks) {
+  return (double)(ticks - profiler->start_ticks) * 1000000.0 /
+         (double)SDL_GetPerformanceFrequency();
+}
+
+static void vulkan_profiler_add_event(VulkanProfiler* profiler,
+                                      const VulkanProfilerEvent* event) {
+  if (!profiler->trace_path) {
+    return;
+  }
+  if (profiler->event_count == profiler->event_capacity) {
+    if (profiler->event_capacity == VULKAN_PROFILER_MAX_EVENTS) {
+      return;
+    }
+    uint32_t capacity = profiler->event_capacity
+                            ? profiler->event_capacity * 2
+                            : VULKAN_PROFILER_INITIAL_EVENTS;
+    if (capacity > VULKAN_PROFILER_MAX_EVENTS) {
+      capacity = VULKAN_PROFILER_MAX_EVENTS;
+    }
+    VulkanProfilerEvent* events = mem_realloc(
+        profiler->events, sizeof(VulkanProfilerEvent) * capacity);
+    if (!events) {
+      return;
+    }
+    profiler->events = events;
+    profiler->event_capacity = capacity;
+    if (capacity == VULKAN_PROFILER_MAX_EVENTS) {
+      log_warning("Profiler capture is full, later events are dropped");
+    }
+  }
+  profiler->events[profiler->event_count++] = *event;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_profiler_read_frame(VulkanProfiler* profiler,
+                               VulkanProfilerFrame* frame) {
+  if (!frame->has_results) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  frame->has_results = false;
+  if (frame->scope_count == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  uint64_t timestamps[VULKAN_PROFILER_QUERY_COUNT];
+  uint32_t query_count = frame->scope_count * 2;
+  VkResult result = profiler->fn->vkGetQueryPoolResults(
+      profiler->device, frame->query_pool, 0, query_count,
+      sizeof(uint64_t) * query_count, timestamps, sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT);
+  // the slot fence signaled before this runs, a missing result means the
+  // frame never executed its scopes
+  if (result == VK_NOT_READY) {
+    log_debug("Dropped GPU scopes of frame %llu",
+              (unsigned long long)frame->frame_number);
+    return Ok(int, ErrorMessage)(0);
+  }
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  // the first scope opened first, everything else is placed relative to it
+  uint64_t origin = timestamps[0] & profiler->timestamp_mask;
+  double frame_start_us =
+      vulkan_profiler_ticks_to_us(profiler, frame->submit_ticks);
+  if (frame_start_us < profiler->gpu_end_us) {
+    frame_start_us = profiler->gpu_end_us;
+  }
+
+  profiler->gpu_origin_timestamp = origin;
+  profiler->gpu_origin_us = frame_start_us;
+  profiler->has_gpu_origin = true;
+
+  double us_per_tick = profiler->timestamp_period / 1000.0;
+  for (uint32_t i = 0; i < frame->scope_count; i++) {
+    const VulkanProfilerScope* scope = &frame->scopes[i];
+    uint64_t begin = timestamps[scope->begin_query];
+    uint64_t end = timestamps[scope->begin_query + 1];
+    // differences are taken modulo the valid bits, a counter wrap inside the
+    // frame still gives the right duration
+    uint64_t offset = (begin - origin) & profiler->timestamp_mask;
+    uint64_t duration = (end - begin) & profiler->timestamp_mask;
+
+    VulkanProfilerEvent event = {
+        .name = scope->name,
+        .frame_number = frame->frame_number,
+        .start_us = frame_start_us + (double)offset * us_per_tick,
+        .duration_us = (double)duration * us_per_tick,
+        .track = VULKAN_PROFILER_TRACK_GPU,
+    };
+    vulkan_profiler_add_event(profiler, &event);
+    if (event.start_us + event.duration_us > profiler->gpu_end_us) {
+      profiler->gpu_end_us = event.start_us + event.duration_us;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_profiler_init(VulkanProfiler* profiler,
+                                               const VulkanDevice* vk_device,
+                                               uint32_t frames_in_flight,
+                                               const char* trace_path) {
+  if (frames_in_flight > VULKAN_MAX_FRAMES_IN_FLIGHT) {
+    return Err(int, ErrorMessage)("Unsupported number of frames in flight");
+  }
+
+  profiler->device = vk_device->device;
+  profiler->fn = &vk_device->fn;
+  profiler->frame_count = frames_in_flight;
+  profiler->current = nullptr;
+  profiler->command_buffer = VK_NULL_HANDLE;
+  profiler->gpu_depth = 0;
+  profiler->cpu_depth = 0;
+  profiler->gpu_overflow_depth = 0;
+  profiler->cpu_overflow_depth = 0;
+  profiler->start_ticks = SDL_GetPerformanceCounter();
+  profiler->gpu_end_us = 0.0;
+  profiler->has_gpu_origin = false;
+  profiler->frame_number = 0;
+  profiler->trace_path = trace_path;
+  profiler->timestamp_period =
+      vk_device->info.properties.limits.timestampPeriod;
+
+  uint32_t valid_bits =
+      vk_device->info.queue_families[vk_device->graphics_queue_family]
+          .timestampValidBits;
+  profiler->has_gpu_timestamps = valid_bits > 0;
+  profiler->timestamp_mask =
+      valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+  if (!profiler->has_gpu_timestamps) {
+    log_warning("Graphics queue has no timestamps, GPU scopes are disabled");
+  }
+
+  for (uint32_t slot = 0; slot < frames_in_flight; slot++) {
+    VulkanProfilerFrame* frame = &profiler->frames[slot];
+    frame->scope_count = 0;
+    frame->has_results = false;
+    if (!profiler->has_gpu_timestamps) {
+      continue;
+    }
+
+    VkQueryPoolCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = VULKAN_PROFILER_QUERY_COUNT,
+        .pipelineStatistics = 0,
+    };
+    VkResult result = profiler->fn->vkCreateQueryPool(
+        profiler->device, &create_info, nullptr, &frame->query_pool);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    frame->is_query_pool_init = true;
+  }
+  profiler->is_profiler_init = true;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_profiler_reset(VulkanProfiler* profiler) {
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    profiler->frames[slot].scope_count = 0;
+    profiler->frames[slot].has_results = false;
+    profiler->frames[slot].is_query_pool_init = false;
+  }
+  profiler->frame_count = 0;
+  profiler->current = nullptr;
+  profiler->has_gpu_timestamps = false;
+  profiler->has_gpu_origin = false;
+  profiler->trace_path = nullptr;
+  profiler->events = nullptr;
+  profiler->event_count = 0;
+  profiler->event_capacity = 0;
+  profiler->is_profiler_init = false;
+}
+
+void vulkan_profiler_destroy(VulkanProfiler* profiler) {
+  for (uint32_t slot = 0; slot < VULKAN_MAX_FRAMES_IN_FLIGHT; slot++) {
+    if (profiler->frames[slot].is_query_pool_init) {
+      profiler->fn->vkDestroyQueryPool(
+          profiler->device, profiler->frames[slot].query_pool, nullptr);
+    }
+  }
+  if (profiler->events) {
+    mem_free(profiler->events);
+  }
+  vulkan_profiler_reset(profiler);
+}
+
+Result(int, ErrorMessage)
+    vulkan_profiler_begin_frame(VulkanProfiler* profiler,
+                                const VulkanFrame* frame) {
+  if (frame->slot >= profiler->frame_count) {
+    return Err(int, ErrorMessage)("Frame slot out of range");
+  }
+
+  VulkanProfilerFrame* current = &profiler->frames[frame->slot];
+  auto read_result = vulkan_profiler_read_frame(profiler, current);
+  if (!read_result.is_ok) {
+    return read_result;
+  }
+
+  current->scope_count = 0;
+  current->frame_number = frame->frame_number;
+  profiler->frame_number = frame->frame_number;
+  profiler->current = current;
+  profiler->command_buffer = frame->command_buffer;
+  profiler->gpu_depth = 0;
+  profiler->gpu_overflow_depth = 0;
+  if (current->is_query_pool_init) {
+    profiler->fn->vkCmdResetQueryPool(frame->command_buffer,
+                                      current->query_pool, 0,
+                                      VULKAN_PROFILER_QUERY_COUNT);
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_profiler_end_frame(VulkanProfiler* profiler) {
+  VulkanProfilerFrame* current = profiler->current;
+  if (!current) {
+    return;
+  }
+  if (profiler->gpu_depth > 0) {
+    log_warning("Frame submitted with %u open GPU scopes, dropping them",
+                profiler->gpu_depth);
+    current->scope_count = 0;
+  }
+
+  current->submit_ticks = SDL_GetPerformanceCounter();
+  current->has_results = current->is_query_pool_init;
+  profiler->current = nullptr;
+  profiler->command_buffer = VK_NULL_HANDLE;
+}
+
+void vulkan_profiler_gpu_begin(VulkanProfiler* profiler, const char* name) {
+  VulkanProfilerFrame* current = profiler->current;
+  if (!current) {
+    return;
+  }
+  if (profiler->gpu_depth == VULKAN_PROFILER_MAX_DEPTH) {
+    profiler->gpu_overflow_depth++;
+    return;
+  }
+
+  uint32_t index = VULKAN_PROFILER_DROPPED_SCOPE;
+  if (current->is_query_pool_init &&
+      current->scope_count < VULKAN_PROFILER_MAX_SCOPES) {
+    index = current->scope_count++;
+    current->scopes[index] = (VulkanProfilerScope){
+        .name = name,
+        .begin_query = index * 2,
+    };
+    profiler->fn->vkCmdWriteTimestamp(profiler->command_buffer,
+                                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                      current->query_pool, index * 2);
+  }
+  profiler->gpu_stack[profiler->gpu_depth++] = index;
+}
+
+void vulkan_profiler_gpu_end(VulkanProfiler* profiler) {
+  VulkanProfilerFrame* current = profiler->current;
+  if (!current) {
+    return;
+  }
+  if (profiler->gpu_overflow_depth > 0) {
+    profiler->gpu_overflow_depth--;
+    return;
+  }
+  if (profiler->gpu_depth == 0) {
+    return;
+  }
+
+  uint32_t index = profiler->gpu_stack[--profiler->gpu_depth];
+  if (index == VULKAN_PROFILER_DROPPED_SCOPE) {
+    return;
+  }
+  // bottom of pipe waits for all work recorded inside the scope
+  profiler->fn->vkCmdWriteTimestamp(
+      profiler->command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      current->query_pool, current->scopes[index].begin_query + 1);
+}
+
+void vulkan_profiler_cpu_begin(VulkanProfiler* profiler, const char* name) {
+  if (profiler->cpu_depth == VULKAN_PROFILER_MAX_DEPTH) {
+    profiler->cpu_overflow_depth++;
+    return;
+  }
+  profiler->cpu_stack[profiler->cpu_depth++] = (VulkanProfilerCpuScope){
+      .name = name,
+      .begin_ticks = SDL_GetPerformanceCounter(),
+  };
+}
+
+void vulkan_profiler_cpu_end(VulkanProfiler* profiler) {
+  if (profiler->cpu_overflow_depth > 0) {
+    profiler->cpu_overflow_depth--;
+    return;
+  }
+  if (profiler->cpu_depth == 0) {
+    return;
+  }
+  uint64_t end_ticks = SDL_GetPerformanceCounter();
+  const VulkanProfilerCpuScope* scope =
+      &profiler->cpu_stack[--profiler->cpu_depth];
+
+  double start_us = vulkan_profiler_ticks_to_us(profiler, scope->begin_ticks);
+  double end_us = vulkan_profiler_ticks_to_us(profiler, end_ticks);
+  VulkanProfilerEvent event = {
+      .name = scope->name,
+      .frame_number = profiler->frame_number,
+      .start_us = start_us,
+      .duration_us = end_us - start_us,
+      .track = VULKAN_PROFILER_TRACK_CPU,
+  };
+  vulkan_profiler_add_event(profiler, &event);
+}
+
+void vulkan_profiler_add_queue_scope(VulkanProfiler* profiler,
+                                     const char* name,
+                                     uint64_t frame_number,
+                                     uint64_t begin_timestamp,
+                                     uint64_t end_timestamp) {
+  if (!profiler->has_gpu_origin) {
+    return;
+  }
+
+  // the span may start before the origin, the masked difference is read as
+  // a signed offset
+  uint64_t mask = profiler->timestamp_mask;
+  uint64_t offset = (begin_timestamp - profiler->gpu_origin_timestamp) & mask;
+  double signed_offset = offset > mask / 2 ? -(double)((mask - offset) + 1)
+                                           : (double)offset;
+  uint64_t duration = (end_timestamp - begin_timestamp) & mask;
+
+  double us_per_tick = profiler->timestamp_period / 1000.0;
+  VulkanProfilerEvent event = {
+      .name = name,
+      .frame_number = frame_number,
+      .start_us = profiler->gpu_origin_us + signed_offset * us_per_tick,
+      .duration_us = (double)duration * us_per_tick,
+      .track = VULKAN_PROFILER_TRACK_COMPUTE,
+  };
+  vulkan_profiler_add_event(profiler, &event);
+}
+
+Result(int, ErrorMessage) vulkan_profiler_collect(VulkanProfiler* profiler) {
+  // oldest submission first, so the GPU frames land on the timeline in order
+  VulkanProfilerFrame* pending[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t pending_count = 0;
+  for (uint32_t slot = 0; slot < profiler->frame_count; slot++) {
+    if (profiler->frames[slot].has_results) {
+      pending[pending_count++] = &profiler->frames[slot];
+    }
+  }
+  for (uint32_t i = 1; i < pending_count; i++) {
+    for (uint32_t j = i; j > 0 && pending[j]->frame_number <
+                                      pending[j - 1]->frame_number;
+         j--) {
+      VulkanProfilerFrame* frame = pending[j];
+      pending[j] = pending[j - 1];
+      pending[j - 1] = frame;
+    }
+  }
+
+  for (uint32_t i = 0; i < pending_count; i++) {
+    auto result = vulkan_profiler_read_frame(profiler, pending[i]);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// scope names come from code, only quotes and backslashes need escaping
+static void vulkan_profiler_escape(const char* name,
+                                   char* escaped,
+                                   size_t size) {
+  size_t length = 0;
+  for (const char* c = name; *c && length + 2 < size; c++) {
+    if (*c == '"' || *c == '\\') {
+      escaped[length++] = '\\';
+    }
+    escaped[length++] = *c;
+  }
+  escaped[length] = '\0';
+}
+
+Result(int, ErrorMessage)
+    vulkan_profiler_write_trace(VulkanProfiler* profiler) {
+  if (!profiler->trace_path) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  SDL_RWops* file = SDL_RWFromFile(profiler->trace_path, "wb");
+  if (!file) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+
+  static const char header[] =
+      "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+      "\"args\":{\"name\":\"CPU\"}},\n"
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+      "\"args\":{\"name\":\"GPU\"}},\n"
+      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,"
+      "\"args\":{\"name\":\"Compute\"}}";
+  bool success = SDL_RWwrite(file, header, sizeof(header) - 1, 1) == 1;
+
+  static const char* const categories[] = {
+      [VULKAN_PROFILER_TRACK_CPU] = "cpu",
+      [VULKAN_PROFILER_TRACK_GPU] = "gpu",
+      [VULKAN_PROFILER_TRACK_COMPUTE] = "compute",
+  };
+  char name[128];
+  char line[256];
+  for (uint32_t i = 0; i < profiler->event_count && success; i++) {
+    const VulkanProfilerEvent* event = &profiler->events[i];
+    vulkan_profiler_escape(event->name, name, sizeof(name));
+    int length = SDL_snprintf(
+        line, sizeof(line),
+        ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+        "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+        name, categories[event->track], (int)event->track + 1, event->start_us,
+        event->duration_us, (unsigned long long)event->frame_number);
+    success = length > 0 && (size_t)length < sizeof(line) &&
+              SDL_RWwrite(file, line, (size_t)length, 1) == 1;
+  }
+
+  static const char footer[] = "\n]}\n";
+  success = success && SDL_RWwrite(file, footer, sizeof(footer) - 1, 1) == 1;
+  success = SDL_RWclose(file) == 0 && success;
+  if (!success) {
+    return Err(int, ErrorMessage)("Unable to write trace file");
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
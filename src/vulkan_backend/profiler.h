@@ -0,0 +1,132 @@
+#ifndef VULKAN_BACKEND_PROFILER_H
+#define VULKAN_BACKEND_PROFILER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+
+// GPU scopes per frame, every scope takes two timestamp queries
+#define VULKAN_PROFILER_MAX_SCOPES 64
+#define VULKAN_PROFILER_MAX_DEPTH 16
+// a capture stops growing past this, about 40 MiB of events
+#define VULKAN_PROFILER_MAX_EVENTS (1u << 20)
+
+typedef enum VulkanProfilerTrack {
+  VULKAN_PROFILER_TRACK_CPU,
+  VULKAN_PROFILER_TRACK_GPU,
+  // submissions of the compute queue, async or not
+  VULKAN_PROFILER_TRACK_COMPUTE,
+} VulkanProfilerTrack;
+
+typedef struct VulkanProfilerEvent {
+  const char* name;
+  uint64_t frame_number;
+  // microseconds since the profiler was initialized
+  double start_us;
+  double duration_us;
+  VulkanProfilerTrack track;
+} VulkanProfilerEvent;
+
+typedef struct VulkanProfilerScope {
+  const char* name;
+  // the end timestamp is the query right after it
+  uint32_t begin_query;
+} VulkanProfilerScope;
+
+typedef struct VulkanProfilerFrame {
+  VkQueryPool query_pool;
+  VulkanProfilerScope scopes[VULKAN_PROFILER_MAX_SCOPES];
+  uint32_t scope_count;
+  uint64_t frame_number;
+  // GPU timestamps have no common origin with the CPU clock, a frame is
+  // placed on the timeline no earlier than its submission
+  uint64_t submit_ticks;
+  // recorded and submitted, results not read back yet
+  bool has_results;
+  bool is_query_pool_init;
+} VulkanProfilerFrame;
+
+typedef struct VulkanProfilerCpuScope {
+  const char* name;
+  uint64_t begin_ticks;
+} VulkanProfilerCpuScope;
+
+// Named, nestable CPU and GPU scopes on one timeline. GPU scopes write
+// timestamps into a query pool per frame in flight, results are read once
+// the frame scheduler waited on the slot so reading never stalls. Scope
+// names must outlive the profiler, string literals are expected. Not thread
+// safe, scopes are recorded from the thread that records the frame.
+typedef struct VulkanProfiler {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanProfilerFrame frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+  uint32_t frame_count;
+  VulkanProfilerFrame* current;
+  VkCommandBuffer command_buffer;
+  // latest frame begun, CPU scopes are attributed to it
+  uint64_t frame_number;
+  // nanoseconds per timestamp tick
+  double timestamp_period;
+  uint64_t timestamp_mask;
+  bool has_gpu_timestamps;
+  uint32_t gpu_stack[VULKAN_PROFILER_MAX_DEPTH];
+  uint32_t gpu_depth;
+  VulkanProfilerCpuScope cpu_stack[VULKAN_PROFILER_MAX_DEPTH];
+  uint32_t cpu_depth;
+  // scopes begun past VULKAN_PROFILER_MAX_DEPTH, their ends must not pop
+  uint32_t gpu_overflow_depth;
+  uint32_t cpu_overflow_depth;
+  uint64_t start_ticks;
+  // end of the latest GPU frame on the timeline
+  double gpu_end_us;
+  // first timestamp of the latest frame read back and where it was placed,
+  // timestamps of other queues are placed relative to it
+  uint64_t gpu_origin_timestamp;
+  double gpu_origin_us;
+  bool has_gpu_origin;
+  // nullptr keeps the profiler from collecting events
+  const char* trace_path;
+  VulkanProfilerEvent* events;
+  uint32_t event_count;
+  uint32_t event_capacity;
+  bool is_profiler_init;
+} VulkanProfiler;
+
+Result(int, ErrorMessage) vulkan_profiler_init(VulkanProfiler* profiler,
+                                               const VulkanDevice* vk_device,
+                                               uint32_t frames_in_flight,
+                                               const char* trace_path);
+void vulkan_profiler_reset(VulkanProfiler* profiler);
+void vulkan_profiler_destroy(VulkanProfiler* profiler);
+
+// reads back the results the slot collected frames_in_flight frames ago and
+// resets its queries, the command buffer must not be inside a render pass
+Result(int, ErrorMessage)
+    vulkan_profiler_begin_frame(VulkanProfiler* profiler,
+                                const VulkanFrame* frame);
+// call right before the frame is submitted
+void vulkan_profiler_end_frame(VulkanProfiler* profiler);
+
+void vulkan_profiler_gpu_begin(VulkanProfiler* profiler, const char* name);
+void vulkan_profiler_gpu_end(VulkanProfiler* profiler);
+void vulkan_profiler_cpu_begin(VulkanProfiler* profiler, const char* name);
+void vulkan_profiler_cpu_end(VulkanProfiler* profiler);
+// Places a span of raw timestamps written on another queue of the device on
+// the compute track. The queues are assumed to share the timestamp clock,
+// spans read before the first GPU frame are dropped.
+void vulkan_profiler_add_queue_scope(VulkanProfiler* profiler,
+                                     const char* name,
+                                     uint64_t frame_number,
+                                     uint64_t begin_timestamp,
+                                     uint64_t end_timestamp);
+
+// reads back every submitted frame, the GPU must be idle
+Result(int, ErrorMessage) vulkan_profiler_collect(VulkanProfiler* profiler);
+// writes the captured timeline as Chrome trace event JSON, load it in
+// chrome://tracing or ui.perfetto.dev
+Result(int, ErrorMessage) vulkan_profiler_write_trace(VulkanProfiler* profiler);
+
+#endif
@@ -0,0 +1,1242 @@
+#include "./render_graph.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/arena.h"
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+#define VULKAN_RENDER_GRAPH_WRITE_ACCESS                               \
+  (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |                      \
+   VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |           \
+   VK_ACCESS_MEMORY_WRITE_BIT)
+// usages that need an image view
+#define VULKAN_RENDER_GRAPH_VIEW_USAGE                       \
+  (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | \
+   VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |                     \
+   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)
+#define VULKAN_RENDER_GRAPH_NO_PASS UINT32_MAX
+
+typedef struct VulkanRenderGraphUsageInfo {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  VkImageLayout layout;
+  // 0 when the usage does not apply to the resource kind
+  VkImageUsageFlags image_usage;
+  VkBufferUsageFlags buffer_usage;
+  bool is_write;
+} VulkanRenderGraphUsageInfo;
+
+static const VulkanRenderGraphUsageInfo
+    vulkan_render_graph_usages[VULKAN_RENDER_GRAPH_USAGE_COUNT] = {
+        [VULKAN_RENDER_GRAPH_USAGE_TRANSFER_SRC] =
+            {
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .buffer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_TRANSFER_DST] =
+            {
+                .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                .buffer_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                .is_write = true,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_COLOR_ATTACHMENT] =
+            {
+                .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                .buffer_usage = 0,
+                .is_write = true,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT] =
+            {
+                .stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                .buffer_usage = 0,
+                .is_write = true,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_FRAGMENT_READ] =
+            {
+                .stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                .access = VK_ACCESS_SHADER_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+                .buffer_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_COMPUTE_READ] =
+            {
+                .stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .access = VK_ACCESS_SHADER_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .image_usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+                .buffer_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_COMPUTE_WRITE] =
+            {
+                .stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .access =
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                .layout = VK_IMAGE_LAYOUT_GENERAL,
+                .image_usage = VK_IMAGE_USAGE_STORAGE_BIT,
+                .buffer_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                .is_write = true,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_UNIFORM] =
+            {
+                .stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .access = VK_ACCESS_UNIFORM_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .image_usage = 0,
+                .buffer_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_VERTEX_BUFFER] =
+            {
+                .stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                .access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .image_usage = 0,
+                .buffer_usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_INDEX_BUFFER] =
+            {
+                .stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                .access = VK_ACCESS_INDEX_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .image_usage = 0,
+                .buffer_usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                .is_write = false,
+            },
+        [VULKAN_RENDER_GRAPH_USAGE_INDIRECT] =
+            {
+                .stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                .access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .image_usage = 0,
+                .buffer_usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                .is_write = false,
+            },
+};
+
+// all declared usages of one resource in a pass
+typedef struct VulkanRenderGraphUse {
+  VulkanRenderGraphHandle resource;
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  VkImageLayout layout;
+  bool is_write;
+} VulkanRenderGraphUse;
+
+// where a resource is while the barriers are planned
+typedef struct VulkanRenderGraphTrack {
+  VkImageLayout layout;
+  // last write and the reads after it
+  VkPipelineStageFlags write_stages;
+  VkAccessFlags write_access;
+  VkPipelineStageFlags read_stages;
+  // reads the last write was already made visible to
+  VkPipelineStageFlags visible_stages;
+  VkAccessFlags visible_access;
+  // earliest point the next barrier of the resource may move up to
+  uint32_t first_point;
+} VulkanRenderGraphTrack;
+
+typedef struct VulkanRenderGraphCompileContext {
+  VulkanRenderGraphUse uses[VULKAN_RENDER_GRAPH_MAX_PASSES]
+                           [VULKAN_RENDER_GRAPH_MAX_PASS_ACCESSES];
+  uint32_t use_counts[VULKAN_RENDER_GRAPH_MAX_PASSES];
+  // lifetime in execution order, VULKAN_RENDER_GRAPH_NO_PASS when unused
+  uint32_t first_use[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  uint32_t last_use[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkImageUsageFlags image_usage[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkBufferUsageFlags buffer_usage[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkMemoryRequirements requirements[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkDeviceSize offsets[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VulkanRenderGraphTrack tracks[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  // every stage and write of the transients sharing the memory of a kind
+  VkPipelineStageFlags heap_stages[2];
+  VkAccessFlags heap_writes[2];
+  VkDeviceSize transient_bytes;
+  VkDeviceSize aliased_bytes;
+} VulkanRenderGraphCompileContext;
+
+static void vulkan_render_graph_fail(VulkanRenderGraph* graph,
+                                     const char* error) {
+  if (!graph->declare_error) {
+    graph->declare_error = error;
+  }
+}
+
+static bool vulkan_render_graph_is_transient(const VulkanRenderGraph* graph,
+                                             VulkanRenderGraphHandle resource) {
+  return !graph->resources[resource].is_imported;
+}
+
+static VkImageAspectFlags vulkan_render_graph_aspect(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+      return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+static void vulkan_render_graph_destroy_transients(
+    VulkanRenderGraph* graph,
+    VulkanRenderGraphTransients* transients) {
+  for (uint32_t i = 0; i < VULKAN_RENDER_GRAPH_MAX_RESOURCES; i++) {
+    if (transients->views[i] != VK_NULL_HANDLE) {
+      graph->fn->vkDestroyImageView(graph->device, transients->views[i],
+                                    nullptr);
+    }
+    if (transients->images[i] != VK_NULL_HANDLE) {
+      graph->fn->vkDestroyImage(graph->device, transients->images[i], nullptr);
+    }
+    if (transients->buffers[i] != VK_NULL_HANDLE) {
+      graph->fn->vkDestroyBuffer(graph->device, transients->buffers[i],
+                                 nullptr);
+    }
+  }
+  if (transients->has_image_memory) {
+    vulkan_allocator_free(graph->allocator, &transients->image_memory);
+  }
+  if (transients->has_buffer_memory) {
+    vulkan_allocator_free(graph->allocator, &transients->buffer_memory);
+  }
+  SDL_memset(transients, 0, sizeof(*transients));
+}
+
+Result(int, ErrorMessage)
+    vulkan_render_graph_init(VulkanRenderGraph* graph,
+                             const VulkanDevice* vk_device,
+                             VulkanAllocator* allocator,
+                             uint32_t frames_in_flight) {
+  vulkan_render_graph_reset(graph);
+  graph->device = vk_device->device;
+  graph->fn = &vk_device->fn;
+  graph->allocator = allocator;
+  graph->frames_in_flight = frames_in_flight;
+
+  graph->barriers =
+      mem_alloc(sizeof(VulkanRenderGraphBarrier) *
+                VULKAN_RENDER_GRAPH_MAX_BARRIERS);
+  CHECK_ALLOC(graph->barriers, Err(int, ErrorMessage)(
+                                   "Unable to allocate memory for barriers"));
+  // one batch per point at most
+  graph->batches = mem_alloc(sizeof(VulkanRenderGraphBatch) *
+                             (VULKAN_RENDER_GRAPH_MAX_PASSES + 1));
+  CHECK_ALLOC(graph->batches, Err(int, ErrorMessage)(
+                                  "Unable to allocate memory for barriers"));
+  graph->is_graph_init = true;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_render_graph_reset(VulkanRenderGraph* graph) {
+  graph->resource_count = 0;
+  graph->pass_count = 0;
+  graph->declare_error = nullptr;
+  graph->order_count = 0;
+  graph->barriers = nullptr;
+  graph->barrier_count = 0;
+  graph->batches = nullptr;
+  graph->batch_count = 0;
+  SDL_memset(graph->generations, 0, sizeof(graph->generations));
+  graph->transients = nullptr;
+  graph->compile_count = 0;
+  graph->is_compiled = false;
+  graph->is_graph_init = false;
+}
+
+void vulkan_render_graph_destroy(VulkanRenderGraph* graph) {
+  for (uint32_t i = 0; i < VULKAN_RENDER_GRAPH_MAX_GENERATIONS; i++) {
+    if (graph->generations[i].is_in_use) {
+      vulkan_render_graph_destroy_transients(graph, &graph->generations[i]);
+    }
+  }
+  if (graph->barriers) {
+    mem_free(graph->barriers);
+  }
+  if (graph->batches) {
+    mem_free(graph->batches);
+  }
+  vulkan_render_graph_reset(graph);
+}
+
+VulkanRenderGraphState vulkan_render_graph_usage_state(
+    VulkanRenderGraphUsage usage) {
+  const VulkanRenderGraphUsageInfo* info = &vulkan_render_graph_usages[usage];
+  return (VulkanRenderGraphState){
+      .stages = info->stages,
+      .access = info->access,
+      .layout = info->layout,
+  };
+}
+
+void vulkan_render_graph_begin(VulkanRenderGraph* graph,
+                               uint64_t frame_number) {
+  graph->frame_number = frame_number;
+  graph->resource_count = 0;
+  graph->pass_count = 0;
+  graph->declare_error = nullptr;
+
+  // the frame before the retiring one was the last to use the transients,
+  // it finished once the slot frames_in_flight frames later began
+  for (uint32_t i = 0; i < VULKAN_RENDER_GRAPH_MAX_GENERATIONS; i++) {
+    VulkanRenderGraphTransients* transients = &graph->generations[i];
+    if (transients->is_in_use && transients != graph->transients &&
+        frame_number >= transients->retired_frame + graph->frames_in_flight) {
+      vulkan_render_graph_destroy_transients(graph, transients);
+    }
+  }
+}
+
+static VulkanRenderGraphHandle vulkan_render_graph_push_resource(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphResource* resource) {
+  if (graph->resource_count == VULKAN_RENDER_GRAPH_MAX_RESOURCES) {
+    vulkan_render_graph_fail(graph, "Too many render graph resources");
+    return VULKAN_RENDER_GRAPH_INVALID_HANDLE;
+  }
+  graph->resources[graph->resource_count] = *resource;
+  return graph->resource_count++;
+}
+
+VulkanRenderGraphHandle vulkan_render_graph_create_image(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphImageDesc* desc) {
+  return vulkan_render_graph_push_resource(
+      graph, &(VulkanRenderGraphResource){
+                 .kind = VULKAN_RENDER_GRAPH_RESOURCE_IMAGE,
+                 .image_desc = *desc,
+             });
+}
+
+VulkanRenderGraphHandle vulkan_render_graph_create_buffer(
+    VulkanRenderGraph* graph,
+    VkDeviceSize size) {
+  return vulkan_render_graph_push_resource(
+      graph, &(VulkanRenderGraphResource){
+                 .kind = VULKAN_RENDER_GRAPH_RESOURCE_BUFFER,
+                 .size = size,
+             });
+}
+
+VulkanRenderGraphHandle vulkan_render_graph_import_image(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphImageDesc* desc,
+    VkImage image,
+    VkImageView view,
+    const VulkanRenderGraphState* initial_state,
+    const VulkanRenderGraphState* final_state) {
+  return vulkan_render_graph_push_resource(
+      graph, &(VulkanRenderGraphResource){
+                 .kind = VULKAN_RENDER_GRAPH_RESOURCE_IMAGE,
+                 .is_imported = true,
+                 .image_desc = *desc,
+                 .initial_state = *initial_state,
+                 .final_state = *final_state,
+                 .image = image,
+                 .view = view,
+             });
+}
+
+VulkanRenderGraphHandle vulkan_render_graph_import_buffer(
+    VulkanRenderGraph* graph,
+    VkBuffer buffer,
+    VkDeviceSize size,
+    const VulkanRenderGraphState* initial_state,
+    const VulkanRenderGraphState* final_state) {
+  return vulkan_render_graph_push_resource(
+      graph, &(VulkanRenderGraphResource){
+                 .kind = VULKAN_RENDER_GRAPH_RESOURCE_BUFFER,
+                 .is_imported = true,
+                 .size = size,
+                 .initial_state = *initial_state,
+                 .final_state = *final_state,
+                 .buffer = buffer,
+             });
+}
+
+VulkanRenderGraphHandle vulkan_render_graph_add_pass(
+    VulkanRenderGraph* graph,
+    const char* name,
+    VulkanRenderGraphRecord record,
+    void* user_data) {
+  if (graph->pass_count == VULKAN_RENDER_GRAPH_MAX_PASSES) {
+    vulkan_render_graph_fail(graph, "Too many render graph passes");
+    return VULKAN_RENDER_GRAPH_INVALID_HANDLE;
+  }
+  VulkanRenderGraphPass* pass = &graph->passes[graph->pass_count];
+  pass->name = name;
+  pass->record = record;
+  pass->user_data = user_data;
+  pass->access_count = 0;
+  pass->has_side_effects = false;
+  return graph->pass_count++;
+}
+
+void vulkan_render_graph_use(VulkanRenderGraph* graph,
+                             VulkanRenderGraphHandle pass,
+                             VulkanRenderGraphHandle resource,
+                             VulkanRenderGraphUsage usage) {
+  if (pass >= graph->pass_count || resource >= graph->resource_count ||
+      usage >= VULKAN_RENDER_GRAPH_USAGE_COUNT) {
+    vulkan_render_graph_fail(graph, "Invalid render graph handle");
+    return;
+  }
+  VulkanRenderGraphPass* declared = &graph->passes[pass];
+  if (declared->access_count == VULKAN_RENDER_GRAPH_MAX_PASS_ACCESSES) {
+    vulkan_render_graph_fail(graph, "Too many accesses in render graph pass");
+    return;
+  }
+  declared->accesses[declared->access_count++] = (VulkanRenderGraphAccess){
+      .resource = resource,
+      .usage = usage,
+  };
+}
+
+void vulkan_render_graph_set_side_effects(VulkanRenderGraph* graph,
+                                          VulkanRenderGraphHandle pass) {
+  if (pass >= graph->pass_count) {
+    vulkan_render_graph_fail(graph, "Invalid render graph handle");
+    return;
+  }
+  graph->passes[pass].has_side_effects = true;
+}
+
+static uint64_t vulkan_render_graph_hash(const VulkanRenderGraph* graph) {
+  uint64_t hash = HASH_FNV1A64_SEED;
+  HASH_VALUE(hash, graph->resource_count);
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    const VulkanRenderGraphResource* resource = &graph->resources[i];
+    HASH_VALUE(hash, resource->kind);
+    HASH_VALUE(hash, resource->is_imported);
+    // the description of an imported resource is only read when recording,
+    // a resized swapchain must not reallocate the transients
+    if (!resource->is_imported) {
+      HASH_MEMBERS(hash, VulkanRenderGraphImageDesc, &resource->image_desc,
+                   format, height);
+      HASH_VALUE(hash, resource->size);
+      continue;
+    }
+    // the barriers at the graph boundary are planned from these
+    HASH_MEMBERS(hash, VulkanRenderGraphState, &resource->initial_state,
+                 stages, layout);
+    HASH_MEMBERS(hash, VulkanRenderGraphState, &resource->final_state,
+                 stages, layout);
+  }
+  HASH_VALUE(hash, graph->pass_count);
+  for (uint32_t i = 0; i < graph->pass_count; i++) {
+    const VulkanRenderGraphPass* pass = &graph->passes[i];
+    HASH_VALUE(hash, pass->has_side_effects);
+    HASH_VALUE(hash, pass->access_count);
+    for (uint32_t j = 0; j < pass->access_count; j++) {
+      HASH_MEMBERS(hash, VulkanRenderGraphAccess, &pass->accesses[j],
+                   resource, usage);
+    }
+  }
+  return hash;
+}
+
+// folds the accesses of every pass into one use per resource
+static Result(int, ErrorMessage)
+    vulkan_render_graph_merge_uses(const VulkanRenderGraph* graph,
+                                   VulkanRenderGraphCompileContext* context) {
+  for (uint32_t i = 0; i < graph->pass_count; i++) {
+    const VulkanRenderGraphPass* pass = &graph->passes[i];
+    VulkanRenderGraphUse* uses = context->uses[i];
+    uint32_t count = 0;
+    for (uint32_t j = 0; j < pass->access_count; j++) {
+      const VulkanRenderGraphAccess* access = &pass->accesses[j];
+      const VulkanRenderGraphUsageInfo* info =
+          &vulkan_render_graph_usages[access->usage];
+      bool is_image = graph->resources[access->resource].kind ==
+                      VULKAN_RENDER_GRAPH_RESOURCE_IMAGE;
+      if ((is_image ? info->image_usage : info->buffer_usage) == 0) {
+        return Err(int, ErrorMessage)(
+            "Render graph usage does not apply to the resource");
+      }
+
+      uint32_t k = 0;
+      while (k < count && uses[k].resource != access->resource) {
+        k++;
+      }
+      if (k == count) {
+        uses[count++] = (VulkanRenderGraphUse){
+            .resource = access->resource,
+            .layout = info->layout,
+        };
+      } else if (is_image && uses[k].layout != info->layout) {
+        return Err(int, ErrorMessage)(
+            "Render graph pass uses an image in two layouts");
+      }
+      uses[k].stages |= info->stages;
+      uses[k].access |= info->access;
+      uses[k].is_write |= info->is_write;
+    }
+    context->use_counts[i] = count;
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// Walks the passes backwards: a pass survives when it has side effects or
+// writes a resource that leaves the graph or that a surviving pass uses.
+static void vulkan_render_graph_cull(VulkanRenderGraph* graph,
+                                     VulkanRenderGraphCompileContext* context) {
+  bool is_needed[VULKAN_RENDER_GRAPH_MAX_RESOURCES] = {};
+  bool is_alive[VULKAN_RENDER_GRAPH_MAX_PASSES] = {};
+  for (uint32_t i = graph->pass_count; i-- > 0;) {
+    const VulkanRenderGraphUse* uses = context->uses[i];
+    bool alive = graph->passes[i].has_side_effects;
+    for (uint32_t j = 0; j < context->use_counts[i] && !alive; j++) {
+      alive = uses[j].is_write &&
+              (graph->resources[uses[j].resource].is_imported ||
+               is_needed[uses[j].resource]);
+    }
+    if (!alive) {
+      continue;
+    }
+    is_alive[i] = true;
+    // the earlier contents count as needed even for plain writes, a pass
+    // may only overwrite part of a resource
+    for (uint32_t j = 0; j < context->use_counts[i]; j++) {
+      is_needed[uses[j].resource] = true;
+    }
+  }
+
+  graph->order_count = 0;
+  for (uint32_t i = 0; i < graph->pass_count; i++) {
+    if (is_alive[i]) {
+      graph->order[graph->order_count++] = i;
+    }
+  }
+}
+
+static void vulkan_render_graph_find_lifetimes(
+    const VulkanRenderGraph* graph,
+    VulkanRenderGraphCompileContext* context) {
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    context->first_use[i] = VULKAN_RENDER_GRAPH_NO_PASS;
+  }
+  for (uint32_t i = 0; i < graph->order_count; i++) {
+    uint32_t pass_index = graph->order[i];
+    const VulkanRenderGraphPass* pass = &graph->passes[pass_index];
+    for (uint32_t j = 0; j < pass->access_count; j++) {
+      const VulkanRenderGraphAccess* access = &pass->accesses[j];
+      const VulkanRenderGraphUsageInfo* info =
+          &vulkan_render_graph_usages[access->usage];
+      context->image_usage[access->resource] |= info->image_usage;
+      context->buffer_usage[access->resource] |= info->buffer_usage;
+    }
+    for (uint32_t j = 0; j < context->use_counts[pass_index]; j++) {
+      const VulkanRenderGraphUse* use = &context->uses[pass_index][j];
+      if (context->first_use[use->resource] == VULKAN_RENDER_GRAPH_NO_PASS) {
+        context->first_use[use->resource] = i;
+      }
+      context->last_use[use->resource] = i;
+      if (vulkan_render_graph_is_transient(graph, use->resource)) {
+        uint32_t kind = graph->resources[use->resource].kind;
+        context->heap_stages[kind] |= use->stages;
+        context->heap_writes[kind] |=
+            use->access & VULKAN_RENDER_GRAPH_WRITE_ACCESS;
+      }
+    }
+  }
+}
+
+static bool vulkan_render_graph_is_placed(
+    const VulkanRenderGraph* graph,
+    const VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphHandle resource,
+    VulkanRenderGraphResourceKind kind) {
+  return vulkan_render_graph_is_transient(graph, resource) &&
+         graph->resources[resource].kind == kind &&
+         context->first_use[resource] != VULKAN_RENDER_GRAPH_NO_PASS;
+}
+
+static bool vulkan_render_graph_lifetimes_overlap(
+    const VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphHandle a,
+    VulkanRenderGraphHandle b) {
+  return context->first_use[a] <= context->last_use[b] &&
+         context->first_use[b] <= context->last_use[a];
+}
+
+static bool vulkan_render_graph_memory_overlaps(
+    const VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphHandle a,
+    VulkanRenderGraphHandle b) {
+  return context->offsets[a] <
+             context->offsets[b] + context->requirements[b].size &&
+         context->offsets[b] <
+             context->offsets[a] + context->requirements[a].size;
+}
+
+// true when resource fits at its offset next to the placed resources that
+// are alive at the same time
+static bool vulkan_render_graph_fits(
+    const VulkanRenderGraphCompileContext* context,
+    const VulkanRenderGraphHandle* placed,
+    uint32_t placed_count,
+    VulkanRenderGraphHandle resource) {
+  for (uint32_t i = 0; i < placed_count; i++) {
+    if (vulkan_render_graph_lifetimes_overlap(context, resource, placed[i]) &&
+        vulkan_render_graph_memory_overlaps(context, resource, placed[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Assigns offsets to the transients of kind, largest first, each one at the
+// lowest offset that overlaps nothing alive at the same time. Returns the
+// size of the memory they share.
+static VkDeviceSize vulkan_render_graph_place(
+    const VulkanRenderGraph* graph,
+    VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphResourceKind kind) {
+  VulkanRenderGraphHandle placed[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    if (!vulkan_render_graph_is_placed(graph, context, i, kind)) {
+      continue;
+    }
+    uint32_t j = count++;
+    while (j > 0 && context->requirements[placed[j - 1]].size <
+                        context->requirements[i].size) {
+      placed[j] = placed[j - 1];
+      j--;
+    }
+    placed[j] = i;
+  }
+
+  VkDeviceSize total = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    VulkanRenderGraphHandle resource = placed[i];
+    VkDeviceSize alignment = context->requirements[resource].alignment;
+    VkDeviceSize best = UINT64_MAX;
+    // the only offsets worth trying are 0 and the ends of placed resources
+    for (uint32_t j = 0; j <= i; j++) {
+      VkDeviceSize candidate = 0;
+      if (j < i) {
+        if (!vulkan_render_graph_lifetimes_overlap(context, resource,
+                                                   placed[j])) {
+          continue;
+        }
+        candidate = context->offsets[placed[j]] +
+                    context->requirements[placed[j]].size;
+      }
+      candidate = ALIGN(candidate, alignment);
+      if (candidate >= best) {
+        continue;
+      }
+      context->offsets[resource] = candidate;
+      if (vulkan_render_graph_fits(context, placed, i, resource)) {
+        best = candidate;
+      }
+    }
+    context->offsets[resource] = best;
+    if (best + context->requirements[resource].size > total) {
+      total = best + context->requirements[resource].size;
+    }
+  }
+
+  return total;
+}
+
+static Result(int, ErrorMessage) vulkan_render_graph_create_resource(
+    VulkanRenderGraph* graph,
+    VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphTransients* transients,
+    VulkanRenderGraphHandle resource) {
+  const VulkanRenderGraphResource* declared = &graph->resources[resource];
+  VkResult result = VK_SUCCESS;
+  if (declared->kind == VULKAN_RENDER_GRAPH_RESOURCE_IMAGE) {
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = declared->image_desc.format,
+        .extent = {declared->image_desc.width, declared->image_desc.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = context->image_usage[resource],
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    result = graph->fn->vkCreateImage(graph->device, &image_create_info,
+                                      nullptr, &transients->images[resource]);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    graph->fn->vkGetImageMemoryRequirements(graph->device,
+                                            transients->images[resource],
+                                            &context->requirements[resource]);
+  } else {
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .size = declared->size,
+        .usage = context->buffer_usage[resource],
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+    };
+    result = graph->fn->vkCreateBuffer(graph->device, &buffer_create_info,
+                                       nullptr, &transients->buffers[resource]);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    graph->fn->vkGetBufferMemoryRequirements(graph->device,
+                                             transients->buffers[resource],
+                                             &context->requirements[resource]);
+  }
+  context->transient_bytes += context->requirements[resource].size;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) vulkan_render_graph_bind_resource(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphCompileContext* context,
+    VulkanRenderGraphTransients* transients,
+    const VulkanAllocation* allocation,
+    VulkanRenderGraphHandle resource) {
+  const VulkanRenderGraphResource* declared = &graph->resources[resource];
+  VkDeviceSize offset = allocation->offset + context->offsets[resource];
+  if (declared->kind == VULKAN_RENDER_GRAPH_RESOURCE_BUFFER) {
+    VkResult result =
+        graph->fn->vkBindBufferMemory(graph->device,
+                                      transients->buffers[resource],
+                                      allocation->memory, offset);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkResult result = graph->fn->vkBindImageMemory(
+      graph->device, transients->images[resource], allocation->memory, offset);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if ((context->image_usage[resource] & VULKAN_RENDER_GRAPH_VIEW_USAGE) == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkImageViewCreateInfo view_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .image = transients->images[resource],
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = declared->image_desc.format,
+      .components =
+          {
+              .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+          },
+      .subresourceRange =
+          {
+              .aspectMask =
+                  vulkan_render_graph_aspect(declared->image_desc.format),
+              .baseMipLevel = 0,
+              .levelCount = 1,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+  };
+  result = graph->fn->vkCreateImageView(graph->device, &view_create_info,
+                                        nullptr, &transients->views[resource]);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// places the transients of kind and binds them to one allocation
+static Result(int, ErrorMessage)
+    vulkan_render_graph_allocate(VulkanRenderGraph* graph,
+                                 VulkanRenderGraphCompileContext* context,
+                                 VulkanRenderGraphTransients* transients,
+                                 VulkanRenderGraphResourceKind kind) {
+  VkMemoryRequirements requirements = {
+      .size = 0,
+      .alignment = 1,
+      .memoryTypeBits = UINT32_MAX,
+  };
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    if (vulkan_render_graph_is_placed(graph, context, i, kind)) {
+      requirements.memoryTypeBits &= context->requirements[i].memoryTypeBits;
+      if (context->requirements[i].alignment > requirements.alignment) {
+        requirements.alignment = context->requirements[i].alignment;
+      }
+      count++;
+    }
+  }
+  if (count == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  if (requirements.memoryTypeBits == 0) {
+    return Err(int, ErrorMessage)(
+        "Transient resources have no memory type in common");
+  }
+  requirements.size = vulkan_render_graph_place(graph, context, kind);
+  context->aliased_bytes += requirements.size;
+
+  bool is_image = kind == VULKAN_RENDER_GRAPH_RESOURCE_IMAGE;
+  VulkanAllocation* allocation =
+      is_image ? &transients->image_memory : &transients->buffer_memory;
+  auto result = vulkan_allocator_allocate(
+      graph->allocator, &requirements, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      is_image ? VULKAN_ALLOCATION_KIND_OPTIMAL : VULKAN_ALLOCATION_KIND_LINEAR,
+      allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+  if (is_image) {
+    transients->has_image_memory = true;
+  } else {
+    transients->has_buffer_memory = true;
+  }
+
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    if (vulkan_render_graph_is_placed(graph, context, i, kind)) {
+      result = vulkan_render_graph_bind_resource(graph, context, transients,
+                                                 allocation, i);
+      if (!result.is_ok) {
+        return result;
+      }
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_render_graph_create_transients(
+        VulkanRenderGraph* graph,
+        VulkanRenderGraphCompileContext* context,
+        VulkanRenderGraphTransients* transients) {
+  transients->is_in_use = true;
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    if (vulkan_render_graph_is_transient(graph, i) &&
+        context->first_use[i] != VULKAN_RENDER_GRAPH_NO_PASS) {
+      auto result =
+          vulkan_render_graph_create_resource(graph, context, transients, i);
+      if (!result.is_ok) {
+        return result;
+      }
+    }
+  }
+
+  auto result = vulkan_render_graph_allocate(
+      graph, context, transients, VULKAN_RENDER_GRAPH_RESOURCE_IMAGE);
+  if (!result.is_ok) {
+    return result;
+  }
+  return vulkan_render_graph_allocate(graph, context, transients,
+                                      VULKAN_RENDER_GRAPH_RESOURCE_BUFFER);
+}
+
+// Imported resources start in their initial state. Transients start
+// undefined after whatever last touched their memory: an aliased resource
+// earlier in the frame or the graph of the previous frame, so their first
+// barrier waits on every stage of the memory they live in and may not move
+// above the last use of an earlier alias.
+static void vulkan_render_graph_init_tracks(
+    const VulkanRenderGraph* graph,
+    VulkanRenderGraphCompileContext* context) {
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    const VulkanRenderGraphResource* resource = &graph->resources[i];
+    VulkanRenderGraphTrack* track = &context->tracks[i];
+    *track = (VulkanRenderGraphTrack){.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+    if (resource->is_imported) {
+      track->layout = resource->initial_state.layout;
+      track->write_stages = resource->initial_state.stages;
+      track->write_access = resource->initial_state.access;
+      continue;
+    }
+    if (context->first_use[i] == VULKAN_RENDER_GRAPH_NO_PASS) {
+      continue;
+    }
+    track->write_stages = context->heap_stages[resource->kind];
+    track->write_access = context->heap_writes[resource->kind];
+    for (uint32_t j = 0; j < graph->resource_count; j++) {
+      if (vulkan_render_graph_is_placed(graph, context, j, resource->kind) &&
+          context->last_use[j] < context->first_use[i] &&
+          vulkan_render_graph_memory_overlaps(context, i, j) &&
+          context->last_use[j] + 1 > track->first_point) {
+        track->first_point = context->last_use[j] + 1;
+      }
+    }
+  }
+}
+
+static void vulkan_render_graph_push_barrier(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphBarrier* barrier) {
+  graph->barriers[graph->barrier_count++] = *barrier;
+}
+
+// Walks the surviving passes in order and records the barrier every use
+// needs, each one allowed anywhere after the previous use of its resource.
+static void vulkan_render_graph_plan_barriers(
+    VulkanRenderGraph* graph,
+    VulkanRenderGraphCompileContext* context) {
+  graph->barrier_count = 0;
+  for (uint32_t i = 0; i < graph->order_count; i++) {
+    uint32_t pass_index = graph->order[i];
+    for (uint32_t j = 0; j < context->use_counts[pass_index]; j++) {
+      const VulkanRenderGraphUse* use = &context->uses[pass_index][j];
+      VulkanRenderGraphTrack* track = &context->tracks[use->resource];
+      bool is_image = graph->resources[use->resource].kind ==
+                      VULKAN_RENDER_GRAPH_RESOURCE_IMAGE;
+      bool is_transition = is_image && use->layout != track->layout;
+
+      VulkanRenderGraphBarrier barrier = {
+          .resource = use->resource,
+          .first_point = track->first_point,
+          .last_point = i,
+          .dst_stages = use->stages,
+          .dst_access = use->access,
+          .old_layout = track->layout,
+          .new_layout = is_image ? use->layout : track->layout,
+      };
+      bool is_needed = false;
+      if (is_transition || use->is_write) {
+        // write after write and write after read, transitions are writes
+        barrier.src_stages = track->write_stages | track->read_stages;
+        barrier.src_access = track->write_access;
+        is_needed = is_transition || barrier.src_stages != 0;
+      } else if (track->write_stages != 0 &&
+                 ((track->visible_stages & use->stages) != use->stages ||
+                  (track->visible_access & use->access) != use->access)) {
+        // read after write the write was not made visible to yet
+        barrier.src_stages = track->write_stages;
+        barrier.src_access = track->write_access;
+        is_needed = true;
+      }
+      if (is_needed) {
+        vulkan_render_graph_push_barrier(graph, &barrier);
+      }
+
+      if (use->is_write) {
+        track->write_stages = use->stages;
+        track->write_access = use->access & VULKAN_RENDER_GRAPH_WRITE_ACCESS;
+        track->read_stages = 0;
+        track->visible_stages = 0;
+        track->visible_access = 0;
+      } else if (is_transition) {
+        // later barriers chain through the stages of this one to reach the
+        // layout transition
+        track->write_stages |= use->stages;
+        track->read_stages |= use->stages;
+        track->visible_stages = use->stages;
+        track->visible_access = use->access;
+      } else {
+        track->read_stages |= use->stages;
+        if (is_needed) {
+          track->visible_stages |= use->stages;
+          track->visible_access |= use->access;
+        }
+      }
+      track->layout = barrier.new_layout;
+      track->first_point = i + 1;
+    }
+  }
+
+  // imported resources leave in their final state, also when unused
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    const VulkanRenderGraphResource* resource = &graph->resources[i];
+    if (!resource->is_imported) {
+      continue;
+    }
+    const VulkanRenderGraphTrack* track = &context->tracks[i];
+    const VulkanRenderGraphState* final_state = &resource->final_state;
+    bool is_transition = resource->kind == VULKAN_RENDER_GRAPH_RESOURCE_IMAGE &&
+                         final_state->layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                         final_state->layout != track->layout;
+    VkPipelineStageFlags src_stages = track->write_stages | track->read_stages;
+    if (!is_transition && (final_state->stages == 0 || src_stages == 0)) {
+      continue;
+    }
+    vulkan_render_graph_push_barrier(
+        graph, &(VulkanRenderGraphBarrier){
+                   .resource = i,
+                   .first_point = track->first_point,
+                   .last_point = graph->order_count,
+                   .src_stages = src_stages,
+                   .dst_stages = final_state->stages,
+                   .src_access = track->write_access,
+                   .dst_access = final_state->access,
+                   .old_layout = track->layout,
+                   .new_layout = is_transition ? final_state->layout
+                                               : track->layout,
+               });
+  }
+}
+
+// Groups the barriers into the fewest pipeline barrier calls. The barriers
+// were planned in order of their last point, so opening a batch at the last
+// point of the first barrier no open batch covers is optimal.
+static void vulkan_render_graph_batch_barriers(VulkanRenderGraph* graph) {
+  graph->batch_count = 0;
+  VulkanRenderGraphBatch* batch = nullptr;
+  for (uint32_t i = 0; i < graph->barrier_count; i++) {
+    VulkanRenderGraphBarrier* barrier = &graph->barriers[i];
+    if (!batch || barrier->first_point > batch->point) {
+      batch = &graph->batches[graph->batch_count++];
+      *batch = (VulkanRenderGraphBatch){
+          .point = barrier->last_point,
+          .first_barrier = i,
+      };
+    }
+    batch->barrier_count++;
+    batch->src_stages |= barrier->src_stages
+                             ? barrier->src_stages
+                             : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    batch->dst_stages |= barrier->dst_stages
+                             ? barrier->dst_stages
+                             : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    if (graph->resources[barrier->resource].kind ==
+            VULKAN_RENDER_GRAPH_RESOURCE_BUFFER &&
+        (barrier->src_access | barrier->dst_access) != 0) {
+      batch->memory_src_access |= barrier->src_access;
+      batch->memory_dst_access |= barrier->dst_access;
+      batch->has_memory_barrier = true;
+    }
+  }
+}
+
+static void vulkan_render_graph_bind_transients(VulkanRenderGraph* graph) {
+  for (uint32_t i = 0; i < graph->resource_count; i++) {
+    VulkanRenderGraphResource* resource = &graph->resources[i];
+    if (!resource->is_imported) {
+      resource->image = graph->transients->images[i];
+      resource->view = graph->transients->views[i];
+      resource->buffer = graph->transients->buffers[i];
+    }
+  }
+}
+
+static void vulkan_render_graph_log_compile(
+    const VulkanRenderGraph* graph,
+    const VulkanRenderGraphCompileContext* context) {
+  // one call per pass that needs a barrier without the merging
+  uint32_t unbatched_count = 0;
+  for (uint32_t i = 0; i < graph->barrier_count; i++) {
+    if (i == 0 ||
+        graph->barriers[i].last_point != graph->barriers[i - 1].last_point) {
+      unbatched_count++;
+    }
+  }
+  log_debug(
+      "Compiled render graph: %u of %u passes, %u barriers in %u calls "
+      "(%u unbatched), transients %llu KiB in %llu KiB of memory",
+      graph->order_count, graph->pass_count, graph->barrier_count,
+      graph->batch_count, unbatched_count,
+      (unsigned long long)(context->transient_bytes / 1024),
+      (unsigned long long)(context->aliased_bytes / 1024));
+}
+
+Result(int, ErrorMessage) vulkan_render_graph_compile(
+    VulkanRenderGraph* graph) {
+  if (graph->declare_error) {
+    return Err(int, ErrorMessage)(graph->declare_error);
+  }
+  uint64_t hash = vulkan_render_graph_hash(graph);
+  if (graph->is_compiled && hash == graph->compiled_hash) {
+    vulkan_render_graph_bind_transients(graph);
+    return Ok(int, ErrorMessage)(0);
+  }
+  graph->is_compiled = false;
+
+  // retired generations are freed by begin, one is always free here
+  VulkanRenderGraphTransients* transients = nullptr;
+  for (uint32_t i = 0; i < VULKAN_RENDER_GRAPH_MAX_GENERATIONS; i++) {
+    if (!graph->generations[i].is_in_use) {
+      transients = &graph->generations[i];
+      break;
+    }
+  }
+  if (!transients) {
+    return Err(int, ErrorMessage)("Too many render graph recompiles");
+  }
+
+  ArenaScratch scratch = arena_scratch_begin();
+  VulkanRenderGraphCompileContext* context =
+      scratch.arena
+          ? arena_alloc_zeroed(scratch.arena,
+                               sizeof(VulkanRenderGraphCompileContext))
+          : nullptr;
+  if (!context) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate memory for render graph");
+  }
+
+  auto result = vulkan_render_graph_merge_uses(graph, context);
+  if (!result.is_ok) {
+    arena_scratch_end(scratch);
+    return result;
+  }
+  vulkan_render_graph_cull(graph, context);
+  vulkan_render_graph_find_lifetimes(graph, context);
+  result = vulkan_render_graph_create_transients(graph, context, transients);
+  if (!result.is_ok) {
+    vulkan_render_graph_destroy_transients(graph, transients);
+    arena_scratch_end(scratch);
+    return result;
+  }
+  if (graph->transients) {
+    graph->transients->retired_frame = graph->frame_number;
+  }
+  graph->transients = transients;
+
+  vulkan_render_graph_init_tracks(graph, context);
+  vulkan_render_graph_plan_barriers(graph, context);
+  vulkan_render_graph_batch_barriers(graph);
+  vulkan_render_graph_log_compile(graph, context);
+  arena_scratch_end(scratch);
+
+  graph->compiled_hash = hash;
+  graph->compile_count++;
+  graph->is_compiled = true;
+  vulkan_render_graph_bind_transients(graph);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_render_graph_record_batch(
+    const VulkanRenderGraph* graph,
+    const VulkanRenderGraphBatch* batch,
+    VkCommandBuffer command_buffer) {
+  // a batch holds at most one barrier per resource
+  VkImageMemoryBarrier image_barriers[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  uint32_t image_barrier_count = 0;
+  for (uint32_t i = 0; i < batch->barrier_count; i++) {
+    const VulkanRenderGraphBarrier* barrier =
+        &graph->barriers[batch->first_barrier + i];
+    const VulkanRenderGraphResource* resource =
+        &graph->resources[barrier->resource];
+    if (resource->kind != VULKAN_RENDER_GRAPH_RESOURCE_IMAGE) {
+      continue;
+    }
+    image_barriers[image_barrier_count++] = (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = barrier->src_access,
+        .dstAccessMask = barrier->dst_access,
+        .oldLayout = barrier->old_layout,
+        .newLayout = barrier->new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = resource->image,
+        .subresourceRange =
+            {
+                .aspectMask =
+                    vulkan_render_graph_aspect(resource->image_desc.format),
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = VK_REMAINING_ARRAY_LAYERS,
+            },
+    };
+  }
+
+  VkMemoryBarrier memory_barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = batch->memory_src_access,
+      .dstAccessMask = batch->memory_dst_access,
+  };
+  graph->fn->vkCmdPipelineBarrier(
+      command_buffer, batch->src_stages, batch->dst_stages, 0,
+      batch->has_memory_barrier ? 1 : 0, &memory_barrier, 0, nullptr,
+      image_barrier_count, image_barriers);
+}
+
+void vulkan_render_graph_execute(VulkanRenderGraph* graph,
+                                 VkCommandBuffer command_buffer,
+                                 VulkanProfiler* profiler) {
+  uint32_t batch_index = 0;
+  for (uint32_t point = 0; point <= graph->order_count; point++) {
+    if (batch_index < graph->batch_count &&
+        graph->batches[batch_index].point == point) {
+      vulkan_render_graph_record_batch(graph, &graph->batches[batch_index],
+                                       command_buffer);
+      batch_index++;
+    }
+    if (point == graph->order_count) {
+      break;
+    }
+
+    const VulkanRenderGraphPass* pass = &graph->passes[graph->order[point]];
+    if (profiler) {
+      vulkan_profiler_gpu_begin(profiler, pass->name);
+    }
+    if (pass->record) {
+      pass->record(graph, command_buffer, pass->user_data);
+    }
+    if (profiler) {
+      vulkan_profiler_gpu_end(profiler);
+    }
+  }
+}
+
+VkImage vulkan_render_graph_image(const VulkanRenderGraph* graph,
+                                  VulkanRenderGraphHandle resource) {
+  return graph->resources[resource].image;
+}
+
+VkImageView vulkan_render_graph_image_view(const VulkanRenderGraph* graph,
+                                           VulkanRenderGraphHandle resource) {
+  return graph->resources[resource].view;
+}
+
+VkBuffer vulkan_render_graph_buffer(const VulkanRenderGraph* graph,
+                                    VulkanRenderGraphHandle resource) {
+  return graph->resources[resource].buffer;
+}
@@ -0,0 +1,244 @@
+#ifndef VULKAN_BACKEND_RENDER_GRAPH_H
+#define VULKAN_BACKEND_RENDER_GRAPH_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./allocator.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+#include "./profiler.h"
+
+#define VULKAN_RENDER_GRAPH_MAX_PASSES 64
+#define VULKAN_RENDER_GRAPH_MAX_RESOURCES 64
+#define VULKAN_RENDER_GRAPH_MAX_PASS_ACCESSES 8
+// every access needs at most one barrier, every imported resource one more
+// into its final state
+#define VULKAN_RENDER_GRAPH_MAX_BARRIERS                                    \
+  (VULKAN_RENDER_GRAPH_MAX_PASSES * VULKAN_RENDER_GRAPH_MAX_PASS_ACCESSES + \
+   VULKAN_RENDER_GRAPH_MAX_RESOURCES)
+// transients stay alive until the frames in flight that used them finished
+#define VULKAN_RENDER_GRAPH_MAX_GENERATIONS (VULKAN_MAX_FRAMES_IN_FLIGHT + 1)
+#define VULKAN_RENDER_GRAPH_INVALID_HANDLE UINT32_MAX
+
+typedef uint32_t VulkanRenderGraphHandle;
+
+typedef enum VulkanRenderGraphUsage {
+  VULKAN_RENDER_GRAPH_USAGE_TRANSFER_SRC,
+  VULKAN_RENDER_GRAPH_USAGE_TRANSFER_DST,
+  VULKAN_RENDER_GRAPH_USAGE_COLOR_ATTACHMENT,
+  VULKAN_RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT,
+  // sampled images, storage buffers
+  VULKAN_RENDER_GRAPH_USAGE_FRAGMENT_READ,
+  VULKAN_RENDER_GRAPH_USAGE_COMPUTE_READ,
+  // storage images and buffers, read-modify-write included
+  VULKAN_RENDER_GRAPH_USAGE_COMPUTE_WRITE,
+  // buffers only
+  VULKAN_RENDER_GRAPH_USAGE_UNIFORM,
+  VULKAN_RENDER_GRAPH_USAGE_VERTEX_BUFFER,
+  VULKAN_RENDER_GRAPH_USAGE_INDEX_BUFFER,
+  VULKAN_RENDER_GRAPH_USAGE_INDIRECT,
+  VULKAN_RENDER_GRAPH_USAGE_COUNT,
+} VulkanRenderGraphUsage;
+
+// Where an imported resource is before and after the graph. Stages 0 means
+// nothing touched it before, for a swapchain image it is the stage the
+// acquire semaphore is waited on.
+typedef struct VulkanRenderGraphState {
+  VkPipelineStageFlags stages;
+  VkAccessFlags access;
+  // ignored for buffers
+  VkImageLayout layout;
+} VulkanRenderGraphState;
+
+typedef struct VulkanRenderGraphImageDesc {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+} VulkanRenderGraphImageDesc;
+
+typedef enum VulkanRenderGraphResourceKind {
+  VULKAN_RENDER_GRAPH_RESOURCE_IMAGE,
+  VULKAN_RENDER_GRAPH_RESOURCE_BUFFER,
+} VulkanRenderGraphResourceKind;
+
+typedef struct VulkanRenderGraphResource {
+  VulkanRenderGraphResourceKind kind;
+  bool is_imported;
+  VulkanRenderGraphImageDesc image_desc;
+  VkDeviceSize size;
+  VulkanRenderGraphState initial_state;
+  VulkanRenderGraphState final_state;
+  // set every frame for imported resources, the compiled transient otherwise
+  VkImage image;
+  VkImageView view;
+  VkBuffer buffer;
+} VulkanRenderGraphResource;
+
+typedef struct VulkanRenderGraphAccess {
+  VulkanRenderGraphHandle resource;
+  VulkanRenderGraphUsage usage;
+} VulkanRenderGraphAccess;
+
+typedef struct VulkanRenderGraph VulkanRenderGraph;
+
+// records the commands of a pass, the resources it declared are already in
+// the state its usages ask for
+typedef void (*VulkanRenderGraphRecord)(const VulkanRenderGraph* graph,
+                                        VkCommandBuffer command_buffer,
+                                        void* user_data);
+
+typedef struct VulkanRenderGraphPass {
+  const char* name;
+  VulkanRenderGraphRecord record;
+  void* user_data;
+  VulkanRenderGraphAccess accesses[VULKAN_RENDER_GRAPH_MAX_PASS_ACCESSES];
+  uint32_t access_count;
+  // never culled, for passes with effects outside the graph
+  bool has_side_effects;
+} VulkanRenderGraphPass;
+
+// One resource transition or memory dependency. It may be recorded at any
+// point from first_point to last_point, point i is right before the i-th
+// pass in execution order and the pass count is after the last one.
+typedef struct VulkanRenderGraphBarrier {
+  VulkanRenderGraphHandle resource;
+  uint32_t first_point;
+  uint32_t last_point;
+  VkPipelineStageFlags src_stages;
+  VkPipelineStageFlags dst_stages;
+  VkAccessFlags src_access;
+  VkAccessFlags dst_access;
+  VkImageLayout old_layout;
+  VkImageLayout new_layout;
+} VulkanRenderGraphBarrier;
+
+// Barriers recorded by one vkCmdPipelineBarrier call. Buffer dependencies
+// are merged into a single global memory barrier.
+typedef struct VulkanRenderGraphBatch {
+  uint32_t point;
+  uint32_t first_barrier;
+  uint32_t barrier_count;
+  VkPipelineStageFlags src_stages;
+  VkPipelineStageFlags dst_stages;
+  VkAccessFlags memory_src_access;
+  VkAccessFlags memory_dst_access;
+  bool has_memory_barrier;
+} VulkanRenderGraphBatch;
+
+// Images and buffers the graph created for one compiled topology, aliased
+// into one allocation per kind
+typedef struct VulkanRenderGraphTransients {
+  VkImage images[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkImageView views[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VkBuffer buffers[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  VulkanAllocation image_memory;
+  VulkanAllocation buffer_memory;
+  // first frame that used the next topology
+  uint64_t retired_frame;
+  bool has_image_memory;
+  bool has_buffer_memory;
+  bool is_in_use;
+} VulkanRenderGraphTransients;
+
+// Frame graph. Passes and resources are declared again every frame between
+// begin and compile, compile only redoes the work when the declarations
+// hash differently from the last compiled ones: imported handles and
+// descriptions, record callbacks and their user data are not part of the
+// hash.
+//
+// Compiling culls passes whose writes nobody reads, places every barrier so
+// they share the fewest vkCmdPipelineBarrier calls, and aliases transient
+// resources with disjoint lifetimes into the same memory. Everything runs on
+// the graphics queue. Not thread safe.
+struct VulkanRenderGraph {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanAllocator* allocator;
+  uint32_t frames_in_flight;
+  uint64_t frame_number;
+  // declarations of the current frame
+  VulkanRenderGraphResource resources[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+  uint32_t resource_count;
+  VulkanRenderGraphPass passes[VULKAN_RENDER_GRAPH_MAX_PASSES];
+  uint32_t pass_count;
+  // first declaration error of the frame, reported by compile
+  const char* declare_error;
+  // compiled plan
+  uint64_t compiled_hash;
+  uint32_t order[VULKAN_RENDER_GRAPH_MAX_PASSES];
+  uint32_t order_count;
+  VulkanRenderGraphBarrier* barriers;
+  uint32_t barrier_count;
+  VulkanRenderGraphBatch* batches;
+  uint32_t batch_count;
+  VulkanRenderGraphTransients generations[VULKAN_RENDER_GRAPH_MAX_GENERATIONS];
+  VulkanRenderGraphTransients* transients;
+  uint32_t compile_count;
+  bool is_compiled;
+  bool is_graph_init;
+};
+
+Result(int, ErrorMessage)
+    vulkan_render_graph_init(VulkanRenderGraph* graph,
+                             const VulkanDevice* vk_device,
+                             VulkanAllocator* allocator,
+                             uint32_t frames_in_flight);
+void vulkan_render_graph_reset(VulkanRenderGraph* graph);
+// the GPU must be done with every frame that executed the graph
+void vulkan_render_graph_destroy(VulkanRenderGraph* graph);
+
+VulkanRenderGraphState vulkan_render_graph_usage_state(
+    VulkanRenderGraphUsage usage);
+
+// clears the declarations, frees transients no frame in flight uses anymore
+void vulkan_render_graph_begin(VulkanRenderGraph* graph, uint64_t frame_number);
+VulkanRenderGraphHandle vulkan_render_graph_create_image(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphImageDesc* desc);
+VulkanRenderGraphHandle vulkan_render_graph_create_buffer(
+    VulkanRenderGraph* graph,
+    VkDeviceSize size);
+// view may be VK_NULL_HANDLE when no pass needs one
+VulkanRenderGraphHandle vulkan_render_graph_import_image(
+    VulkanRenderGraph* graph,
+    const VulkanRenderGraphImageDesc* desc,
+    VkImage image,
+    VkImageView view,
+    const VulkanRenderGraphState* initial_state,
+    const VulkanRenderGraphState* final_state);
+VulkanRenderGraphHandle vulkan_render_graph_import_buffer(
+    VulkanRenderGraph* graph,
+    VkBuffer buffer,
+    VkDeviceSize size,
+    const VulkanRenderGraphState* initial_state,
+    const VulkanRenderGraphState* final_state);
+// name is kept for the profiler, it must outlive the trace
+VulkanRenderGraphHandle vulkan_render_graph_add_pass(
+    VulkanRenderGraph* graph,
+    const char* name,
+    VulkanRenderGraphRecord record,
+    void* user_data);
+void vulkan_render_graph_use(VulkanRenderGraph* graph,
+                             VulkanRenderGraphHandle pass,
+                             VulkanRenderGraphHandle resource,
+                             VulkanRenderGraphUsage usage);
+void vulkan_render_graph_set_side_effects(VulkanRenderGraph* graph,
+                                          VulkanRenderGraphHandle pass);
+
+Result(int, ErrorMessage) vulkan_render_graph_compile(VulkanRenderGraph* graph);
+// Records the barriers and passes of the frame, compile must have succeeded
+// since begin. profiler may be nullptr, otherwise every pass gets a GPU scope.
+void vulkan_render_graph_execute(VulkanRenderGraph* graph,
+                                 VkCommandBuffer command_buffer,
+                                 VulkanProfiler* profiler);
+
+VkImage vulkan_render_graph_image(const VulkanRenderGraph* graph,
+                                  VulkanRenderGraphHandle resource);
+VkImageView vulkan_render_graph_image_view(const VulkanRenderGraph* graph,
+                                           VulkanRenderGraphHandle resource);
+VkBuffer vulkan_render_graph_buffer(const VulkanRenderGraph* graph,
+                                    VulkanRenderGraphHandle resource);
+
+#endif
@@ -0,0 +1,358 @@
+#include "./shader_cache.h"
+
+#include <SDL2/SDL.h>
+#include <string.h>
+
+#include "../utils/hash.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+void vulkan_shader_cache_init(VulkanShaderCache* cache,
+                              const VulkanDevice* vk_device,
+                              VulkanLayoutCache* layout_cache,
+                              bool watch) {
+  cache->device = vk_device->device;
+  cache->fn = &vk_device->fn;
+  cache->layout_cache = layout_cache;
+  cache->is_watching = watch;
+  cache->last_poll_ticks = SDL_GetTicks64();
+  cache->is_cache_init = true;
+}
+
+void vulkan_shader_cache_reset(VulkanShaderCache* cache) {
+  cache->device = VK_NULL_HANDLE;
+  cache->fn = nullptr;
+  cache->layout_cache = nullptr;
+  cache->modules = nullptr;
+  cache->module_count = 0;
+  cache->module_capacity = 0;
+  cache->files = nullptr;
+  cache->file_count = 0;
+  cache->file_capacity = 0;
+  cache->last_poll_ticks = 0;
+  cache->reload_count = 0;
+  cache->is_watching = false;
+  cache->is_cache_init = false;
+}
+
+void vulkan_shader_cache_destroy(VulkanShaderCache* cache) {
+  if (!cache->is_cache_init) {
+    return;
+  }
+  for (uint32_t i = 0; i < cache->module_count; i++) {
+    cache->fn->vkDestroyShaderModule(cache->device, cache->modules[i].module,
+                                     nullptr);
+    mem_free(cache->modules[i].code);
+  }
+  for (uint32_t i = 0; i < cache->file_count; i++) {
+    mem_free(cache->files[i].path);
+  }
+  if (cache->modules) {
+    mem_free(cache->modules);
+  }
+  if (cache->files) {
+    mem_free(cache->files);
+  }
+  vulkan_shader_cache_reset(cache);
+}
+
+// finds or creates the module for the mapped SPIR-V, the mapping can be
+// closed afterwards
+static Result(int, ErrorMessage)
+    vulkan_shader_cache_get_module(VulkanShaderCache* cache,
+                                   const FileMap* map,
+                                   uint32_t* module_index) {
+  if (map->size == 0 || map->size % sizeof(uint32_t) != 0) {
+    return Err(int, ErrorMessage)("SPIR-V file size is not a word multiple");
+  }
+
+  uint64_t hash = hash_fnv1a64(map->data, map->size, HASH_FNV1A64_SEED);
+  // shaders are loaded a handful of times, a linear search is plenty
+  for (uint32_t i = 0; i < cache->module_count; i++) {
+    const VulkanShaderModuleEntry* entry = &cache->modules[i];
+    if (entry->hash == hash && entry->code_size == map->size &&
+        memcmp(entry->code, map->data, map->size) == 0) {
+      *module_index = i;
+      return Ok(int, ErrorMessage)(0);
+    }
+  }
+
+  if (cache->module_count == cache->module_capacity) {
+    uint32_t capacity =
+        cache->module_capacity ? cache->module_capacity * 2 : 16;
+    VulkanShaderModuleEntry* modules =
+        mem_realloc(cache->modules, sizeof(VulkanShaderModuleEntry) * capacity);
+    CHECK_ALLOC(modules, Err(int, ErrorMessage)(
+                             "Unable to allocate memory for shaders"));
+    cache->modules = modules;
+    cache->module_capacity = capacity;
+  }
+
+  VulkanShaderModuleEntry* entry = &cache->modules[cache->module_count];
+  // mappings are page aligned, the words can be read in place
+  auto result =
+      vulkan_shader_reflect((const uint32_t*)map->data,
+                            map->size / sizeof(uint32_t), &entry->reflection);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  // the mapping is closed once the module exists, later loads compare
+  // against the copy
+  entry->code = mem_alloc(map->size);
+  CHECK_ALLOC(entry->code,
+              Err(int, ErrorMessage)("Unable to allocate memory for shaders"));
+  mem_copy(entry->code, map->data, map->size);
+  entry->code_size = map->size;
+
+  VkShaderModuleCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .codeSize = entry->code_size,
+      .pCode = entry->code,
+  };
+  VkResult vk_result = cache->fn->vkCreateShaderModule(
+      cache->device, &create_info, nullptr, &entry->module);
+  if (vk_result != VK_SUCCESS) {
+    mem_free(entry->code);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  entry->hash = hash;
+  *module_index = cache->module_count++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_shader_cache_read(VulkanShaderCache* cache,
+                             const char* path,
+                             uint32_t* module_index) {
+  FileMap map = {0};
+  auto result = file_map_open(&map, path);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_shader_cache_get_module(cache, &map, module_index);
+  file_map_close(&map);
+
+  return result;
+}
+
+Result(int, ErrorMessage) vulkan_shader_cache_load(VulkanShaderCache* cache,
+                                                   const char* path,
+                                                   VulkanShaderHandle* shader) {
+  size_t path_length = strlen(path);
+  uint64_t path_hash = hash_fnv1a64(path, path_length, HASH_FNV1A64_SEED);
+  for (uint32_t i = 0; i < cache->file_count; i++) {
+    if (cache->files[i].path_hash == path_hash &&
+        strcmp(cache->files[i].path, path) == 0) {
+      *shader = i;
+      return Ok(int, ErrorMessage)(0);
+    }
+  }
+
+  if (cache->file_count == cache->file_capacity) {
+    uint32_t capacity = cache->file_capacity ? cache->file_capacity * 2 : 16;
+    VulkanShaderFile* files =
+        mem_realloc(cache->files, sizeof(VulkanShaderFile) * capacity);
+    CHECK_ALLOC(files, Err(int, ErrorMessage)(
+                           "Unable to allocate memory for shaders"));
+    cache->files = files;
+    cache->file_capacity = capacity;
+  }
+
+  VulkanShaderFile* file = &cache->files[cache->file_count];
+  *file = (VulkanShaderFile){.path_hash = path_hash};
+  // stat before reading, a write racing the load is picked up by the next
+  // poll instead of being missed
+  if (!file_stat(path, &file->stat)) {
+    return Err(int, ErrorMessage)("Unable to find shader file");
+  }
+  auto result = vulkan_shader_cache_read(cache, path, &file->module);
+  if (!result.is_ok) {
+    return result;
+  }
+  file->path = mem_alloc(path_length + 1);
+  CHECK_ALLOC(file->path, Err(int, ErrorMessage)(
+                              "Unable to allocate memory for shaders"));
+  mem_copy(file->path, path, path_length + 1);
+  *shader = cache->file_count++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+VkShaderModule vulkan_shader_cache_module(const VulkanShaderCache* cache,
+                                          VulkanShaderHandle shader) {
+  return cache->modules[cache->files[shader].module].module;
+}
+
+const VulkanShaderReflection* vulkan_shader_cache_reflection(
+    const VulkanShaderCache* cache,
+    VulkanShaderHandle shader) {
+  return &cache->modules[cache->files[shader].module].reflection;
+}
+
+uint32_t vulkan_shader_cache_generation(const VulkanShaderCache* cache,
+                                        VulkanShaderHandle shader) {
+  return cache->files[shader].generation;
+}
+
+// bindings of one descriptor set merged across stages
+typedef struct VulkanShaderSetBindings {
+  VkDescriptorSetLayoutBinding bindings[VULKAN_SHADER_MAX_BINDINGS];
+  uint32_t count;
+} VulkanShaderSetBindings;
+
+static Result(int, ErrorMessage)
+    vulkan_shader_merge_binding(VulkanShaderSetBindings* set,
+                                const VulkanShaderBinding* binding,
+                                VkShaderStageFlagBits stage) {
+  if (binding->count == 0) {
+    return Err(int, ErrorMessage)(
+        "Runtime descriptor arrays need an explicit pipeline layout");
+  }
+  for (uint32_t i = 0; i < set->count; i++) {
+    VkDescriptorSetLayoutBinding* merged = &set->bindings[i];
+    if (merged->binding != binding->binding) {
+      continue;
+    }
+    if (merged->descriptorType != binding->type ||
+        merged->descriptorCount != binding->count) {
+      return Err(int, ErrorMessage)(
+          "Shader stages disagree on a descriptor binding");
+    }
+    merged->stageFlags |= stage;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  if (set->count == VULKAN_SHADER_MAX_BINDINGS) {
+    return Err(int, ErrorMessage)("Shader uses too many descriptor bindings");
+  }
+  set->bindings[set->count++] = (VkDescriptorSetLayoutBinding){
+      .binding = binding->binding,
+      .descriptorType = binding->type,
+      .descriptorCount = binding->count,
+      .stageFlags = stage,
+      .pImmutableSamplers = nullptr,
+  };
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_shader_cache_pipeline_layout(VulkanShaderCache* cache,
+                                        const VulkanShaderHandle* shaders,
+                                        uint32_t shader_count,
+                                        VkPipelineLayout* layout) {
+  if (shader_count > VULKAN_SHADER_MAX_STAGES) {
+    return Err(int, ErrorMessage)("Too many shader stages");
+  }
+
+  VulkanShaderSetBindings sets[VULKAN_SHADER_MAX_SETS] = {0};
+  uint32_t set_count = 0;
+  VkPushConstantRange ranges[VULKAN_SHADER_MAX_STAGES];
+  uint32_t range_count = 0;
+  VkShaderStageFlags stages = 0;
+  for (uint32_t i = 0; i < shader_count; i++) {
+    const VulkanShaderReflection* reflection =
+        vulkan_shader_cache_reflection(cache, shaders[i]);
+    if (stages & reflection->stage) {
+      return Err(int, ErrorMessage)("Shader stage is used twice");
+    }
+    stages |= reflection->stage;
+
+    for (uint32_t j = 0; j < reflection->binding_count; j++) {
+      const VulkanShaderBinding* binding = &reflection->bindings[j];
+      auto result = vulkan_shader_merge_binding(&sets[binding->set], binding,
+                                                reflection->stage);
+      if (!result.is_ok) {
+        return result;
+      }
+      if (binding->set + 1 > set_count) {
+        set_count = binding->set + 1;
+      }
+    }
+    if (reflection->push_constant_size > 0) {
+      ranges[range_count++] = (VkPushConstantRange){
+          .stageFlags = reflection->stage,
+          .offset = reflection->push_constant_offset,
+          .size = reflection->push_constant_size,
+      };
+    }
+  }
+
+  // sets no stage uses below the highest one get empty layouts
+  VkDescriptorSetLayout set_layouts[VULKAN_SHADER_MAX_SETS];
+  for (uint32_t i = 0; i < set_count; i++) {
+    VkDescriptorSetLayoutCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = sets[i].count,
+        .pBindings = sets[i].bindings,
+    };
+    auto result = vulkan_layout_cache_get_set_layout(
+        cache->layout_cache, &create_info, &set_layouts[i]);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  VkPipelineLayoutCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .setLayoutCount = set_count,
+      .pSetLayouts = set_layouts,
+      .pushConstantRangeCount = range_count,
+      .pPushConstantRanges = ranges,
+  };
+  return vulkan_layout_cache_get_pipeline_layout(cache->layout_cache,
+                                                 &create_info, layout);
+}
+
+Result(int, ErrorMessage) vulkan_shader_cache_poll(VulkanShaderCache* cache) {
+  uint64_t now = SDL_GetTicks64();
+  if (!cache->is_watching ||
+      now - cache->last_poll_ticks < VULKAN_SHADER_CACHE_POLL_INTERVAL_MS) {
+    return Ok(int, ErrorMessage)(0);
+  }
+  cache->last_poll_ticks = now;
+
+  auto poll_result = Ok(int, ErrorMessage)(0);
+  for (uint32_t i = 0; i < cache->file_count; i++) {
+    VulkanShaderFile* file = &cache->files[i];
+    FileStat stat = {0};
+    // editors that save by renaming leave the file missing for a moment,
+    // the next poll sees the new one
+    if (!file_stat(file->path, &stat) ||
+        (stat.modified_time == file->stat.modified_time &&
+         stat.size == file->stat.size)) {
+      continue;
+    }
+
+    uint32_t module = 0;
+    auto result = vulkan_shader_cache_read(cache, file->path, &module);
+    if (!result.is_ok) {
+      // retried once the file changes again
+      file->stat = stat;
+      if (poll_result.is_ok) {
+        poll_result = result;
+      }
+      continue;
+    }
+    file->stat = stat;
+    // touched without a change in contents
+    if (module == file->module) {
+      continue;
+    }
+    file->module = module;
+    file->generation++;
+    cache->reload_count++;
+    log_info("Reloaded shader %s", file->path);
+  }
+
+  return poll_result;
+}
@@ -0,0 +1,97 @@
+#ifndef VULKAN_BACKEND_SHADER_CACHE_H
+#define VULKAN_BACKEND_SHADER_CACHE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "../utils/file_map.h"
+#include "./device.h"
+#include "./layout_cache.h"
+#include "./shader_reflect.h"
+
+#define VULKAN_SHADER_CACHE_POLL_INTERVAL_MS 250u
+// vertex to fragment, or task, mesh and fragment
+#define VULKAN_SHADER_MAX_STAGES 5
+
+typedef uint32_t VulkanShaderHandle;
+
+// One VkShaderModule per distinct SPIR-V contents
+typedef struct VulkanShaderModuleEntry {
+  uint64_t hash;
+  // copy of the SPIR-V, a hash match only counts when the words match too
+  uint32_t* code;
+  size_t code_size;
+  VkShaderModule module;
+  VulkanShaderReflection reflection;
+} VulkanShaderModuleEntry;
+
+typedef struct VulkanShaderFile {
+  char* path;
+  uint64_t path_hash;
+  uint32_t module;
+  FileStat stat;
+  // bumped every time a reload changes the module, pipelines built from an
+  // older generation should be rebuilt
+  uint32_t generation;
+} VulkanShaderFile;
+
+// Loads SPIR-V files on first use by mapping them, and deduplicates the
+// modules by their contents, so files with equal code share one
+// VkShaderModule. Every module is reflected once, pipeline layouts are built
+// from the reflection through the layout cache.
+//
+// With watching enabled poll stats the loaded files and reloads the ones
+// that changed. A reload that fails keeps the previous module. Modules are
+// never destroyed before the cache is, pipelines compiling in the
+// background may still reference a superseded one. Not thread safe.
+typedef struct VulkanShaderCache {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanLayoutCache* layout_cache;
+  VulkanShaderModuleEntry* modules;
+  uint32_t module_count;
+  uint32_t module_capacity;
+  VulkanShaderFile* files;
+  uint32_t file_count;
+  uint32_t file_capacity;
+  uint64_t last_poll_ticks;
+  uint32_t reload_count;
+  bool is_watching;
+  bool is_cache_init;
+} VulkanShaderCache;
+
+void vulkan_shader_cache_init(VulkanShaderCache* cache,
+                              const VulkanDevice* vk_device,
+                              VulkanLayoutCache* layout_cache,
+                              bool watch);
+void vulkan_shader_cache_reset(VulkanShaderCache* cache);
+// no pipeline may still be compiling from the modules
+void vulkan_shader_cache_destroy(VulkanShaderCache* cache);
+
+// loads the file unless it already is, the handle stays valid until destroy
+Result(int, ErrorMessage) vulkan_shader_cache_load(VulkanShaderCache* cache,
+                                                   const char* path,
+                                                   VulkanShaderHandle* shader);
+VkShaderModule vulkan_shader_cache_module(const VulkanShaderCache* cache,
+                                          VulkanShaderHandle shader);
+const VulkanShaderReflection* vulkan_shader_cache_reflection(
+    const VulkanShaderCache* cache,
+    VulkanShaderHandle shader);
+uint32_t vulkan_shader_cache_generation(const VulkanShaderCache* cache,
+                                        VulkanShaderHandle shader);
+
+// Pipeline layout of the stages together. Bindings seen by several stages
+// are merged, every stage gets its own push constant range. Runtime sized
+// descriptor arrays need an explicit layout and are rejected.
+Result(int, ErrorMessage)
+    vulkan_shader_cache_pipeline_layout(VulkanShaderCache* cache,
+                                        const VulkanShaderHandle* shaders,
+                                        uint32_t shader_count,
+                                        VkPipelineLayout* layout);
+
+// Reloads changed files when watching and the poll interval elapsed, returns
+// the first error after trying every file
+Result(int, ErrorMessage) vulkan_shader_cache_poll(VulkanShaderCache* cache);
+
+#endif
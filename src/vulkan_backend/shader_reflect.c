@@ -0,0 +1,487 @@
+#include "./shader_reflect.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/arena.h"
+
+#define SPIRV_MAGIC 0x07230203u
+#define SPIRV_HEADER_WORDS 5
+// ids beyond this are a corrupt header rather than a real module
+#define SPIRV_MAX_ID_BOUND (1u << 22)
+// nesting of arrays and structs followed when sizing push constants
+#define SPIRV_MAX_TYPE_DEPTH 16
+
+// the subset of the SPIR-V grammar reflection needs
+typedef enum SpirvOp {
+  SPIRV_OP_ENTRY_POINT = 15,
+  SPIRV_OP_EXECUTION_MODE = 16,
+  SPIRV_OP_TYPE_BOOL = 20,
+  SPIRV_OP_TYPE_INT = 21,
+  SPIRV_OP_TYPE_FLOAT = 22,
+  SPIRV_OP_TYPE_VECTOR = 23,
+  SPIRV_OP_TYPE_MATRIX = 24,
+  SPIRV_OP_TYPE_IMAGE = 25,
+  SPIRV_OP_TYPE_SAMPLER = 26,
+  SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+  SPIRV_OP_TYPE_ARRAY = 28,
+  SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+  SPIRV_OP_TYPE_STRUCT = 30,
+  SPIRV_OP_TYPE_POINTER = 32,
+  SPIRV_OP_CONSTANT = 43,
+  SPIRV_OP_VARIABLE = 59,
+  SPIRV_OP_DECORATE = 71,
+  SPIRV_OP_MEMBER_DECORATE = 72,
+  SPIRV_OP_TYPE_ACCELERATION_STRUCTURE = 5341,
+} SpirvOp;
+
+typedef enum SpirvDecoration {
+  SPIRV_DECORATION_BLOCK = 2,
+  SPIRV_DECORATION_BUFFER_BLOCK = 3,
+  SPIRV_DECORATION_ARRAY_STRIDE = 6,
+  SPIRV_DECORATION_MATRIX_STRIDE = 7,
+  SPIRV_DECORATION_BINDING = 33,
+  SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+  SPIRV_DECORATION_OFFSET = 35,
+} SpirvDecoration;
+
+typedef enum SpirvStorageClass {
+  SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+  SPIRV_STORAGE_CLASS_UNIFORM = 2,
+  SPIRV_STORAGE_CLASS_PUSH_CONSTANT = 9,
+  SPIRV_STORAGE_CLASS_STORAGE_BUFFER = 12,
+} SpirvStorageClass;
+
+#define SPIRV_EXECUTION_MODE_LOCAL_SIZE 17
+#define SPIRV_DIM_BUFFER 5
+#define SPIRV_DIM_SUBPASS_DATA 6
+
+typedef struct SpirvId {
+  uint32_t opcode;
+  // first word of the instruction that defines the id
+  uint32_t word;
+  uint32_t set;
+  uint32_t binding;
+  uint32_t array_stride;
+  bool has_binding;
+  bool is_block;
+  bool is_buffer_block;
+} SpirvId;
+
+typedef struct SpirvModule {
+  const uint32_t* code;
+  size_t word_count;
+  SpirvId* ids;
+  uint32_t bound;
+} SpirvModule;
+
+static const SpirvId* spirv_id(const SpirvModule* module, uint32_t id) {
+  return id < module->bound && module->ids[id].opcode != 0 ? &module->ids[id]
+                                                            : nullptr;
+}
+
+// operand of the instruction defining id, 0 when it has no such operand
+static uint32_t spirv_operand(const SpirvModule* module,
+                              const SpirvId* id,
+                              uint32_t operand) {
+  uint32_t word_count = module->code[id->word] >> 16;
+  return operand < word_count ? module->code[id->word + operand] : 0;
+}
+
+static VkShaderStageFlagBits spirv_stage(uint32_t execution_model) {
+  switch (execution_model) {
+    case 0:
+      return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+      return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+      return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+      return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+      return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+      return VK_SHADER_STAGE_COMPUTE_BIT;
+    // the NV and EXT execution models map to the same stages
+    case 5267:
+    case 5364:
+      return VK_SHADER_STAGE_TASK_BIT_EXT;
+    case 5268:
+    case 5365:
+      return VK_SHADER_STAGE_MESH_BIT_EXT;
+    default:
+      return 0;
+  }
+}
+
+// value of a member decoration of a struct, scans the whole module since
+// only push constant blocks ask
+static bool spirv_member_decoration(const SpirvModule* module,
+                                    uint32_t struct_id,
+                                    uint32_t member,
+                                    uint32_t decoration,
+                                    uint32_t* value) {
+  for (size_t word = SPIRV_HEADER_WORDS; word < module->word_count;) {
+    uint32_t word_count = module->code[word] >> 16;
+    uint32_t opcode = module->code[word] & 0xffff;
+    if (opcode == SPIRV_OP_MEMBER_DECORATE && word_count >= 5 &&
+        module->code[word + 1] == struct_id &&
+        module->code[word + 2] == member &&
+        module->code[word + 3] == decoration) {
+      *value = module->code[word + 4];
+      return true;
+    }
+    word += word_count;
+  }
+  return false;
+}
+
+static uint32_t spirv_array_length(const SpirvModule* module,
+                                   const SpirvId* array) {
+  const SpirvId* length = spirv_id(module, spirv_operand(module, array, 3));
+  if (!length || length->opcode != SPIRV_OP_CONSTANT) {
+    return 0;
+  }
+  return spirv_operand(module, length, 3);
+}
+
+// bytes the type takes in a block, matrix_stride comes from the member
+// decoration of the enclosing struct
+static uint32_t spirv_type_size(const SpirvModule* module,
+                                uint32_t type_id,
+                                uint32_t matrix_stride,
+                                uint32_t depth) {
+  const SpirvId* type = spirv_id(module, type_id);
+  if (!type || depth == SPIRV_MAX_TYPE_DEPTH) {
+    return 0;
+  }
+
+  switch (type->opcode) {
+    case SPIRV_OP_TYPE_BOOL:
+      return 4;
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+      return spirv_operand(module, type, 2) / 8;
+    case SPIRV_OP_TYPE_VECTOR:
+      return spirv_type_size(module, spirv_operand(module, type, 2), 0,
+                             depth + 1) *
+             spirv_operand(module, type, 3);
+    case SPIRV_OP_TYPE_MATRIX: {
+      uint32_t column_type = spirv_operand(module, type, 2);
+      uint32_t column_size =
+          matrix_stride ? matrix_stride
+                        : spirv_type_size(module, column_type, 0, depth + 1);
+      return column_size * spirv_operand(module, type, 3);
+    }
+    case SPIRV_OP_TYPE_ARRAY: {
+      uint32_t stride = type->array_stride
+                            ? type->array_stride
+                            : spirv_type_size(module,
+                                              spirv_operand(module, type, 2),
+                                              matrix_stride, depth + 1);
+      return stride * spirv_array_length(module, type);
+    }
+    case SPIRV_OP_TYPE_STRUCT: {
+      uint32_t size = 0;
+      uint32_t member_count = (module->code[type->word] >> 16) - 2;
+      for (uint32_t i = 0; i < member_count; i++) {
+        uint32_t offset = 0;
+        uint32_t member_matrix_stride = 0;
+        spirv_member_decoration(module, type_id, i, SPIRV_DECORATION_OFFSET,
+                                &offset);
+        spirv_member_decoration(module, type_id, i,
+                                SPIRV_DECORATION_MATRIX_STRIDE,
+                                &member_matrix_stride);
+        uint32_t end = offset + spirv_type_size(
+                                    module, spirv_operand(module, type, 2 + i),
+                                    member_matrix_stride, depth + 1);
+        if (end > size) {
+          size = end;
+        }
+      }
+      return size;
+    }
+    case SPIRV_OP_TYPE_POINTER:
+      // physical storage buffer addresses
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// lowest member offset of a push constant block
+static uint32_t spirv_block_offset(const SpirvModule* module,
+                                   uint32_t struct_id) {
+  const SpirvId* type = spirv_id(module, struct_id);
+  if (!type || type->opcode != SPIRV_OP_TYPE_STRUCT) {
+    return 0;
+  }
+  uint32_t lowest = UINT32_MAX;
+  uint32_t member_count = (module->code[type->word] >> 16) - 2;
+  for (uint32_t i = 0; i < member_count; i++) {
+    uint32_t offset = 0;
+    if (spirv_member_decoration(module, struct_id, i, SPIRV_DECORATION_OFFSET,
+                                &offset) &&
+        offset < lowest) {
+      lowest = offset;
+    }
+  }
+  return lowest == UINT32_MAX ? 0 : lowest;
+}
+
+static Result(int, ErrorMessage)
+    spirv_descriptor_type(const SpirvModule* module,
+                          uint32_t storage_class,
+                          const SpirvId* type,
+                          VkDescriptorType* descriptor_type) {
+  if (storage_class == SPIRV_STORAGE_CLASS_STORAGE_BUFFER) {
+    *descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    return Ok(int, ErrorMessage)(0);
+  }
+  if (storage_class == SPIRV_STORAGE_CLASS_UNIFORM) {
+    // storage buffers before SPIR-V 1.3 are Uniform BufferBlocks
+    *descriptor_type = type->is_buffer_block
+                           ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                           : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  switch (type->opcode) {
+    case SPIRV_OP_TYPE_SAMPLER:
+      *descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+      break;
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+      *descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      break;
+    case SPIRV_OP_TYPE_IMAGE: {
+      uint32_t dim = spirv_operand(module, type, 3);
+      // 1 is known to be sampled, 2 is a storage image
+      bool is_sampled = spirv_operand(module, type, 7) == 1;
+      if (dim == SPIRV_DIM_BUFFER) {
+        *descriptor_type = is_sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+                                      : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+      } else if (dim == SPIRV_DIM_SUBPASS_DATA) {
+        *descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      } else {
+        *descriptor_type = is_sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+                                      : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      }
+      break;
+    }
+    case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+      *descriptor_type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+      break;
+    default:
+      return Err(int, ErrorMessage)("Unsupported SPIR-V descriptor type");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    spirv_reflect_variable(const SpirvModule* module,
+                           const SpirvId* variable,
+                           VulkanShaderReflection* reflection) {
+  uint32_t storage_class = spirv_operand(module, variable, 3);
+  const SpirvId* pointer =
+      spirv_id(module, spirv_operand(module, variable, 1));
+  if (!pointer || pointer->opcode != SPIRV_OP_TYPE_POINTER) {
+    return Err(int, ErrorMessage)("SPIR-V variable is not a pointer");
+  }
+  uint32_t type_id = spirv_operand(module, pointer, 3);
+
+  if (storage_class == SPIRV_STORAGE_CLASS_PUSH_CONSTANT) {
+    uint32_t offset = spirv_block_offset(module, type_id);
+    uint32_t end = spirv_type_size(module, type_id, 0, 0);
+    reflection->push_constant_offset = offset;
+    reflection->push_constant_size = end > offset ? end - offset : 0;
+    return Ok(int, ErrorMessage)(0);
+  }
+  if ((storage_class != SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT &&
+       storage_class != SPIRV_STORAGE_CLASS_UNIFORM &&
+       storage_class != SPIRV_STORAGE_CLASS_STORAGE_BUFFER) ||
+      !variable->has_binding) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  // arrays of descriptors, nested arrays multiply
+  uint32_t count = 1;
+  const SpirvId* type = spirv_id(module, type_id);
+  for (uint32_t depth = 0;
+       type && depth < SPIRV_MAX_TYPE_DEPTH &&
+       (type->opcode == SPIRV_OP_TYPE_ARRAY ||
+        type->opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY);
+       depth++) {
+    count = type->opcode == SPIRV_OP_TYPE_ARRAY
+                ? count * spirv_array_length(module, type)
+                : 0;
+    type = spirv_id(module, spirv_operand(module, type, 2));
+  }
+  if (!type) {
+    return Err(int, ErrorMessage)("SPIR-V variable has an undefined type");
+  }
+
+  if (variable->set >= VULKAN_SHADER_MAX_SETS) {
+    return Err(int, ErrorMessage)("Shader uses too many descriptor sets");
+  }
+  if (reflection->binding_count == VULKAN_SHADER_MAX_BINDINGS) {
+    return Err(int, ErrorMessage)("Shader uses too many descriptor bindings");
+  }
+  VulkanShaderBinding* binding =
+      &reflection->bindings[reflection->binding_count];
+  auto result =
+      spirv_descriptor_type(module, storage_class, type, &binding->type);
+  if (!result.is_ok) {
+    return result;
+  }
+  binding->set = variable->set;
+  binding->binding = variable->binding;
+  binding->count = count;
+  reflection->binding_count++;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// records the ids, decorations and entry point, the module is validated as
+// it is walked
+static Result(int, ErrorMessage)
+    spirv_scan(SpirvModule* module, VulkanShaderReflection* reflection) {
+  bool has_entry_point = false;
+  uint32_t entry_point_id = 0;
+  for (size_t word = SPIRV_HEADER_WORDS; word < module->word_count;) {
+    const uint32_t* op = &module->code[word];
+    uint32_t word_count = op[0] >> 16;
+    uint32_t opcode = op[0] & 0xffff;
+    if (word_count == 0 || word_count > module->word_count - word) {
+      return Err(int, ErrorMessage)("Truncated SPIR-V instruction");
+    }
+
+    // where the instruction keeps its result id
+    uint32_t result_operand = 0;
+    switch (opcode) {
+      case SPIRV_OP_ENTRY_POINT:
+        if (!has_entry_point && word_count >= 4) {
+          has_entry_point = true;
+          reflection->stage = spirv_stage(op[1]);
+          entry_point_id = op[2];
+          // the name is a nul terminated string packed into the words
+          size_t max_length = SDL_min((size_t)(word_count - 3) * 4,
+                                      sizeof(reflection->entry_point) - 1);
+          const char* name = (const char*)&op[3];
+          size_t length = 0;
+          while (length < max_length && name[length] != '\0') {
+            length++;
+          }
+          SDL_memcpy(reflection->entry_point, name, length);
+          reflection->entry_point[length] = '\0';
+        }
+        break;
+      case SPIRV_OP_EXECUTION_MODE:
+        if (word_count >= 6 && op[1] == entry_point_id &&
+            op[2] == SPIRV_EXECUTION_MODE_LOCAL_SIZE) {
+          reflection->local_size[0] = op[3];
+          reflection->local_size[1] = op[4];
+          reflection->local_size[2] = op[5];
+        }
+        break;
+      case SPIRV_OP_DECORATE:
+        if (word_count >= 3 && op[1] < module->bound) {
+          SpirvId* target = &module->ids[op[1]];
+          uint32_t value = word_count >= 4 ? op[3] : 0;
+          switch (op[2]) {
+            case SPIRV_DECORATION_BLOCK:
+              target->is_block = true;
+              break;
+            case SPIRV_DECORATION_BUFFER_BLOCK:
+              target->is_buffer_block = true;
+              break;
+            case SPIRV_DECORATION_ARRAY_STRIDE:
+              target->array_stride = value;
+              break;
+            case SPIRV_DECORATION_BINDING:
+              target->binding = value;
+              target->has_binding = true;
+              break;
+            case SPIRV_DECORATION_DESCRIPTOR_SET:
+              target->set = value;
+              break;
+            default:
+              break;
+          }
+        }
+        break;
+      case SPIRV_OP_TYPE_BOOL:
+      case SPIRV_OP_TYPE_INT:
+      case SPIRV_OP_TYPE_FLOAT:
+      case SPIRV_OP_TYPE_VECTOR:
+      case SPIRV_OP_TYPE_MATRIX:
+      case SPIRV_OP_TYPE_IMAGE:
+      case SPIRV_OP_TYPE_SAMPLER:
+      case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+      case SPIRV_OP_TYPE_ARRAY:
+      case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+      case SPIRV_OP_TYPE_STRUCT:
+      case SPIRV_OP_TYPE_POINTER:
+      case SPIRV_OP_TYPE_ACCELERATION_STRUCTURE:
+        result_operand = 1;
+        break;
+      case SPIRV_OP_CONSTANT:
+      case SPIRV_OP_VARIABLE:
+        result_operand = 2;
+        break;
+      default:
+        break;
+    }
+
+    if (result_operand != 0) {
+      if (word_count <= result_operand || op[result_operand] >= module->bound) {
+        return Err(int, ErrorMessage)("Invalid SPIR-V result id");
+      }
+      SpirvId* id = &module->ids[op[result_operand]];
+      id->opcode = opcode;
+      id->word = (uint32_t)word;
+    }
+    word += word_count;
+  }
+
+  if (!has_entry_point || reflection->stage == 0) {
+    return Err(int, ErrorMessage)("SPIR-V module has no usable entry point");
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_shader_reflect(const uint32_t* code,
+                          size_t word_count,
+                          VulkanShaderReflection* reflection) {
+  *reflection = (VulkanShaderReflection){0};
+  if (word_count < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+    return Err(int, ErrorMessage)("Not a SPIR-V module");
+  }
+  SpirvModule module = {
+      .code = code,
+      .word_count = word_count,
+      .bound = code[3],
+  };
+  if (module.bound == 0 || module.bound > SPIRV_MAX_ID_BOUND) {
+    return Err(int, ErrorMessage)("Invalid SPIR-V id bound");
+  }
+
+  ArenaScratch scratch = arena_scratch_begin();
+  module.ids =
+      scratch.arena
+          ? arena_alloc_zeroed(scratch.arena, sizeof(SpirvId) * module.bound)
+          : nullptr;
+  if (!module.ids) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate memory for reflection");
+  }
+
+  auto result = spirv_scan(&module, reflection);
+  for (uint32_t i = 0; i < module.bound && result.is_ok; i++) {
+    if (module.ids[i].opcode == SPIRV_OP_VARIABLE) {
+      result = spirv_reflect_variable(&module, &module.ids[i], reflection);
+    }
+  }
+  arena_scratch_end(scratch);
+
+  return result;
+}
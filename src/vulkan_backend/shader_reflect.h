@@ -0,0 +1,44 @@
+#ifndef VULKAN_BACKEND_SHADER_REFLECT_H
+#define VULKAN_BACKEND_SHADER_REFLECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+
+#define VULKAN_SHADER_MAX_SETS 4
+#define VULKAN_SHADER_MAX_BINDINGS 32
+#define VULKAN_SHADER_MAX_ENTRY_POINT_NAME 64
+
+typedef struct VulkanShaderBinding {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType type;
+  // 0 for a runtime sized array
+  uint32_t count;
+} VulkanShaderBinding;
+
+// What a pipeline layout needs to know about one shader stage
+typedef struct VulkanShaderReflection {
+  VkShaderStageFlagBits stage;
+  char entry_point[VULKAN_SHADER_MAX_ENTRY_POINT_NAME];
+  VulkanShaderBinding bindings[VULKAN_SHADER_MAX_BINDINGS];
+  uint32_t binding_count;
+  // push_constant_size 0 when the stage has no push constants
+  uint32_t push_constant_offset;
+  uint32_t push_constant_size;
+  // workgroup size of compute, task and mesh shaders
+  uint32_t local_size[3];
+} VulkanShaderReflection;
+
+// Reads the descriptor bindings and push constants straight out of a SPIR-V
+// module. Every resource the module declares is reported, not only the ones
+// its entry point uses. Modules with several entry points are described by
+// the first one.
+Result(int, ErrorMessage)
+    vulkan_shader_reflect(const uint32_t* code,
+                          size_t word_count,
+                          VulkanShaderReflection* reflection);
+
+#endif
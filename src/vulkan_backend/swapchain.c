@@ -0,0 +1,536 @@
+#include "./swapchain.h"
+
+#include <SDL2/SDL.h>
+
+#include "../utils/arena.h"
+#include "../utils/logger.h"
+#include "./debug.h"
+#include "./functions.h"
+
+// a chain used by frame N is safe to destroy once the fence of frame N
+// signaled, one more frame covers the present that waits on its semaphore
+#define VULKAN_SWAPCHAIN_RETIRE_MARGIN 1
+
+const char* vulkan_present_mode_name(VkPresentModeKHR present_mode) {
+  switch (present_mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+      return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return "fifo relaxed";
+    default:
+      return "other";
+  }
+}
+
+static VkPresentModeKHR vulkan_swapchain_pick_present_mode(
+    VulkanPresentPolicy policy,
+    const VkPresentModeKHR* modes,
+    uint32_t mode_count) {
+  VkPresentModeKHR preferred[2];
+  uint32_t preferred_count = 0;
+  switch (policy) {
+    case VULKAN_PRESENT_POLICY_IMMEDIATE:
+      preferred[preferred_count++] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+      preferred[preferred_count++] = VK_PRESENT_MODE_MAILBOX_KHR;
+      break;
+    case VULKAN_PRESENT_POLICY_LOW_LATENCY:
+      preferred[preferred_count++] = VK_PRESENT_MODE_MAILBOX_KHR;
+      break;
+    case VULKAN_PRESENT_POLICY_VSYNC:
+      break;
+  }
+
+  for (uint32_t i = 0; i < preferred_count; i++) {
+    for (uint32_t j = 0; j < mode_count; j++) {
+      if (modes[j] == preferred[i]) {
+        return preferred[i];
+      }
+    }
+  }
+  // the only mode every implementation has to support
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static VkSurfaceFormatKHR vulkan_swapchain_pick_format(
+    const VkSurfaceFormatKHR* formats,
+    uint32_t format_count) {
+  VkSurfaceFormatKHR fallback = {
+      .format = VK_FORMAT_B8G8R8A8_SRGB,
+      .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+  };
+  if (format_count == 0 ||
+      (format_count == 1 && formats[0].format == VK_FORMAT_UNDEFINED)) {
+    return fallback;
+  }
+  for (uint32_t i = 0; i < format_count; i++) {
+    if ((formats[i].format == VK_FORMAT_B8G8R8A8_SRGB ||
+         formats[i].format == VK_FORMAT_R8G8B8A8_SRGB) &&
+        formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+      return formats[i];
+    }
+  }
+  return formats[0];
+}
+
+static Result(int, ErrorMessage)
+    vulkan_swapchain_query_surface(VulkanSwapchain* swapchain) {
+  ArenaScratch scratch = arena_scratch_begin();
+  if (!scratch.arena) {
+    return Err(int, ErrorMessage)("Unable to get a scratch arena");
+  }
+
+  uint32_t format_count = 0;
+  VkResult result =
+      swapchain->instance_fn->vkGetPhysicalDeviceSurfaceFormatsKHR(
+          swapchain->physical_device, swapchain->surface, &format_count,
+          nullptr);
+  if (result != VK_SUCCESS) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  VkSurfaceFormatKHR* formats =
+      arena_alloc_array(scratch.arena, format_count, sizeof(*formats));
+  if (!formats) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate surface formats");
+  }
+  result = swapchain->instance_fn->vkGetPhysicalDeviceSurfaceFormatsKHR(
+      swapchain->physical_device, swapchain->surface, &format_count, formats);
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  swapchain->surface_format =
+      vulkan_swapchain_pick_format(formats, format_count);
+
+  uint32_t mode_count = 0;
+  result = swapchain->instance_fn->vkGetPhysicalDeviceSurfacePresentModesKHR(
+      swapchain->physical_device, swapchain->surface, &mode_count, nullptr);
+  if (result != VK_SUCCESS) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  VkPresentModeKHR* modes =
+      arena_alloc_array(scratch.arena, mode_count, sizeof(*modes));
+  if (!modes) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)("Unable to allocate present modes");
+  }
+  result = swapchain->instance_fn->vkGetPhysicalDeviceSurfacePresentModesKHR(
+      swapchain->physical_device, swapchain->surface, &mode_count, modes);
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    arena_scratch_end(scratch);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  swapchain->present_mode =
+      vulkan_swapchain_pick_present_mode(swapchain->policy, modes, mode_count);
+
+  arena_scratch_end(scratch);
+  return Ok(int, ErrorMessage)(0);
+}
+
+static void vulkan_swapchain_chain_reset(VulkanSwapchainChain* chain) {
+  chain->swapchain = VK_NULL_HANDLE;
+  for (uint32_t i = 0; i < VULKAN_SWAPCHAIN_MAX_IMAGES; i++) {
+    chain->images[i] = VK_NULL_HANDLE;
+    chain->views[i] = VK_NULL_HANDLE;
+    chain->present_semaphores[i] = VK_NULL_HANDLE;
+  }
+  chain->image_count = 0;
+  chain->retired_frame = 0;
+}
+
+static void vulkan_swapchain_chain_destroy(VulkanSwapchainChain* chain,
+                                           const VulkanDeviceFunctions* fn,
+                                           VkDevice device) {
+  for (uint32_t i = 0; i < chain->image_count; i++) {
+    if (chain->present_semaphores[i] != VK_NULL_HANDLE) {
+      fn->vkDestroySemaphore(device, chain->present_semaphores[i], nullptr);
+    }
+    if (chain->views[i] != VK_NULL_HANDLE) {
+      fn->vkDestroyImageView(device, chain->views[i], nullptr);
+    }
+  }
+  if (chain->swapchain != VK_NULL_HANDLE) {
+    fn->vkDestroySwapchainKHR(device, chain->swapchain, nullptr);
+  }
+  vulkan_swapchain_chain_reset(chain);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_swapchain_chain_init_images(VulkanSwapchain* swapchain,
+                                       VulkanSwapchainChain* chain) {
+  // the driver may create more images than asked for
+  uint32_t image_count = 0;
+  VkResult result = swapchain->fn->vkGetSwapchainImagesKHR(
+      swapchain->device, chain->swapchain, &image_count, nullptr);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  if (image_count > VULKAN_SWAPCHAIN_MAX_IMAGES) {
+    return Err(int, ErrorMessage)("Too many swapchain images");
+  }
+  result = swapchain->fn->vkGetSwapchainImagesKHR(
+      swapchain->device, chain->swapchain, &image_count, chain->images);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  chain->image_count = image_count;
+
+  for (uint32_t i = 0; i < image_count; i++) {
+    VkImageViewCreateInfo view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .image = chain->images[i],
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = swapchain->surface_format.format,
+        .components =
+            {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+    result = swapchain->fn->vkCreateImageView(
+        swapchain->device, &view_create_info, nullptr, &chain->views[i]);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+    };
+    result = swapchain->fn->vkCreateSemaphore(swapchain->device,
+                                              &semaphore_create_info, nullptr,
+                                              &chain->present_semaphores[i]);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// destroys the retired chains no frame in flight can still use
+static void vulkan_swapchain_collect_retired(VulkanSwapchain* swapchain,
+                                             uint64_t frame_number) {
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < swapchain->retired_count; i++) {
+    VulkanSwapchainChain* chain = &swapchain->retired[i];
+    if (frame_number >= chain->retired_frame + swapchain->frames_in_flight +
+                            VULKAN_SWAPCHAIN_RETIRE_MARGIN) {
+      vulkan_swapchain_chain_destroy(chain, swapchain->fn, swapchain->device);
+    } else {
+      swapchain->retired[kept++] = *chain;
+    }
+  }
+  swapchain->retired_count = kept;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_swapchain_retire(VulkanSwapchain* swapchain, uint64_t frame_number) {
+  if (swapchain->retired_count == VULKAN_SWAPCHAIN_MAX_RETIRED) {
+    // only reached when the chain was recreated several times within a
+    // single frame, waiting on the queue is rare enough to not matter
+    VkResult result = swapchain->fn->vkQueueWaitIdle(swapchain->present_queue);
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    for (uint32_t i = 0; i < swapchain->retired_count; i++) {
+      vulkan_swapchain_chain_destroy(&swapchain->retired[i], swapchain->fn,
+                                     swapchain->device);
+    }
+    swapchain->retired_count = 0;
+  }
+
+  swapchain->chain.retired_frame = frame_number;
+  swapchain->retired[swapchain->retired_count++] = swapchain->chain;
+  vulkan_swapchain_chain_reset(&swapchain->chain);
+  swapchain->is_chain_init = false;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_swapchain_create(VulkanSwapchain* swapchain, uint64_t frame_number) {
+  uint64_t start = SDL_GetPerformanceCounter();
+
+  VkSurfaceCapabilitiesKHR capabilities;
+  VkResult result =
+      swapchain->instance_fn->vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+          swapchain->physical_device, swapchain->surface, &capabilities);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkExtent2D extent = capabilities.currentExtent;
+  if (extent.width == UINT32_MAX) {
+    extent.width = SDL_max(capabilities.minImageExtent.width,
+                           SDL_min(swapchain->width,
+                                   capabilities.maxImageExtent.width));
+    extent.height = SDL_max(capabilities.minImageExtent.height,
+                            SDL_min(swapchain->height,
+                                    capabilities.maxImageExtent.height));
+  }
+  swapchain->extent = extent;
+  if (extent.width == 0 || extent.height == 0) {
+    // minimized, stays out of date until the window has an area again
+    swapchain->is_out_of_date = true;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+    return Err(int, ErrorMessage)(
+        "Surface images can not be written by transfers");
+  }
+
+  // every frame in flight holds an image while one is on screen
+  uint32_t image_count = swapchain->frames_in_flight + 1;
+  if (image_count < capabilities.minImageCount) {
+    image_count = capabilities.minImageCount;
+  }
+  if (capabilities.maxImageCount > 0 &&
+      image_count > capabilities.maxImageCount) {
+    image_count = capabilities.maxImageCount;
+  }
+  if (image_count > VULKAN_SWAPCHAIN_MAX_IMAGES) {
+    image_count = VULKAN_SWAPCHAIN_MAX_IMAGES;
+  }
+
+  VkCompositeAlphaFlagBitsKHR composite_alpha =
+      VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  if (!(capabilities.supportedCompositeAlpha & composite_alpha)) {
+    composite_alpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+  }
+
+  VkSwapchainCreateInfoKHR create_info = {
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .pNext = nullptr,
+      .flags = 0,
+      .surface = swapchain->surface,
+      .minImageCount = image_count,
+      .imageFormat = swapchain->surface_format.format,
+      .imageColorSpace = swapchain->surface_format.colorSpace,
+      .imageExtent = extent,
+      .imageArrayLayers = 1,
+      .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .preTransform = capabilities.currentTransform,
+      .compositeAlpha = composite_alpha,
+      .presentMode = swapchain->present_mode,
+      .clipped = VK_TRUE,
+      // lets the driver hand over resources, images of the old chain that
+      // are already acquired can still be presented
+      .oldSwapchain = swapchain->chain.swapchain,
+  };
+  VkSwapchainKHR new_swapchain = VK_NULL_HANDLE;
+  result = swapchain->fn->vkCreateSwapchainKHR(swapchain->device, &create_info,
+                                               nullptr, &new_swapchain);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  // the old chain is retired even if the rest below fails, it can not be
+  // acquired from anymore
+  if (swapchain->is_chain_init) {
+    auto retire_result = vulkan_swapchain_retire(swapchain, frame_number);
+    if (!retire_result.is_ok) {
+      swapchain->fn->vkDestroySwapchainKHR(swapchain->device, new_swapchain,
+                                           nullptr);
+      return retire_result;
+    }
+  }
+  swapchain->chain.swapchain = new_swapchain;
+  swapchain->is_chain_init = true;
+
+  auto images_result =
+      vulkan_swapchain_chain_init_images(swapchain, &swapchain->chain);
+  if (!images_result.is_ok) {
+    return images_result;
+  }
+
+  swapchain->is_out_of_date = false;
+  swapchain->recreate_count++;
+  double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+              (double)SDL_GetPerformanceFrequency();
+  log_debug("Created swapchain %ux%u, %u images, %s, in %.2f ms",
+            extent.width, extent.height, swapchain->chain.image_count,
+            vulkan_present_mode_name(swapchain->present_mode), ms);
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_swapchain_init(VulkanSwapchain* swapchain,
+                                                const VulkanDevice* vk_device,
+                                                VkSurfaceKHR surface,
+                                                uint32_t width,
+                                                uint32_t height,
+                                                uint32_t frames_in_flight,
+                                                VulkanPresentPolicy policy) {
+  swapchain->device = vk_device->device;
+  swapchain->fn = &vk_device->fn;
+  swapchain->instance_fn = vk_device->instance_fn;
+  swapchain->physical_device = vk_device->info.physical_device;
+  swapchain->surface = surface;
+  swapchain->present_queue = vk_device->graphics_queue;
+  swapchain->policy = policy;
+  swapchain->frames_in_flight = frames_in_flight;
+  swapchain->width = width;
+  swapchain->height = height;
+  swapchain->is_swapchain_init = true;
+
+  auto result = vulkan_swapchain_query_surface(swapchain);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  return vulkan_swapchain_create(swapchain, 0);
+}
+
+void vulkan_swapchain_reset(VulkanSwapchain* swapchain) {
+  vulkan_swapchain_chain_reset(&swapchain->chain);
+  for (uint32_t i = 0; i < VULKAN_SWAPCHAIN_MAX_RETIRED; i++) {
+    vulkan_swapchain_chain_reset(&swapchain->retired[i]);
+  }
+  swapchain->retired_count = 0;
+  swapchain->recreate_count = 0;
+  swapchain->extent = (VkExtent2D){0, 0};
+  swapchain->is_out_of_date = false;
+  swapchain->is_chain_init = false;
+  swapchain->is_swapchain_init = false;
+}
+
+void vulkan_swapchain_destroy(VulkanSwapchain* swapchain) {
+  if (!swapchain->is_swapchain_init) {
+    return;
+  }
+  for (uint32_t i = 0; i < swapchain->retired_count; i++) {
+    vulkan_swapchain_chain_destroy(&swapchain->retired[i], swapchain->fn,
+                                   swapchain->device);
+  }
+  vulkan_swapchain_chain_destroy(&swapchain->chain, swapchain->fn,
+                                 swapchain->device);
+  if (swapchain->recreate_count > 1) {
+    log_debug("Swapchain was recreated %u times",
+              swapchain->recreate_count - 1);
+  }
+  vulkan_swapchain_reset(swapchain);
+}
+
+void vulkan_swapchain_resize(VulkanSwapchain* swapchain,
+                             uint32_t width,
+                             uint32_t height) {
+  swapchain->width = width;
+  swapchain->height = height;
+  swapchain->is_out_of_date = true;
+}
+
+Result(int, ErrorMessage)
+    vulkan_swapchain_acquire(VulkanSwapchain* swapchain,
+                             VkSemaphore image_available,
+                             uint64_t frame_number,
+                             VulkanSwapchainImage* image,
+                             bool* has_image) {
+  *has_image = false;
+  vulkan_swapchain_collect_retired(swapchain, frame_number);
+
+  // an out of date chain is replaced and the acquire tried once more
+  for (uint32_t attempt = 0; attempt < 2; attempt++) {
+    if (swapchain->is_out_of_date || !swapchain->is_chain_init) {
+      auto create_result = vulkan_swapchain_create(swapchain, frame_number);
+      if (!create_result.is_ok) {
+        return create_result;
+      }
+      if (swapchain->is_out_of_date) {
+        return Ok(int, ErrorMessage)(0);
+      }
+    }
+
+    uint32_t index = 0;
+    VkResult result = swapchain->fn->vkAcquireNextImageKHR(
+        swapchain->device, swapchain->chain.swapchain, UINT64_MAX,
+        image_available, VK_NULL_HANDLE, &index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      swapchain->is_out_of_date = true;
+      continue;
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    // the semaphore is signaled either way, the image is presented and the
+    // chain replaced at the next acquire
+    if (result == VK_SUBOPTIMAL_KHR) {
+      swapchain->is_out_of_date = true;
+    }
+
+    image->index = index;
+    image->image = swapchain->chain.images[index];
+    image->view = swapchain->chain.views[index];
+    image->present_semaphore = swapchain->chain.present_semaphores[index];
+    *has_image = true;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_swapchain_present(VulkanSwapchain* swapchain,
+                             const VulkanSwapchainImage* image) {
+  VkPresentInfoKHR present_info = {
+      .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &image->present_semaphore,
+      .swapchainCount = 1,
+      .pSwapchains = &swapchain->chain.swapchain,
+      .pImageIndices = &image->index,
+      .pResults = nullptr,
+  };
+  VkResult result = swapchain->fn->vkQueuePresentKHR(swapchain->present_queue,
+                                                     &present_info);
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    swapchain->is_out_of_date = true;
+    return Ok(int, ErrorMessage)(0);
+  }
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_swapchain_record_clear(const VulkanDeviceFunctions* fn,
+                                   const VulkanSwapchainImage* image,
+                                   VkCommandBuffer command_buffer,
+                                   VkClearColorValue clear_color) {
+  VkImageSubresourceRange color_range = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+  };
+  fn->vkCmdClearColorImage(command_buffer, image->image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color,
+                           1, &color_range);
+}
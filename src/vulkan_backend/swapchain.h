@@ -0,0 +1,117 @@
+#ifndef VULKAN_BACKEND_SWAPCHAIN_H
+#define VULKAN_BACKEND_SWAPCHAIN_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./device.h"
+#include "./frame_scheduler.h"
+
+#define VULKAN_SWAPCHAIN_MAX_IMAGES 8
+// resizing recreates the swapchain every frame, a chain is retired for
+// frames_in_flight + 1 frames so this many can be waiting at once
+#define VULKAN_SWAPCHAIN_MAX_RETIRED (VULKAN_MAX_FRAMES_IN_FLIGHT + 2)
+
+typedef enum VulkanPresentPolicy {
+  // FIFO, the GPU sleeps until vblank, the lowest power draw
+  VULKAN_PRESENT_POLICY_VSYNC,
+  // MAILBOX, no tearing and vblank picks up the newest frame, falls back to
+  // FIFO
+  VULKAN_PRESENT_POLICY_LOW_LATENCY,
+  // IMMEDIATE, tears, falls back to MAILBOX then FIFO
+  VULKAN_PRESENT_POLICY_IMMEDIATE,
+} VulkanPresentPolicy;
+
+// A VkSwapchainKHR with everything created per image, kept together so a
+// retired chain goes away as a whole
+typedef struct VulkanSwapchainChain {
+  VkSwapchainKHR swapchain;
+  VkImage images[VULKAN_SWAPCHAIN_MAX_IMAGES];
+  VkImageView views[VULKAN_SWAPCHAIN_MAX_IMAGES];
+  // per image, a present may still wait on the semaphore of an image when
+  // another frame slot gets to signal it, one per slot would be reused early
+  VkSemaphore present_semaphores[VULKAN_SWAPCHAIN_MAX_IMAGES];
+  uint32_t image_count;
+  // frame that was recorded when the chain was retired
+  uint64_t retired_frame;
+} VulkanSwapchainChain;
+
+typedef struct VulkanSwapchainImage {
+  uint32_t index;
+  VkImage image;
+  VkImageView view;
+  // signal it from the submission that renders the image
+  VkSemaphore present_semaphore;
+} VulkanSwapchainImage;
+
+// Presents to the window surface. A resize or an out of date swapchain is
+// handled by creating the new chain with the old one as oldSwapchain, the old
+// chain is destroyed once the frames that used it finished, so resizing never
+// waits for the device to go idle.
+typedef struct VulkanSwapchain {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  // surface queries are instance level
+  const VulkanInstanceFunctions* instance_fn;
+  VkPhysicalDevice physical_device;
+  VkSurfaceKHR surface;
+  VkQueue present_queue;
+  VulkanPresentPolicy policy;
+  uint32_t frames_in_flight;
+  VkSurfaceFormatKHR surface_format;
+  VkPresentModeKHR present_mode;
+  VkExtent2D extent;
+  // drawable size of the window, used when the surface leaves it to us
+  uint32_t width;
+  uint32_t height;
+  VulkanSwapchainChain chain;
+  VulkanSwapchainChain retired[VULKAN_SWAPCHAIN_MAX_RETIRED];
+  uint32_t retired_count;
+  uint32_t recreate_count;
+  bool is_out_of_date;
+  bool is_chain_init;
+  bool is_swapchain_init;
+} VulkanSwapchain;
+
+Result(int, ErrorMessage) vulkan_swapchain_init(VulkanSwapchain* swapchain,
+                                                const VulkanDevice* vk_device,
+                                                VkSurfaceKHR surface,
+                                                uint32_t width,
+                                                uint32_t height,
+                                                uint32_t frames_in_flight,
+                                                VulkanPresentPolicy policy);
+void vulkan_swapchain_reset(VulkanSwapchain* swapchain);
+// the device must be idle
+void vulkan_swapchain_destroy(VulkanSwapchain* swapchain);
+
+// the swapchain is recreated with the new size at the next acquire
+void vulkan_swapchain_resize(VulkanSwapchain* swapchain,
+                             uint32_t width,
+                             uint32_t height);
+
+// Acquires the next image, image_available is signaled once it can be
+// written. frame_number is the frame being recorded, it decides when retired
+// chains are destroyed. has_image is false while the window has no area,
+// the frame is then rendered without presenting.
+Result(int, ErrorMessage)
+    vulkan_swapchain_acquire(VulkanSwapchain* swapchain,
+                             VkSemaphore image_available,
+                             uint64_t frame_number,
+                             VulkanSwapchainImage* image,
+                             bool* has_image);
+// queues the image for presentation once its present semaphore signaled
+Result(int, ErrorMessage)
+    vulkan_swapchain_present(VulkanSwapchain* swapchain,
+                             const VulkanSwapchainImage* image);
+
+// records a clear of an acquired image, it must be in
+// VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+void vulkan_swapchain_record_clear(const VulkanDeviceFunctions* fn,
+                                   const VulkanSwapchainImage* image,
+                                   VkCommandBuffer command_buffer,
+                                   VkClearColorValue clear_color);
+
+const char* vulkan_present_mode_name(VkPresentModeKHR present_mode);
+
+#endif
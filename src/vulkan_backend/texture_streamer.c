@@ -0,0 +1,743 @@
+#include "./texture_streamer.h"
+
+#include <string.h>
+
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+static VkDeviceSize vulkan_texture_bytes(const VulkanTexture* texture,
+                                         uint32_t base_level) {
+  VkDeviceSize size = 0;
+  for (uint32_t i = base_level; i < texture->file.level_count; i++) {
+    size += texture->file.levels[i].size;
+  }
+  return size;
+}
+
+static void vulkan_texture_reset(VulkanTexture* texture) {
+  texture->map = (FileMap){0};
+  texture->file = (TextureFile){0};
+  texture->image = (VulkanTextureImage){0};
+  texture->bindless_index = VULKAN_BINDLESS_INVALID_INDEX;
+  texture->resident_level = 0;
+  texture->target_level = 0;
+  texture->coarse_level = 0;
+  texture->finest_level = 0;
+  texture->requested_level = 0;
+  texture->last_used_frame = 0;
+  texture->load = (VulkanTextureLoad){0};
+  texture->is_loading = false;
+  texture->is_map_init = false;
+  texture->is_image_init = false;
+}
+
+static void vulkan_texture_image_destroy(VulkanTextureStreamer* streamer,
+                                         VulkanTextureImage* image) {
+  if (image->view != VK_NULL_HANDLE) {
+    streamer->fn->vkDestroyImageView(streamer->device, image->view, nullptr);
+  }
+  vulkan_allocator_destroy_image(streamer->allocator, image->image,
+                                 &image->allocation);
+  *image = (VulkanTextureImage){0};
+}
+
+// the image is destroyed once the frames in flight recorded up to now are
+// done with it
+static Result(int, ErrorMessage)
+    vulkan_texture_streamer_retire(VulkanTextureStreamer* streamer,
+                                   const VulkanTextureImage* image) {
+  if (streamer->retired_count == streamer->retired_capacity) {
+    uint32_t capacity =
+        streamer->retired_capacity > 0 ? streamer->retired_capacity * 2 : 16;
+    VulkanRetiredTexture* retired = mem_realloc(
+        streamer->retired, sizeof(VulkanRetiredTexture) * capacity);
+    CHECK_ALLOC(retired, Err(int, ErrorMessage)(
+                             "Unable to allocate memory for retired textures"));
+    streamer->retired = retired;
+    streamer->retired_capacity = capacity;
+  }
+  streamer->retired[streamer->retired_count++] = (VulkanRetiredTexture){
+      .image = *image,
+      .retired_frame = streamer->frame_number,
+  };
+  return Ok(int, ErrorMessage)(0);
+}
+
+// drops an image that never became a texture's, copies into it may already
+// be recorded so it is only destroyed right away when it cannot be retired
+static void vulkan_texture_streamer_discard(VulkanTextureStreamer* streamer,
+                                            VulkanTextureImage* image) {
+  auto result = vulkan_texture_streamer_retire(streamer, image);
+  if (!result.is_ok) {
+    vulkan_texture_image_destroy(streamer, image);
+  }
+}
+
+static void vulkan_texture_streamer_collect_retired(
+    VulkanTextureStreamer* streamer,
+    uint64_t frame_number) {
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < streamer->retired_count; i++) {
+    VulkanRetiredTexture* retired = &streamer->retired[i];
+    if (frame_number >= retired->retired_frame + streamer->frames_in_flight) {
+      vulkan_texture_image_destroy(streamer, &retired->image);
+    } else {
+      streamer->retired[kept++] = *retired;
+    }
+  }
+  streamer->retired_count = kept;
+}
+
+// Creates an image holding levels [base_level, level_count) and queues their
+// uploads, levels[i] points at the bytes of level i of the file
+static Result(int, ErrorMessage)
+    vulkan_texture_build_image(VulkanTextureStreamer* streamer,
+                               const TextureFile* file,
+                               uint32_t base_level,
+                               const uint8_t* const* levels,
+                               VulkanTextureImage* image) {
+  VkImageCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = file->format,
+      .extent =
+          {
+              .width = file->levels[base_level].width,
+              .height = file->levels[base_level].height,
+              .depth = 1,
+          },
+      .mipLevels = file->level_count - base_level,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  *image = (VulkanTextureImage){0};
+  auto result = vulkan_allocator_create_image(
+      streamer->allocator, &create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      0, &image->image, &image->allocation);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  VkImageViewCreateInfo view_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .image = image->image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = file->format,
+      .components =
+          {
+              .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+              .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+          },
+      .subresourceRange =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .baseMipLevel = 0,
+              .levelCount = create_info.mipLevels,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+  };
+  VkResult vk_result = streamer->fn->vkCreateImageView(
+      streamer->device, &view_create_info, nullptr, &image->view);
+  if (vk_result != VK_SUCCESS) {
+    image->view = VK_NULL_HANDLE;
+    vulkan_texture_image_destroy(streamer, image);
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+
+  for (uint32_t i = base_level; i < file->level_count; i++) {
+    const TextureLevel* level = &file->levels[i];
+    VulkanImageUpload upload = {
+        .image = image->image,
+        .subresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = i - base_level,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        .offset = {0, 0, 0},
+        .extent = {level->width, level->height, 1},
+        .final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .data = levels[i],
+        .size = level->size,
+    };
+    result = vulkan_uploader_upload_image(streamer->uploader, &upload);
+    if (!result.is_ok) {
+      vulkan_texture_streamer_discard(streamer, image);
+      return result;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// Replaces the texture's image, the old one is retired. On failure the
+// texture keeps its old image and the new one is discarded.
+static Result(int, ErrorMessage)
+    vulkan_texture_swap_image(VulkanTextureStreamer* streamer,
+                              VulkanTexture* texture,
+                              VulkanTextureImage* image,
+                              uint32_t base_level) {
+  uint32_t bindless_index = VULKAN_BINDLESS_INVALID_INDEX;
+  if (streamer->bindless) {
+    auto result = vulkan_bindless_table_register_texture(
+        streamer->bindless, image->view, streamer->sampler,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &bindless_index);
+    if (!result.is_ok) {
+      vulkan_texture_streamer_discard(streamer, image);
+      return result;
+    }
+  }
+
+  if (texture->is_image_init) {
+    auto result = vulkan_texture_streamer_retire(streamer, &texture->image);
+    if (!result.is_ok) {
+      if (bindless_index != VULKAN_BINDLESS_INVALID_INDEX) {
+        vulkan_bindless_table_release(streamer->bindless,
+                                      VULKAN_BINDLESS_KIND_TEXTURE,
+                                      bindless_index);
+      }
+      vulkan_texture_streamer_discard(streamer, image);
+      return result;
+    }
+    if (texture->bindless_index != VULKAN_BINDLESS_INVALID_INDEX) {
+      vulkan_bindless_table_release(streamer->bindless,
+                                    VULKAN_BINDLESS_KIND_TEXTURE,
+                                    texture->bindless_index);
+    }
+    streamer->resident_bytes -= texture->image.allocation.size;
+  }
+  texture->image = *image;
+  texture->bindless_index = bindless_index;
+  texture->resident_level = base_level;
+  texture->is_image_init = true;
+  streamer->resident_bytes += image->allocation.size;
+  if (streamer->resident_bytes > streamer->peak_resident_bytes) {
+    streamer->peak_resident_bytes = streamer->resident_bytes;
+  }
+  return Ok(int, ErrorMessage)(0);
+}
+
+// Reads the levels of the queued textures out of their mappings. With the
+// pages not in memory yet this is where the disk reads happen, away from the
+// thread recording frames.
+static int vulkan_texture_streamer_thread_run(void* data) {
+  VulkanTextureStreamer* streamer = data;
+
+  SDL_LockMutex(streamer->mutex);
+  while (true) {
+    while (streamer->is_running && streamer->queue_count == 0) {
+      SDL_CondWait(streamer->work_available, streamer->mutex);
+    }
+    if (!streamer->is_running) {
+      break;
+    }
+    uint32_t index = streamer->queue[streamer->queue_head];
+    streamer->queue_head = (streamer->queue_head + 1) % streamer->capacity;
+    streamer->queue_count--;
+    VulkanTexture* texture = &streamer->textures[index];
+    SDL_UnlockMutex(streamer->mutex);
+
+    VulkanTextureLoad* load = &texture->load;
+    VkDeviceSize size = vulkan_texture_bytes(texture, load->base_level);
+    load->data = mem_alloc(size);
+    load->is_failed = load->data == nullptr;
+    VkDeviceSize offset = 0;
+    for (uint32_t i = load->base_level;
+         i < texture->file.level_count && !load->is_failed; i++) {
+      const TextureLevel* level = &texture->file.levels[i];
+      mem_copy(load->data + offset, texture->map.data + level->offset,
+               level->size);
+      load->offsets[i] = offset;
+      offset += level->size;
+    }
+
+    SDL_LockMutex(streamer->mutex);
+    uint32_t slot =
+        (streamer->done_head + streamer->done_count) % streamer->capacity;
+    streamer->done[slot] = index;
+    streamer->done_count++;
+  }
+  SDL_UnlockMutex(streamer->mutex);
+
+  return 0;
+}
+
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_init(VulkanTextureStreamer* streamer,
+                                 const VulkanDevice* vk_device,
+                                 VulkanAllocator* allocator,
+                                 VulkanUploader* uploader,
+                                 VulkanBindlessTable* bindless,
+                                 VkDeviceSize budget,
+                                 uint32_t capacity,
+                                 uint32_t frames_in_flight) {
+  streamer->is_streamer_init = true;
+  streamer->device = vk_device->device;
+  streamer->fn = &vk_device->fn;
+  streamer->allocator = allocator;
+  streamer->uploader = uploader;
+  streamer->bindless = bindless;
+  streamer->capacity = capacity;
+  streamer->frames_in_flight = frames_in_flight;
+  streamer->budget = budget;
+  streamer->is_running = true;
+
+  streamer->textures = mem_alloc(sizeof(VulkanTexture) * capacity);
+  CHECK_ALLOC(streamer->textures,
+              Err(int, ErrorMessage)("Unable to allocate memory for textures"));
+  streamer->queue = mem_alloc(sizeof(uint32_t) * capacity);
+  CHECK_ALLOC(streamer->queue, Err(int, ErrorMessage)(
+                                   "Unable to allocate memory for texture "
+                                   "loads"));
+  streamer->done = mem_alloc(sizeof(uint32_t) * capacity);
+  CHECK_ALLOC(streamer->done, Err(int, ErrorMessage)(
+                                  "Unable to allocate memory for texture "
+                                  "loads"));
+
+  VkSamplerCreateInfo sampler_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .magFilter = VK_FILTER_LINEAR,
+      .minFilter = VK_FILTER_LINEAR,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 1.0f,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      // the image's level 0 is whatever level is resident, the LOD the
+      // hardware computes is relative to it already
+      .maxLod = VK_LOD_CLAMP_NONE,
+      .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  VkResult vk_result = streamer->fn->vkCreateSampler(
+      streamer->device, &sampler_create_info, nullptr, &streamer->sampler);
+  if (vk_result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(vk_result));
+  }
+  streamer->is_sampler_init = true;
+
+  streamer->mutex = SDL_CreateMutex();
+  if (!streamer->mutex) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  streamer->is_mutex_init = true;
+
+  streamer->work_available = SDL_CreateCond();
+  if (!streamer->work_available) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  streamer->is_work_available_init = true;
+
+  streamer->thread = SDL_CreateThread(vulkan_texture_streamer_thread_run,
+                                      "texture_io", streamer);
+  if (!streamer->thread) {
+    return Err(int, ErrorMessage)(SDL_GetError());
+  }
+  streamer->is_thread_init = true;
+
+  log_debug("Initialized texture streamer with %llu MiB budget",
+            (unsigned long long)(budget / (1024 * 1024)));
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_texture_streamer_reset(VulkanTextureStreamer* streamer) {
+  streamer->device = VK_NULL_HANDLE;
+  streamer->fn = nullptr;
+  streamer->allocator = nullptr;
+  streamer->uploader = nullptr;
+  streamer->bindless = nullptr;
+  streamer->sampler = VK_NULL_HANDLE;
+  streamer->textures = nullptr;
+  streamer->texture_count = 0;
+  streamer->capacity = 0;
+  streamer->retired = nullptr;
+  streamer->retired_count = 0;
+  streamer->retired_capacity = 0;
+  streamer->frames_in_flight = 0;
+  streamer->frame_number = 0;
+  streamer->budget = 0;
+  streamer->target_bytes = 0;
+  streamer->resident_bytes = 0;
+  streamer->peak_resident_bytes = 0;
+  streamer->streamed_bytes = 0;
+  streamer->stream_in_count = 0;
+  streamer->evicted_level_count = 0;
+  streamer->denied_count = 0;
+  streamer->queue = nullptr;
+  streamer->queue_head = 0;
+  streamer->queue_count = 0;
+  streamer->done = nullptr;
+  streamer->done_head = 0;
+  streamer->done_count = 0;
+  streamer->thread = nullptr;
+  streamer->mutex = nullptr;
+  streamer->work_available = nullptr;
+  streamer->is_running = false;
+  streamer->is_sampler_init = false;
+  streamer->is_mutex_init = false;
+  streamer->is_work_available_init = false;
+  streamer->is_thread_init = false;
+  streamer->is_streamer_init = false;
+}
+
+void vulkan_texture_streamer_destroy(VulkanTextureStreamer* streamer) {
+  if (!streamer->is_streamer_init) {
+    return;
+  }
+  if (streamer->is_mutex_init) {
+    SDL_LockMutex(streamer->mutex);
+    streamer->is_running = false;
+    if (streamer->is_work_available_init) {
+      SDL_CondBroadcast(streamer->work_available);
+    }
+    SDL_UnlockMutex(streamer->mutex);
+  }
+  if (streamer->is_thread_init) {
+    SDL_WaitThread(streamer->thread, nullptr);
+  }
+
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    VulkanTexture* texture = &streamer->textures[i];
+    mem_free(texture->load.data);
+    if (texture->is_image_init) {
+      if (texture->bindless_index != VULKAN_BINDLESS_INVALID_INDEX) {
+        vulkan_bindless_table_release(streamer->bindless,
+                                      VULKAN_BINDLESS_KIND_TEXTURE,
+                                      texture->bindless_index);
+      }
+      vulkan_texture_image_destroy(streamer, &texture->image);
+    }
+    if (texture->is_map_init) {
+      file_map_close(&texture->map);
+    }
+  }
+  for (uint32_t i = 0; i < streamer->retired_count; i++) {
+    vulkan_texture_image_destroy(streamer, &streamer->retired[i].image);
+  }
+
+  if (streamer->is_sampler_init) {
+    streamer->fn->vkDestroySampler(streamer->device, streamer->sampler,
+                                   nullptr);
+  }
+  if (streamer->is_work_available_init) {
+    SDL_DestroyCond(streamer->work_available);
+  }
+  if (streamer->is_mutex_init) {
+    SDL_DestroyMutex(streamer->mutex);
+  }
+  mem_free(streamer->textures);
+  mem_free(streamer->retired);
+  mem_free(streamer->queue);
+  mem_free(streamer->done);
+  vulkan_texture_streamer_reset(streamer);
+}
+
+// coarse levels come straight out of the mapping, they are small enough
+// that reading them on the calling thread does not matter
+static Result(int, ErrorMessage)
+    vulkan_texture_streamer_open(VulkanTextureStreamer* streamer,
+                                 VulkanTexture* texture,
+                                 const char* path) {
+  auto result = file_map_open(&texture->map, path);
+  if (!result.is_ok) {
+    return result;
+  }
+  texture->is_map_init = true;
+  result = texture_file_parse(texture->map.data, texture->map.size,
+                              &texture->file);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  const TextureFile* file = &texture->file;
+  VkDeviceSize max_upload = streamer->uploader->ring_size / 2;
+  texture->finest_level = 0;
+  while (texture->finest_level < file->level_count &&
+         file->levels[texture->finest_level].size > max_upload) {
+    texture->finest_level++;
+  }
+  if (texture->finest_level == file->level_count) {
+    return Err(int, ErrorMessage)("Texture levels exceed the staging ring");
+  }
+  texture->coarse_level = file->level_count - 1;
+  for (uint32_t i = 0; i < file->level_count; i++) {
+    const TextureLevel* level = &file->levels[i];
+    if (SDL_max(level->width, level->height) <= VULKAN_TEXTURE_COARSE_SIZE) {
+      texture->coarse_level = i;
+      break;
+    }
+  }
+  texture->coarse_level = SDL_max(texture->coarse_level, texture->finest_level);
+
+  const uint8_t* levels[TEXTURE_MAX_LEVELS];
+  for (uint32_t i = 0; i < file->level_count; i++) {
+    levels[i] = texture->map.data + file->levels[i].offset;
+  }
+  VulkanTextureImage image;
+  result = vulkan_texture_build_image(streamer, file, texture->coarse_level,
+                                      levels, &image);
+  if (!result.is_ok) {
+    return result;
+  }
+  result = vulkan_texture_swap_image(streamer, texture, &image,
+                                     texture->coarse_level);
+  if (!result.is_ok) {
+    return result;
+  }
+  texture->target_level = texture->coarse_level;
+  texture->requested_level = texture->coarse_level;
+  texture->last_used_frame = streamer->frame_number;
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_add(VulkanTextureStreamer* streamer,
+                                const char* path,
+                                VulkanTextureHandle* handle) {
+  if (streamer->texture_count == streamer->capacity) {
+    return Err(int, ErrorMessage)("Texture streamer is full");
+  }
+  VulkanTexture* texture = &streamer->textures[streamer->texture_count];
+  vulkan_texture_reset(texture);
+  auto result = vulkan_texture_streamer_open(streamer, texture, path);
+  if (!result.is_ok) {
+    if (texture->is_map_init) {
+      file_map_close(&texture->map);
+    }
+    return result;
+  }
+
+  streamer->target_bytes +=
+      vulkan_texture_bytes(texture, texture->coarse_level);
+  if (streamer->target_bytes > streamer->budget) {
+    log_warning("Coarse texture levels exceed the budget by %llu KiB",
+                (unsigned long long)((streamer->target_bytes -
+                                      streamer->budget) / 1024));
+  }
+  *handle = streamer->texture_count++;
+  log_debug("Added texture %s: %ux%u, %u levels, %u resident", path,
+            texture->file.width, texture->file.height,
+            texture->file.level_count,
+            texture->file.level_count - texture->coarse_level);
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_texture_streamer_request(VulkanTextureStreamer* streamer,
+                                     VulkanTextureHandle handle,
+                                     uint32_t level) {
+  VulkanTexture* texture = &streamer->textures[handle];
+  texture->requested_level = SDL_min(texture->requested_level, level);
+  texture->last_used_frame = streamer->frame_number;
+}
+
+// moves the target of a texture, the budget is tracked on the targets
+static void vulkan_texture_streamer_retarget(VulkanTextureStreamer* streamer,
+                                             VulkanTexture* texture,
+                                             uint32_t level) {
+  streamer->target_bytes -= vulkan_texture_bytes(texture,
+                                                 texture->target_level);
+  streamer->target_bytes += vulkan_texture_bytes(texture, level);
+  texture->target_level = level;
+}
+
+// level the requests since the last update ask for
+static uint32_t vulkan_texture_wanted_level(const VulkanTexture* texture) {
+  return SDL_max(texture->requested_level, texture->finest_level);
+}
+
+// Takes the finest target level away from the least recently used texture
+// that was not requested since the last update or holds finer levels than
+// requested, false when there is none
+static bool vulkan_texture_streamer_evict_level(
+    VulkanTextureStreamer* streamer,
+    const VulkanTexture* keep) {
+  VulkanTexture* victim = nullptr;
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    VulkanTexture* texture = &streamer->textures[i];
+    if (texture == keep || texture->target_level >= texture->coarse_level) {
+      continue;
+    }
+    if (texture->last_used_frame >= streamer->frame_number &&
+        texture->target_level >= vulkan_texture_wanted_level(texture)) {
+      continue;
+    }
+    if (!victim || texture->last_used_frame < victim->last_used_frame) {
+      victim = texture;
+    }
+  }
+  if (!victim) {
+    return false;
+  }
+  vulkan_texture_streamer_retarget(streamer, victim, victim->target_level + 1);
+  streamer->evicted_level_count++;
+  return true;
+}
+
+// grows the targets towards the requested levels one level at a time,
+// evicting levels of unused textures while the budget does not allow it
+static void vulkan_texture_streamer_plan(VulkanTextureStreamer* streamer) {
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    VulkanTexture* texture = &streamer->textures[i];
+    uint32_t wanted = vulkan_texture_wanted_level(texture);
+    while (wanted < texture->target_level) {
+      VkDeviceSize size =
+          texture->file.levels[texture->target_level - 1].size;
+      bool fits = streamer->target_bytes + size <= streamer->budget;
+      while (!fits && vulkan_texture_streamer_evict_level(streamer, texture)) {
+        fits = streamer->target_bytes + size <= streamer->budget;
+      }
+      if (!fits) {
+        streamer->denied_count++;
+        break;
+      }
+      vulkan_texture_streamer_retarget(streamer, texture,
+                                       texture->target_level - 1);
+    }
+  }
+  // the eviction above still compares against the requests of every texture
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    streamer->textures[i].requested_level = streamer->textures[i].coarse_level;
+  }
+}
+
+static void vulkan_texture_streamer_schedule(VulkanTextureStreamer* streamer) {
+  bool has_work = false;
+  SDL_LockMutex(streamer->mutex);
+  for (uint32_t i = 0; i < streamer->texture_count; i++) {
+    VulkanTexture* texture = &streamer->textures[i];
+    if (texture->is_loading ||
+        texture->target_level == texture->resident_level) {
+      continue;
+    }
+    texture->is_loading = true;
+    texture->load.base_level = texture->target_level;
+    uint32_t slot =
+        (streamer->queue_head + streamer->queue_count) % streamer->capacity;
+    streamer->queue[slot] = i;
+    streamer->queue_count++;
+    has_work = true;
+  }
+  if (has_work) {
+    SDL_CondSignal(streamer->work_available);
+  }
+  SDL_UnlockMutex(streamer->mutex);
+}
+
+// Swaps in the levels a load read. A failure leaves the texture at the
+// levels it has, the next plan may ask for the rest again.
+static void vulkan_texture_streamer_finish_load(
+    VulkanTextureStreamer* streamer,
+    VulkanTexture* texture) {
+  VulkanTextureLoad* load = &texture->load;
+  texture->is_loading = false;
+  if (load->is_failed) {
+    log_warning("Unable to read levels of a %ux%u texture",
+                texture->file.width, texture->file.height);
+    vulkan_texture_streamer_retarget(streamer, texture,
+                                     texture->resident_level);
+    return;
+  }
+  // a target that moved on while the thread read is scheduled again
+  if (load->base_level != texture->target_level) {
+    mem_free(load->data);
+    load->data = nullptr;
+    return;
+  }
+
+  const uint8_t* levels[TEXTURE_MAX_LEVELS];
+  for (uint32_t i = load->base_level; i < texture->file.level_count; i++) {
+    levels[i] = load->data + load->offsets[i];
+  }
+  bool is_stream_in = load->base_level < texture->resident_level;
+  VulkanTextureImage image;
+  auto result = vulkan_texture_build_image(
+      streamer, &texture->file, load->base_level, levels, &image);
+  if (result.is_ok) {
+    result =
+        vulkan_texture_swap_image(streamer, texture, &image, load->base_level);
+  }
+  mem_free(load->data);
+  load->data = nullptr;
+  if (!result.is_ok) {
+    log_warning("Unable to stream a %ux%u texture to level %u: %s",
+                texture->file.width, texture->file.height, load->base_level,
+                result.error);
+    vulkan_texture_streamer_retarget(streamer, texture,
+                                     texture->resident_level);
+    return;
+  }
+  if (is_stream_in) {
+    streamer->stream_in_count++;
+  }
+  streamer->streamed_bytes += vulkan_texture_bytes(texture, load->base_level);
+}
+
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_update(VulkanTextureStreamer* streamer,
+                                   uint64_t frame_number) {
+  vulkan_texture_streamer_collect_retired(streamer, frame_number);
+
+  // new images go through the staging ring, only about half of it is spent
+  // per frame so the other uploads do not stall behind the textures
+  VkDeviceSize upload_limit = streamer->uploader->ring_size / 2;
+  VkDeviceSize uploaded = 0;
+  while (uploaded < upload_limit) {
+    SDL_LockMutex(streamer->mutex);
+    uint32_t index = UINT32_MAX;
+    if (streamer->done_count > 0) {
+      index = streamer->done[streamer->done_head];
+      streamer->done_head = (streamer->done_head + 1) % streamer->capacity;
+      streamer->done_count--;
+    }
+    SDL_UnlockMutex(streamer->mutex);
+    if (index == UINT32_MAX) {
+      break;
+    }
+
+    VulkanTexture* texture = &streamer->textures[index];
+    uploaded += vulkan_texture_bytes(texture, texture->load.base_level);
+    vulkan_texture_streamer_finish_load(streamer, texture);
+  }
+
+  vulkan_texture_streamer_plan(streamer);
+  vulkan_texture_streamer_schedule(streamer);
+  streamer->frame_number = frame_number;
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_texture_streamer_log_stats(const VulkanTextureStreamer* streamer) {
+  log_info("Textures: %u, %llu KiB resident (%llu KiB peak) of %llu KiB "
+           "budget",
+           streamer->texture_count,
+           (unsigned long long)(streamer->resident_bytes / 1024),
+           (unsigned long long)(streamer->peak_resident_bytes / 1024),
+           (unsigned long long)(streamer->budget / 1024));
+  log_info("Texture streaming: %u stream ins, %llu KiB uploaded, %u levels "
+           "evicted, %u requests over budget",
+           streamer->stream_in_count,
+           (unsigned long long)(streamer->streamed_bytes / 1024),
+           streamer->evicted_level_count, streamer->denied_count);
+}
@@ -0,0 +1,169 @@
+#ifndef VULKAN_BACKEND_TEXTURE_STREAMER_H
+#define VULKAN_BACKEND_TEXTURE_STREAMER_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../assets/texture_format.h"
+#include "../result.h"
+#include "../utils/file_map.h"
+#include "./allocator.h"
+#include "./bindless.h"
+#include "./device.h"
+#include "./uploader.h"
+
+// levels this small on their longer side are loaded with the texture and
+// stay resident until it is destroyed
+#define VULKAN_TEXTURE_COARSE_SIZE 64
+#define VULKAN_TEXTURE_STREAMER_DEFAULT_CAPACITY 1024
+
+typedef uint32_t VulkanTextureHandle;
+
+// Levels [base_level, level_count) of one texture, read from the file by the
+// I/O thread into one block. Only the I/O thread touches it while the
+// texture is loading.
+typedef struct VulkanTextureLoad {
+  uint32_t base_level;
+  uint8_t* data;
+  // of each level inside data, indexed by the level in the file
+  VkDeviceSize offsets[TEXTURE_MAX_LEVELS];
+  bool is_failed;
+} VulkanTextureLoad;
+
+typedef struct VulkanTextureImage {
+  VkImage image;
+  VulkanAllocation allocation;
+  VkImageView view;
+} VulkanTextureImage;
+
+typedef struct VulkanTexture {
+  FileMap map;
+  TextureFile file;
+  // holds the file's levels from resident_level on, resident_level is the
+  // image's level 0
+  VulkanTextureImage image;
+  // VULKAN_BINDLESS_INVALID_INDEX without a bindless table, changes
+  // whenever the image is replaced
+  uint32_t bindless_index;
+  uint32_t resident_level;
+  // level the image moves to once the pending load lands
+  uint32_t target_level;
+  // levels from coarse_level on are always resident
+  uint32_t coarse_level;
+  // finer levels do not fit the staging ring in one upload
+  uint32_t finest_level;
+  // finest level requested since the last update
+  uint32_t requested_level;
+  uint64_t last_used_frame;
+  VulkanTextureLoad load;
+  // queued for or owned by the I/O thread
+  bool is_loading;
+  bool is_map_init;
+  bool is_image_init;
+} VulkanTexture;
+
+// An image replaced while frames in flight may still sample it
+typedef struct VulkanRetiredTexture {
+  VulkanTextureImage image;
+  uint64_t retired_frame;
+} VulkanRetiredTexture;
+
+// Textures whose finer levels are streamed in on demand and evicted under
+// memory pressure. Adding a texture maps its KTX2 file and uploads only the
+// coarse levels. Renderers request the level they sample each frame, the
+// update then moves each texture's image towards the finest requested level
+// within the budget, taking levels away from the least recently used
+// textures when the budget would be exceeded.
+//
+// Images can not change their level count, a texture that gains or loses
+// levels gets a new image holding all of its resident levels. The file
+// reads happen on a background I/O thread, the new image is created and
+// uploaded on the calling thread once the read finished, and the old one
+// retired until the frames in flight are done with it. Not thread safe.
+typedef struct VulkanTextureStreamer {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanAllocator* allocator;
+  VulkanUploader* uploader;
+  // nullptr when textures are bound through descriptor sets
+  VulkanBindlessTable* bindless;
+  // trilinear and repeating, shared by every texture
+  VkSampler sampler;
+  VulkanTexture* textures;
+  uint32_t texture_count;
+  uint32_t capacity;
+  VulkanRetiredTexture* retired;
+  uint32_t retired_count;
+  uint32_t retired_capacity;
+  uint32_t frames_in_flight;
+  // frame of the last update, requests are stamped with it
+  uint64_t frame_number;
+  VkDeviceSize budget;
+  // sum of the level sizes every texture has at its target level, the
+  // budget is enforced on it
+  VkDeviceSize target_bytes;
+  // device memory of the current images
+  VkDeviceSize resident_bytes;
+  VkDeviceSize peak_resident_bytes;
+  VkDeviceSize streamed_bytes;
+  uint32_t stream_in_count;
+  uint32_t evicted_level_count;
+  uint32_t denied_count;
+  // texture indices waiting for the I/O thread and the ones it finished,
+  // each texture has at most one load so both fit capacity
+  uint32_t* queue;
+  uint32_t queue_head;
+  uint32_t queue_count;
+  uint32_t* done;
+  uint32_t done_head;
+  uint32_t done_count;
+  SDL_Thread* thread;
+  SDL_mutex* mutex;
+  SDL_cond* work_available;
+  bool is_running;
+  bool is_sampler_init;
+  bool is_mutex_init;
+  bool is_work_available_init;
+  bool is_thread_init;
+  bool is_streamer_init;
+} VulkanTextureStreamer;
+
+// bindless may be nullptr, the budget is compared against the bytes of the
+// levels every texture keeps resident
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_init(VulkanTextureStreamer* streamer,
+                                 const VulkanDevice* vk_device,
+                                 VulkanAllocator* allocator,
+                                 VulkanUploader* uploader,
+                                 VulkanBindlessTable* bindless,
+                                 VkDeviceSize budget,
+                                 uint32_t capacity,
+                                 uint32_t frames_in_flight);
+void vulkan_texture_streamer_reset(VulkanTextureStreamer* streamer);
+// the device must be idle
+void vulkan_texture_streamer_destroy(VulkanTextureStreamer* streamer);
+
+// maps a KTX2 file and uploads its coarse levels, the file stays mapped
+// until the streamer is destroyed
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_add(VulkanTextureStreamer* streamer,
+                                const char* path,
+                                VulkanTextureHandle* handle);
+// marks the texture used this frame and asks for level, 0 being the full
+// resolution, to become resident
+void vulkan_texture_streamer_request(VulkanTextureStreamer* streamer,
+                                     VulkanTextureHandle handle,
+                                     uint32_t level);
+// Frees retired images, swaps in the textures the I/O thread finished
+// reading and plans the next loads against the budget. Runs once per frame
+// before the uploader flush, the frame that acquires the flush is the first
+// to see the new images. A texture that fails to stream keeps the levels it
+// has, the failure is only logged.
+Result(int, ErrorMessage)
+    vulkan_texture_streamer_update(VulkanTextureStreamer* streamer,
+                                   uint64_t frame_number);
+
+void vulkan_texture_streamer_log_stats(const VulkanTextureStreamer* streamer);
+
+#endif
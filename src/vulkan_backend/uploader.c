@@ -0,0 +1,727 @@
+#include "./uploader.h"
+
+#include "../utils/arena.h"
+#include "../utils/logger.h"
+#include "../utils/memory.h"
+#include "./debug.h"
+#include "./functions.h"
+
+// bufferOffset of a buffer to image copy must be a multiple of 4 and of the
+// texel block size, 16 covers every uncompressed and block compressed format
+#define VULKAN_UPLOADER_MIN_COPY_ALIGNMENT 16ull
+#define VULKAN_UPLOADER_MIN_BARRIER_CAPACITY 16
+
+static VkDeviceSize vulkan_uploader_round_up(VkDeviceSize value,
+                                             VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VulkanUploadBatch* vulkan_uploader_batch_at(VulkanUploader* uploader,
+                                                   uint32_t index) {
+  return &uploader->batches[(uploader->oldest_batch + index) %
+                            VULKAN_UPLOADER_MAX_BATCHES];
+}
+
+static VulkanUploadBatch* vulkan_uploader_open_batch(
+    VulkanUploader* uploader) {
+  if (uploader->batch_count == 0) {
+    return nullptr;
+  }
+  VulkanUploadBatch* newest =
+      vulkan_uploader_batch_at(uploader, uploader->batch_count - 1);
+  return newest->state == VULKAN_UPLOAD_BATCH_STATE_RECORDING ? newest
+                                                              : nullptr;
+}
+
+static bool vulkan_uploader_has_ownership_transfer(VulkanUploader* uploader) {
+  return uploader->transfer_queue_family != uploader->graphics_queue_family;
+}
+
+// Moves the ring tail past every batch the GPU finished reading, in
+// submission order. With block set it waits for the oldest unfinished batch.
+static Result(int, ErrorMessage)
+    vulkan_uploader_release(VulkanUploader* uploader, bool block) {
+  for (uint32_t i = 0; i < uploader->batch_count; i++) {
+    VulkanUploadBatch* batch = vulkan_uploader_batch_at(uploader, i);
+    if (batch->state == VULKAN_UPLOAD_BATCH_STATE_RECORDING) {
+      break;
+    }
+    if (batch->is_ring_released) {
+      continue;
+    }
+
+    VkResult result = uploader->fn->vkWaitForFences(
+        uploader->device, 1, &batch->fence, VK_TRUE, block ? UINT64_MAX : 0);
+    if (result == VK_TIMEOUT) {
+      break;
+    }
+    if (result != VK_SUCCESS) {
+      return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+    }
+    uploader->ring_tail = batch->ring_end;
+    batch->is_ring_released = true;
+    block = false;
+  }
+
+  // a batch slot is only reusable once a frame consumed its semaphore
+  while (uploader->batch_count > 0) {
+    VulkanUploadBatch* batch = vulkan_uploader_batch_at(uploader, 0);
+    if (batch->state != VULKAN_UPLOAD_BATCH_STATE_ACQUIRED ||
+        !batch->is_ring_released) {
+      break;
+    }
+    batch->state = VULKAN_UPLOAD_BATCH_STATE_FREE;
+    uploader->oldest_batch =
+        (uploader->oldest_batch + 1) % VULKAN_UPLOADER_MAX_BATCHES;
+    uploader->batch_count--;
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static bool vulkan_uploader_try_allocate(VulkanUploader* uploader,
+                                         VkDeviceSize size,
+                                         VkDeviceSize* offset) {
+  if (uploader->ring_head == uploader->ring_tail) {
+    uploader->ring_head = 0;
+    uploader->ring_tail = 0;
+  }
+
+  VkDeviceSize head = uploader->ring_head;
+  VkDeviceSize tail = uploader->ring_tail;
+  VkDeviceSize aligned =
+      vulkan_uploader_round_up(head, uploader->copy_alignment);
+  if (head >= tail) {
+    // in use is [tail, head), free space is behind head and in front of tail
+    if (aligned + size <= uploader->ring_size) {
+      *offset = aligned;
+    } else if (size < tail) {
+      *offset = 0;
+    } else {
+      return false;
+    }
+  } else {
+    // wrapped, free space is [head, tail). Head never catches up with tail,
+    // head == tail is reserved for the empty ring
+    if (aligned + size < tail) {
+      *offset = aligned;
+    } else {
+      return false;
+    }
+  }
+
+  uploader->ring_head = *offset + size;
+  return true;
+}
+
+static Result(int, ErrorMessage)
+    vulkan_uploader_allocate(VulkanUploader* uploader,
+                             VkDeviceSize size,
+                             VkDeviceSize* offset) {
+  if (size > uploader->ring_size) {
+    return Err(int, ErrorMessage)("Upload does not fit into the staging ring");
+  }
+
+  bool is_batch_start = vulkan_uploader_open_batch(uploader) == nullptr;
+  while (!vulkan_uploader_try_allocate(uploader, size, offset)) {
+    bool has_pending = false;
+    for (uint32_t i = 0; i < uploader->batch_count; i++) {
+      VulkanUploadBatch* batch = vulkan_uploader_batch_at(uploader, i);
+      if (batch->state != VULKAN_UPLOAD_BATCH_STATE_RECORDING &&
+          !batch->is_ring_released) {
+        has_pending = true;
+      }
+    }
+
+    if (!has_pending) {
+      // the open batch itself fills the ring, submit it so it can drain
+      if (vulkan_uploader_open_batch(uploader) == nullptr) {
+        return Err(int, ErrorMessage)(
+            "Upload does not fit into the staging ring");
+      }
+      auto flush_result = vulkan_uploader_flush(uploader);
+      if (!flush_result.is_ok) {
+        return flush_result;
+      }
+      is_batch_start = true;
+      continue;
+    }
+
+    uploader->stall_count++;
+    log_debug("Staging ring full, waiting for the transfer queue");
+    auto release_result = vulkan_uploader_release(uploader, true);
+    if (!release_result.is_ok) {
+      return release_result;
+    }
+  }
+
+  if (is_batch_start) {
+    uploader->flush_begin = *offset;
+  }
+  uploader->uploaded_bytes += size;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_uploader_begin_batch(VulkanUploader* uploader,
+                                VulkanUploadBatch** batch) {
+  VulkanUploadBatch* open = vulkan_uploader_open_batch(uploader);
+  if (open) {
+    *batch = open;
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  auto release_result = vulkan_uploader_release(uploader, false);
+  if (!release_result.is_ok) {
+    return release_result;
+  }
+  if (uploader->batch_count == VULKAN_UPLOADER_MAX_BATCHES) {
+    VulkanUploadBatch* oldest = vulkan_uploader_batch_at(uploader, 0);
+    if (oldest->state != VULKAN_UPLOAD_BATCH_STATE_ACQUIRED) {
+      return Err(int, ErrorMessage)(
+          "Too many upload batches waiting for a frame to acquire them");
+    }
+    uploader->stall_count++;
+    release_result = vulkan_uploader_release(uploader, true);
+    if (!release_result.is_ok) {
+      return release_result;
+    }
+  }
+
+  VulkanUploadBatch* next =
+      vulkan_uploader_batch_at(uploader, uploader->batch_count);
+  // the pool resets command buffers individually, begin discards the old
+  // recording
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr,
+  };
+  VkResult result = uploader->fn->vkBeginCommandBuffer(next->command_buffer,
+                                                       &begin_info);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  next->state = VULKAN_UPLOAD_BATCH_STATE_RECORDING;
+  next->is_ring_released = false;
+  // the arrays of the last round went away with a frame arena clear
+  next->buffer_barriers = nullptr;
+  next->buffer_barrier_count = 0;
+  next->buffer_barrier_capacity = 0;
+  next->image_barriers = nullptr;
+  next->image_barrier_count = 0;
+  next->image_barrier_capacity = 0;
+  uploader->batch_count++;
+  *batch = next;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+// doubles an array of barriers in the frame arena, the old one stays behind
+// until the clear
+static void* vulkan_upload_batch_grow(void* barriers,
+                                      uint32_t count,
+                                      uint32_t* capacity,
+                                      size_t barrier_size) {
+  uint32_t new_capacity =
+      *capacity ? *capacity * 2 : VULKAN_UPLOADER_MIN_BARRIER_CAPACITY;
+  Arena* arena = arena_frame();
+  void* new_barriers =
+      arena ? arena_alloc_array(arena, new_capacity, barrier_size) : nullptr;
+  if (!new_barriers) {
+    return nullptr;
+  }
+  if (count > 0) {
+    mem_copy(new_barriers, barriers, barrier_size * count);
+  }
+  *capacity = new_capacity;
+  return new_barriers;
+}
+
+static Result(int, ErrorMessage) vulkan_upload_batch_add_buffer_barrier(
+    VulkanUploadBatch* batch,
+    const VkBufferMemoryBarrier* barrier) {
+  // neighbouring uploads into the same buffer share one barrier
+  if (batch->buffer_barrier_count > 0) {
+    VkBufferMemoryBarrier* last =
+        &batch->buffer_barriers[batch->buffer_barrier_count - 1];
+    if (last->buffer == barrier->buffer &&
+        last->offset + last->size == barrier->offset) {
+      last->size += barrier->size;
+      return Ok(int, ErrorMessage)(0);
+    }
+  }
+
+  if (batch->buffer_barrier_count == batch->buffer_barrier_capacity) {
+    VkBufferMemoryBarrier* barriers = vulkan_upload_batch_grow(
+        batch->buffer_barriers, batch->buffer_barrier_count,
+        &batch->buffer_barrier_capacity, sizeof(VkBufferMemoryBarrier));
+    CHECK_ALLOC(barriers, Err(int, ErrorMessage)(
+                              "Unable to allocate memory for upload barriers"));
+    batch->buffer_barriers = barriers;
+  }
+  batch->buffer_barriers[batch->buffer_barrier_count++] = *barrier;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage) vulkan_upload_batch_add_image_barrier(
+    VulkanUploadBatch* batch,
+    const VkImageMemoryBarrier* barrier) {
+  if (batch->image_barrier_count == batch->image_barrier_capacity) {
+    VkImageMemoryBarrier* barriers = vulkan_upload_batch_grow(
+        batch->image_barriers, batch->image_barrier_count,
+        &batch->image_barrier_capacity, sizeof(VkImageMemoryBarrier));
+    CHECK_ALLOC(barriers, Err(int, ErrorMessage)(
+                              "Unable to allocate memory for upload barriers"));
+    batch->image_barriers = barriers;
+  }
+  batch->image_barriers[batch->image_barrier_count++] = *barrier;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_upload_batch_init(VulkanUploadBatch* batch,
+                             const VulkanDeviceFunctions* fn,
+                             VkDevice device,
+                             VkCommandPool command_pool) {
+  batch->state = VULKAN_UPLOAD_BATCH_STATE_FREE;
+
+  VkCommandBufferAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+  VkResult result = fn->vkAllocateCommandBuffers(device, &allocate_info,
+                                                 &batch->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  VkFenceCreateInfo fence_create_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = fn->vkCreateFence(device, &fence_create_info, nullptr,
+                             &batch->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  batch->is_fence_init = true;
+
+  VkSemaphoreCreateInfo semaphore_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+  };
+  result = fn->vkCreateSemaphore(device, &semaphore_create_info, nullptr,
+                                 &batch->semaphore);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  batch->is_semaphore_init = true;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_uploader_init(VulkanUploader* uploader,
+                                               const VulkanDevice* vk_device,
+                                               VulkanAllocator* allocator,
+                                               VkDeviceSize ring_size) {
+  uploader->device = vk_device->device;
+  uploader->fn = &vk_device->fn;
+  uploader->allocator = allocator;
+  uploader->queue = vk_device->transfer_queue;
+  uploader->transfer_queue_family = vk_device->transfer_queue_family;
+  uploader->graphics_queue_family = vk_device->graphics_queue_family;
+  uploader->ring_head = 0;
+  uploader->ring_tail = 0;
+  uploader->flush_begin = 0;
+  uploader->oldest_batch = 0;
+  uploader->batch_count = 0;
+  uploader->uploaded_bytes = 0;
+  uploader->stall_count = 0;
+
+  const VkPhysicalDeviceLimits* limits = &vk_device->info.properties.limits;
+  uploader->copy_alignment = limits->optimalBufferCopyOffsetAlignment;
+  if (uploader->copy_alignment < VULKAN_UPLOADER_MIN_COPY_ALIGNMENT) {
+    uploader->copy_alignment = VULKAN_UPLOADER_MIN_COPY_ALIGNMENT;
+  }
+  // flushed ranges are rounded to whole atoms, the ring must end on one
+  uploader->ring_size =
+      vulkan_uploader_round_up(ring_size, limits->nonCoherentAtomSize);
+
+  VkCommandPoolCreateInfo pool_create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+               VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = uploader->transfer_queue_family,
+  };
+  VkResult result = uploader->fn->vkCreateCommandPool(
+      uploader->device, &pool_create_info, nullptr, &uploader->command_pool);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  uploader->is_command_pool_init = true;
+
+  for (uint32_t i = 0; i < VULKAN_UPLOADER_MAX_BATCHES; i++) {
+    auto batch_result =
+        vulkan_upload_batch_init(&uploader->batches[i], uploader->fn,
+                                 uploader->device, uploader->command_pool);
+    if (!batch_result.is_ok) {
+      return batch_result;
+    }
+  }
+
+  // only the transfer queue reads the ring, it stays mapped for its lifetime
+  VkBufferCreateInfo buffer_create_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .size = uploader->ring_size,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+  };
+  auto buffer_result = vulkan_allocator_create_buffer(
+      allocator, &buffer_create_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uploader->ring_buffer,
+      &uploader->ring_allocation);
+  if (!buffer_result.is_ok) {
+    return buffer_result;
+  }
+  uploader->is_ring_init = true;
+  uploader->ring = uploader->ring_allocation.mapped;
+
+  VkMemoryPropertyFlags memory_flags =
+      vk_device->info.memory_properties
+          .memoryTypes[uploader->ring_allocation.memory_type]
+          .propertyFlags;
+  uploader->non_coherent_atom_size =
+      memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+          ? 0
+          : limits->nonCoherentAtomSize;
+
+  log_debug("Initialized uploader with a %llu KiB staging ring%s",
+            (unsigned long long)(uploader->ring_size / 1024),
+            vulkan_uploader_has_ownership_transfer(uploader)
+                ? " on a dedicated transfer queue"
+                : "");
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_uploader_reset(VulkanUploader* uploader) {
+  for (uint32_t i = 0; i < VULKAN_UPLOADER_MAX_BATCHES; i++) {
+    VulkanUploadBatch* batch = &uploader->batches[i];
+    batch->buffer_barriers = nullptr;
+    batch->buffer_barrier_count = 0;
+    batch->buffer_barrier_capacity = 0;
+    batch->image_barriers = nullptr;
+    batch->image_barrier_count = 0;
+    batch->image_barrier_capacity = 0;
+    batch->state = VULKAN_UPLOAD_BATCH_STATE_FREE;
+    batch->is_fence_init = false;
+    batch->is_semaphore_init = false;
+  }
+  uploader->ring = nullptr;
+  uploader->uploaded_bytes = 0;
+  uploader->oldest_batch = 0;
+  uploader->batch_count = 0;
+  uploader->is_command_pool_init = false;
+  uploader->is_ring_init = false;
+}
+
+void vulkan_uploader_destroy(VulkanUploader* uploader) {
+  if (uploader->uploaded_bytes > 0) {
+    log_debug("Uploaded %llu KiB, stalled on a full staging ring %u times",
+              (unsigned long long)(uploader->uploaded_bytes / 1024),
+              uploader->stall_count);
+  }
+
+  for (uint32_t i = 0; i < VULKAN_UPLOADER_MAX_BATCHES; i++) {
+    VulkanUploadBatch* batch = &uploader->batches[i];
+    if (batch->is_semaphore_init) {
+      uploader->fn->vkDestroySemaphore(uploader->device, batch->semaphore,
+                                       nullptr);
+    }
+    if (batch->is_fence_init) {
+      uploader->fn->vkDestroyFence(uploader->device, batch->fence, nullptr);
+    }
+  }
+  // destroying the pool frees the batch command buffers
+  if (uploader->is_command_pool_init) {
+    uploader->fn->vkDestroyCommandPool(uploader->device, uploader->command_pool,
+                                       nullptr);
+  }
+  if (uploader->is_ring_init) {
+    vulkan_allocator_destroy_buffer(uploader->allocator, uploader->ring_buffer,
+                                    &uploader->ring_allocation);
+  }
+  vulkan_uploader_reset(uploader);
+}
+
+Result(int, ErrorMessage)
+    vulkan_uploader_upload_buffer(VulkanUploader* uploader,
+                                  VkBuffer buffer,
+                                  VkDeviceSize offset,
+                                  const void* data,
+                                  VkDeviceSize size) {
+  if (size == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkDeviceSize ring_offset = 0;
+  auto result = vulkan_uploader_allocate(uploader, size, &ring_offset);
+  if (!result.is_ok) {
+    return result;
+  }
+  VulkanUploadBatch* batch = nullptr;
+  result = vulkan_uploader_begin_batch(uploader, &batch);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  mem_copy(uploader->ring + ring_offset, data, size);
+  VkBufferCopy region = {
+      .srcOffset = ring_offset,
+      .dstOffset = offset,
+      .size = size,
+  };
+  uploader->fn->vkCmdCopyBuffer(batch->command_buffer, uploader->ring_buffer,
+                                buffer, 1, &region);
+
+  // on a shared family the semaphore wait alone makes the copy visible
+  if (vulkan_uploader_has_ownership_transfer(uploader)) {
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = 0,
+        .srcQueueFamilyIndex = uploader->transfer_queue_family,
+        .dstQueueFamilyIndex = uploader->graphics_queue_family,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+    result = vulkan_upload_batch_add_buffer_barrier(batch, &barrier);
+    if (!result.is_ok) {
+      return result;
+    }
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage)
+    vulkan_uploader_upload_image(VulkanUploader* uploader,
+                                 const VulkanImageUpload* upload) {
+  VkDeviceSize ring_offset = 0;
+  auto result = vulkan_uploader_allocate(uploader, upload->size, &ring_offset);
+  if (!result.is_ok) {
+    return result;
+  }
+  VulkanUploadBatch* batch = nullptr;
+  result = vulkan_uploader_begin_batch(uploader, &batch);
+  if (!result.is_ok) {
+    return result;
+  }
+
+  mem_copy(uploader->ring + ring_offset, upload->data, upload->size);
+
+  VkImageSubresourceRange range = {
+      .aspectMask = upload->subresource.aspectMask,
+      .baseMipLevel = upload->subresource.mipLevel,
+      .levelCount = 1,
+      .baseArrayLayer = upload->subresource.baseArrayLayer,
+      .layerCount = upload->subresource.layerCount,
+  };
+  VkImageMemoryBarrier to_transfer = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = upload->image,
+      .subresourceRange = range,
+  };
+  uploader->fn->vkCmdPipelineBarrier(batch->command_buffer,
+                                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                     nullptr, 0, nullptr, 1, &to_transfer);
+
+  VkBufferImageCopy region = {
+      .bufferOffset = ring_offset,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource = upload->subresource,
+      .imageOffset = upload->offset,
+      .imageExtent = upload->extent,
+  };
+  uploader->fn->vkCmdCopyBufferToImage(
+      batch->command_buffer, uploader->ring_buffer, upload->image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  // recorded at flush, it doubles as the release half of the ownership
+  // transfer and has to be repeated on the graphics queue
+  bool is_transfer = vulkan_uploader_has_ownership_transfer(uploader);
+  uint32_t src_queue_family =
+      is_transfer ? uploader->transfer_queue_family : VK_QUEUE_FAMILY_IGNORED;
+  uint32_t dst_queue_family =
+      is_transfer ? uploader->graphics_queue_family : VK_QUEUE_FAMILY_IGNORED;
+  VkImageMemoryBarrier to_final = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .pNext = nullptr,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = 0,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = upload->final_layout,
+      .srcQueueFamilyIndex = src_queue_family,
+      .dstQueueFamilyIndex = dst_queue_family,
+      .image = upload->image,
+      .subresourceRange = range,
+  };
+  return vulkan_upload_batch_add_image_barrier(batch, &to_final);
+}
+
+static Result(int, ErrorMessage)
+    vulkan_uploader_flush_ring(VulkanUploader* uploader) {
+  if (uploader->non_coherent_atom_size == 0) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  VkDeviceSize atom = uploader->non_coherent_atom_size;
+  VkDeviceSize ranges[2][2] = {{uploader->flush_begin, uploader->ring_head}};
+  uint32_t range_count = 1;
+  if (uploader->ring_head < uploader->flush_begin) {
+    ranges[0][1] = uploader->ring_size;
+    ranges[1][0] = 0;
+    ranges[1][1] = uploader->ring_head;
+    range_count = 2;
+  }
+
+  VkMappedMemoryRange memory_ranges[2];
+  for (uint32_t i = 0; i < range_count; i++) {
+    VkDeviceSize begin = ranges[i][0] / atom * atom;
+    VkDeviceSize end = vulkan_uploader_round_up(ranges[i][1], atom);
+    memory_ranges[i] = (VkMappedMemoryRange){
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext = nullptr,
+        .memory = uploader->ring_allocation.memory,
+        .offset = uploader->ring_allocation.offset + begin,
+        .size = end - begin,
+    };
+  }
+  VkResult result =
+      uploader->fn->vkFlushMappedMemoryRanges(uploader->device, range_count,
+                                              memory_ranges);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+Result(int, ErrorMessage) vulkan_uploader_flush(VulkanUploader* uploader) {
+  auto release_result = vulkan_uploader_release(uploader, false);
+  if (!release_result.is_ok) {
+    return release_result;
+  }
+
+  VulkanUploadBatch* batch = vulkan_uploader_open_batch(uploader);
+  if (!batch) {
+    return Ok(int, ErrorMessage)(0);
+  }
+
+  if (batch->buffer_barrier_count > 0 || batch->image_barrier_count > 0) {
+    uploader->fn->vkCmdPipelineBarrier(
+        batch->command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+        batch->buffer_barrier_count, batch->buffer_barriers,
+        batch->image_barrier_count, batch->image_barriers);
+  }
+  VkResult result = uploader->fn->vkEndCommandBuffer(batch->command_buffer);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  auto flush_result = vulkan_uploader_flush_ring(uploader);
+  if (!flush_result.is_ok) {
+    return flush_result;
+  }
+
+  result = uploader->fn->vkResetFences(uploader->device, 1, &batch->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+  VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .pNext = nullptr,
+      .waitSemaphoreCount = 0,
+      .pWaitSemaphores = nullptr,
+      .pWaitDstStageMask = nullptr,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &batch->command_buffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &batch->semaphore,
+  };
+  result = uploader->fn->vkQueueSubmit(uploader->queue, 1, &submit_info,
+                                       batch->fence);
+  if (result != VK_SUCCESS) {
+    return Err(int, ErrorMessage)(vulkan_result_to_string(result));
+  }
+
+  batch->ring_end = uploader->ring_head;
+  batch->state = VULKAN_UPLOAD_BATCH_STATE_SUBMITTED;
+
+  return Ok(int, ErrorMessage)(0);
+}
+
+void vulkan_uploader_acquire(VulkanUploader* uploader,
+                             VkCommandBuffer command_buffer,
+                             VulkanUploadWait* wait) {
+  wait->count = 0;
+  bool is_transfer = vulkan_uploader_has_ownership_transfer(uploader);
+
+  for (uint32_t i = 0; i < uploader->batch_count; i++) {
+    VulkanUploadBatch* batch = vulkan_uploader_batch_at(uploader, i);
+    if (batch->state != VULKAN_UPLOAD_BATCH_STATE_SUBMITTED) {
+      continue;
+    }
+
+    if (is_transfer &&
+        (batch->buffer_barrier_count > 0 || batch->image_barrier_count > 0)) {
+      // same barriers as the release, only the access masks change sides
+      for (uint32_t j = 0; j < batch->buffer_barrier_count; j++) {
+        batch->buffer_barriers[j].srcAccessMask = 0;
+        batch->buffer_barriers[j].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+      }
+      for (uint32_t j = 0; j < batch->image_barrier_count; j++) {
+        batch->image_barriers[j].srcAccessMask = 0;
+        batch->image_barriers[j].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+      }
+      uploader->fn->vkCmdPipelineBarrier(
+          command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+          batch->buffer_barrier_count, batch->buffer_barriers,
+          batch->image_barrier_count, batch->image_barriers);
+    }
+
+    wait->semaphores[wait->count] = batch->semaphore;
+    wait->stages[wait->count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    wait->count++;
+    batch->state = VULKAN_UPLOAD_BATCH_STATE_ACQUIRED;
+  }
+}
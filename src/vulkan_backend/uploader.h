@@ -0,0 +1,131 @@
+#ifndef VULKAN_BACKEND_UPLOADER_H
+#define VULKAN_BACKEND_UPLOADER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "../result.h"
+#include "./allocator.h"
+#include "./device.h"
+
+#define VULKAN_UPLOADER_MAX_BATCHES 8
+
+typedef enum VulkanUploadBatchState {
+  VULKAN_UPLOAD_BATCH_STATE_FREE,
+  VULKAN_UPLOAD_BATCH_STATE_RECORDING,
+  // submitted to the transfer queue, no frame waits on it yet
+  VULKAN_UPLOAD_BATCH_STATE_SUBMITTED,
+  // a frame waits on the semaphore, the batch is free once its fence signals
+  VULKAN_UPLOAD_BATCH_STATE_ACQUIRED,
+} VulkanUploadBatchState;
+
+// One submission on the transfer queue, all uploads between two flushes are
+// recorded into the same command buffer
+typedef struct VulkanUploadBatch {
+  VkCommandBuffer command_buffer;
+  VkFence fence;
+  VkSemaphore semaphore;
+  // ring head after the last upload of the batch, the tail moves here once
+  // the fence signaled
+  VkDeviceSize ring_end;
+  bool is_ring_released;
+  // release barriers of the queue family ownership transfers, recorded again
+  // on the graphics queue as the matching acquire. They live in the frame
+  // arena of the uploading thread, the frame clears it only after acquiring
+  // every submitted batch.
+  VkBufferMemoryBarrier* buffer_barriers;
+  uint32_t buffer_barrier_count;
+  uint32_t buffer_barrier_capacity;
+  VkImageMemoryBarrier* image_barriers;
+  uint32_t image_barrier_count;
+  uint32_t image_barrier_capacity;
+  VulkanUploadBatchState state;
+  bool is_fence_init;
+  bool is_semaphore_init;
+} VulkanUploadBatch;
+
+typedef struct VulkanImageUpload {
+  VkImage image;
+  VkImageSubresourceLayers subresource;
+  VkOffset3D offset;
+  VkExtent3D extent;
+  // the previous contents of the subresource are discarded
+  VkImageLayout final_layout;
+  const void* data;
+  VkDeviceSize size;
+} VulkanImageUpload;
+
+// Semaphores a graphics submission waits on before it uses uploaded data
+typedef struct VulkanUploadWait {
+  VkSemaphore semaphores[VULKAN_UPLOADER_MAX_BATCHES];
+  VkPipelineStageFlags stages[VULKAN_UPLOADER_MAX_BATCHES];
+  uint32_t count;
+} VulkanUploadWait;
+
+// Streams data to device local resources through a persistently mapped
+// staging ring. Uploads are batched into one transfer queue submission per
+// flush, the graphics queue only waits on them in the frame that acquires
+// them, so copies overlap with the frames still rendering.
+//
+// Resources written from a dedicated transfer family change queue family
+// ownership, they must be created VK_SHARING_MODE_EXCLUSIVE and the written
+// ranges are treated as fresh data.
+typedef struct VulkanUploader {
+  VkDevice device;
+  const VulkanDeviceFunctions* fn;
+  VulkanAllocator* allocator;
+  VkQueue queue;
+  uint32_t transfer_queue_family;
+  uint32_t graphics_queue_family;
+  VkCommandPool command_pool;
+  VkBuffer ring_buffer;
+  VulkanAllocation ring_allocation;
+  uint8_t* ring;
+  VkDeviceSize ring_size;
+  // written up to head, the GPU may still read from tail, head == tail means
+  // the ring is empty
+  VkDeviceSize ring_head;
+  VkDeviceSize ring_tail;
+  VkDeviceSize copy_alignment;
+  // 0 for host coherent memory, otherwise written ranges are flushed
+  VkDeviceSize non_coherent_atom_size;
+  VkDeviceSize flush_begin;
+  VulkanUploadBatch batches[VULKAN_UPLOADER_MAX_BATCHES];
+  // batches are used in submission order starting at oldest_batch
+  uint32_t oldest_batch;
+  uint32_t batch_count;
+  VkDeviceSize uploaded_bytes;
+  uint32_t stall_count;
+  bool is_command_pool_init;
+  bool is_ring_init;
+} VulkanUploader;
+
+Result(int, ErrorMessage) vulkan_uploader_init(VulkanUploader* uploader,
+                                               const VulkanDevice* vk_device,
+                                               VulkanAllocator* allocator,
+                                               VkDeviceSize ring_size);
+void vulkan_uploader_reset(VulkanUploader* uploader);
+void vulkan_uploader_destroy(VulkanUploader* uploader);
+
+// Copies data into the ring and records the copy into the open batch. Only
+// blocks when the ring is full of data the GPU has not consumed yet.
+Result(int, ErrorMessage)
+    vulkan_uploader_upload_buffer(VulkanUploader* uploader,
+                                  VkBuffer buffer,
+                                  VkDeviceSize offset,
+                                  const void* data,
+                                  VkDeviceSize size);
+Result(int, ErrorMessage)
+    vulkan_uploader_upload_image(VulkanUploader* uploader,
+                                 const VulkanImageUpload* upload);
+
+// submits the open batch to the transfer queue, does nothing without uploads
+Result(int, ErrorMessage) vulkan_uploader_flush(VulkanUploader* uploader);
+// records the ownership acquire barriers of every flushed batch into a
+// graphics command buffer, the submission of that command buffer has to wait
+// on the returned semaphores
+void vulkan_uploader_acquire(VulkanUploader* uploader,
+                             VkCommandBuffer command_buffer,
+                             VulkanUploadWait* wait);
+
+#endif
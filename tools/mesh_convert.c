@@ -0,0 +1,22 @@
+#include <stdlib.h>
+
+#include "../src/assets/mesh_convert.h"
+#include "../src/result.h"
+#include "../src/utils/logger.h"
+
+int main(int argc, char* argv[argc + 1]) {
+  if (argc != 3) {
+    log_error("Usage: %s <input.obj> <output.mesh>", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  MeshBuilder builder;
+  mesh_builder_init(&builder);
+  auto result = mesh_convert(&builder, argv[1], argv[2]);
+  mesh_builder_destroy(&builder);
+  if (!result.is_ok) {
+    log_error("Unable to convert %s: %s", argv[1], result.error);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}